@@ -129,6 +129,12 @@ enum lttng_event_output {
 	LTTNG_EVENT_MMAP                      = 1,
 };
 
+/* Compression of the trace data streamed to the relay daemon. */
+enum lttng_compression {
+	LTTNG_COMPRESSION_NONE                = 0,
+	LTTNG_COMPRESSION_LZ4                 = 1,
+};
+
 /* Event context possible type */
 enum lttng_event_context_type {
 	LTTNG_EVENT_CONTEXT_PID               = 0,
@@ -299,7 +305,7 @@ struct lttng_event_field {
  *
  * The structures should be initialized to zero before use.
  */
-#define LTTNG_CHANNEL_ATTR_PADDING1        LTTNG_SYMBOL_NAME_LEN + 12
+#define LTTNG_CHANNEL_ATTR_PADDING1        LTTNG_SYMBOL_NAME_LEN + 8
 struct lttng_channel_attr {
 	int overwrite;                      /* 1: overwrite, 0: discard */
 	uint64_t subbuf_size;               /* bytes */
@@ -312,6 +318,11 @@ struct lttng_channel_attr {
 	uint64_t tracefile_count;           /* number of tracefiles */
 	/* LTTng 2.3 padding limit */
 	unsigned int live_timer_interval;   /* usec */
+	/*
+	 * 1: create the channel with the sub-buffer size and count recommended
+	 * from the events it discarded in the previous session of the same name.
+	 */
+	unsigned int auto_buffer_size;
 
 	char padding[LTTNG_CHANNEL_ATTR_PADDING1];
 };
@@ -330,6 +341,64 @@ struct lttng_channel {
 	char padding[LTTNG_CHANNEL_PADDING1];
 };
 
+/*
+ * Memory used by the buffers of a channel for one application (per-PID
+ * buffers), one user (per-UID buffers) or the kernel. The metadata channel is
+ * reported under the "metadata" name along with its metadata cache.
+ *
+ * This is an 'output data' meaning that it only comes *from* the session
+ * daemon *to* the lttng client.
+ */
+#define LTTNG_MEMORY_USAGE_PADDING1        64
+struct lttng_memory_usage {
+	char channel_name[LTTNG_SYMBOL_NAME_LEN];
+	int32_t pid;			/* -1 if the buffers are not per-PID. */
+	int32_t uid;			/* -1 for the kernel domain. */
+	uint32_t bits_per_long;
+	uint32_t nr_streams;		/* Streams mapped by the consumer. */
+	uint64_t buffer_size;		/* Bytes of sub-buffers of all streams. */
+	uint64_t metadata_cache_size;	/* Bytes, metadata channel only. */
+
+	char padding[LTTNG_MEMORY_USAGE_PADDING1];
+};
+
+/*
+ * Number of buckets of the write latency histogram of a stream. Bucket 0
+ * counts the sub-buffers written in less than 1 usec, bucket i those written
+ * in [2^(i-1), 2^i) usec and the last bucket everything above.
+ */
+#define LTTNG_STREAM_STATS_LATENCY_BUCKETS	24
+
+/*
+ * Statistics of the consumer daemon about a stream, or a whole channel when
+ * stream_name is empty. Channel totals include the streams already deleted.
+ *
+ * The write latency of a sub-buffer is the time from the moment the consumer
+ * wakes up to read the stream until the sub-buffer is written to the trace
+ * file or sent to the relay daemon.
+ *
+ * This is an 'output data' meaning that it only comes *from* the session
+ * daemon *to* the lttng client.
+ */
+#define LTTNG_STREAM_STATS_PADDING1        64
+struct lttng_stream_stats {
+	char channel_name[LTTNG_SYMBOL_NAME_LEN];
+	char stream_name[LTTNG_SYMBOL_NAME_LEN];	/* Empty for a channel. */
+	uint64_t channel_key;		/* Consumer channel key. */
+	int32_t uid;			/* Owner of the buffers. */
+	uint32_t metadata;		/* 1 for the metadata channel. */
+	uint64_t elapsed;		/* Nsec since the first sub-buffer. */
+	uint64_t subbuf_count;		/* Sub-buffers consumed. */
+	uint64_t bytes_consumed;	/* Bytes of sub-buffers consumed. */
+	uint64_t bytes_written;		/* Bytes written or sent, once compressed. */
+	uint64_t events_discarded;	/* Reported by the tracer. */
+	uint64_t latency_total;		/* Nsec, sum over all sub-buffers. */
+	uint64_t latency_max;		/* Nsec. */
+	uint64_t latency_hist[LTTNG_STREAM_STATS_LATENCY_BUCKETS];
+
+	char padding[LTTNG_STREAM_STATS_PADDING1];
+};
+
 #define LTTNG_CALIBRATE_PADDING1           16
 struct lttng_calibrate {
 	enum lttng_calibrate_type type;
@@ -440,6 +509,16 @@ extern int lttng_create_session_snapshot(const char *name,
 extern int lttng_create_session_live(const char *name, const char *url,
 		unsigned int timer_interval);
 
+/*
+ * Set the compression of the trace data sent to the relay daemon by a network
+ * session. It must be set before the first channel of the session is enabled.
+ * If the relay daemon does not support it, the data is sent uncompressed.
+ *
+ * Returns LTTNG_OK on success or a negative error code.
+ */
+extern int lttng_set_session_compression(const char *name,
+		enum lttng_compression compression);
+
 /*
  * Destroy a tracing session.
  *
@@ -476,6 +555,26 @@ extern int lttng_list_domains(const char *session_name,
 extern int lttng_list_channels(struct lttng_handle *handle,
 		struct lttng_channel **channels);
 
+/*
+ * List the buffer memory used by the channels of a session for the domain of
+ * the handle, per application or user.
+ *
+ * Return the size (number of entries) of the "lttng_memory_usage" array.
+ * Caller must free(3).
+ */
+extern int lttng_list_memory_usage(struct lttng_handle *handle,
+		struct lttng_memory_usage **usage);
+
+/*
+ * List the consumer statistics of the streams and channels of a session for
+ * the domain of the handle.
+ *
+ * Return the size (number of entries) of the "lttng_stream_stats" array.
+ * Caller must free(3).
+ */
+extern int lttng_list_stream_stats(struct lttng_handle *handle,
+		struct lttng_stream_stats **stats);
+
 /*
  * List the event(s) of a session channel.
  *
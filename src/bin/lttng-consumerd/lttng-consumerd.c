@@ -45,6 +45,8 @@
 #include <common/common.h>
 #include <common/consumer.h>
 #include <common/consumer-timer.h>
+#include <common/consumer-uring.h>
+#include <common/compress/compress.h>
 #include <common/compat/poll.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/utils.h>
@@ -288,6 +290,8 @@ int main(int argc, char **argv)
 {
 	int ret = 0;
 	void *status;
+	const char *env_read_budget, *env_uring_depth, *env_direct_io;
+	const char *env_compress_output;
 
 	/* Parse arguments */
 	progname = argv[0];
@@ -320,6 +324,45 @@ int main(int argc, char **argv)
 	/* Set up max poll set size */
 	lttng_poll_set_max_size();
 
+	env_read_budget = getenv(DEFAULT_CONSUMER_READ_BUDGET_ENV);
+	if (env_read_budget) {
+		char *endptr;
+		unsigned long v;
+
+		/* strtoul() wraps negative values, INT_MAX rejects them. */
+		errno = 0;
+		v = strtoul(env_read_budget, &endptr, 0);
+		if (errno != 0 || endptr == env_read_budget || *endptr != '\0' ||
+				v == 0 || v > INT_MAX) {
+			WARN("Invalid %s value %s, using %d",
+					DEFAULT_CONSUMER_READ_BUDGET_ENV, env_read_budget,
+					DEFAULT_CONSUMER_READ_BUDGET);
+		} else {
+			lttng_consumer_set_read_budget(v);
+		}
+	}
+
+	env_uring_depth = getenv(DEFAULT_CONSUMER_IO_URING_DEPTH_ENV);
+	if (env_uring_depth && atoi(env_uring_depth) > 0) {
+		consumer_uring_set_depth(atoi(env_uring_depth));
+	}
+
+	env_direct_io = getenv(DEFAULT_CONSUMER_DIRECT_IO_ENV);
+	if (env_direct_io) {
+		lttng_consumer_set_direct_io(atoi(env_direct_io));
+	}
+
+	env_compress_output = getenv(DEFAULT_CONSUMER_COMPRESS_OUTPUT_ENV);
+	if (env_compress_output) {
+		enum lttng_compression compression;
+
+		if (compress_parse_type(env_compress_output, &compression) < 0) {
+			ERR("Unknown trace file compression %s", env_compress_output);
+			goto error;
+		}
+		lttng_consumer_set_output_compression(compression);
+	}
+
 	if (*command_sock_path == '\0') {
 		switch (opt_type) {
 		case LTTNG_CONSUMER_KERNEL:
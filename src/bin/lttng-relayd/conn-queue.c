@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+
+#include "conn-queue.h"
+
+/*
+ * Initialize an empty connection queue.
+ *
+ * Return 0 on success else a negative value.
+ */
+int relay_conn_queue_init(struct relay_conn_queue *queue)
+{
+	assert(queue);
+
+	cds_wfq_init(&queue->queue);
+	queue->wakeup_pending = 0;
+	queue->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (queue->event_fd < 0) {
+		PERROR("eventfd connection queue");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Destroy the connections left in a queue and release it. No thread may use
+ * the queue anymore. A queue which is not initialized MUST have an event_fd of
+ * -1.
+ */
+void relay_conn_queue_fini(struct relay_conn_queue *queue)
+{
+	int ret;
+	struct relay_connection *conn;
+
+	assert(queue);
+
+	/* Never initialized. */
+	if (queue->event_fd < 0) {
+		return;
+	}
+
+	while ((conn = relay_conn_queue_dequeue(queue))) {
+		connection_destroy(conn);
+	}
+	ret = close(queue->event_fd);
+	if (ret) {
+		PERROR("close connection queue eventfd");
+	}
+	queue->event_fd = -1;
+}
+
+/*
+ * Hand a connection to the worker thread. Only the enqueue finding the worker
+ * without a pending wake up writes to event_fd.
+ */
+void relay_conn_queue_enqueue(struct relay_conn_queue *queue,
+		struct relay_connection *conn)
+{
+	ssize_t ret;
+	uint64_t count = 1;
+
+	assert(queue);
+	assert(conn);
+
+	/* Implicit memory barrier with the exchange in cds_wfq_enqueue. */
+	cds_wfq_enqueue(&queue->queue, &conn->qnode);
+
+	if (uatomic_cmpxchg(&queue->wakeup_pending, 0, 1) != 0) {
+		return;
+	}
+	do {
+		ret = write(queue->event_fd, &count, sizeof(count));
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		/* Only a counter overflow fails, the worker is awake anyway. */
+		PERROR("write connection queue eventfd");
+	}
+}
+
+/*
+ * Acknowledge a wake up of the worker thread, which MUST then dequeue until
+ * the queue is empty: connections enqueued from now on wake it up again.
+ */
+void relay_conn_queue_ack(struct relay_conn_queue *queue)
+{
+	ssize_t ret;
+	uint64_t count;
+
+	assert(queue);
+
+	do {
+		ret = read(queue->event_fd, &count, sizeof(count));
+	} while (ret < 0 && errno == EINTR);
+
+	uatomic_set(&queue->wakeup_pending, 0);
+	/* Order the reset before the dequeues, paired with cds_wfq_enqueue. */
+	cmm_smp_mb();
+}
+
+/*
+ * Return the next queued connection or NULL if the queue is empty. Only the
+ * worker thread dequeues.
+ */
+struct relay_connection *relay_conn_queue_dequeue(
+		struct relay_conn_queue *queue)
+{
+	struct cds_wfq_node *node;
+
+	assert(queue);
+
+	node = cds_wfq_dequeue_blocking(&queue->queue);
+	if (!node) {
+		return NULL;
+	}
+	return caa_container_of(node, struct relay_connection, qnode);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _RELAYD_CONN_QUEUE_H
+#define _RELAYD_CONN_QUEUE_H
+
+#include <urcu/wfqueue.h>
+
+#include "connection.h"
+
+/*
+ * Queue of the connections accepted by a listener thread for a worker thread.
+ * Listeners enqueue without locking and the worker polls event_fd along with
+ * its sockets, so a connection reaches the worker without any thread hop.
+ */
+struct relay_conn_queue {
+	struct cds_wfq_queue queue;
+	/* Readable once connections are queued, polled by the worker. */
+	int event_fd;
+	/* Set from the first enqueue until the worker acknowledges event_fd. */
+	unsigned long wakeup_pending;
+};
+
+int relay_conn_queue_init(struct relay_conn_queue *queue);
+void relay_conn_queue_fini(struct relay_conn_queue *queue);
+void relay_conn_queue_enqueue(struct relay_conn_queue *queue,
+		struct relay_connection *conn);
+void relay_conn_queue_ack(struct relay_conn_queue *queue);
+struct relay_connection *relay_conn_queue_dequeue(
+		struct relay_conn_queue *queue);
+
+#endif /* _RELAYD_CONN_QUEUE_H */
@@ -89,6 +89,7 @@ struct relay_connection *connection_create(void)
 		PERROR("zmalloc relay connection");
 		goto error;
 	}
+	relay_stats_init(&conn->stats);
 
 error:
 	return conn;
@@ -30,6 +30,7 @@
 #include <common/sessiond-comm/sessiond-comm.h>
 
 #include "session.h"
+#include "stats.h"
 
 enum connection_type {
 	RELAY_DATA                  = 1,
@@ -53,10 +54,16 @@ struct relay_connection {
 	/* Protocol version to use for this connection. */
 	uint32_t major;
 	uint32_t minor;
+	/* enum lttng_compression acknowledged by the version check. */
+	uint32_t compression;
 	uint64_t session_id;
 	struct cds_list_head recv_head;
 	unsigned int version_check_done:1;
 
+	/* Counters of a data or control connection, see stats.h. */
+	struct relay_stats stats;
+	struct cds_list_head stats_node;
+
 	/* Pointer to the sessions HT that this connection can use. */
 	struct lttng_ht *sessions_ht;
 };
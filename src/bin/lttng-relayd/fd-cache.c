@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <common/common.h>
+
+#include "fd-cache.h"
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Files open and not in use, least recently used first. */
+static CDS_LIST_HEAD(lru_head);
+
+/* Maximum number of open files, 0 means no limit. */
+static unsigned int cache_cap;
+static unsigned int nr_open;
+
+/*
+ * Set the maximum number of files kept open at once. Must be called before
+ * any file is created.
+ */
+void relay_fd_cache_init(unsigned int cap)
+{
+	cache_cap = cap;
+	DBG("Relay fd cache capped at %u open files", cap);
+}
+
+/*
+ * Close the fd of the least recently used file until we are below the cap.
+ * Files in use are never closed so the cap can be exceeded temporarily.
+ *
+ * Cache lock MUST be held.
+ */
+static void evict_files(void)
+{
+	int ret, flags;
+	struct relay_fd *file;
+
+	while (cache_cap && nr_open >= cache_cap && !cds_list_empty(&lru_head)) {
+		file = cds_list_first_entry(&lru_head, struct relay_fd, lru_node);
+		cds_list_del_init(&file->lru_node);
+
+		file->offset = lseek(file->fd, 0, SEEK_CUR);
+		if (file->offset < 0) {
+			PERROR("lseek relay fd %d", file->fd);
+			file->offset = 0;
+		}
+		/* Direct I/O can have been disabled since the file was opened. */
+		flags = fcntl(file->fd, F_GETFL);
+		if (flags >= 0 && !(flags & O_DIRECT)) {
+			file->flags &= ~O_DIRECT;
+		}
+		ret = close(file->fd);
+		if (ret < 0) {
+			PERROR("close relay fd %d", file->fd);
+		}
+		DBG3("Relay fd cache closed %s", file->path);
+		file->fd = -1;
+		nr_open--;
+	}
+}
+
+/*
+ * Reopen a file closed by the cache at the offset it had.
+ *
+ * Cache lock MUST be held.
+ */
+static int reopen_file(struct relay_fd *file)
+{
+	int fd;
+	off_t ret;
+
+	evict_files();
+
+	fd = open(file->path, file->flags);
+	if (fd < 0) {
+		PERROR("reopen %s", file->path);
+		return -errno;
+	}
+
+	ret = lseek(fd, file->offset, SEEK_SET);
+	if (ret < 0) {
+		PERROR("lseek %s", file->path);
+		(void) close(fd);
+		return -errno;
+	}
+
+	DBG3("Relay fd cache reopened %s", file->path);
+	file->fd = fd;
+	nr_open++;
+	return 0;
+}
+
+/*
+ * Track an open fd in the cache. The fd is owned by the returned file from now
+ * on and is closed on error.
+ *
+ * Return a file with a reference held by the caller or NULL on error.
+ */
+struct relay_fd *relay_fd_create(int fd)
+{
+	int flags;
+	ssize_t len;
+	char proc_path[32], path[PATH_MAX];
+	struct relay_fd *file = NULL;
+
+	assert(fd >= 0);
+
+	/*
+	 * Get the path of the file from the kernel rather than rebuilding it from
+	 * the stream information, every caller building it its own way.
+	 */
+	snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+	len = readlink(proc_path, path, sizeof(path) - 1);
+	if (len < 0) {
+		PERROR("readlink %s", proc_path);
+		goto error;
+	}
+	path[len] = '\0';
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0) {
+		PERROR("fcntl get flags");
+		goto error;
+	}
+
+	file = zmalloc(sizeof(*file));
+	if (!file) {
+		PERROR("zmalloc relay fd");
+		goto error;
+	}
+	file->path = strdup(path);
+	if (!file->path) {
+		PERROR("strdup relay fd path");
+		goto error;
+	}
+	file->fd = fd;
+	file->flags = (flags & (O_ACCMODE | O_DIRECT)) | O_CLOEXEC;
+	file->refcount = 1;
+	CDS_INIT_LIST_HEAD(&file->lru_node);
+
+	pthread_mutex_lock(&cache_lock);
+	evict_files();
+	nr_open++;
+	cds_list_add_tail(&file->lru_node, &lru_head);
+	pthread_mutex_unlock(&cache_lock);
+
+	return file;
+
+error:
+	if (file) {
+		free(file->path);
+		free(file);
+	}
+	if (close(fd) < 0) {
+		PERROR("close relay fd");
+	}
+	return NULL;
+}
+
+void relay_fd_get_ref(struct relay_fd *file)
+{
+	assert(file);
+
+	pthread_mutex_lock(&cache_lock);
+	assert(file->refcount > 0);
+	file->refcount++;
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/*
+ * Release a reference on a file, closing and freeing it when it was the last
+ * one.
+ */
+void relay_fd_put_ref(struct relay_fd *file)
+{
+	int ret;
+
+	assert(file);
+
+	pthread_mutex_lock(&cache_lock);
+	assert(file->refcount > 0);
+	if (--file->refcount) {
+		pthread_mutex_unlock(&cache_lock);
+		return;
+	}
+	assert(file->use_count == 0);
+	cds_list_del(&file->lru_node);
+	if (file->fd >= 0) {
+		nr_open--;
+	}
+	pthread_mutex_unlock(&cache_lock);
+
+	if (file->fd >= 0) {
+		ret = close(file->fd);
+		if (ret < 0) {
+			PERROR("close relay fd %d", file->fd);
+		}
+	}
+	free(file->path);
+	free(file);
+}
+
+/*
+ * Get the fd of a file, reopening it if it was closed by the cache. The fd
+ * can't be closed by the cache until relay_fd_release() is called.
+ *
+ * Return the fd or a negative value on error.
+ */
+int relay_fd_acquire(struct relay_fd *file)
+{
+	int ret;
+
+	assert(file);
+
+	pthread_mutex_lock(&cache_lock);
+	if (file->fd < 0) {
+		ret = reopen_file(file);
+		if (ret < 0) {
+			goto end;
+		}
+	} else if (file->use_count == 0) {
+		cds_list_del_init(&file->lru_node);
+	}
+	file->use_count++;
+	ret = file->fd;
+
+end:
+	pthread_mutex_unlock(&cache_lock);
+	return ret;
+}
+
+/*
+ * Done using the fd returned by relay_fd_acquire(). The file becomes the most
+ * recently used one.
+ */
+void relay_fd_release(struct relay_fd *file)
+{
+	assert(file);
+
+	pthread_mutex_lock(&cache_lock);
+	assert(file->use_count > 0);
+	if (--file->use_count == 0) {
+		cds_list_add_tail(&file->lru_node, &lru_head);
+	}
+	pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _RELAY_FD_CACHE_H
+#define _RELAY_FD_CACHE_H
+
+#include <sys/types.h>
+#include <urcu/list.h>
+
+/*
+ * File used by the relayd for a stream, an index or a viewer stream. The
+ * underlying fd is closed when the number of open files goes over the cap and
+ * the file is the least recently used one, and transparently reopened at the
+ * same offset the next time it is acquired.
+ *
+ * Every field is protected by the cache lock.
+ */
+struct relay_fd {
+	/* -1 while the file is closed by the cache. */
+	int fd;
+	char *path;
+	/* Access mode, and direct I/O, used to reopen the file. */
+	int flags;
+	/* File offset saved when the fd is closed by the cache. */
+	off_t offset;
+	/* Number of objects referencing this file. */
+	unsigned int refcount;
+	/* Number of users of the fd, which can't be closed while in use. */
+	unsigned int use_count;
+	/* Member of the LRU list when open and not in use. */
+	struct cds_list_head lru_node;
+};
+
+void relay_fd_cache_init(unsigned int cap);
+
+struct relay_fd *relay_fd_create(int fd);
+void relay_fd_get_ref(struct relay_fd *file);
+void relay_fd_put_ref(struct relay_fd *file);
+
+int relay_fd_acquire(struct relay_fd *file);
+void relay_fd_release(struct relay_fd *file);
+
+#endif /* _RELAY_FD_CACHE_H */
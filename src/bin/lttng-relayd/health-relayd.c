@@ -88,7 +88,7 @@ static int send_unix_sock(int sock, void *buf, size_t len)
 	return lttcomm_send_unix_sock(sock, buf, len);
 }
 
-static int create_lttng_rundir_with_perm(const char *rundir)
+int create_lttng_rundir_with_perm(const char *rundir)
 {
 	int ret;
 
@@ -130,36 +130,36 @@ error:
 	return ret;
 }
 
-static
-int parse_health_env(void)
-{
-	const char *health_path;
-
-	health_path = getenv(LTTNG_RELAYD_HEALTH_ENV);
-	if (health_path) {
-		strncpy(health_unix_sock_path, health_path,
-			PATH_MAX);
-		health_unix_sock_path[PATH_MAX - 1] = '\0';
-	}
-
-	return 0;
-}
-
-static
-int setup_health_path(void)
+/*
+ * Set path to the Unix socket of the relay daemon named by the env_var
+ * environment variable, else to global_fmt, formatted with the pid, for root
+ * or to home_fmt, formatted with the home directory and the pid, for the
+ * other users. The run directories of the latter two are created.
+ *
+ * Return 0 on success else a negative value.
+ */
+int setup_relayd_sock_path(char *path, size_t len, const char *env_var,
+		const char *global_fmt, const char *home_fmt)
 {
 	int is_root, ret = 0;
-	char *home_path = NULL, *rundir = NULL, *relayd_path;
+	const char *env_path;
+	char *home_path = NULL, *rundir = NULL, *relayd_path = NULL;
 
-	ret = parse_health_env();
-	if (ret) {
-		return ret;
+	env_path = getenv(env_var);
+	if (env_path) {
+		strncpy(path, env_path, len);
+		path[len - 1] = '\0';
+		goto end;
 	}
 
 	is_root = !getuid();
 
 	if (is_root) {
 		rundir = strdup(DEFAULT_LTTNG_RUNDIR);
+		if (!rundir) {
+			ret = -ENOMEM;
+			goto end;
+		}
 	} else {
 		/*
 		 * Create rundir from home path. This will create something like
@@ -176,6 +176,7 @@ int setup_health_path(void)
 
 		ret = asprintf(&rundir, DEFAULT_LTTNG_HOME_RUNDIR, home_path);
 		if (ret < 0) {
+			rundir = NULL;
 			ret = -ENOMEM;
 			goto end;
 		}
@@ -183,6 +184,7 @@ int setup_health_path(void)
 
 	ret = asprintf(&relayd_path, DEFAULT_RELAYD_PATH, rundir);
 	if (ret < 0) {
+		relayd_path = NULL;
 		ret = -ENOMEM;
 		goto end;
 	}
@@ -198,24 +200,13 @@ int setup_health_path(void)
 	}
 
 	if (is_root) {
-		if (strlen(health_unix_sock_path) != 0) {
-			goto end;
-		}
-		snprintf(health_unix_sock_path, sizeof(health_unix_sock_path),
-			DEFAULT_GLOBAL_RELAY_HEALTH_UNIX_SOCK,
-			getpid());
+		snprintf(path, len, global_fmt, getpid());
 	} else {
-		/* Set health check Unix path */
-		if (strlen(health_unix_sock_path) != 0) {
-			goto end;
-		}
-
-		snprintf(health_unix_sock_path, sizeof(health_unix_sock_path),
-			DEFAULT_HOME_RELAY_HEALTH_UNIX_SOCK,
-			home_path, getpid());
+		snprintf(path, len, home_fmt, home_path, getpid());
 	}
 
 end:
+	free(relayd_path);
 	free(rundir);
 	return ret;
 }
@@ -234,7 +225,10 @@ void *thread_manage_health(void *data)
 
 	DBG("[thread] Manage health check started");
 
-	setup_health_path();
+	setup_relayd_sock_path(health_unix_sock_path,
+			sizeof(health_unix_sock_path), LTTNG_RELAYD_HEALTH_ENV,
+			DEFAULT_GLOBAL_RELAY_HEALTH_UNIX_SOCK,
+			DEFAULT_HOME_RELAY_HEALTH_UNIX_SOCK);
 
 	rcu_register_thread();
 
@@ -20,10 +20,16 @@
  */
 
 #include <limits.h>
+#include <stddef.h>
 #include <lttng/health-internal.h>
 
 #define LTTNG_RELAYD_HEALTH_ENV		"LTTNG_RELAYD_HEALTH"
 
+/*
+ * The dispatcher threads are gone, the workers take the new connections
+ * directly. Their types are kept so the numbering of the health components
+ * known by liblttng-ctl does not change, and are always reported as healthy.
+ */
 enum health_type_relayd {
 	HEALTH_RELAYD_TYPE_DISPATCHER		= 0,
 	HEALTH_RELAYD_TYPE_WORKER		= 1,
@@ -39,6 +45,9 @@ extern struct health_app *health_relayd;
 
 extern int health_quit_pipe[2];
 
+int create_lttng_rundir_with_perm(const char *rundir);
+int setup_relayd_sock_path(char *path, size_t len, const char *env_var,
+		const char *global_fmt, const char *home_fmt);
 void *thread_manage_health(void *data);
 
 #endif /* HEALTH_RELAYD_H */
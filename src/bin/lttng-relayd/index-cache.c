@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+
+#include <common/common.h>
+#include <common/utils.h>
+
+#include "index-cache.h"
+
+/*
+ * Create an index cache using at most budget bytes for its entries.
+ *
+ * Return the new cache or NULL if the budget is too small to hold a single
+ * entry or on allocation error.
+ */
+struct index_cache *index_cache_create(uint64_t budget)
+{
+	uint64_t nr_entries;
+	struct index_cache *cache;
+
+	nr_entries = budget / sizeof(struct index_cache_entry);
+	if (nr_entries == 0) {
+		return NULL;
+	}
+	if (nr_entries > (1ULL << 31)) {
+		nr_entries = 1ULL << 31;
+	}
+
+	cache = zmalloc(sizeof(*cache));
+	if (!cache) {
+		PERROR("zmalloc index cache");
+		goto error;
+	}
+
+	/* Round down to a power of two so the position is a simple mask. */
+	cache->size = 1UL << (utils_get_count_order_u32(nr_entries + 1) - 1);
+	cache->entries = zmalloc(cache->size * sizeof(*cache->entries));
+	if (!cache->entries) {
+		PERROR("zmalloc index cache entries");
+		goto error;
+	}
+	pthread_mutex_init(&cache->lock, NULL);
+
+	return cache;
+
+error:
+	free(cache);
+	return NULL;
+}
+
+void index_cache_destroy(struct index_cache *cache)
+{
+	if (!cache) {
+		return;
+	}
+
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->entries);
+	free(cache);
+}
+
+/*
+ * Add an index that was just written at the given position of the index file
+ * of a tracefile, overwriting the oldest entry if the cache is full.
+ */
+void index_cache_add(struct index_cache *cache, uint64_t tracefile_id,
+		uint64_t pos, struct ctf_packet_index *index)
+{
+	struct index_cache_entry *entry;
+
+	assert(cache);
+	assert(index);
+
+	pthread_mutex_lock(&cache->lock);
+	entry = &cache->entries[cache->count & (cache->size - 1)];
+	entry->tracefile_id = tracefile_id;
+	entry->pos = pos;
+	entry->index = *index;
+	cache->count++;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * Copy in index the cached index found at the given position of the index
+ * file of a tracefile.
+ *
+ * Return 0 on success or -ENOENT if that index is not in the cache and must
+ * be read from the index file.
+ */
+int index_cache_get(struct index_cache *cache, uint64_t tracefile_id,
+		uint64_t pos, struct ctf_packet_index *index)
+{
+	int ret = -ENOENT;
+	uint64_t last, delta;
+	struct index_cache_entry *entry;
+
+	assert(cache);
+	assert(index);
+
+	pthread_mutex_lock(&cache->lock);
+	if (cache->count == 0) {
+		goto end;
+	}
+
+	/*
+	 * Indexes of a tracefile are added in the order of their position so the
+	 * distance from the last one gives the slot to look at.
+	 */
+	last = cache->count - 1;
+	entry = &cache->entries[last & (cache->size - 1)];
+	if (entry->tracefile_id != tracefile_id || pos > entry->pos) {
+		goto end;
+	}
+	delta = entry->pos - pos;
+	if (delta >= cache->size || delta > last) {
+		goto end;
+	}
+
+	/* A write error could have left a hole, check that we have the right one. */
+	entry = &cache->entries[(last - delta) & (cache->size - 1)];
+	if (entry->tracefile_id != tracefile_id || entry->pos != pos) {
+		goto end;
+	}
+
+	*index = entry->index;
+	ret = 0;
+
+end:
+	pthread_mutex_unlock(&cache->lock);
+	return ret;
+}
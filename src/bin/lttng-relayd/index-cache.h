@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _RELAY_INDEX_CACHE_H
+#define _RELAY_INDEX_CACHE_H
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <common/index/ctf-index.h>
+
+/*
+ * An index written on disk along with its location: the tracefile it belongs
+ * to and its position in the index file of that tracefile.
+ */
+struct index_cache_entry {
+	uint64_t tracefile_id;
+	uint64_t pos;
+	/* Big endian, as written on disk. */
+	struct ctf_packet_index index;
+};
+
+/*
+ * Ring of the most recent indexes written for a stream so live viewers don't
+ * have to read them back from the index file. The writer adds indexes in the
+ * order they are written in the file; once the ring is full, the oldest ones
+ * are overwritten and must be read from the file.
+ */
+struct index_cache {
+	pthread_mutex_t lock;
+	/* Number of entries, a power of two. */
+	unsigned long size;
+	/* Number of indexes ever added. */
+	uint64_t count;
+	struct index_cache_entry *entries;
+};
+
+struct index_cache *index_cache_create(uint64_t budget);
+void index_cache_destroy(struct index_cache *cache);
+void index_cache_add(struct index_cache *cache, uint64_t tracefile_id,
+		uint64_t pos, struct ctf_packet_index *index);
+int index_cache_get(struct index_cache *cache, uint64_t tracefile_id,
+		uint64_t pos, struct ctf_packet_index *index);
+
+#endif /* _RELAY_INDEX_CACHE_H */
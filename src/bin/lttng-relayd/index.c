@@ -24,6 +24,7 @@
 
 #include "lttng-relayd.h"
 #include "index.h"
+#include "stats.h"
 
 /*
  * Deferred free of a relay index object. MUST only be called by a call RCU.
@@ -33,13 +34,8 @@ static void deferred_free_relay_index(struct rcu_head *head)
 	struct relay_index *index =
 		caa_container_of(head, struct relay_index, rcu_node);
 
-	if (index->to_close_fd >= 0) {
-		int ret;
-
-		ret = close(index->to_close_fd);
-		if (ret < 0) {
-			PERROR("Relay index to close fd %d", index->to_close_fd);
-		}
+	if (index->file) {
+		relay_fd_put_ref(index->file);
 	}
 
 	relay_index_free(index);
@@ -65,8 +61,8 @@ struct relay_index *relay_index_create(uint64_t stream_id,
 		goto error;
 	}
 
-	index->to_close_fd = -1;
 	lttng_ht_node_init_two_u64(&index->index_n, stream_id, net_seq_num);
+	index->create_ts = utils_get_monotonic_ns();
 
 error:
 	return index;
@@ -128,20 +124,23 @@ void relay_index_add(struct relay_index *index, struct relay_index **_index)
 }
 
 /*
- * Write index on disk to the given fd. Once done error or not, it is removed
- * from the hash table and destroy the object.
+ * Write index on disk to its file. Once done error or not, it is removed from
+ * the hash table and destroy the object.
  *
  * MUST be called with a RCU read side lock held.
  *
  * Return 0 on success else a negative value.
  */
-int relay_index_write(int fd, struct relay_index *index)
+int relay_index_write(struct relay_index *index)
 {
-	int ret;
+	int ret, fd;
+	ssize_t write_ret;
 	struct lttng_ht_iter iter;
 
+	assert(index->file);
+
 	DBG2("Writing index for stream ID %" PRIu64 " and seq num %" PRIu64
-			" on fd %d", index->key.key1, index->key.key2, fd);
+			" on %s", index->key.key1, index->key.key2, index->file->path);
 
 	/* Delete index from hash table. */
 	iter.iter.node = &index->index_n.node;
@@ -149,7 +148,17 @@ int relay_index_write(int fd, struct relay_index *index)
 	assert(!ret);
 	call_rcu(&index->rcu_node, deferred_free_relay_index);
 
-	return index_write(fd, &index->index_data, sizeof(index->index_data));
+	fd = relay_fd_acquire(index->file);
+	if (fd < 0) {
+		return fd;
+	}
+	write_ret = index_write(fd, &index->index_data, sizeof(index->index_data));
+	relay_fd_release(index->file);
+	if (write_ret < (ssize_t) sizeof(index->index_data)) {
+		return -1;
+	}
+
+	return 0;
 }
 
 /*
@@ -25,21 +25,24 @@
 #include <common/hashtable/hashtable.h>
 #include <common/index/index.h>
 
+#include "fd-cache.h"
+
 struct relay_index {
-	/* FD on which to write the index data. */
-	int fd;
 	/*
-	 * When destroying this object, this fd is checked and if valid, close it
-	 * so this is basically a lazy close of the previous fd corresponding to
-	 * the same stream id. This is used for the rotate file feature.
+	 * File on which to write the index data. A reference is held on it so
+	 * the previous index file of a stream stays open until every pending
+	 * index of that file is written. This is used for the rotate file
+	 * feature.
 	 */
-	int to_close_fd;
+	struct relay_fd *file;
 
 	/* Index packet data. This is the data that is written on disk. */
 	struct ctf_packet_index index_data;
 
 	/* key1 = stream_id, key2 = net_seq_num */
 	struct lttng_ht_two_u64 key;
+	/* Arrival of the first half of the index, for the index wait stats. */
+	uint64_t create_ts;
 	struct lttng_ht_node_two_u64 index_n;
 	struct rcu_head rcu_node;
 	pthread_mutex_t mutex;
@@ -49,7 +52,7 @@ struct relay_index *relay_index_create(uint64_t stream_id,
 		uint64_t net_seq_num);
 struct relay_index *relay_index_find(uint64_t stream_id, uint64_t net_seq_num);
 void relay_index_add(struct relay_index *index, struct relay_index **_index);
-int relay_index_write(int fd, struct relay_index *index);
+int relay_index_write(struct relay_index *index);
 void relay_index_free(struct relay_index *index);
 void relay_index_free_safe(struct relay_index *index);
 void relay_index_delete(struct relay_index *index);
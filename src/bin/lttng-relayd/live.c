@@ -33,7 +33,6 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <inttypes.h>
-#include <urcu/futex.h>
 #include <urcu/uatomic.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -44,7 +43,6 @@
 #include <common/compat/poll.h>
 #include <common/compat/socket.h>
 #include <common/defaults.h>
-#include <common/futex.h>
 #include <common/index/index.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/sessiond-comm/inet.h>
@@ -63,32 +61,83 @@
 #include "session.h"
 #include "ctf-trace.h"
 #include "connection.h"
+#include "conn-queue.h"
+#include "stats.h"
 
 static struct lttng_uri *live_uri;
 
-/*
- * This pipe is used to inform the worker thread that a command is queued and
- * ready to be processed.
- */
-static int live_conn_pipe[2] = { -1, -1 };
-
-/* Shared between threads */
-static int live_dispatch_thread_exit;
-
 static pthread_t live_listener_thread;
-static pthread_t live_dispatcher_thread;
 static pthread_t live_worker_thread;
 
 /*
- * Relay command queue.
+ * Viewer connection queue.
  *
- * The live_thread_listener and live_thread_dispatcher communicate with this
- * queue.
+ * The live thread_listener hands the new connections to the live
+ * thread_worker through this queue.
  */
-static struct relay_conn_queue viewer_conn_queue;
+static struct relay_conn_queue viewer_conn_queue = { .event_fd = -1 };
 
 static uint64_t last_relay_viewer_session_id;
 
+/*
+ * This pipe is used by the relayd threads receiving the indexes to inform the
+ * worker thread that a new index is available on a stream. The stream id is
+ * written in it and the pipe is non-blocking so the writers are never stalled
+ * by the viewers.
+ */
+static int live_notify_pipe[2] = { -1, -1 };
+
+/* Maximum number of stream ids read from the notify pipe at once. */
+#define LIVE_NOTIFY_BATCH	64
+
+/*
+ * Subscription of a viewer notification connection to the indexes of a
+ * session. Only used by the worker thread.
+ */
+struct live_subscription {
+	uint64_t session_id;
+	struct relay_connection *conn;
+	struct cds_list_head list;
+};
+
+static CDS_LIST_HEAD(live_subscriptions);
+
+/*
+ * Number of subscriptions, read by the index receiving threads to avoid
+ * waking up the worker thread when no viewer asked for notifications.
+ */
+static unsigned long live_nr_subscriptions;
+
+/*
+ * Inform the worker thread that a new index was received for the given stream
+ * so it can notify the subscribed viewers. Notifications are coalesced until
+ * the worker thread handles the stream.
+ */
+void live_notify_new_index(struct relay_stream *stream)
+{
+	ssize_t ret;
+	uint64_t stream_id;
+
+	assert(stream);
+
+	if (!uatomic_read(&live_nr_subscriptions)) {
+		return;
+	}
+
+	/* A notification is already pending for this stream. */
+	if (uatomic_cmpxchg(&stream->index_notify_pending, 0, 1) != 0) {
+		return;
+	}
+
+	stream_id = stream->stream_handle;
+	ret = lttng_write(live_notify_pipe[1], &stream_id, sizeof(stream_id));
+	if (ret < sizeof(stream_id)) {
+		/* Pipe full, the viewers will catch up on their next poll. */
+		DBG("Dropping index notification of stream %" PRIu64, stream_id);
+		uatomic_set(&stream->index_notify_pending, 0);
+	}
+}
+
 /*
  * Cleanup the daemon
  */
@@ -97,6 +146,13 @@ void cleanup(void)
 {
 	DBG("Cleaning up");
 
+	/*
+	 * The relayd worker thread writes in this pipe so it is closed only once
+	 * every thread is joined.
+	 */
+	utils_close_pipe(live_notify_pipe);
+	/* Connections accepted after the worker thread exited are dropped. */
+	relay_conn_queue_fini(&viewer_conn_queue);
 	free(live_uri);
 }
 
@@ -354,10 +410,6 @@ void stop_threads(void)
 	if (ret < 0) {
 		ERR("write error on thread quit pipe");
 	}
-
-	/* Dispatch thread */
-	CMM_STORE_SHARED(live_dispatch_thread_exit, 1);
-	futex_nto1_wake(&viewer_conn_queue.futex);
 }
 
 /*
@@ -556,14 +608,8 @@ restart:
 				}
 				new_conn->sock = newsock;
 
-				/* Enqueue request for the dispatcher thread. */
-				cds_wfq_enqueue(&viewer_conn_queue.queue, &new_conn->qnode);
-
-				/*
-				 * Wake the dispatch queue futex. Implicit memory barrier with
-				 * the exchange in cds_wfq_enqueue.
-				 */
-				futex_nto1_wake(&viewer_conn_queue.futex);
+				/* Hand the connection to the worker thread. */
+				relay_conn_queue_enqueue(&viewer_conn_queue, new_conn);
 			}
 		}
 	}
@@ -592,82 +638,6 @@ error_sock_control:
 	return NULL;
 }
 
-/*
- * This thread manages the dispatching of the requests to worker threads
- */
-static
-void *thread_dispatcher(void *data)
-{
-	int err = -1;
-	ssize_t ret;
-	struct cds_wfq_node *node;
-	struct relay_connection *conn = NULL;
-
-	DBG("[thread] Live viewer relay dispatcher started");
-
-	health_register(health_relayd, HEALTH_RELAYD_TYPE_LIVE_DISPATCHER);
-
-	if (testpoint(relayd_thread_live_dispatcher)) {
-		goto error_testpoint;
-	}
-
-	health_code_update();
-
-	while (!CMM_LOAD_SHARED(live_dispatch_thread_exit)) {
-		health_code_update();
-
-		/* Atomically prepare the queue futex */
-		futex_nto1_prepare(&viewer_conn_queue.futex);
-
-		do {
-			health_code_update();
-
-			/* Dequeue commands */
-			node = cds_wfq_dequeue_blocking(&viewer_conn_queue.queue);
-			if (node == NULL) {
-				DBG("Woken up but nothing in the live-viewer "
-						"relay command queue");
-				/* Continue thread execution */
-				break;
-			}
-			conn = caa_container_of(node, struct relay_connection, qnode);
-			DBG("Dispatching viewer request waiting on sock %d",
-					conn->sock->fd);
-
-			/*
-			 * Inform worker thread of the new request. This call is blocking
-			 * so we can be assured that the data will be read at some point in
-			 * time or wait to the end of the world :)
-			 */
-			ret = lttng_write(live_conn_pipe[1], &conn, sizeof(conn));
-			if (ret < 0) {
-				PERROR("write conn pipe");
-				connection_destroy(conn);
-				goto error;
-			}
-		} while (node != NULL);
-
-		/* Futex wait on queue. Blocking call on futex() */
-		health_poll_entry();
-		futex_nto1_wait(&viewer_conn_queue.futex);
-		health_poll_exit();
-	}
-
-	/* Normal exit, no error */
-	err = 0;
-
-error:
-error_testpoint:
-	if (err) {
-		health_error();
-		ERR("Health error occurred in %s", __func__);
-	}
-	health_unregister(health_relayd);
-	DBG("Live viewer dispatch thread dying");
-	stop_threads();
-	return NULL;
-}
-
 /*
  * Establish connection with the viewer and check the versions.
  *
@@ -1120,7 +1090,7 @@ error:
 /*
  * Open the index file if needed for the given vstream.
  *
- * If an index file is successfully opened, the index_read_fd of the stream is
+ * If an index file is successfully opened, the index_file of the stream is
  * set with it.
  *
  * Return 0 on success, a negative value on error (-ENOENT if not ready yet).
@@ -1133,7 +1103,7 @@ static int try_open_index(struct relay_viewer_stream *vstream,
 	assert(vstream);
 	assert(rstream);
 
-	if (vstream->index_read_fd >= 0) {
+	if (vstream->index_file) {
 		goto end;
 	}
 
@@ -1150,8 +1120,8 @@ static int try_open_index(struct relay_viewer_stream *vstream,
 	ret = index_open(vstream->path_name, vstream->channel_name,
 			vstream->tracefile_count, vstream->tracefile_count_current);
 	if (ret >= 0) {
-		vstream->index_read_fd = ret;
-		ret = 0;
+		vstream->index_file = relay_fd_create(ret);
+		ret = vstream->index_file ? 0 : -1;
 		goto end;
 	}
 
@@ -1239,6 +1209,47 @@ index_ready:
 	return 1;
 }
 
+/*
+ * Read the next index of a viewer stream. It is taken from the index cache of
+ * the stream when still there, otherwise it is read from the index file.
+ *
+ * Return the number of bytes read, less than the size of an index if it is not
+ * completely written yet, or a negative value on error.
+ */
+static ssize_t read_next_index(struct relay_viewer_stream *vstream,
+		struct relay_stream *rstream, struct ctf_packet_index *index)
+{
+	int fd;
+	ssize_t ret;
+	off_t offset;
+
+	if (rstream->index_cache &&
+			!index_cache_get(rstream->index_cache,
+				vstream->tracefile_count_current,
+				vstream->index_read_pos, index)) {
+		ret = sizeof(*index);
+		goto end;
+	}
+
+	fd = relay_fd_acquire(vstream->index_file);
+	if (fd < 0) {
+		ret = fd;
+		goto end;
+	}
+	offset = sizeof(struct ctf_packet_index_file_hdr) +
+		vstream->index_read_pos * sizeof(*index);
+	do {
+		ret = pread(fd, index, sizeof(*index), offset);
+	} while (ret < 0 && errno == EINTR);
+	relay_fd_release(vstream->index_file);
+
+end:
+	if (ret == sizeof(*index)) {
+		vstream->index_read_pos++;
+	}
+	return ret;
+}
+
 /*
  * Send the next index for a stream.
  *
@@ -1360,8 +1371,7 @@ int viewer_get_next_index(struct relay_connection *conn)
 		goto send_reply;
 	}
 
-	read_ret = lttng_read(vstream->index_read_fd, &packet_index,
-			sizeof(packet_index));
+	read_ret = read_next_index(vstream, rstream, &packet_index);
 	pthread_mutex_unlock(&vstream->overwrite_lock);
 	pthread_mutex_unlock(&rstream->viewer_stream_rotation_lock);
 	if (read_ret < 0) {
@@ -1384,7 +1394,7 @@ int viewer_get_next_index(struct relay_connection *conn)
 				viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_RETRY);
 			}
 		} else {
-			ERR("Relay reading index file %d", vstream->index_read_fd);
+			ERR("Relay reading index file %s", vstream->index_file->path);
 			viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_ERR);
 		}
 		pthread_mutex_unlock(&rstream->viewer_stream_rotation_lock);
@@ -1392,6 +1402,7 @@ int viewer_get_next_index(struct relay_connection *conn)
 	} else {
 		viewer_index.status = htobe32(LTTNG_VIEWER_INDEX_OK);
 		vstream->last_sent_index++;
+		vstream->last_index = packet_index;
 	}
 
 	/*
@@ -1425,6 +1436,54 @@ end:
 	return ret;
 }
 
+/*
+ * Read the part of a compressed packet asked by a viewer. The packet is read
+ * as stored in the trace file and expanded if needed, the viewer only knows
+ * its offset in the expanded file.
+ *
+ * Return the number of bytes read or a negative value on error.
+ */
+static ssize_t read_stored_packet(struct relay_viewer_stream *vstream, int fd,
+		uint64_t offset, char *data, uint32_t len)
+{
+	ssize_t ret;
+	char *packet;
+	struct ctf_packet_index *index = &vstream->last_index;
+	uint64_t packet_offset = be64toh(index->offset);
+	uint64_t packet_size = be64toh(index->packet_size) / CHAR_BIT;
+
+	if (offset < packet_offset ||
+			offset + len > packet_offset + packet_size) {
+		ERR("Viewer read outside of the packet of stream %" PRIu64,
+				vstream->stream_handle);
+		return -1;
+	}
+
+	if (offset == packet_offset && len == packet_size) {
+		packet = data;
+	} else {
+		packet = zmalloc(packet_size);
+		if (!packet) {
+			PERROR("relay packet zmalloc");
+			return -1;
+		}
+	}
+	ret = index_read_packet(fd, index, packet);
+	if (ret < 0) {
+		goto end;
+	}
+	if (packet != data) {
+		memcpy(data, packet + (offset - packet_offset), len);
+	}
+	ret = len;
+
+end:
+	if (packet != data) {
+		free(packet);
+	}
+	return ret;
+}
+
 /*
  * Send the next index for a stream
  *
@@ -1433,7 +1492,7 @@ end:
 static
 int viewer_get_packet(struct relay_connection *conn)
 {
-	int ret, send_data = 0;
+	int ret, fd, send_data = 0;
 	char *data = NULL;
 	uint32_t len = 0;
 	ssize_t read_len;
@@ -1479,7 +1538,7 @@ int viewer_get_packet(struct relay_connection *conn)
 	 * only arrive here if an index has already been sent to the viewer, so the
 	 * tracefile must exist, if it does not it is a fatal error.
 	 */
-	if (stream->read_fd < 0) {
+	if (!stream->read_file) {
 		char fullpath[PATH_MAX];
 
 		if (stream->tracefile_count > 0) {
@@ -1498,7 +1557,10 @@ int viewer_get_packet(struct relay_connection *conn)
 			PERROR("Relay opening trace file");
 			goto error;
 		}
-		stream->read_fd = ret;
+		stream->read_file = relay_fd_create(ret);
+		if (!stream->read_file) {
+			goto error;
+		}
 	}
 
 	if (!ctf_trace->metadata_received ||
@@ -1524,8 +1586,37 @@ int viewer_get_packet(struct relay_connection *conn)
 		goto error;
 	}
 
-	ret = lseek(stream->read_fd, be64toh(get_packet_info.offset), SEEK_SET);
+	fd = relay_fd_acquire(stream->read_file);
+	if (fd < 0) {
+		/*
+		 * The trace file can't be reopened if the streaming side removed it,
+		 * which is expected when the abort_flag is set.
+		 */
+		if (stream->abort_flag == 0) {
+			goto error;
+		}
+		reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_EOF);
+		goto send_reply;
+	}
+
+	/* Packets stored elsewhere than their offset are in a compressed file. */
+	if (index_is_stored(&stream->last_index)) {
+		read_len = read_stored_packet(stream, fd,
+				be64toh(get_packet_info.offset), data, len);
+		relay_fd_release(stream->read_file);
+		if (read_len < len) {
+			if (stream->abort_flag == 0) {
+				goto error;
+			}
+			reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_EOF);
+			goto send_reply;
+		}
+		goto packet_ok;
+	}
+
+	ret = lseek(fd, be64toh(get_packet_info.offset), SEEK_SET);
 	if (ret < 0) {
+		relay_fd_release(stream->read_file);
 		/*
 		 * If the read fd was closed by the streaming side, the
 		 * abort_flag will be set to 1, otherwise it is an error.
@@ -1537,15 +1628,16 @@ int viewer_get_packet(struct relay_connection *conn)
 		reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_EOF);
 		goto send_reply;
 	}
-	read_len = lttng_read(stream->read_fd, data, len);
+	read_len = lttng_read(fd, data, len);
+	relay_fd_release(stream->read_file);
 	if (read_len < len) {
 		/*
 		 * If the read fd was closed by the streaming side, the
 		 * abort_flag will be set to 1, otherwise it is an error.
 		 */
 		if (stream->abort_flag == 0) {
-			PERROR("Relay reading trace file, fd: %d, offset: %" PRIu64,
-					stream->read_fd,
+			PERROR("Relay reading trace file %s, offset: %" PRIu64,
+					stream->read_file->path,
 					be64toh(get_packet_info.offset));
 			goto error;
 		} else {
@@ -1553,6 +1645,7 @@ int viewer_get_packet(struct relay_connection *conn)
 			goto send_reply;
 		}
 	}
+packet_ok:
 	reply.status = htobe32(LTTNG_VIEWER_GET_PACKET_OK);
 	reply.len = htobe32(len);
 	send_data = 1;
@@ -1600,7 +1693,7 @@ end:
 static
 int viewer_get_metadata(struct relay_connection *conn)
 {
-	int ret = 0;
+	int ret = 0, fd;
 	ssize_t read_len;
 	uint64_t len = 0;
 	char *data = NULL;
@@ -1649,7 +1742,7 @@ int viewer_get_metadata(struct relay_connection *conn)
 	}
 
 	/* first time, we open the metadata file */
-	if (stream->read_fd < 0) {
+	if (!stream->read_file) {
 		char fullpath[PATH_MAX];
 
 		ret = snprintf(fullpath, PATH_MAX, "%s/%s", stream->path_name,
@@ -1662,7 +1755,10 @@ int viewer_get_metadata(struct relay_connection *conn)
 			PERROR("Relay opening metadata file");
 			goto error;
 		}
-		stream->read_fd = ret;
+		stream->read_file = relay_fd_create(ret);
+		if (!stream->read_file) {
+			goto error;
+		}
 	}
 
 	reply.len = htobe64(len);
@@ -1672,7 +1768,12 @@ int viewer_get_metadata(struct relay_connection *conn)
 		goto error;
 	}
 
-	read_len = lttng_read(stream->read_fd, data, len);
+	fd = relay_fd_acquire(stream->read_file);
+	if (fd < 0) {
+		goto error;
+	}
+	read_len = lttng_read(fd, data, len);
+	relay_fd_release(stream->read_file);
 	if (read_len < len) {
 		PERROR("Relay reading metadata file");
 		goto error;
@@ -1748,6 +1849,189 @@ end:
 }
 
 
+/*
+ * Subscribe a notification connection to the new indexes of a session.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int viewer_subscribe(struct relay_connection *conn)
+{
+	int ret;
+	uint64_t session_id;
+	struct lttng_viewer_subscribe request;
+	struct lttng_viewer_subscribe_response resp;
+	struct live_subscription *sub;
+
+	assert(conn);
+
+	DBG("Viewer subscribe received");
+
+	health_code_update();
+
+	ret = recv_request(conn->sock, &request, sizeof(request));
+	if (ret < 0) {
+		goto end;
+	}
+	session_id = be64toh(request.session_id);
+
+	health_code_update();
+
+	memset(&resp, 0, sizeof(resp));
+
+	if (conn->type != RELAY_VIEWER_NOTIFICATION) {
+		resp.status = htobe32(LTTNG_VIEWER_SUBSCRIBE_ERR);
+		goto send_reply;
+	}
+
+	rcu_read_lock();
+	if (!session_find_by_id(conn->sessions_ht, session_id)) {
+		rcu_read_unlock();
+		DBG("Relay session %" PRIu64 " not found", session_id);
+		resp.status = htobe32(LTTNG_VIEWER_SUBSCRIBE_UNK);
+		goto send_reply;
+	}
+	rcu_read_unlock();
+
+	resp.status = htobe32(LTTNG_VIEWER_SUBSCRIBE_OK);
+
+	cds_list_for_each_entry(sub, &live_subscriptions, list) {
+		if (sub->conn == conn && sub->session_id == session_id) {
+			/* Already subscribed. */
+			goto send_reply;
+		}
+	}
+
+	sub = zmalloc(sizeof(*sub));
+	if (!sub) {
+		PERROR("zmalloc live subscription");
+		resp.status = htobe32(LTTNG_VIEWER_SUBSCRIBE_ERR);
+		goto send_reply;
+	}
+	sub->session_id = session_id;
+	sub->conn = conn;
+	cds_list_add(&sub->list, &live_subscriptions);
+	uatomic_inc(&live_nr_subscriptions);
+
+	DBG("Viewer subscribed to session %" PRIu64 " indexes", session_id);
+
+send_reply:
+	health_code_update();
+	ret = send_response(conn->sock, &resp, sizeof(resp));
+	if (ret < 0) {
+		goto end;
+	}
+	health_code_update();
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Remove every subscription of a connection.
+ */
+static
+void unsubscribe_connection(struct relay_connection *conn)
+{
+	struct live_subscription *sub, *tmp_sub;
+
+	cds_list_for_each_entry_safe(sub, tmp_sub, &live_subscriptions, list) {
+		if (sub->conn != conn) {
+			continue;
+		}
+		cds_list_del(&sub->list);
+		uatomic_dec(&live_nr_subscriptions);
+		free(sub);
+	}
+}
+
+/*
+ * Send an index notification for the given stream to every connection
+ * subscribed to its session.
+ *
+ * A notification is never allowed to block the worker thread: it is dropped
+ * if the socket buffer is full. A partially sent notification breaks the
+ * stream of messages so the connection is shut down, the hang up being handled
+ * by the poll loop.
+ */
+static
+void notify_stream_index(uint64_t stream_id)
+{
+	ssize_t ret;
+	struct relay_stream *stream;
+	struct live_subscription *sub;
+	struct lttng_viewer_index_notification msg;
+
+	rcu_read_lock();
+	stream = stream_find_by_id(relay_streams_ht, stream_id);
+	if (!stream) {
+		goto end;
+	}
+
+	/* Indexes received from now on need a new notification. */
+	uatomic_set(&stream->index_notify_pending, 0);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.session_id = htobe64(stream->session_id);
+	msg.stream_id = htobe64(stream_id);
+
+	cds_list_for_each_entry(sub, &live_subscriptions, list) {
+		if (sub->session_id != stream->session_id) {
+			continue;
+		}
+
+		do {
+			ret = send(sub->conn->sock->fd, &msg, sizeof(msg),
+					MSG_DONTWAIT | MSG_NOSIGNAL);
+		} while (ret < 0 && errno == EINTR);
+		if (ret < 0) {
+			DBG("Index notification of stream %" PRIu64 " dropped on "
+					"socket %d", stream_id, sub->conn->sock->fd);
+		} else if (ret < sizeof(msg)) {
+			ERR("Partial index notification on socket %d, closing it",
+					sub->conn->sock->fd);
+			(void) shutdown(sub->conn->sock->fd, SHUT_RDWR);
+		}
+	}
+
+end:
+	rcu_read_unlock();
+}
+
+/*
+ * Consume the stream ids written in the notify pipe.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int handle_notify_pipe(void)
+{
+	ssize_t ret;
+	unsigned int i;
+	uint64_t stream_ids[LIVE_NOTIFY_BATCH];
+
+	/*
+	 * Stream ids are written atomically in the pipe so a read of a multiple
+	 * of their size never returns a partial one.
+	 */
+	ret = read(live_notify_pipe[0], stream_ids, sizeof(stream_ids));
+	if (ret < 0) {
+		if (errno == EINTR || errno == EAGAIN) {
+			return 0;
+		}
+		PERROR("read live notify pipe");
+		return -1;
+	}
+
+	for (i = 0; i < ret / sizeof(stream_ids[0]); i++) {
+		health_code_update();
+		notify_stream_index(stream_ids[i]);
+	}
+
+	return 0;
+}
+
 /*
  * live_relay_unknown_command: send -1 if received unknown command
  */
@@ -1770,11 +2054,13 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 {
 	int ret = 0;
 	uint32_t msg_value;
+	uint64_t start_ts;
 
 	assert(recv_hdr);
 	assert(conn);
 
 	msg_value = be32toh(recv_hdr->cmd);
+	start_ts = utils_get_monotonic_ns();
 
 	/*
 	 * Make sure we've done the version check before any command other then a
@@ -1811,6 +2097,9 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 	case LTTNG_VIEWER_CREATE_SESSION:
 		ret = viewer_create_session(conn);
 		break;
+	case LTTNG_VIEWER_SUBSCRIBE:
+		ret = viewer_subscribe(conn);
+		break;
 	default:
 		ERR("Received unknown viewer command (%u)", be32toh(recv_hdr->cmd));
 		live_relay_unknown_command(conn);
@@ -1818,6 +2107,8 @@ int process_control(struct lttng_viewer_cmd *recv_hdr,
 		goto end;
 	}
 
+	relay_stats_add_viewer_request(msg_value, utils_get_monotonic_ns() - start_ts);
+
 end:
 	return ret;
 }
@@ -1851,6 +2142,7 @@ static void destroy_connection(struct lttng_ht *relay_connections_ht,
 	assert(conn);
 
 	connection_delete(relay_connections_ht, conn);
+	unsubscribe_connection(conn);
 
 	if (!conn->viewer_session) {
 		goto end;
@@ -1901,12 +2193,17 @@ void *thread_worker(void *data)
 		goto relay_connections_ht_error;
 	}
 
-	ret = create_thread_poll_set(&events, 2);
+	ret = create_thread_poll_set(&events, 3);
 	if (ret < 0) {
 		goto error_poll_create;
 	}
 
-	ret = lttng_poll_add(&events, live_conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	ret = lttng_poll_add(&events, viewer_conn_queue.event_fd, LPOLLIN);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = lttng_poll_add(&events, live_notify_pipe[0], LPOLLIN | LPOLLRDHUP);
 	if (ret < 0) {
 		goto error;
 	}
@@ -1953,25 +2250,35 @@ restart:
 				goto exit;
 			}
 
-			/* Inspect the relay conn pipe for new connection */
-			if (pollfd == live_conn_pipe[0]) {
+			/* Inspect the viewer conn queue for new connections */
+			if (pollfd == viewer_conn_queue.event_fd) {
+				if (revents & LPOLLERR) {
+					ERR("Relay live connection queue error");
+					goto error;
+				} else if (revents & LPOLLIN) {
+					relay_conn_queue_ack(&viewer_conn_queue);
+					while ((conn = relay_conn_queue_dequeue(
+							&viewer_conn_queue))) {
+						conn->sessions_ht = sessions_ht;
+						connection_init(conn);
+						lttng_poll_add(&events, conn->sock->fd,
+								LPOLLIN | LPOLLRDHUP);
+						rcu_read_lock();
+						lttng_ht_add_unique_ulong(relay_connections_ht,
+								&conn->sock_n);
+						rcu_read_unlock();
+						DBG("Connection socket %d added", conn->sock->fd);
+					}
+				}
+			} else if (pollfd == live_notify_pipe[0]) {
 				if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
-					ERR("Relay live pipe error");
+					ERR("Relay live notify pipe error");
 					goto error;
 				} else if (revents & LPOLLIN) {
-					ret = lttng_read(live_conn_pipe[0], &conn, sizeof(conn));
+					ret = handle_notify_pipe();
 					if (ret < 0) {
 						goto error;
 					}
-					conn->sessions_ht = sessions_ht;
-					connection_init(conn);
-					lttng_poll_add(&events, conn->sock->fd,
-							LPOLLIN | LPOLLRDHUP);
-					rcu_read_lock();
-					lttng_ht_add_unique_ulong(relay_connections_ht,
-							&conn->sock_n);
-					rcu_read_unlock();
-					DBG("Connection socket %d added", conn->sock->fd);
 				}
 			} else {
 				rcu_read_lock();
@@ -2020,8 +2327,6 @@ error:
 error_poll_create:
 	lttng_ht_destroy(relay_connections_ht);
 relay_connections_ht_error:
-	/* Close relay conn pipes */
-	utils_close_pipe(live_conn_pipe);
 	if (err) {
 		DBG("Viewer worker thread exited with error");
 	}
@@ -2038,14 +2343,14 @@ error_testpoint:
 }
 
 /*
- * Create the relay command pipe to wake thread_manage_apps.
+ * Create the pipe used to notify the worker thread of new indexes.
  * Closed in cleanup().
  */
-static int create_conn_pipe(void)
+static int create_notify_pipe(void)
 {
 	int ret;
 
-	ret = utils_create_pipe_cloexec(live_conn_pipe);
+	ret = utils_create_pipe_cloexec_nonblock(live_notify_pipe);
 
 	return ret;
 }
@@ -2069,12 +2374,6 @@ void live_stop_threads(void)
 		goto error;	/* join error, exit without cleanup */
 	}
 
-	ret = pthread_join(live_dispatcher_thread, &status);
-	if (ret != 0) {
-		PERROR("pthread_join live dispatcher");
-		goto error;	/* join error, exit without cleanup */
-	}
-
 	cleanup();
 
 error:
@@ -2105,25 +2404,20 @@ int live_start_threads(struct lttng_uri *uri,
 		}
 	}
 
-	/* Setup the thread apps communication pipe. */
-	if ((ret = create_conn_pipe()) < 0) {
+	/* Init viewer connection queue, released in cleanup(). */
+	ret = relay_conn_queue_init(&viewer_conn_queue);
+	if (ret < 0) {
 		goto exit;
 	}
 
-	/* Init relay command queue. */
-	cds_wfq_init(&viewer_conn_queue.queue);
+	/* Setup the index notification pipe. */
+	if ((ret = create_notify_pipe()) < 0) {
+		goto exit;
+	}
 
 	/* Set up max poll set size */
 	lttng_poll_set_max_size();
 
-	/* Setup the dispatcher thread */
-	ret = pthread_create(&live_dispatcher_thread, NULL,
-			thread_dispatcher, (void *) NULL);
-	if (ret != 0) {
-		PERROR("pthread_create viewer dispatcher");
-		goto exit_dispatcher;
-	}
-
 	/* Setup the worker thread */
 	ret = pthread_create(&live_worker_thread, NULL,
 			thread_worker, relay_ctx);
@@ -2157,13 +2451,6 @@ exit_worker:
 		goto error;	/* join error, exit without cleanup */
 	}
 
-exit_dispatcher:
-	ret = pthread_join(live_dispatcher_thread, &status);
-	if (ret != 0) {
-		PERROR("pthread_join live dispatcher");
-		goto error;	/* join error, exit without cleanup */
-	}
-
 exit:
 	cleanup();
 
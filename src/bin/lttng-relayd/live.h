@@ -22,11 +22,13 @@
 #include <common/uri.h>
 
 #include "lttng-relayd.h"
+#include "stream.h"
 
 int live_start_threads(struct lttng_uri *live_uri,
 		struct relay_local_data *relay_ctx);
 void live_stop_threads(void);
 
 struct relay_viewer_stream *live_find_viewer_stream_by_id(uint64_t stream_id);
+void live_notify_new_index(struct relay_stream *stream);
 
 #endif /* LTTNG_RELAYD_LIVE_H */
@@ -22,23 +22,15 @@
 #define _LGPL_SOURCE
 #include <limits.h>
 #include <urcu.h>
-#include <urcu/wfqueue.h>
 
 #include <common/hashtable/hashtable.h>
 
-/*
- * Queue used to enqueue relay requests
- */
-struct relay_conn_queue {
-	struct cds_wfq_queue queue;
-	int32_t futex;
-};
-
 struct relay_local_data {
 	struct lttng_ht *sessions_ht;
 };
 
 extern char *opt_output_path;
+extern uint64_t opt_live_index_cache_size;
 
 /*
  * Contains stream indexed by ID. This is important since many commands lookup
@@ -48,6 +48,7 @@ enum lttng_viewer_command {
 	LTTNG_VIEWER_GET_METADATA	= 6,
 	LTTNG_VIEWER_GET_NEW_STREAMS	= 7,
 	LTTNG_VIEWER_CREATE_SESSION	= 8,
+	LTTNG_VIEWER_SUBSCRIBE		= 9,
 };
 
 enum lttng_viewer_attach_return_code {
@@ -86,6 +87,12 @@ enum lttng_viewer_connection_type {
 	LTTNG_VIEWER_CLIENT_NOTIFICATION	= 2,
 };
 
+enum lttng_viewer_subscribe_return_code {
+	LTTNG_VIEWER_SUBSCRIBE_OK	= 1, /* Index notifications will be sent. */
+	LTTNG_VIEWER_SUBSCRIBE_UNK	= 2, /* The session ID is unknown. */
+	LTTNG_VIEWER_SUBSCRIBE_ERR	= 3, /* Not a notification connection. */
+};
+
 enum lttng_viewer_seek {
 	/* Receive the trace packets from the beginning. */
 	LTTNG_VIEWER_SEEK_BEGINNING	= 1,
@@ -232,4 +239,28 @@ struct lttng_viewer_create_session_response {
 	uint32_t status;
 } __attribute__((__packed__));
 
+/*
+ * LTTNG_VIEWER_SUBSCRIBE payload, only accepted on a connection established
+ * with the LTTNG_VIEWER_CLIENT_NOTIFICATION type. Once subscribed, the relayd
+ * sends a struct lttng_viewer_index_notification on that connection every
+ * time a new index is available for a stream of the session. Notifications
+ * are coalesced per stream and are only hints: the viewer must keep asking
+ * for the next index on its command connection until it gets a
+ * LTTNG_VIEWER_INDEX_RETRY, and should still poll with a long timeout since a
+ * notification is dropped if the connection can't accept it right away.
+ */
+struct lttng_viewer_subscribe {
+	uint64_t session_id;
+} __attribute__((__packed__));
+
+struct lttng_viewer_subscribe_response {
+	/* enum lttng_viewer_subscribe_return_code */
+	uint32_t status;
+} __attribute__((__packed__));
+
+struct lttng_viewer_index_notification {
+	uint64_t session_id;
+	uint64_t stream_id;
+} __attribute__((__packed__));
+
 #endif /* LTTNG_VIEWER_ABI_H */
@@ -34,7 +34,6 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <inttypes.h>
-#include <urcu/futex.h>
 #include <urcu/uatomic.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -46,13 +45,13 @@
 #include <common/compat/socket.h>
 #include <common/defaults.h>
 #include <common/daemonize.h>
-#include <common/futex.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/sessiond-comm/inet.h>
 #include <common/sessiond-comm/relayd.h>
 #include <common/uri.h>
 #include <common/utils.h>
 #include <common/config/config.h>
+#include <common/compress/compress.h>
 
 #include "cmd.h"
 #include "ctf-trace.h"
@@ -66,9 +65,16 @@
 #include "session.h"
 #include "stream.h"
 #include "connection.h"
+#include "conn-queue.h"
+#include "fd-cache.h"
+#include "stats.h"
 
 /* command line options */
 char *opt_output_path;
+uint64_t opt_live_index_cache_size = DEFAULT_RELAYD_LIVE_INDEX_CACHE_SIZE;
+static unsigned int opt_fd_cap;
+static int opt_direct_io;
+static int opt_compress_output;
 static int opt_daemon, opt_background;
 
 /*
@@ -97,33 +103,30 @@ const char * const config_section_name = "relayd";
  */
 int thread_quit_pipe[2] = { -1, -1 };
 
-/*
- * This pipe is used to inform the worker thread that a command is queued and
- * ready to be processed.
- */
-static int relay_conn_pipe[2] = { -1, -1 };
-
-/* Shared between threads */
-static int dispatch_thread_exit;
-
 static pthread_t listener_thread;
-static pthread_t dispatcher_thread;
 static pthread_t worker_thread;
 static pthread_t health_thread;
+static pthread_t stats_thread;
 
 static uint64_t last_relay_stream_id;
 
 /*
- * Relay command queue.
+ * Relay connection queue.
  *
- * The relay_thread_listener and relay_thread_dispatcher communicate with this
- * queue.
+ * The relay_thread_listener hands the new connections to the
+ * relay_thread_worker through this queue.
  */
-static struct relay_conn_queue relay_conn_queue;
+static struct relay_conn_queue relay_conn_queue = { .event_fd = -1 };
 
 /* buffer allocated at startup, used to store the trace data */
 static char *data_buffer;
 static unsigned int data_buffer_size;
+/* Trace data of compressed sessions is decompressed in this buffer. */
+static char *uncompressed_buffer;
+static unsigned int uncompressed_buffer_size;
+/* Packets of compressed trace files are compressed in this buffer. */
+static char *compressed_buffer;
+static unsigned int compressed_buffer_size;
 
 /* We need those values for the file/dir creation. */
 static uid_t relayd_uid;
@@ -152,6 +155,10 @@ static struct option long_options[] = {
 	{ "output", 1, 0, 'o', },
 	{ "verbose", 0, 0, 'v', },
 	{ "config", 1, 0, 'f' },
+	{ "live-index-cache", 1, 0, 'I', },
+	{ "fd-cap", 1, 0, 'F', },
+	{ "direct-io", 0, 0, 'O', },
+	{ "compress-output", 0, 0, 'Z', },
 	{ NULL, 0, 0, 0, },
 };
 
@@ -174,6 +181,12 @@ void usage(void)
 	fprintf(stderr, "  -v, --verbose             Verbose mode. Activate DBG() macro.\n");
 	fprintf(stderr, "  -g, --group NAME          Specify the tracing group name. (default: tracing)\n");
 	fprintf(stderr, "  -f  --config              Load daemon configuration file\n");
+	fprintf(stderr, "  -I, --live-index-cache SIZE  Memory used to cache the recent indexes of each live stream. (default: %u)\n",
+			DEFAULT_RELAYD_LIVE_INDEX_CACHE_SIZE);
+	fprintf(stderr, "  -F, --fd-cap NUM          Maximum number of trace and index files kept open. (default: %u%% of the open files limit)\n",
+			DEFAULT_RELAYD_FD_CAP_THRESHOLD);
+	fprintf(stderr, "  -O, --direct-io           Write the trace data files with O_DIRECT, bypassing the page cache.\n");
+	fprintf(stderr, "  -Z, --compress-output     Store the packets of the trace data files compressed with LZ4.\n");
 }
 
 /*
@@ -245,6 +258,36 @@ int set_option(int opt, const char *arg, const char *optname)
 			goto end;
 		}
 		break;
+	case 'I':
+		ret = utils_parse_size_suffix((char *) arg,
+				&opt_live_index_cache_size);
+		if (ret < 0) {
+			ERR("Invalid live index cache size %s", arg);
+			goto end;
+		}
+		break;
+	case 'F':
+	{
+		char *endptr;
+		unsigned long v;
+
+		errno = 0;
+		v = strtoul(arg, &endptr, 0);
+		if (errno != 0 || endptr == arg || *endptr != '\0' ||
+				v > UINT_MAX) {
+			ERR("Invalid fd cap %s", arg);
+			ret = -1;
+			goto end;
+		}
+		opt_fd_cap = v;
+		break;
+	}
+	case 'O':
+		opt_direct_io = 1;
+		break;
+	case 'Z':
+		opt_compress_output = 1;
+		break;
 	case 'v':
 		/* Verbose level can increase using multiple -v */
 		if (arg) {
@@ -449,6 +492,9 @@ void cleanup(void)
 	/* Close thread quit pipes */
 	utils_close_pipe(thread_quit_pipe);
 
+	/* Connections accepted after the worker thread exited are dropped. */
+	relay_conn_queue_fini(&relay_conn_queue);
+
 	uri_free(control_uri);
 	uri_free(data_uri);
 	/* Live URI is freed in the live thread. */
@@ -500,10 +546,6 @@ void stop_threads(void)
 	}
 
 	notify_health_quit_pipe(health_quit_pipe);
-
-	/* Dispatch thread */
-	CMM_STORE_SHARED(dispatch_thread_exit, 1);
-	futex_nto1_wake(&relay_conn_queue.futex);
 }
 
 /*
@@ -877,14 +919,8 @@ restart:
 				}
 				new_conn->sock = newsock;
 
-				/* Enqueue request for the dispatcher thread. */
-				cds_wfq_enqueue(&relay_conn_queue.queue, &new_conn->qnode);
-
-				/*
-				 * Wake the dispatch queue futex. Implicit memory barrier with
-				 * the exchange in cds_wfq_enqueue.
-				 */
-				futex_nto1_wake(&relay_conn_queue.futex);
+				/* Hand the connection to the worker thread. */
+				relay_conn_queue_enqueue(&relay_conn_queue, new_conn);
 			}
 		}
 	}
@@ -921,81 +957,6 @@ error_sock_control:
 	return NULL;
 }
 
-/*
- * This thread manages the dispatching of the requests to worker threads
- */
-static
-void *relay_thread_dispatcher(void *data)
-{
-	int err = -1;
-	ssize_t ret;
-	struct cds_wfq_node *node;
-	struct relay_connection *new_conn = NULL;
-
-	DBG("[thread] Relay dispatcher started");
-
-	health_register(health_relayd, HEALTH_RELAYD_TYPE_DISPATCHER);
-
-	if (testpoint(relayd_thread_dispatcher)) {
-		goto error_testpoint;
-	}
-
-	health_code_update();
-
-	while (!CMM_LOAD_SHARED(dispatch_thread_exit)) {
-		health_code_update();
-
-		/* Atomically prepare the queue futex */
-		futex_nto1_prepare(&relay_conn_queue.futex);
-
-		do {
-			health_code_update();
-
-			/* Dequeue commands */
-			node = cds_wfq_dequeue_blocking(&relay_conn_queue.queue);
-			if (node == NULL) {
-				DBG("Woken up but nothing in the relay command queue");
-				/* Continue thread execution */
-				break;
-			}
-			new_conn = caa_container_of(node, struct relay_connection, qnode);
-
-			DBG("Dispatching request waiting on sock %d", new_conn->sock->fd);
-
-			/*
-			 * Inform worker thread of the new request. This call is blocking
-			 * so we can be assured that the data will be read at some point in
-			 * time or wait to the end of the world :)
-			 */
-			ret = lttng_write(relay_conn_pipe[1], &new_conn, sizeof(new_conn));
-			if (ret < 0) {
-				PERROR("write connection pipe");
-				connection_destroy(new_conn);
-				goto error;
-			}
-		} while (node != NULL);
-
-		/* Futex wait on queue. Blocking call on futex() */
-		health_poll_entry();
-		futex_nto1_wait(&relay_conn_queue.futex);
-		health_poll_exit();
-	}
-
-	/* Normal exit, no error */
-	err = 0;
-
-error:
-error_testpoint:
-	if (err) {
-		health_error();
-		ERR("Health error occurred in %s", __func__);
-	}
-	health_unregister(health_relayd);
-	DBG("Dispatch thread dying");
-	stop_threads();
-	return NULL;
-}
-
 static void try_close_streams(struct relay_session *session)
 {
 	struct ctf_trace *ctf_trace;
@@ -1089,6 +1050,7 @@ int relay_create_session(struct lttcomm_relayd_hdr *recv_hdr,
 	}
 	session->minor = conn->minor;
 	session->major = conn->major;
+	session->compression = conn->compression;
 	conn->session_id = session->id;
 	conn->session = session;
 
@@ -1156,6 +1118,24 @@ static void queue_stream(struct relay_stream *stream,
 	cds_list_add(&stream->recv_list, &conn->recv_head);
 }
 
+/*
+ * Open the trace file of a data stream for direct I/O if enabled.
+ */
+static void stream_file_direct_io(struct relay_stream *stream, int fd)
+{
+	stream->direct_io = 0;
+	if (!opt_direct_io ||
+			!strncmp(stream->channel_name, DEFAULT_METADATA_NAME, NAME_MAX)) {
+		return;
+	}
+	if (utils_set_fd_direct_io(fd, 1) < 0) {
+		DBG("Tracefile of stream %" PRIu64 " written through the page cache",
+				stream->stream_handle);
+		return;
+	}
+	stream->direct_io = 1;
+}
+
 /*
  * relay_add_stream: allocate a new stream for a session
  */
@@ -1199,8 +1179,6 @@ int relay_add_stream(struct lttcomm_relayd_hdr *recv_hdr,
 	stream->stream_handle = ++last_relay_stream_id;
 	stream->prev_seq = -1ULL;
 	stream->session_id = session->id;
-	stream->index_fd = -1;
-	stream->read_index_fd = -1;
 	lttng_ht_node_init_u64(&stream->node, stream->stream_handle);
 	pthread_mutex_init(&stream->lock, NULL);
 
@@ -1220,7 +1198,12 @@ int relay_add_stream(struct lttcomm_relayd_hdr *recv_hdr,
 		ERR("Create output file");
 		goto end;
 	}
-	stream->fd = ret;
+	stream_file_direct_io(stream, ret);
+	stream->file = relay_fd_create(ret);
+	if (!stream->file) {
+		ret = -1;
+		goto end;
+	}
 	if (stream->tracefile_size) {
 		DBG("Tracefile %s/%s_0 created", stream->path_name, stream->channel_name);
 	} else {
@@ -1244,6 +1227,20 @@ int relay_add_stream(struct lttcomm_relayd_hdr *recv_hdr,
 		trace->metadata_stream = stream;
 	}
 
+	/*
+	 * Packets are only found in a compressed trace file through their index,
+	 * hence the data streams of sessions without indexes are stored as is.
+	 */
+	if (opt_compress_output && !stream->metadata_flag &&
+			session->minor >= 4 && !session->snapshot) {
+		stream->compress_output = 1;
+	}
+
+	/* Only the data streams of live sessions have indexes read by viewers. */
+	if (session->live_timer && !stream->metadata_flag) {
+		stream->index_cache = index_cache_create(opt_live_index_cache_size);
+	}
+
 	/*
 	 * Add the stream in the recv list of the connection. Once the end stream
 	 * message is received, this list is emptied and streams are set with the
@@ -1270,6 +1267,10 @@ end:
 	if (ret < 0) {
 		reply.ret_code = htobe32(LTTNG_ERR_UNK);
 		/* stream was not properly added to the ht, so free it */
+		if (stream->file) {
+			relay_fd_put_ref(stream->file);
+		}
+		index_cache_destroy(stream->index_cache);
 		free(stream);
 	} else {
 		reply.ret_code = htobe32(LTTNG_OK);
@@ -1439,6 +1440,202 @@ end:
 	return ret;
 }
 
+/*
+ * Make sure a receive buffer can hold size bytes. Its content is not kept.
+ * With direct I/O, the buffer is page aligned.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int reserve_buffer(char **buffer, unsigned int *buffer_size,
+		size_t size)
+{
+	int ret;
+	void *buf;
+
+	if (*buffer_size >= size) {
+		return 0;
+	}
+
+	free(*buffer);
+	*buffer = NULL;
+	*buffer_size = 0;
+
+	if (opt_direct_io) {
+		ret = posix_memalign(&buf, sysconf(_SC_PAGESIZE), size);
+		if (ret) {
+			buf = NULL;
+		}
+	} else {
+		buf = malloc(size);
+	}
+	if (!buf) {
+		ERR("Allocating data buffer");
+		return -1;
+	}
+	*buffer = buf;
+	*buffer_size = size;
+	return 0;
+}
+
+/*
+ * Extract the packet of a data payload of a compressed session received in
+ * data_buffer. On success, buf, buf_size and size are set to the packet, its
+ * buffer capacity and its size.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int uncompress_data(struct relay_stream *stream, char **buf,
+		size_t *buf_size, uint32_t *size, uint32_t padding_size)
+{
+	ssize_t ret;
+	uint32_t compression, payload_size;
+	struct lttcomm_relayd_compressed_hdr hdr;
+
+	if (*size < sizeof(hdr)) {
+		ERR("Compressed data of size %" PRIu32 " has no header", *size);
+		return -1;
+	}
+	memcpy(&hdr, data_buffer, sizeof(hdr));
+	compression = be32toh(hdr.compression);
+	payload_size = *size - sizeof(hdr);
+	*size = be32toh(hdr.size);
+
+	if (compression == LTTNG_COMPRESSION_NONE) {
+		if (*size != payload_size) {
+			ERR("Uncompressed data size mismatch (%" PRIu32 " != %" PRIu32 ")",
+					*size, payload_size);
+			return -1;
+		}
+		if (opt_direct_io) {
+			/* Keep the packet page aligned. */
+			memmove(data_buffer, data_buffer + sizeof(hdr), payload_size);
+			*buf = data_buffer;
+			*buf_size = data_buffer_size;
+		} else {
+			*buf = data_buffer + sizeof(hdr);
+			*buf_size = data_buffer_size - sizeof(hdr);
+		}
+		return 0;
+	}
+
+	ret = reserve_buffer(&uncompressed_buffer, &uncompressed_buffer_size,
+			(size_t) *size + padding_size);
+	if (ret < 0) {
+		return -1;
+	}
+	ret = decompress_buffer(compression, data_buffer + sizeof(hdr),
+			payload_size, uncompressed_buffer, *size);
+	if (ret != *size) {
+		ERR("Decompressing data of stream %" PRIu64, stream->stream_handle);
+		return -1;
+	}
+	*buf = uncompressed_buffer;
+	*buf_size = uncompressed_buffer_size;
+	return 0;
+}
+
+/*
+ * Compress a packet of a stream stored compressed. Its padding is zeroes and
+ * is not part of the compressed block. When the packet gets smaller, buf,
+ * buf_size and size are set to the compressed packet and padding_size to 0,
+ * otherwise they are left untouched and the packet is stored as is.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int compress_data(struct relay_stream *stream, char **buf,
+		size_t *buf_size, uint32_t *size, uint32_t *padding_size)
+{
+	ssize_t ret;
+	size_t packet_size = (size_t) *size + *padding_size;
+
+	if (packet_size < 2) {
+		return 0;
+	}
+	ret = reserve_buffer(&compressed_buffer, &compressed_buffer_size,
+			packet_size);
+	if (ret < 0) {
+		return -1;
+	}
+	/* A compressed packet MUST be smaller than the packet itself. */
+	ret = compress_buffer(LTTNG_COMPRESSION_LZ4, *buf, *size,
+			compressed_buffer, packet_size - 1);
+	if (ret < 0) {
+		DBG3("Packet of stream %" PRIu64 " stored uncompressed",
+				stream->stream_handle);
+		return 0;
+	}
+	*buf = compressed_buffer;
+	*buf_size = compressed_buffer_size;
+	*size = ret;
+	*padding_size = 0;
+	return 0;
+}
+
+/*
+ * Append a payload followed by its padding to a stream file. The buffer holds
+ * buf_size bytes, of which the first size are the payload.
+ *
+ * With direct I/O, the packet is written at once, its padding zeroed in the
+ * buffer, if the buffer has room for the padding and the packet size is a
+ * multiple of the page size, which is the case of every packet but a
+ * truncated last one. Since every previous write of the file was aligned, so
+ * is the file offset. Otherwise, the rest of the file is written through the
+ * page cache.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int write_stream_file(struct relay_stream *stream, char *buf,
+		size_t buf_size, size_t size, uint32_t padding_size)
+{
+	int ret, fd;
+	ssize_t size_ret;
+	struct relay_fd *file = stream->file;
+
+	if (!file) {
+		/* A previous rotation of the file failed. */
+		ret = -1;
+		goto end;
+	}
+
+	fd = relay_fd_acquire(file);
+	if (fd < 0) {
+		ret = -1;
+		goto end;
+	}
+
+	if (stream->direct_io) {
+		if (size + padding_size <= buf_size &&
+				utils_is_direct_io_aligned(0, size + padding_size, buf)) {
+			memset(buf + size, 0, padding_size);
+			size_ret = lttng_write(fd, buf, size + padding_size);
+			if (size_ret == size + padding_size) {
+				ret = 0;
+				goto end_release;
+			} else if (size_ret >= 0 || errno != EINVAL) {
+				ret = -1;
+				goto end_release;
+			}
+		}
+		DBG("Tracefile of stream %" PRIu64 " falls back on buffered writes",
+				stream->stream_handle);
+		(void) utils_set_fd_direct_io(fd, 0);
+		stream->direct_io = 0;
+	}
+
+	size_ret = lttng_write(fd, buf, size);
+	if (size_ret < size) {
+		ret = -1;
+		goto end_release;
+	}
+
+	ret = write_padding_to_file(fd, padding_size);
+
+end_release:
+	relay_fd_release(file);
+end:
+	return ret;
+}
+
 /*
  * relay_recv_metadata: receive the metada for the session.
  */
@@ -1447,7 +1644,6 @@ int relay_recv_metadata(struct lttcomm_relayd_hdr *recv_hdr,
 		struct relay_connection *conn)
 {
 	int ret = htobe32(LTTNG_OK);
-	ssize_t size_ret;
 	struct relay_session *session = conn->session;
 	struct lttcomm_relayd_metadata_payload *metadata_struct;
 	struct relay_stream *metadata_stream;
@@ -1468,19 +1664,9 @@ int relay_recv_metadata(struct lttcomm_relayd_hdr *recv_hdr,
 	}
 	payload_size -= sizeof(struct lttcomm_relayd_metadata_payload);
 
-	if (data_buffer_size < data_size) {
-		/* In case the realloc fails, we can free the memory */
-		char *tmp_data_ptr;
-
-		tmp_data_ptr = realloc(data_buffer, data_size);
-		if (!tmp_data_ptr) {
-			ERR("Allocating data buffer");
-			free(data_buffer);
-			ret = -1;
-			goto end;
-		}
-		data_buffer = tmp_data_ptr;
-		data_buffer_size = data_size;
+	ret = reserve_buffer(&data_buffer, &data_buffer_size, data_size);
+	if (ret < 0) {
+		goto end;
 	}
 	memset(data_buffer, 0, data_size);
 	DBG2("Relay receiving metadata, waiting for %" PRIu64 " bytes", data_size);
@@ -1505,17 +1691,11 @@ int relay_recv_metadata(struct lttcomm_relayd_hdr *recv_hdr,
 		goto end_unlock;
 	}
 
-	size_ret = lttng_write(metadata_stream->fd, metadata_struct->payload,
-			payload_size);
-	if (size_ret < payload_size) {
-		ERR("Relay error writing metadata on file");
-		ret = -1;
-		goto end_unlock;
-	}
-
-	ret = write_padding_to_file(metadata_stream->fd,
+	ret = write_stream_file(metadata_stream, metadata_struct->payload,
+			payload_size, payload_size,
 			be32toh(metadata_struct->padding_size));
 	if (ret < 0) {
+		ERR("Relay error writing metadata on file");
 		goto end_unlock;
 	}
 
@@ -1581,6 +1761,17 @@ int relay_send_version(struct lttcomm_relayd_hdr *recv_hdr,
 		conn->minor = be32toh(msg.minor);
 	}
 
+	/* Acknowledge the compression requested, if we support it. */
+	switch (be32toh(recv_hdr->cmd_version)) {
+	case LTTNG_COMPRESSION_LZ4:
+		conn->compression = be32toh(recv_hdr->cmd_version);
+		reply.minor |= conn->compression << RELAYD_VERSION_COMPRESSION_SHIFT;
+		break;
+	default:
+		conn->compression = LTTNG_COMPRESSION_NONE;
+		break;
+	}
+
 	reply.major = htobe32(reply.major);
 	reply.minor = htobe32(reply.minor);
 	ret = conn->sock->ops->sendmsg(conn->sock, &reply,
@@ -1589,8 +1780,9 @@ int relay_send_version(struct lttcomm_relayd_hdr *recv_hdr,
 		ERR("Relay sending version");
 	}
 
-	DBG("Version check done using protocol %u.%u", conn->major,
-			conn->minor);
+	DBG("Version check done using protocol %u.%u, compression %s",
+			conn->major, conn->minor,
+			compress_type_str(conn->compression));
 
 end:
 	return ret;
@@ -1882,6 +2074,42 @@ end_no_session:
 	return ret;
 }
 
+/*
+ * Write an index on disk and keep a copy in the index cache of the stream if
+ * it belongs to its current index file.
+ *
+ * RCU read side lock MUST be acquired.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int write_relay_index(struct relay_session *session,
+		struct relay_stream *stream, struct relay_index *index)
+{
+	int ret;
+
+	ret = relay_index_write(index);
+	if (ret < 0) {
+		goto end;
+	}
+	relay_stats_add_index(&session->stats,
+			utils_get_monotonic_ns() - index->create_ts);
+
+	if (index->file == stream->index_file) {
+		if (stream->index_cache) {
+			index_cache_add(stream->index_cache,
+					stream->tracefile_count_current,
+					stream->index_file_pos, &index->index_data);
+		}
+		stream->index_file_pos++;
+	}
+	stream->total_index_received++;
+	live_notify_new_index(stream);
+	ret = 0;
+
+end:
+	return ret;
+}
+
 /*
  * Receive an index for a specific stream.
  *
@@ -1978,11 +2206,10 @@ int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 
 	/* Do we have a writable ready index to write on disk. */
 	if (wr_index) {
-		ret = relay_index_write(wr_index->fd, wr_index);
+		ret = write_relay_index(session, stream, wr_index);
 		if (ret < 0) {
 			goto end_rcu_unlock;
 		}
-		stream->total_index_received++;
 	}
 
 end_rcu_unlock:
@@ -2119,18 +2346,25 @@ end:
  *
  * Return 0 on success else a negative value.
  */
-static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
-		int rotate_index)
+static int handle_index_data(struct relay_session *session,
+		struct relay_stream *stream, uint64_t net_seq_num, int rotate_index,
+		uint64_t stored_size)
 {
 	int ret = 0, index_created = 0;
-	uint64_t stream_id, data_offset;
+	uint64_t stream_id, data_offset, compressed_offset, compressed_size;
 	struct relay_index *index, *wr_index = NULL;
 
 	assert(stream);
 
 	stream_id = stream->stream_handle;
 	/* Get data offset because we are about to update the index. */
-	data_offset = htobe64(stream->tracefile_size_current);
+	compressed_offset = htobe64(stream->tracefile_size_current);
+	compressed_size = htobe64(stored_size);
+	if (stream->compress_output) {
+		data_offset = htobe64(stream->tracefile_uncompressed_size_current);
+	} else {
+		data_offset = compressed_offset;
+	}
 
 	/*
 	 * Lookup for an existing index for that stream id/sequence number. If on
@@ -2148,20 +2382,35 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 		index_created = 1;
 	}
 
-	if (rotate_index || stream->index_fd < 0) {
-		index->to_close_fd = stream->index_fd;
+	if (rotate_index || !stream->index_file) {
 		ret = index_create_file(stream->path_name, stream->channel_name,
 				relayd_uid, relayd_gid, stream->tracefile_size,
 				stream->tracefile_count_current);
 		if (ret < 0) {
-			/* This will close the stream's index fd if one. */
-			relay_index_free_safe(index);
-			goto error;
+			goto error_free;
+		}
+		/*
+		 * Pending indexes of the previous file hold a reference on it so it
+		 * is closed once they are all written.
+		 */
+		if (stream->index_file) {
+			relay_fd_put_ref(stream->index_file);
+		}
+		stream->index_file = relay_fd_create(ret);
+		stream->index_file_pos = 0;
+		if (!stream->index_file) {
+			ret = -1;
+			goto error_free;
 		}
-		stream->index_fd = ret;
 	}
-	index->fd = stream->index_fd;
+	if (index->file) {
+		relay_fd_put_ref(index->file);
+	}
+	relay_fd_get_ref(stream->index_file);
+	index->file = stream->index_file;
 	index->index_data.offset = data_offset;
+	index->index_data.compressed_offset = compressed_offset;
+	index->index_data.compressed_size = compressed_size;
 
 	if (index_created) {
 		/*
@@ -2171,9 +2420,13 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 		relay_index_add(index, &wr_index);
 		if (wr_index) {
 			/* Copy back data from the created index. */
-			wr_index->fd = index->fd;
-			wr_index->to_close_fd = index->to_close_fd;
+			if (wr_index->file) {
+				relay_fd_put_ref(wr_index->file);
+			}
+			wr_index->file = index->file;
 			wr_index->index_data.offset = data_offset;
+			wr_index->index_data.compressed_offset = compressed_offset;
+			wr_index->index_data.compressed_size = compressed_size;
 			free(index);
 		}
 	} else {
@@ -2183,15 +2436,58 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 
 	/* Do we have a writable ready index to write on disk. */
 	if (wr_index) {
-		ret = relay_index_write(wr_index->fd, wr_index);
+		ret = write_relay_index(session, stream, wr_index);
 		if (ret < 0) {
 			goto error;
 		}
-		stream->total_index_received++;
 	}
 
 error:
 	return ret;
+
+error_free:
+	if (index_created) {
+		relay_index_free_safe(index);
+	}
+	return ret;
+}
+
+/*
+ * Close the current trace file of a stream and create the next one of the
+ * on-disk circular buffer.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int rotate_stream_file(struct relay_stream *stream)
+{
+	int ret;
+
+	relay_fd_put_ref(stream->file);
+	stream->file = NULL;
+
+	if (stream->tracefile_count > 0) {
+		stream->tracefile_count_current =
+			(stream->tracefile_count_current + 1) % stream->tracefile_count;
+	} else {
+		stream->tracefile_count_current++;
+	}
+
+	ret = utils_create_stream_file(stream->path_name, stream->channel_name,
+			stream->tracefile_size, stream->tracefile_count_current,
+			relayd_uid, relayd_gid, NULL);
+	if (ret < 0) {
+		goto end;
+	}
+	stream_file_direct_io(stream, ret);
+	stream->file = relay_fd_create(ret);
+	if (!stream->file) {
+		ret = -1;
+		goto end;
+	}
+	ret = 0;
+
+end:
+	return ret;
 }
 
 /*
@@ -2201,13 +2497,15 @@ static
 int relay_process_data(struct relay_connection *conn)
 {
 	int ret = 0, rotate_index = 0;
-	ssize_t size_ret;
 	struct relay_stream *stream;
 	struct lttcomm_relayd_data_hdr data_hdr;
 	uint64_t stream_id;
 	uint64_t net_seq_num;
-	uint32_t data_size;
+	uint32_t data_size, padding_size;
+	uint64_t packet_size, received_size;
 	struct relay_session *session;
+	char *buf;
+	size_t buf_size;
 
 	assert(conn);
 
@@ -2237,18 +2535,16 @@ int relay_process_data(struct relay_connection *conn)
 	assert(session);
 
 	data_size = be32toh(data_hdr.data_size);
-	if (data_buffer_size < data_size) {
-		char *tmp_data_ptr;
-
-		tmp_data_ptr = realloc(data_buffer, data_size);
-		if (!tmp_data_ptr) {
-			ERR("Allocating data buffer");
-			free(data_buffer);
-			ret = -1;
-			goto end_rcu_unlock;
-		}
-		data_buffer = tmp_data_ptr;
-		data_buffer_size = data_size;
+	padding_size = be32toh(data_hdr.padding_size);
+	/*
+	 * With direct I/O, the padding is appended to the data in the buffer.
+	 * Whether the stream file is written with direct I/O can change on
+	 * rotation, so the room is reserved whenever the option is set.
+	 */
+	ret = reserve_buffer(&data_buffer, &data_buffer_size, opt_direct_io ?
+			(size_t) data_size + padding_size : data_size);
+	if (ret < 0) {
+		goto end_rcu_unlock;
 	}
 	memset(data_buffer, 0, data_size);
 
@@ -2266,6 +2562,28 @@ int relay_process_data(struct relay_connection *conn)
 		goto end_rcu_unlock;
 	}
 
+	received_size = sizeof(data_hdr) + (uint64_t) data_size;
+
+	buf = data_buffer;
+	buf_size = data_buffer_size;
+	if (session->compression != LTTNG_COMPRESSION_NONE) {
+		ret = uncompress_data(stream, &buf, &buf_size, &data_size,
+				padding_size);
+		if (ret < 0) {
+			goto end_rcu_unlock;
+		}
+	}
+
+	/* From here, data_size and padding_size are what is stored in the file. */
+	packet_size = (uint64_t) data_size + padding_size;
+	if (stream->compress_output) {
+		ret = compress_data(stream, &buf, &buf_size, &data_size,
+				&padding_size);
+		if (ret < 0) {
+			goto end_rcu_unlock;
+		}
+	}
+
 	/* Check if a rotation is needed. */
 	if (stream->tracefile_size > 0 &&
 			(stream->tracefile_size_current + data_size) >
@@ -2312,10 +2630,7 @@ int relay_process_data(struct relay_connection *conn)
 				vstream->close_write_flag = 1;
 			}
 		}
-		ret = utils_rotate_stream_file(stream->path_name, stream->channel_name,
-				stream->tracefile_size, stream->tracefile_count,
-				relayd_uid, relayd_gid, stream->fd,
-				&(stream->tracefile_count_current), &stream->fd);
+		ret = rotate_stream_file(stream);
 		stream->total_index_received = 0;
 		pthread_mutex_unlock(&stream->viewer_stream_rotation_lock);
 		if (ret < 0) {
@@ -2324,7 +2639,9 @@ int relay_process_data(struct relay_connection *conn)
 		}
 		/* Reset current size because we just perform a stream rotation. */
 		stream->tracefile_size_current = 0;
+		stream->tracefile_uncompressed_size_current = 0;
 		rotate_index = 1;
+		relay_stats_add_rotation(&session->stats);
 	}
 
 	/*
@@ -2332,31 +2649,33 @@ int relay_process_data(struct relay_connection *conn)
 	 * index are NOT supported.
 	 */
 	if (session->minor >= 4 && !session->snapshot) {
-		ret = handle_index_data(stream, net_seq_num, rotate_index);
+		ret = handle_index_data(session, stream, net_seq_num, rotate_index,
+				(uint64_t) data_size + padding_size);
 		if (ret < 0) {
 			goto end_rcu_unlock;
 		}
 	}
 
-	/* Write data to stream output fd. */
-	size_ret = lttng_write(stream->fd, data_buffer, data_size);
-	if (size_ret < data_size) {
+	/* Write data to stream output file. */
+	ret = write_stream_file(stream, buf, buf_size, data_size, padding_size);
+	if (ret < 0) {
 		ERR("Relay error writing data to file");
-		ret = -1;
 		goto end_rcu_unlock;
 	}
 
-	DBG2("Relay wrote %d bytes to tracefile for stream id %" PRIu64,
-			ret, stream->stream_handle);
-
-	ret = write_padding_to_file(stream->fd, be32toh(data_hdr.padding_size));
-	if (ret < 0) {
-		goto end_rcu_unlock;
-	}
-	stream->tracefile_size_current += data_size + be32toh(data_hdr.padding_size);
+	DBG2("Relay wrote %" PRIu32 " bytes to tracefile for stream id %" PRIu64,
+			data_size, stream->stream_handle);
+	stream->tracefile_size_current += data_size + padding_size;
+	stream->tracefile_uncompressed_size_current += packet_size;
 
 	stream->prev_seq = net_seq_num;
 
+	relay_stats_add_packet(&session->stats, received_size,
+			(uint64_t) data_size + padding_size);
+	relay_stats_add_packet(&conn->stats, received_size,
+			(uint64_t) data_size + padding_size);
+	conn->session_id = session->id;
+
 	try_close_stream(session, stream);
 
 end_rcu_unlock:
@@ -2387,6 +2706,7 @@ static void destroy_connection(struct lttng_ht *relay_connections_ht,
 	assert(conn);
 
 	connection_delete(relay_connections_ht, conn);
+	relay_stats_del_connection(conn);
 
 	/* For the control socket, we try to destroy the session. */
 	if (conn->type == RELAY_CONTROL && conn->session) {
@@ -2441,7 +2761,7 @@ void *relay_thread_worker(void *data)
 		goto error_poll_create;
 	}
 
-	ret = lttng_poll_add(&events, relay_conn_pipe[0], LPOLLIN | LPOLLRDHUP);
+	ret = lttng_poll_add(&events, relay_conn_queue.event_fd, LPOLLIN);
 	if (ret < 0) {
 		goto error;
 	}
@@ -2488,25 +2808,26 @@ restart:
 				goto exit;
 			}
 
-			/* Inspect the relay conn pipe for new connection */
-			if (pollfd == relay_conn_pipe[0]) {
-				if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
-					ERR("Relay connection pipe error");
+			/* Inspect the relay conn queue for new connections */
+			if (pollfd == relay_conn_queue.event_fd) {
+				if (revents & LPOLLERR) {
+					ERR("Relay connection queue error");
 					goto error;
 				} else if (revents & LPOLLIN) {
-					ret = lttng_read(relay_conn_pipe[0], &conn, sizeof(conn));
-					if (ret < 0) {
-						goto error;
+					relay_conn_queue_ack(&relay_conn_queue);
+					while ((conn = relay_conn_queue_dequeue(
+							&relay_conn_queue))) {
+						conn->sessions_ht = sessions_ht;
+						connection_init(conn);
+						lttng_poll_add(&events, conn->sock->fd,
+								LPOLLIN | LPOLLRDHUP);
+						rcu_read_lock();
+						lttng_ht_add_unique_ulong(relay_connections_ht,
+								&conn->sock_n);
+						rcu_read_unlock();
+						relay_stats_add_connection(conn);
+						DBG("Connection socket %d added", conn->sock->fd);
 					}
-					conn->sessions_ht = sessions_ht;
-					connection_init(conn);
-					lttng_poll_add(&events, conn->sock->fd,
-							LPOLLIN | LPOLLRDHUP);
-					rcu_read_lock();
-					lttng_ht_add_unique_ulong(relay_connections_ht,
-							&conn->sock_n);
-					rcu_read_unlock();
-					DBG("Connection socket %d added", conn->sock->fd);
 				}
 			} else {
 				rcu_read_lock();
@@ -2530,6 +2851,9 @@ restart:
 							destroy_connection(relay_connections_ht, conn);
 							DBG("Control connection closed with %d", pollfd);
 						} else {
+							relay_stats_add_packet(&conn->stats,
+									sizeof(recv_hdr) +
+									be64toh(recv_hdr.data_size), 0);
 							ret = relay_process_control(&recv_hdr, conn);
 							if (ret < 0) {
 								/* Clear the session on error. */
@@ -2583,8 +2907,8 @@ restart:
 
 			health_code_update();
 
-			/* Skip the command pipe. It's handled in the first loop. */
-			if (pollfd == relay_conn_pipe[0]) {
+			/* Skip the connection queue. It's handled in the first loop. */
+			if (pollfd == relay_conn_queue.event_fd) {
 				continue;
 			}
 
@@ -2646,13 +2970,13 @@ error_poll_create:
 indexes_ht_error:
 	lttng_ht_destroy(relay_connections_ht);
 relay_connections_ht_error:
-	/* Close relay conn pipes */
-	utils_close_pipe(relay_conn_pipe);
 	if (err) {
 		DBG("Thread exited with error");
 	}
 	DBG("Worker thread cleanup complete");
 	free(data_buffer);
+	free(uncompressed_buffer);
+	free(compressed_buffer);
 error_testpoint:
 	if (err) {
 		health_error();
@@ -2665,21 +2989,31 @@ error_testpoint:
 }
 
 /*
- * Create the relay command pipe to wake thread_manage_apps.
- * Closed in cleanup().
+ * main
  */
-static int create_relay_conn_pipe(void)
+/*
+ * Cap the number of trace, index and viewer files kept open at once. Unless
+ * set with --fd-cap, a share of the open files limit is left to the sockets
+ * and pipes of the daemon.
+ */
+static void init_fd_cache(void)
 {
 	int ret;
+	struct rlimit rlim;
 
-	ret = utils_create_pipe_cloexec(relay_conn_pipe);
+	if (!opt_fd_cap) {
+		ret = getrlimit(RLIMIT_NOFILE, &rlim);
+		if (ret < 0) {
+			PERROR("getrlimit");
+		} else if (rlim.rlim_cur != RLIM_INFINITY) {
+			opt_fd_cap = (rlim.rlim_cur * DEFAULT_RELAYD_FD_CAP_THRESHOLD)
+				/ 100;
+		}
+	}
 
-	return ret;
+	relay_fd_cache_init(opt_fd_cap);
 }
 
-/*
- * main
- */
 int main(int argc, char **argv)
 {
 	int ret = 0;
@@ -2735,6 +3069,8 @@ int main(int argc, char **argv)
 		goto error;
 	}
 
+	init_fd_cache();
+
 	/* We need those values for the file/dir creation. */
 	relayd_uid = getuid();
 	relayd_gid = getgid();
@@ -2748,14 +3084,12 @@ int main(int argc, char **argv)
 		}
 	}
 
-	/* Setup the thread apps communication pipe. */
-	if ((ret = create_relay_conn_pipe()) < 0) {
+	/* Init relay connection queue, released in cleanup(). */
+	ret = relay_conn_queue_init(&relay_conn_queue);
+	if (ret < 0) {
 		goto exit;
 	}
 
-	/* Init relay command queue. */
-	cds_wfq_init(&relay_conn_queue.queue);
-
 	/* Set up max poll set size */
 	lttng_poll_set_max_size();
 
@@ -2807,12 +3141,12 @@ int main(int argc, char **argv)
 		goto health_error;
 	}
 
-	/* Setup the dispatcher thread */
-	ret = pthread_create(&dispatcher_thread, NULL,
-			relay_thread_dispatcher, (void *) NULL);
+	/* Create thread to serve the statistics socket */
+	ret = pthread_create(&stats_thread, NULL,
+			thread_manage_stats, (void *) relay_ctx);
 	if (ret != 0) {
-		PERROR("pthread_create dispatcher");
-		goto exit_dispatcher;
+		PERROR("pthread_create stats");
+		goto exit_stats;
 	}
 
 	/* Setup the worker thread */
@@ -2852,13 +3186,13 @@ exit_listener:
 	}
 
 exit_worker:
-	ret = pthread_join(dispatcher_thread, &status);
+	ret = pthread_join(stats_thread, &status);
 	if (ret != 0) {
-		PERROR("pthread_join");
+		PERROR("pthread_join stats thread");
 		goto error;	/* join error, exit without cleanup */
 	}
 
-exit_dispatcher:
+exit_stats:
 	ret = pthread_join(health_thread, &status);
 	if (ret != 0) {
 		PERROR("pthread_join health thread");
@@ -57,6 +57,7 @@ struct relay_session *session_create(void)
 	}
 
 	pthread_mutex_init(&session->viewer_ready_lock, NULL);
+	relay_stats_init(&session->stats);
 	session->id = ++last_relay_session_id;
 	lttng_ht_node_init_u64(&session->session_n, session->id);
 
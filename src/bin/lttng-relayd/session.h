@@ -26,6 +26,8 @@
 
 #include <common/hashtable/hashtable.h>
 
+#include "stats.h"
+
 /*
  * Represents a session for the relay point of view
  */
@@ -60,6 +62,11 @@ struct relay_session {
 	 */
 	uint64_t minor;
 	uint64_t major;
+	/*
+	 * Compression of the data packets of this session, negotiated by the
+	 * control connection (enum lttng_compression).
+	 */
+	uint32_t compression;
 	/*
 	 * Flag checked and exchanged with uatomic_cmpxchg to tell the
 	 * viewer-side if new streams got added since the last check.
@@ -77,6 +84,9 @@ struct relay_session {
 	 * Member of the session list in struct relay_viewer_session.
 	 */
 	struct cds_list_head viewer_session_list;
+
+	/* Ingest counters of the session, see stats.h. */
+	struct relay_stats stats;
 };
 
 struct relay_viewer_session {
@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <urcu/list.h>
+
+#include <common/common.h>
+#include <common/compat/poll.h>
+#include <common/defaults.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <common/utils.h>
+
+#include "lttng-relayd.h"
+#include "lttng-viewer-abi.h"
+#include "health-relayd.h"
+#include "connection.h"
+#include "session.h"
+#include "stats.h"
+
+/* Time a client has to read each part of the statistics reply. */
+#define STATS_SEND_TIMEOUT_MS	1000
+
+/* Global statistics unix path */
+static char stats_unix_sock_path[PATH_MAX];
+
+/* Connections of the worker thread, reported with their backlog. */
+static CDS_LIST_HEAD(stats_connections);
+static pthread_mutex_t stats_connections_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Requests of the live viewers, indexed by enum lttng_viewer_command. */
+static const char *viewer_cmd_names[] = {
+	[LTTNG_VIEWER_CONNECT] = "connect",
+	[LTTNG_VIEWER_LIST_SESSIONS] = "list_sessions",
+	[LTTNG_VIEWER_ATTACH_SESSION] = "attach_session",
+	[LTTNG_VIEWER_GET_NEXT_INDEX] = "get_next_index",
+	[LTTNG_VIEWER_GET_PACKET] = "get_packet",
+	[LTTNG_VIEWER_GET_METADATA] = "get_metadata",
+	[LTTNG_VIEWER_GET_NEW_STREAMS] = "get_new_streams",
+	[LTTNG_VIEWER_CREATE_SESSION] = "create_session",
+	[LTTNG_VIEWER_SUBSCRIBE] = "subscribe",
+};
+
+#define NR_VIEWER_CMDS	(sizeof(viewer_cmd_names) / sizeof(viewer_cmd_names[0]))
+
+static struct {
+	pthread_mutex_t lock;
+	uint64_t requests[NR_VIEWER_CMDS];
+	uint64_t time_total[NR_VIEWER_CMDS];
+} viewer_stats = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t start_ts;
+
+void relay_stats_init(struct relay_stats *stats)
+{
+	assert(stats);
+
+	memset(stats, 0, sizeof(*stats));
+	pthread_mutex_init(&stats->lock, NULL);
+}
+
+void relay_stats_add_packet(struct relay_stats *stats, uint64_t received,
+		uint64_t written)
+{
+	pthread_mutex_lock(&stats->lock);
+	stats->packets++;
+	stats->bytes_received += received;
+	stats->bytes_written += written;
+	pthread_mutex_unlock(&stats->lock);
+}
+
+void relay_stats_add_index(struct relay_stats *stats, uint64_t wait)
+{
+	pthread_mutex_lock(&stats->lock);
+	stats->indexes++;
+	stats->index_wait_total += wait;
+	if (wait > stats->index_wait_max) {
+		stats->index_wait_max = wait;
+	}
+	pthread_mutex_unlock(&stats->lock);
+}
+
+void relay_stats_add_rotation(struct relay_stats *stats)
+{
+	pthread_mutex_lock(&stats->lock);
+	stats->rotations++;
+	pthread_mutex_unlock(&stats->lock);
+}
+
+void relay_stats_add_viewer_request(uint32_t cmd, uint64_t duration)
+{
+	if (cmd >= NR_VIEWER_CMDS || !viewer_cmd_names[cmd]) {
+		return;
+	}
+
+	pthread_mutex_lock(&viewer_stats.lock);
+	viewer_stats.requests[cmd]++;
+	viewer_stats.time_total[cmd] += duration;
+	pthread_mutex_unlock(&viewer_stats.lock);
+}
+
+void relay_stats_add_connection(struct relay_connection *conn)
+{
+	pthread_mutex_lock(&stats_connections_lock);
+	cds_list_add_tail(&conn->stats_node, &stats_connections);
+	pthread_mutex_unlock(&stats_connections_lock);
+}
+
+void relay_stats_del_connection(struct relay_connection *conn)
+{
+	pthread_mutex_lock(&stats_connections_lock);
+	cds_list_del(&conn->stats_node);
+	pthread_mutex_unlock(&stats_connections_lock);
+}
+
+static void copy_stats(struct relay_stats *dst, struct relay_stats *src)
+{
+	pthread_mutex_lock(&src->lock);
+	memcpy(dst, src, sizeof(*dst));
+	pthread_mutex_unlock(&src->lock);
+}
+
+/*
+ * Print a label value, escaping the characters the exposition format
+ * reserves.
+ */
+static void print_label(FILE *f, const char *value)
+{
+	for (; *value; value++) {
+		switch (*value) {
+		case '"':
+		case '\\':
+			fputc('\\', f);
+			fputc(*value, f);
+			break;
+		case '\n':
+			fputs("\\n", f);
+			break;
+		default:
+			fputc(*value, f);
+		}
+	}
+}
+
+static void print_sessions(FILE *f, struct lttng_ht *sessions_ht)
+{
+	struct lttng_ht_iter iter;
+	struct relay_session *session;
+	struct relay_stats stats;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(sessions_ht->ht, &iter.iter, session,
+			session_n.node) {
+		copy_stats(&stats, &session->stats);
+
+#define PRINT_SESSION(name, value)					\
+		do {							\
+			fprintf(f, "relayd_session_" name "{id=\"%" PRIu64	\
+					"\",session=\"", session->id);	\
+			print_label(f, session->session_name);		\
+			fputs("\",hostname=\"", f);			\
+			print_label(f, session->hostname);		\
+			fprintf(f, "\"} %" PRIu64 "\n", (value));	\
+		} while (0)
+
+		PRINT_SESSION("packets_total", stats.packets);
+		PRINT_SESSION("bytes_received_total", stats.bytes_received);
+		PRINT_SESSION("bytes_written_total", stats.bytes_written);
+		PRINT_SESSION("indexes_total", stats.indexes);
+		PRINT_SESSION("index_wait_ns_total", stats.index_wait_total);
+		PRINT_SESSION("index_wait_ns_max", stats.index_wait_max);
+		PRINT_SESSION("rotations_total", stats.rotations);
+		PRINT_SESSION("streams", (uint64_t) session->stream_count);
+
+#undef PRINT_SESSION
+	}
+	rcu_read_unlock();
+}
+
+static void print_connections(FILE *f)
+{
+	struct relay_connection *conn;
+	struct relay_stats stats;
+
+	pthread_mutex_lock(&stats_connections_lock);
+	cds_list_for_each_entry(conn, &stats_connections, stats_node) {
+		int backlog = 0;
+		const char *type;
+
+		copy_stats(&stats, &conn->stats);
+		/* Bytes received by the kernel the worker did not read yet. */
+		if (ioctl(conn->sock->fd, FIONREAD, &backlog) < 0) {
+			backlog = 0;
+		}
+		type = conn->type == RELAY_DATA ? "data" : "control";
+
+#define PRINT_CONNECTION(name, value)					\
+		fprintf(f, "relayd_connection_" name "{fd=\"%d\",type=\"%s\","	\
+				"session_id=\"%" PRIu64 "\"} %" PRIu64 "\n",	\
+				conn->sock->fd, type, conn->session_id,		\
+				(uint64_t) (value))
+
+		PRINT_CONNECTION("messages_total", stats.packets);
+		PRINT_CONNECTION("bytes_received_total", stats.bytes_received);
+		PRINT_CONNECTION("backlog_bytes", backlog);
+
+#undef PRINT_CONNECTION
+	}
+	pthread_mutex_unlock(&stats_connections_lock);
+}
+
+static void print_viewer(FILE *f)
+{
+	int i;
+	uint64_t requests[NR_VIEWER_CMDS], time_total[NR_VIEWER_CMDS];
+
+	pthread_mutex_lock(&viewer_stats.lock);
+	memcpy(requests, viewer_stats.requests, sizeof(requests));
+	memcpy(time_total, viewer_stats.time_total, sizeof(time_total));
+	pthread_mutex_unlock(&viewer_stats.lock);
+
+	for (i = 0; i < NR_VIEWER_CMDS; i++) {
+		if (!viewer_cmd_names[i]) {
+			continue;
+		}
+		fprintf(f, "relayd_viewer_requests_total{command=\"%s\"} %" PRIu64 "\n",
+				viewer_cmd_names[i], requests[i]);
+		fprintf(f, "relayd_viewer_request_ns_total{command=\"%s\"} %" PRIu64 "\n",
+				viewer_cmd_names[i], time_total[i]);
+	}
+}
+
+/*
+ * Write every counter on the socket, one "name{labels} value" line each, and
+ * close it. The reply is formatted in memory first so that the locks shared
+ * with the worker threads and the RCU read-side critical section are never
+ * held while waiting on a client which does not read, and the send gives up
+ * after STATS_SEND_TIMEOUT_MS.
+ */
+static void send_stats(int sock, struct lttng_ht *sessions_ht)
+{
+	FILE *f;
+	char *buf = NULL;
+	size_t len = 0, sent = 0;
+	ssize_t ret;
+
+	f = open_memstream(&buf, &len);
+	if (!f) {
+		PERROR("open_memstream stats reply");
+		goto end;
+	}
+
+	fprintf(f, "relayd_uptime_ns %" PRIu64 "\n", utils_get_monotonic_ns() - start_ts);
+	print_sessions(f, sessions_ht);
+	print_connections(f);
+	print_viewer(f);
+
+	if (fclose(f)) {
+		PERROR("fclose stats reply");
+		goto end;
+	}
+
+	(void) lttcomm_setsockopt_snd_timeout(sock, STATS_SEND_TIMEOUT_MS);
+	while (sent < len) {
+		ret = lttcomm_send_unix_sock(sock, buf + sent, len - sent);
+		if (ret <= 0) {
+			DBG("Statistics client stopped reading, reply truncated");
+			break;
+		}
+		sent += ret;
+	}
+
+end:
+	free(buf);
+	if (close(sock)) {
+		PERROR("close");
+	}
+}
+
+/*
+ * Thread serving the statistics socket. A client connects and reads the
+ * statistics until the relay daemon closes the connection.
+ */
+void *thread_manage_stats(void *data)
+{
+	int sock = -1, new_sock, ret, i, err = -1;
+	uint32_t revents, nb_fd;
+	struct lttng_poll_event events;
+	struct relay_local_data *relay_ctx = data;
+
+	DBG("[thread] Manage statistics started");
+
+	start_ts = utils_get_monotonic_ns();
+
+	rcu_register_thread();
+
+	/* We might hit an error path before this is created. */
+	lttng_poll_init(&events);
+
+	ret = setup_relayd_sock_path(stats_unix_sock_path,
+			sizeof(stats_unix_sock_path), LTTNG_RELAYD_STATS_ENV,
+			DEFAULT_GLOBAL_RELAY_STATS_UNIX_SOCK,
+			DEFAULT_HOME_RELAY_STATS_UNIX_SOCK);
+	if (ret < 0) {
+		goto error;
+	}
+
+	sock = lttcomm_create_unix_sock(stats_unix_sock_path);
+	if (sock < 0) {
+		ERR("Unable to create statistics Unix socket");
+		goto error;
+	}
+
+	if (!getuid()) {
+		ret = chown(stats_unix_sock_path, 0,
+				utils_get_group_id(tracing_group_name));
+		if (ret < 0) {
+			ERR("Unable to set group on %s", stats_unix_sock_path);
+			PERROR("chown");
+			goto error;
+		}
+
+		ret = chmod(stats_unix_sock_path,
+				S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+		if (ret < 0) {
+			ERR("Unable to set permissions on %s", stats_unix_sock_path);
+			PERROR("chmod");
+			goto error;
+		}
+	}
+
+	(void) utils_set_fd_cloexec(sock);
+
+	ret = lttcomm_listen_unix_sock(sock);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = lttng_poll_create(&events, 2, LTTNG_CLOEXEC);
+	if (ret < 0) {
+		ERR("Poll set creation failed");
+		goto error;
+	}
+
+	ret = lttng_poll_add(&events, thread_quit_pipe[0], LPOLLIN | LPOLLERR);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = lttng_poll_add(&events, sock, LPOLLIN | LPOLLPRI);
+	if (ret < 0) {
+		goto error;
+	}
+
+	while (1) {
+restart:
+		ret = lttng_poll_wait(&events, -1);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				goto restart;
+			}
+			goto error;
+		}
+
+		nb_fd = ret;
+
+		for (i = 0; i < nb_fd; i++) {
+			int pollfd = LTTNG_POLL_GETFD(&events, i);
+
+			revents = LTTNG_POLL_GETEV(&events, i);
+
+			/* Thread quit pipe has been triggered. Killing thread. */
+			if (pollfd == thread_quit_pipe[0] && (revents & LPOLLIN)) {
+				err = 0;
+				goto exit;
+			}
+
+			if (pollfd == sock &&
+					(revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP))) {
+				ERR("Statistics socket poll error");
+				goto error;
+			}
+		}
+
+		new_sock = lttcomm_accept_unix_sock(sock);
+		if (new_sock < 0) {
+			goto error;
+		}
+
+		(void) utils_set_fd_cloexec(new_sock);
+
+		send_stats(new_sock, relay_ctx->sessions_ht);
+	}
+
+exit:
+error:
+	if (err) {
+		ERR("Statistics thread error occurred in %s", __func__);
+	}
+	DBG("Statistics thread dying");
+	if (sock >= 0) {
+		unlink(stats_unix_sock_path);
+		ret = close(sock);
+		if (ret) {
+			PERROR("close");
+		}
+	}
+
+	lttng_poll_clean(&events);
+
+	rcu_unregister_thread();
+	return NULL;
+}
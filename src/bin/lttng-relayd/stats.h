@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef RELAYD_STATS_H
+#define RELAYD_STATS_H
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#define LTTNG_RELAYD_STATS_ENV		"LTTNG_RELAYD_STATS"
+
+struct relay_connection;
+
+/*
+ * Counters of a session or of a connection. They are only ever incremented
+ * so the rates are computed by whoever scrapes them. The lock protects the
+ * counters against the reads of the statistics thread.
+ */
+struct relay_stats {
+	pthread_mutex_t lock;
+	/* Data packets, or commands on a control connection. */
+	uint64_t packets;
+	/* Bytes received on the socket, headers included. */
+	uint64_t bytes_received;
+	/* Bytes written in the trace files, padding included. */
+	uint64_t bytes_written;
+	/* Indexes written once both their data and control halves arrived. */
+	uint64_t indexes;
+	/* Time between the first and the second half of an index, in ns. */
+	uint64_t index_wait_total;
+	uint64_t index_wait_max;
+	/* Trace file rotations. */
+	uint64_t rotations;
+};
+
+void relay_stats_init(struct relay_stats *stats);
+void relay_stats_add_packet(struct relay_stats *stats, uint64_t received,
+		uint64_t written);
+void relay_stats_add_index(struct relay_stats *stats, uint64_t wait);
+void relay_stats_add_rotation(struct relay_stats *stats);
+void relay_stats_add_viewer_request(uint32_t cmd, uint64_t duration);
+
+void relay_stats_add_connection(struct relay_connection *conn);
+void relay_stats_del_connection(struct relay_connection *conn);
+
+void *thread_manage_stats(void *data);
+
+#endif /* RELAYD_STATS_H */
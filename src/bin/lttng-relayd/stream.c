@@ -28,6 +28,7 @@ static void rcu_destroy_stream(struct rcu_head *head)
 	struct relay_stream *stream =
 		caa_container_of(head, struct relay_stream, rcu_node);
 
+	index_cache_destroy(stream->index_cache);
 	free(stream->path_name);
 	free(stream->channel_name);
 	free(stream);
@@ -69,7 +70,7 @@ end:
  */
 int stream_close(struct relay_session *session, struct relay_stream *stream)
 {
-	int delret, ret;
+	int ret;
 	struct relay_viewer_stream *vstream;
 	struct ctf_trace *ctf_trace;
 
@@ -85,18 +86,14 @@ int stream_close(struct relay_session *session, struct relay_stream *stream)
 
 	DBG("Closing stream id %" PRIu64, stream->stream_handle);
 
-	if (stream->fd >= 0) {
-		delret = close(stream->fd);
-		if (delret < 0) {
-			PERROR("close stream");
-		}
+	if (stream->file) {
+		relay_fd_put_ref(stream->file);
+		stream->file = NULL;
 	}
 
-	if (stream->index_fd >= 0) {
-		delret = close(stream->index_fd);
-		if (delret < 0) {
-			PERROR("close stream index_fd");
-		}
+	if (stream->index_file) {
+		relay_fd_put_ref(stream->index_file);
+		stream->index_file = NULL;
 	}
 
 	vstream = viewer_stream_find_by_id(stream->stream_handle);
@@ -26,6 +26,8 @@
 
 #include <common/hashtable/hashtable.h>
 
+#include "fd-cache.h"
+#include "index-cache.h"
 #include "session.h"
 
 /*
@@ -46,17 +48,29 @@ struct relay_stream {
 	struct cds_list_head trace_list;
 	struct rcu_head rcu_node;
 	uint64_t session_id;
-	int fd;
-	/* FD on which to write the index data. */
-	int index_fd;
-	/* FD on which to read the index data for the viewer. */
-	int read_index_fd;
+	/* Trace file on which to write the data. */
+	struct relay_fd *file;
+	/* Set while the trace file is written with direct I/O. */
+	int direct_io;
+	/* Set if the packets are stored compressed in the trace files. */
+	int compress_output;
+	/* File on which to write the index data. */
+	struct relay_fd *index_file;
+	/* Number of indexes written in the current index file. */
+	uint64_t index_file_pos;
+	/*
+	 * Recent indexes kept in memory for the live viewers, NULL if the session
+	 * is not live or the cache is disabled.
+	 */
+	struct index_cache *index_cache;
 
 	char *path_name;
 	char *channel_name;
 	/* on-disk circular buffer of tracefiles */
 	uint64_t tracefile_size;
 	uint64_t tracefile_size_current;
+	/* Size of the current trace file once expanded, if compressed. */
+	uint64_t tracefile_uncompressed_size_current;
 	uint64_t tracefile_count;
 	uint64_t tracefile_count_current;
 	/* To inform the viewer up to where it can go back in time. */
@@ -64,6 +78,11 @@ struct relay_stream {
 
 	uint64_t total_index_received;
 	uint64_t last_net_seq_num;
+	/*
+	 * Set with uatomic_cmpxchg when a new index notification for this stream
+	 * is queued to the live worker thread, cleared when it is handled.
+	 */
+	unsigned long index_notify_pending;
 
 	/*
 	 * To protect from concurrent read/update. Also used to synchronize the
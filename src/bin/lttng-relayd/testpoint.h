@@ -22,10 +22,8 @@
 #include <common/testpoint/testpoint.h>
 
 /* Testpoints, internal use only */
-TESTPOINT_DECL(relayd_thread_dispatcher);
 TESTPOINT_DECL(relayd_thread_worker);
 TESTPOINT_DECL(relayd_thread_listener);
-TESTPOINT_DECL(relayd_thread_live_dispatcher);
 TESTPOINT_DECL(relayd_thread_live_worker);
 TESTPOINT_DECL(relayd_thread_live_listener);
 
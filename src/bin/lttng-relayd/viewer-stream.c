@@ -83,9 +83,6 @@ struct relay_viewer_stream *viewer_stream_create(struct relay_stream *stream,
 	lttng_ht_node_init_u64(&vstream->stream_n, stream->stream_handle);
 	lttng_ht_add_unique_u64(viewer_streams_ht, &vstream->stream_n);
 
-	vstream->index_read_fd = -1;
-	vstream->read_fd = -1;
-
 	/*
 	 * This is to avoid a race between the initialization of this object and
 	 * the close of the given stream. If the stream is unable to find this
@@ -98,10 +95,8 @@ struct relay_viewer_stream *viewer_stream_create(struct relay_stream *stream,
 	 * If we never received an index for the current stream, delay the opening
 	 * of the index, otherwise open it right now.
 	 */
-	if (vstream->tracefile_count_current == stream->tracefile_count_current
-			&& vstream->total_index_received == 0) {
-		vstream->index_read_fd = -1;
-	} else {
+	if (vstream->tracefile_count_current != stream->tracefile_count_current
+			|| vstream->total_index_received != 0) {
 		int read_fd;
 
 		read_fd = index_open(vstream->path_name, vstream->channel_name,
@@ -109,18 +104,14 @@ struct relay_viewer_stream *viewer_stream_create(struct relay_stream *stream,
 		if (read_fd < 0) {
 			goto error;
 		}
-		vstream->index_read_fd = read_fd;
-	}
-
-	if (seek_t == LTTNG_VIEWER_SEEK_LAST && vstream->index_read_fd >= 0) {
-		off_t lseek_ret;
-
-		lseek_ret = lseek(vstream->index_read_fd,
-				vstream->total_index_received * sizeof(struct ctf_packet_index),
-				SEEK_CUR);
-		if (lseek_ret < 0) {
+		vstream->index_file = relay_fd_create(read_fd);
+		if (!vstream->index_file) {
 			goto error;
 		}
+	}
+
+	if (seek_t == LTTNG_VIEWER_SEEK_LAST && vstream->index_file) {
+		vstream->index_read_pos = vstream->total_index_received;
 		vstream->last_sent_index = vstream->total_index_received;
 	}
 
@@ -146,25 +137,19 @@ void viewer_stream_delete(struct relay_viewer_stream *stream)
 void viewer_stream_destroy(struct ctf_trace *ctf_trace,
 		struct relay_viewer_stream *stream)
 {
-	int ret;
-
 	assert(stream);
 
 	if (ctf_trace) {
 		ctf_trace_put_ref(ctf_trace);
 	}
 
-	if (stream->read_fd >= 0) {
-		ret = close(stream->read_fd);
-		if (ret < 0) {
-			PERROR("close read_fd");
-		}
+	if (stream->read_file) {
+		relay_fd_put_ref(stream->read_file);
+		stream->read_file = NULL;
 	}
-	if (stream->index_read_fd >= 0) {
-		ret = close(stream->index_read_fd);
-		if (ret < 0) {
-			PERROR("close index_read_fd");
-		}
+	if (stream->index_file) {
+		relay_fd_put_ref(stream->index_file);
+		stream->index_file = NULL;
 	}
 
 	call_rcu(&stream->rcu_node, deferred_free_viewer_stream);
@@ -243,17 +228,15 @@ int viewer_stream_rotate(struct relay_viewer_stream *vstream,
 	}
 	vstream->tracefile_count_current = tracefile_id;
 
-	ret = close(vstream->index_read_fd);
-	if (ret < 0) {
-		PERROR("close index file %d", vstream->index_read_fd);
+	if (vstream->index_file) {
+		relay_fd_put_ref(vstream->index_file);
+		vstream->index_file = NULL;
 	}
-	vstream->index_read_fd = -1;
 
-	ret = close(vstream->read_fd);
-	if (ret < 0) {
-		PERROR("close tracefile %d", vstream->read_fd);
+	if (vstream->read_file) {
+		relay_fd_put_ref(vstream->read_file);
+		vstream->read_file = NULL;
 	}
-	vstream->read_fd = -1;
 
 	pthread_mutex_lock(&vstream->overwrite_lock);
 	vstream->abort_flag = 0;
@@ -264,7 +247,12 @@ int viewer_stream_rotate(struct relay_viewer_stream *vstream,
 	if (ret < 0) {
 		goto error;
 	}
-	vstream->index_read_fd = ret;
+	vstream->index_file = relay_fd_create(ret);
+	if (!vstream->index_file) {
+		ret = -1;
+		goto error;
+	}
+	vstream->index_read_pos = 0;
 
 	ret = 0;
 
@@ -26,6 +26,7 @@
 #include <common/hashtable/hashtable.h>
 
 #include "ctf-trace.h"
+#include "fd-cache.h"
 #include "lttng-viewer-abi.h"
 #include "stream.h"
 
@@ -41,11 +42,16 @@ struct relay_stream;
 struct relay_viewer_stream {
 	uint64_t stream_handle;
 	uint64_t session_id;
-	int read_fd;
-	int index_read_fd;
+	/* Trace file and index file currently read, NULL if not opened yet. */
+	struct relay_fd *read_file;
+	struct relay_fd *index_file;
 	char *path_name;
 	char *channel_name;
 	uint64_t last_sent_index;
+	/* Last index sent, locates its packet in a compressed trace file. */
+	struct ctf_packet_index last_index;
+	/* Position of the next index to read in the current index file. */
+	uint64_t index_read_pos;
 	uint64_t total_index_received;
 	uint64_t tracefile_count;
 	uint64_t tracefile_count_current;
@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <urcu/list.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+
+#include "buffer-advice.h"
+#include "trace-kernel.h"
+#include "trace-ust.h"
+
+/* Discards reported for a channel of a tracked session. */
+struct advice_channel {
+	enum lttng_domain_type domain;
+	char name[LTTNG_SYMBOL_NAME_LEN];
+	uint64_t events_discarded;
+	uint64_t subbuf_count;
+	/* Sum of the fill ratio of the reported sub-buffers, in per mille. */
+	uint64_t fill_total;
+	struct cds_list_head list;
+};
+
+struct advice_session {
+	uint64_t id;
+	char name[NAME_MAX];
+	struct cds_list_head channels;
+	struct cds_list_head list;
+};
+
+/* Buffer recommended for the channel of the next session of that name. */
+struct advice {
+	char session_name[NAME_MAX];
+	enum lttng_domain_type domain;
+	char channel_name[LTTNG_SYMBOL_NAME_LEN];
+	uint64_t subbuf_size;
+	uint64_t num_subbuf;
+	struct cds_list_head list;
+};
+
+/*
+ * Protects both lists. Taken by the client threads and by the consumer
+ * management threads, which must never wait on a session lock.
+ */
+static pthread_mutex_t advice_lock = PTHREAD_MUTEX_INITIALIZER;
+static CDS_LIST_HEAD(advice_sessions);
+static CDS_LIST_HEAD(advices);
+
+static struct advice_session *find_session(uint64_t id)
+{
+	struct advice_session *asession;
+
+	cds_list_for_each_entry(asession, &advice_sessions, list) {
+		if (asession->id == id) {
+			return asession;
+		}
+	}
+
+	return NULL;
+}
+
+static struct advice *find_advice(const char *session_name,
+		enum lttng_domain_type domain, const char *channel_name)
+{
+	struct advice *advice;
+
+	cds_list_for_each_entry(advice, &advices, list) {
+		if (advice->domain == domain &&
+				!strcmp(advice->session_name, session_name) &&
+				!strcmp(advice->channel_name, channel_name)) {
+			return advice;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Grow a buffer discarding events by doubling either the size or the number
+ * of its sub-buffers. Sub-buffers which are mostly flushed by a timer before
+ * being full would not use more space, so more of them are recommended
+ * instead.
+ *
+ * Return 0 on success or -1 if the buffer would exceed
+ * DEFAULT_BUFFER_ADVICE_MAX_SIZE, in which case nothing is changed.
+ */
+int buffer_advice_recommend(uint64_t *subbuf_size, uint64_t *num_subbuf,
+		uint32_t fill_ratio)
+{
+	assert(subbuf_size);
+	assert(num_subbuf);
+
+	if (*subbuf_size * *num_subbuf > DEFAULT_BUFFER_ADVICE_MAX_SIZE / 2) {
+		return -1;
+	}
+
+	if (fill_ratio < 500) {
+		*num_subbuf <<= 1;
+	} else {
+		*subbuf_size <<= 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Start gathering the discard reports of a session.
+ *
+ * The session lock MUST be acquired.
+ */
+void buffer_advice_track_session(struct ltt_session *session)
+{
+	struct advice_session *asession;
+
+	assert(session);
+
+	asession = zmalloc(sizeof(*asession));
+	if (!asession) {
+		PERROR("zmalloc advice session");
+		return;
+	}
+	asession->id = session->id;
+	strncpy(asession->name, session->name, sizeof(asession->name));
+	asession->name[sizeof(asession->name) - 1] = '\0';
+	CDS_INIT_LIST_HEAD(&asession->channels);
+
+	pthread_mutex_lock(&advice_lock);
+	cds_list_add(&asession->list, &advice_sessions);
+	pthread_mutex_unlock(&advice_lock);
+}
+
+/*
+ * Get the buffer of a channel of the session and whether it is sized
+ * automatically.
+ *
+ * Return 0 on success or -1 if the channel is not found.
+ */
+static int get_channel_buffer(struct ltt_session *session,
+		struct advice_channel *achan, uint64_t *subbuf_size,
+		uint64_t *num_subbuf, int *auto_size)
+{
+	int ret = -1;
+
+	switch (achan->domain) {
+	case LTTNG_DOMAIN_KERNEL:
+	{
+		struct ltt_kernel_channel *kchan;
+
+		if (!session->kernel_session) {
+			break;
+		}
+		kchan = trace_kernel_get_channel_by_name(achan->name,
+				session->kernel_session);
+		if (!kchan) {
+			break;
+		}
+		*subbuf_size = kchan->channel->attr.subbuf_size;
+		*num_subbuf = kchan->channel->attr.num_subbuf;
+		*auto_size = kchan->channel->attr.auto_buffer_size;
+		ret = 0;
+		break;
+	}
+	case LTTNG_DOMAIN_UST:
+	{
+		struct ltt_ust_channel *uchan;
+
+		if (!session->ust_session) {
+			break;
+		}
+		rcu_read_lock();
+		uchan = trace_ust_find_channel_by_name(
+				session->ust_session->domain_global.channels,
+				achan->name);
+		if (uchan) {
+			*subbuf_size = uchan->attr.subbuf_size;
+			*num_subbuf = uchan->attr.num_subbuf;
+			*auto_size = uchan->auto_buffer_size;
+			ret = 0;
+		}
+		rcu_read_unlock();
+		break;
+	}
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+/*
+ * Recommend a buffer for each channel of a session being destroyed which
+ * discarded events and stop gathering its reports. The recommendation of a
+ * channel sized automatically replaces the one of its previous session.
+ *
+ * The session lock MUST be acquired, before its channels are destroyed.
+ */
+void buffer_advice_untrack_session(struct ltt_session *session)
+{
+	struct advice_session *asession;
+	struct advice_channel *achan, *tmp;
+
+	assert(session);
+
+	pthread_mutex_lock(&advice_lock);
+	asession = find_session(session->id);
+	if (!asession) {
+		goto end;
+	}
+	cds_list_del(&asession->list);
+
+	cds_list_for_each_entry_safe(achan, tmp, &asession->channels, list) {
+		int auto_size;
+		uint32_t fill_ratio = 0;
+		uint64_t subbuf_size, num_subbuf;
+		struct advice *advice;
+
+		if (achan->subbuf_count) {
+			fill_ratio = achan->fill_total / achan->subbuf_count;
+		}
+		if (get_channel_buffer(session, achan, &subbuf_size, &num_subbuf,
+					&auto_size) < 0 ||
+				buffer_advice_recommend(&subbuf_size, &num_subbuf,
+					fill_ratio) < 0) {
+			WARN("Channel %s of session %s discarded %" PRIu64
+					" events, no larger buffer to recommend",
+					achan->name, session->name,
+					achan->events_discarded);
+			goto next;
+		}
+
+		WARN("Channel %s of session %s discarded %" PRIu64 " events, "
+				"recommended buffer: %" PRIu64 " sub-buffers of %"
+				PRIu64 " bytes%s", achan->name, session->name,
+				achan->events_discarded, num_subbuf, subbuf_size,
+				auto_size ? ", applied to the next session" : "");
+		if (!auto_size) {
+			goto next;
+		}
+
+		advice = find_advice(session->name, achan->domain, achan->name);
+		if (!advice) {
+			advice = zmalloc(sizeof(*advice));
+			if (!advice) {
+				PERROR("zmalloc advice");
+				goto next;
+			}
+			strncpy(advice->session_name, session->name,
+					sizeof(advice->session_name));
+			advice->session_name[sizeof(advice->session_name) - 1] = '\0';
+			advice->domain = achan->domain;
+			strncpy(advice->channel_name, achan->name,
+					sizeof(advice->channel_name));
+			advice->channel_name[sizeof(advice->channel_name) - 1] = '\0';
+			cds_list_add(&advice->list, &advices);
+		}
+		advice->subbuf_size = subbuf_size;
+		advice->num_subbuf = num_subbuf;
+next:
+		cds_list_del(&achan->list);
+		free(achan);
+	}
+	free(asession);
+
+end:
+	pthread_mutex_unlock(&advice_lock);
+}
+
+/*
+ * Add up a discard report of a consumer daemon to the channel of its
+ * session and warn about it. Called by the consumer management threads.
+ */
+void buffer_advice_add_report(enum lttng_domain_type domain,
+		const struct lttcomm_consumer_discard_report *report)
+{
+	char name[LTTNG_SYMBOL_NAME_LEN];
+	struct advice_session *asession;
+	struct advice_channel *achan;
+
+	assert(report);
+
+	strncpy(name, report->channel_name, sizeof(name));
+	name[sizeof(name) - 1] = '\0';
+
+	pthread_mutex_lock(&advice_lock);
+	asession = find_session(report->session_id);
+	if (!asession) {
+		/* Reports of a destroyed session may come in late. */
+		DBG("Discard report of unknown session id %" PRIu64,
+				report->session_id);
+		goto end;
+	}
+
+	WARN("Channel %s of session %s discarded %" PRIu64 " events in %"
+			PRIu64 " ms over %" PRIu64 " sub-buffers %u%% full",
+			name, asession->name, report->events_discarded,
+			report->interval / 1000000, report->subbuf_count,
+			report->fill_ratio / 10);
+
+	cds_list_for_each_entry(achan, &asession->channels, list) {
+		if (achan->domain == domain && !strcmp(achan->name, name)) {
+			goto found;
+		}
+	}
+	achan = zmalloc(sizeof(*achan));
+	if (!achan) {
+		PERROR("zmalloc advice channel");
+		goto end;
+	}
+	achan->domain = domain;
+	strcpy(achan->name, name);
+	cds_list_add(&achan->list, &asession->channels);
+
+found:
+	achan->events_discarded += report->events_discarded;
+	achan->subbuf_count += report->subbuf_count;
+	achan->fill_total += (uint64_t) report->fill_ratio * report->subbuf_count;
+
+end:
+	pthread_mutex_unlock(&advice_lock);
+}
+
+/*
+ * Apply the buffer recommended in the previous session of the same name to a
+ * channel about to be created with the auto_buffer_size attribute, unless
+ * the requested buffer is already larger.
+ *
+ * The session lock MUST be acquired.
+ */
+void buffer_advice_apply(struct ltt_session *session,
+		enum lttng_domain_type domain, struct lttng_channel *attr)
+{
+	const char *name;
+	struct advice *advice;
+
+	assert(session);
+	assert(attr);
+
+	if (!attr->attr.auto_buffer_size) {
+		return;
+	}
+	name = attr->name[0] != '\0' ? attr->name : DEFAULT_CHANNEL_NAME;
+
+	pthread_mutex_lock(&advice_lock);
+	advice = find_advice(session->name, domain, name);
+	if (advice && advice->subbuf_size * advice->num_subbuf >
+			attr->attr.subbuf_size * attr->attr.num_subbuf) {
+		DBG("Channel %s of session %s sized from its discarded events: "
+				"%" PRIu64 " sub-buffers of %" PRIu64 " bytes",
+				name, session->name, advice->num_subbuf,
+				advice->subbuf_size);
+		attr->attr.subbuf_size = advice->subbuf_size;
+		attr->attr.num_subbuf = advice->num_subbuf;
+	}
+	pthread_mutex_unlock(&advice_lock);
+}
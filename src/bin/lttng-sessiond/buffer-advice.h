@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_BUFFER_ADVICE_H
+#define LTTNG_BUFFER_ADVICE_H
+
+#include <stdint.h>
+
+#include <lttng/lttng.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+
+#include "session.h"
+
+/*
+ * Buffer sizing from the events discarded by the tracers.
+ *
+ * The consumer daemons report the streams discarding events on their error
+ * socket. The reports of a session are added up per channel while the
+ * session exists, each one being logged as a warning. When the session is
+ * destroyed, a larger buffer is recommended for every channel which
+ * discarded events. The recommendation of a channel created with the
+ * auto_buffer_size attribute is kept and applied to the channel of the same
+ * name and domain in the next session of the same name.
+ */
+
+void buffer_advice_track_session(struct ltt_session *session);
+void buffer_advice_untrack_session(struct ltt_session *session);
+void buffer_advice_add_report(enum lttng_domain_type domain,
+		const struct lttcomm_consumer_discard_report *report);
+void buffer_advice_apply(struct ltt_session *session,
+		enum lttng_domain_type domain, struct lttng_channel *attr);
+int buffer_advice_recommend(uint64_t *subbuf_size, uint64_t *num_subbuf,
+		uint32_t fill_ratio);
+
+#endif /* LTTNG_BUFFER_ADVICE_H */
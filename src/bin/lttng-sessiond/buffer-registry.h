@@ -49,8 +49,11 @@ struct buffer_reg_channel {
 	pthread_mutex_t stream_list_lock;
 	/* Node for hash table usage. */
 	struct lttng_ht_node_u64 node;
-	/* Size of subbuffers in this channel. */
+	/* Size and number of subbuffers in this channel. */
 	size_t subbuf_size;
+	uint64_t num_subbuf;
+	/* Name of the tracing channel, used for reporting. */
+	char name[LTTNG_SYMBOL_NAME_LEN];
 	union {
 		/* Original object data that MUST be copied over. */
 		struct lttng_ust_object_data *ust;
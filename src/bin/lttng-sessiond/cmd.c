@@ -27,6 +27,7 @@
 #include <common/relayd/relayd.h>
 #include <common/utils.h>
 
+#include "buffer-advice.h"
 #include "channel.h"
 #include "consumer.h"
 #include "event.h"
@@ -536,7 +537,8 @@ error:
  * Else, it's stays untouched and a lttcomm error code is returned.
  */
 static int create_connect_relayd(struct lttng_uri *uri,
-		struct lttcomm_relayd_sock **relayd_sock)
+		struct lttcomm_relayd_sock **relayd_sock,
+		enum lttng_compression compression)
 {
 	int ret;
 	struct lttcomm_relayd_sock *rsock;
@@ -547,6 +549,8 @@ static int create_connect_relayd(struct lttng_uri *uri,
 		ret = LTTNG_ERR_FATAL;
 		goto error;
 	}
+	/* Requested to the relayd by the version check of the control socket. */
+	rsock->compression = compression;
 
 	/*
 	 * Connect to relayd so we can proceed with a session creation. This call
@@ -600,13 +604,14 @@ error:
 static int send_consumer_relayd_socket(int domain, unsigned int session_id,
 		struct lttng_uri *relayd_uri, struct consumer_output *consumer,
 		struct consumer_socket *consumer_sock,
-		char *session_name, char *hostname, int session_live_timer)
+		char *session_name, char *hostname, int session_live_timer,
+		enum lttng_compression compression)
 {
 	int ret;
 	struct lttcomm_relayd_sock *rsock = NULL;
 
 	/* Connect to relayd and make version check if uri is the control. */
-	ret = create_connect_relayd(relayd_uri, &rsock);
+	ret = create_connect_relayd(relayd_uri, &rsock, compression);
 	if (ret != LTTNG_OK) {
 		goto error;
 	}
@@ -670,7 +675,8 @@ error:
  */
 static int send_consumer_relayd_sockets(int domain, unsigned int session_id,
 		struct consumer_output *consumer, struct consumer_socket *sock,
-		char *session_name, char *hostname, int session_live_timer)
+		char *session_name, char *hostname, int session_live_timer,
+		enum lttng_compression compression)
 {
 	int ret = LTTNG_OK;
 
@@ -681,7 +687,7 @@ static int send_consumer_relayd_sockets(int domain, unsigned int session_id,
 	if (!sock->control_sock_sent) {
 		ret = send_consumer_relayd_socket(domain, session_id,
 				&consumer->dst.net.control, consumer, sock,
-				session_name, hostname, session_live_timer);
+				session_name, hostname, session_live_timer, compression);
 		if (ret != LTTNG_OK) {
 			goto error;
 		}
@@ -691,7 +697,7 @@ static int send_consumer_relayd_sockets(int domain, unsigned int session_id,
 	if (!sock->data_sock_sent) {
 		ret = send_consumer_relayd_socket(domain, session_id,
 				&consumer->dst.net.data, consumer, sock,
-				session_name, hostname, session_live_timer);
+				session_name, hostname, session_live_timer, compression);
 		if (ret != LTTNG_OK) {
 			goto error;
 		}
@@ -732,7 +738,7 @@ int cmd_setup_relayd(struct ltt_session *session)
 			ret = send_consumer_relayd_sockets(LTTNG_DOMAIN_UST, session->id,
 					usess->consumer, socket,
 					session->name, session->hostname,
-					session->live_timer);
+					session->live_timer, session->compression);
 			pthread_mutex_unlock(socket->lock);
 			if (ret != LTTNG_OK) {
 				goto error;
@@ -750,7 +756,7 @@ int cmd_setup_relayd(struct ltt_session *session)
 			ret = send_consumer_relayd_sockets(LTTNG_DOMAIN_KERNEL, session->id,
 					ksess->consumer, socket,
 					session->name, session->hostname,
-					session->live_timer);
+					session->live_timer, session->compression);
 			pthread_mutex_unlock(socket->lock);
 			if (ret != LTTNG_OK) {
 				goto error;
@@ -947,6 +953,7 @@ int cmd_enable_channel(struct ltt_session *session,
 				ret = LTTNG_ERR_TRACE_ALREADY_STARTED;
 				goto error;
 			}
+			buffer_advice_apply(session, LTTNG_DOMAIN_KERNEL, attr);
 			ret = channel_kernel_create(session->kernel_session, attr, wpipe);
 			if (attr->name[0] != '\0') {
 				session->kernel_session->has_non_default_channel = 1;
@@ -979,6 +986,7 @@ int cmd_enable_channel(struct ltt_session *session,
 				ret = LTTNG_ERR_TRACE_ALREADY_STARTED;
 				goto error;
 			}
+			buffer_advice_apply(session, LTTNG_DOMAIN_UST, attr);
 			ret = channel_ust_create(usess, attr, domain->buf_type);
 			if (attr->name[0] != '\0') {
 				usess->has_non_default_channel = 1;
@@ -2051,6 +2059,8 @@ int cmd_create_session_uri(char *name, struct lttng_uri *uris,
 
 	session->consumer->enabled = 1;
 
+	buffer_advice_track_session(session);
+
 	return LTTNG_OK;
 
 consumer_error:
@@ -2126,6 +2136,39 @@ error:
 	return ret;
 }
 
+/*
+ * Command LTTNG_SET_SESSION_COMPRESSION processed by the client thread.
+ */
+int cmd_set_session_compression(struct ltt_session *session,
+		enum lttng_compression compression)
+{
+	int ret;
+
+	assert(session);
+
+	switch (compression) {
+	case LTTNG_COMPRESSION_NONE:
+	case LTTNG_COMPRESSION_LZ4:
+		break;
+	default:
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+
+	/* The compression is negotiated when connecting to the relayd. */
+	if (session->net_handle) {
+		ret = LTTNG_ERR_COMPRESSION_LATE;
+		goto error;
+	}
+
+	session->compression = compression;
+	DBG("Session %s compression set to %d", session->name, compression);
+	ret = LTTNG_OK;
+
+error:
+	return ret;
+}
+
 /*
  * Command LTTNG_DESTROY_SESSION processed by the client thread.
  */
@@ -2141,6 +2184,9 @@ int cmd_destroy_session(struct ltt_session *session, int wpipe)
 	usess = session->ust_session;
 	ksess = session->kernel_session;
 
+	/* Recommend buffer sizes while the channels still exist. */
+	buffer_advice_untrack_session(session);
+
 	/* Clean kernel session teardown */
 	kernel_destroy_session(ksess);
 
@@ -2418,6 +2464,148 @@ error:
 	return -ret;
 }
 
+/*
+ * Fill the memory usage of the kernel session channels. One entry per channel
+ * plus one for the metadata.
+ */
+static ssize_t list_kernel_memory_usage(struct ltt_kernel_session *ksess,
+		struct lttng_memory_usage **usage)
+{
+	ssize_t i = 0;
+	struct ltt_kernel_channel *kchan;
+	struct lttng_memory_usage *entry;
+
+	*usage = zmalloc((ksess->channel_count + 1) * sizeof(**usage));
+	if (!*usage) {
+		return -LTTNG_ERR_FATAL;
+	}
+
+	cds_list_for_each_entry(kchan, &ksess->channel_list.head, list) {
+		entry = &(*usage)[i++];
+		strncpy(entry->channel_name, kchan->channel->name,
+				sizeof(entry->channel_name));
+		entry->channel_name[sizeof(entry->channel_name) - 1] = '\0';
+		entry->pid = -1;
+		entry->uid = -1;
+		entry->nr_streams = kchan->stream_count;
+		entry->buffer_size = (uint64_t) kchan->stream_count *
+			kchan->channel->attr.subbuf_size *
+			kchan->channel->attr.num_subbuf;
+	}
+
+	if (ksess->metadata) {
+		entry = &(*usage)[i++];
+		strncpy(entry->channel_name, DEFAULT_METADATA_NAME,
+				sizeof(entry->channel_name));
+		entry->pid = -1;
+		entry->uid = -1;
+		entry->nr_streams = ksess->metadata_stream_fd >= 0 ? 1 : 0;
+		entry->buffer_size = entry->nr_streams *
+			ksess->metadata->conf->attr.subbuf_size *
+			ksess->metadata->conf->attr.num_subbuf;
+	}
+
+	return i;
+}
+
+/*
+ * Command LTTNG_LIST_MEMORY_USAGE processed by the client thread.
+ */
+ssize_t cmd_list_memory_usage(int domain, struct ltt_session *session,
+		struct lttng_memory_usage **usage)
+{
+	int ret;
+	ssize_t nb_usage = 0;
+
+	*usage = NULL;
+
+	switch (domain) {
+	case LTTNG_DOMAIN_KERNEL:
+		if (session->kernel_session == NULL) {
+			ret = LTTNG_ERR_KERN_CHAN_NOT_FOUND;
+			goto error;
+		}
+		nb_usage = list_kernel_memory_usage(session->kernel_session, usage);
+		if (nb_usage < 0) {
+			ret = -nb_usage;
+			goto error;
+		}
+		break;
+	case LTTNG_DOMAIN_UST:
+		if (session->ust_session == NULL) {
+			ret = LTTNG_ERR_UST_CHAN_NOT_FOUND;
+			goto error;
+		}
+		nb_usage = ust_app_list_memory_usage(session->ust_session, usage);
+		if (nb_usage < 0) {
+			ret = LTTNG_ERR_NOMEM;
+			goto error;
+		}
+		break;
+	default:
+		ret = LTTNG_ERR_UND;
+		goto error;
+	}
+
+	DBG3("Number of memory usage entries %zd", nb_usage);
+	return nb_usage;
+
+error:
+	/* Return negative value to differentiate return code */
+	return -ret;
+}
+
+/*
+ * Command LTTNG_LIST_STREAM_STATS processed by the client thread.
+ */
+ssize_t cmd_list_stream_stats(int domain, struct ltt_session *session,
+		struct lttng_stream_stats **stats)
+{
+	int ret;
+	ssize_t nb_stats = 0;
+	uint64_t session_id;
+	struct consumer_output *consumer;
+
+	*stats = NULL;
+
+	switch (domain) {
+	case LTTNG_DOMAIN_KERNEL:
+		if (session->kernel_session == NULL) {
+			ret = LTTNG_ERR_KERN_CHAN_NOT_FOUND;
+			goto error;
+		}
+		session_id = session->kernel_session->id;
+		consumer = session->kernel_session->consumer;
+		break;
+	case LTTNG_DOMAIN_UST:
+		if (session->ust_session == NULL) {
+			ret = LTTNG_ERR_UST_CHAN_NOT_FOUND;
+			goto error;
+		}
+		session_id = session->ust_session->id;
+		consumer = session->ust_session->consumer;
+		break;
+	default:
+		ret = LTTNG_ERR_UND;
+		goto error;
+	}
+
+	if (consumer) {
+		nb_stats = consumer_get_stream_stats(session_id, consumer, stats);
+		if (nb_stats < 0) {
+			ret = LTTNG_ERR_UNK;
+			goto error;
+		}
+	}
+
+	DBG3("Number of stream stats entries %zd", nb_stats);
+	return nb_stats;
+
+error:
+	/* Return negative value to differentiate return code */
+	return -ret;
+}
+
 /*
  * Command LTTNG_LIST_EVENTS processed by the client thread.
  */
@@ -2781,7 +2969,7 @@ static int set_relayd_for_snapshot(struct consumer_output *consumer,
 		ret = send_consumer_relayd_sockets(0, session->id,
 				snap_output->consumer, socket,
 				session->name, session->hostname,
-				session->live_timer);
+				session->live_timer, session->compression);
 		if (ret != LTTNG_OK) {
 			rcu_read_unlock();
 			goto error;
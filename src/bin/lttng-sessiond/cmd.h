@@ -33,6 +33,8 @@ int cmd_create_session_uri(char *name, struct lttng_uri *uris,
 int cmd_create_session_snapshot(char *name, struct lttng_uri *uris,
 		size_t nb_uri, lttng_sock_cred *creds);
 int cmd_destroy_session(struct ltt_session *session, int wpipe);
+int cmd_set_session_compression(struct ltt_session *session,
+		enum lttng_compression compression);
 
 /* Channel commands */
 int cmd_disable_channel(struct ltt_session *session, int domain,
@@ -80,6 +82,10 @@ ssize_t cmd_list_events(int domain, struct ltt_session *session,
 		char *channel_name, struct lttng_event **events);
 ssize_t cmd_list_channels(int domain, struct ltt_session *session,
 		struct lttng_channel **channels);
+ssize_t cmd_list_memory_usage(int domain, struct ltt_session *session,
+		struct lttng_memory_usage **usage);
+ssize_t cmd_list_stream_stats(int domain, struct ltt_session *session,
+		struct lttng_stream_stats **stats);
 ssize_t cmd_list_domains(struct ltt_session *session,
 		struct lttng_domain **domains);
 void cmd_list_lttng_sessions(struct lttng_session *sessions, uid_t uid,
@@ -1124,6 +1124,90 @@ error_unlock:
 	return -1;
 }
 
+/*
+ * Ask every consumer of the given output for the stream stats of a session.
+ * The entries of all consumers are appended to stats, which the caller must
+ * free.
+ *
+ * Return the number of entries or a negative value on error.
+ */
+ssize_t consumer_get_stream_stats(uint64_t session_id,
+		struct consumer_output *consumer, struct lttng_stream_stats **stats)
+{
+	int ret;
+	size_t count = 0;
+	struct consumer_socket *socket;
+	struct lttng_ht_iter iter;
+	struct lttcomm_consumer_msg msg;
+
+	assert(consumer);
+	assert(stats);
+
+	DBG3("Consumer stream stats for id %" PRIu64, session_id);
+
+	*stats = NULL;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd_type = LTTNG_CONSUMER_STREAM_STATS;
+	msg.u.stream_stats.session_id = session_id;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(consumer->socks->ht, &iter.iter, socket,
+			node.node) {
+		struct lttcomm_consumer_stream_stats_reply reply;
+		struct lttng_stream_stats *new_stats;
+
+		pthread_mutex_lock(socket->lock);
+		ret = consumer_socket_send(socket, &msg, sizeof(msg));
+		if (ret < 0) {
+			pthread_mutex_unlock(socket->lock);
+			goto error_unlock;
+		}
+
+		/* The reply header is the status, followed by the entries. */
+		ret = consumer_socket_recv(socket, &reply, sizeof(reply));
+		if (ret < 0) {
+			pthread_mutex_unlock(socket->lock);
+			goto error_unlock;
+		}
+		if (reply.ret_code != LTTCOMM_CONSUMERD_SUCCESS) {
+			pthread_mutex_unlock(socket->lock);
+			ERR("Consumer stream stats failed with code %u", reply.ret_code);
+			goto error_unlock;
+		}
+		if (!reply.count) {
+			pthread_mutex_unlock(socket->lock);
+			continue;
+		}
+
+		new_stats = realloc(*stats,
+				(count + reply.count) * sizeof(**stats));
+		if (!new_stats) {
+			PERROR("realloc stream stats");
+			pthread_mutex_unlock(socket->lock);
+			goto error_unlock;
+		}
+		*stats = new_stats;
+
+		ret = consumer_socket_recv(socket, &(*stats)[count],
+				reply.count * sizeof(**stats));
+		pthread_mutex_unlock(socket->lock);
+		if (ret < 0) {
+			goto error_unlock;
+		}
+		count += reply.count;
+	}
+	rcu_read_unlock();
+
+	return count;
+
+error_unlock:
+	rcu_read_unlock();
+	free(*stats);
+	*stats = NULL;
+	return -1;
+}
+
 /*
  * Send a flush command to consumer using the given channel key.
  *
@@ -267,6 +267,8 @@ void consumer_init_channel_comm_msg(struct lttcomm_consumer_msg *msg,
 		unsigned int live_timer_interval);
 int consumer_is_data_pending(uint64_t session_id,
 		struct consumer_output *consumer);
+ssize_t consumer_get_stream_stats(uint64_t session_id,
+		struct consumer_output *consumer, struct lttng_stream_stats **stats);
 int consumer_close_metadata(struct consumer_socket *socket,
 		uint64_t metadata_key);
 int consumer_setup_metadata(struct consumer_socket *socket,
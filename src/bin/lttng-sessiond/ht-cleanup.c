@@ -26,12 +26,57 @@
 #include "health-sessiond.h"
 #include "testpoint.h"
 
+/*
+ * Maximum number of hash tables fetched from the cleanup pipe and destroyed
+ * per wake up. Tearing down a session with many applications pushes tens of
+ * thousands of tables at once; draining them in batches avoids a poll and a
+ * read per table.
+ */
+#define HT_CLEANUP_BATCH_SIZE	512
+
+/*
+ * Read at least one and at most HT_CLEANUP_BATCH_SIZE hash table pointers
+ * from the cleanup pipe into the given array.
+ *
+ * Return the number of pointers read or a negative value on error.
+ */
+static ssize_t read_ht_batch(int fd, struct lttng_ht **hts)
+{
+	ssize_t ret, size_ret, remain;
+
+	do {
+		ret = read(fd, hts, HT_CLEANUP_BATCH_SIZE * sizeof(*hts));
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0) {
+		goto error;
+	}
+
+	/*
+	 * Pointers are written atomically in the pipe so a partial pointer
+	 * should never be read. Be safe and complete it if it ever happens.
+	 */
+	remain = ret % sizeof(*hts);
+	if (remain) {
+		size_ret = lttng_read(fd, (char *) hts + ret, sizeof(*hts) - remain);
+		if (size_ret < sizeof(*hts) - remain) {
+			goto error;
+		}
+		ret += size_ret;
+	}
+
+	return ret / sizeof(*hts);
+
+error:
+	return -1;
+}
+
 void *thread_ht_cleanup(void *data)
 {
 	int ret, i, pollfd, err = -1;
-	ssize_t size_ret;
+	ssize_t nb_ht, j;
 	uint32_t revents, nb_fd;
 	struct lttng_poll_event events;
+	struct lttng_ht *hts[HT_CLEANUP_BATCH_SIZE];
 
 	DBG("[ht-thread] startup.");
 
@@ -81,8 +126,6 @@ restart:
 		nb_fd = ret;
 
 		for (i = 0; i < nb_fd; i++) {
-			struct lttng_ht *ht;
-
 			health_code_update();
 
 			/* Fetch once the poll data */
@@ -106,10 +149,9 @@ restart:
 				goto error;
 			}
 
-			/* Get socket from dispatch thread. */
-			size_ret = lttng_read(ht_cleanup_pipe[0], &ht,
-					sizeof(ht));
-			if (size_ret < sizeof(ht)) {
+			/* Get a batch of hash tables from the other threads. */
+			nb_ht = read_ht_batch(ht_cleanup_pipe[0], hts);
+			if (nb_ht < 0) {
 				PERROR("ht cleanup notify pipe");
 				goto error;
 			}
@@ -120,7 +162,9 @@ restart:
 			 * 1) a read-side RCU lock,
 			 * 2) a call_rcu thread.
 			 */
-			lttng_ht_destroy(ht);
+			for (j = 0; j < nb_ht; j++) {
+				lttng_ht_destroy(hts[j]);
+			}
 
 			health_code_update();
 		}
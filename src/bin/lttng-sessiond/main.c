@@ -45,6 +45,7 @@
 #include <common/kernel-consumer/kernel-consumer.h>
 #include <common/futex.h>
 #include <common/relayd/relayd.h>
+#include <common/sessiond-comm/list.h>
 #include <common/utils.h>
 #include <common/daemonize.h>
 #include <common/config/config.h>
@@ -69,6 +70,7 @@
 #include "ust-thread.h"
 #include "jul-thread.h"
 #include "save.h"
+#include "buffer-advice.h"
 
 #define CONSUMERD_FILE	"lttng-consumerd"
 
@@ -743,6 +745,53 @@ error:
 	return ret;
 }
 
+/*
+ * Setup the lttng message of a list command with either the events or the
+ * event fields given. The compact list format is used if the client
+ * understands it, else the plain array is copied in the payload.
+ *
+ * Return the payload size or a negative value on error.
+ */
+static int setup_list_msg(struct command_ctx *cmd_ctx,
+		const struct lttng_event *events,
+		const struct lttng_event_field *fields, size_t nb)
+{
+	int ret;
+	ssize_t len;
+	char *payload = NULL;
+
+	if (cmd_ctx->lsm->u.list.format < LTTCOMM_LIST_FORMAT_VERSION) {
+		len = nb * (fields ? sizeof(*fields) : sizeof(*events));
+		ret = setup_lttng_msg(cmd_ctx, len);
+		if (ret < 0) {
+			goto end;
+		}
+		memcpy(cmd_ctx->llm->payload, fields ? (void *) fields :
+				(void *) events, len);
+		goto end;
+	}
+
+	if (fields) {
+		len = lttcomm_list_encode_fields(fields, nb, &payload);
+	} else {
+		len = lttcomm_list_encode_events(events, nb, &payload);
+	}
+	if (len < 0) {
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	ret = setup_lttng_msg(cmd_ctx, len);
+	if (ret < 0) {
+		goto end;
+	}
+	memcpy(cmd_ctx->llm->payload, payload, len);
+
+end:
+	free(payload);
+	return ret;
+}
+
 /*
  * Update the kernel poll set of all channel fd available over all tracing
  * session. Add the wakeup pipe at the end of the set.
@@ -1047,6 +1096,28 @@ static void signal_consumer_condition(struct consumer_data *data, int state)
 	pthread_mutex_unlock(&data->cond_mutex);
 }
 
+/*
+ * Receive the discard report following its code on the error socket of a
+ * consumer daemon.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int recv_discard_report(struct consumer_data *consumer_data, int sock)
+{
+	int ret;
+	struct lttcomm_consumer_discard_report report;
+
+	ret = lttcomm_recv_unix_sock(sock, &report, sizeof(report));
+	if (ret <= 0) {
+		ERR("Receiving consumer discard report");
+		return -1;
+	}
+
+	buffer_advice_add_report(consumer_data->type == LTTNG_CONSUMER_KERNEL ?
+			LTTNG_DOMAIN_KERNEL : LTTNG_DOMAIN_UST, &report);
+	return 0;
+}
+
 /*
  * This thread manage the consumer error sent back to the session daemon.
  */
@@ -1254,6 +1325,15 @@ restart_poll:
 					goto error;
 				}
 
+				/* Discard reports are the only non fatal codes. */
+				if (code == LTTCOMM_CONSUMERD_DISCARD_REPORT) {
+					ret = recv_discard_report(consumer_data, sock);
+					if (ret < 0) {
+						goto error;
+					}
+					continue;
+				}
+
 				ERR("consumer return code : %s",
 						lttcomm_get_readable_code(-code));
 
@@ -2720,6 +2800,7 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	case LTTNG_SNAPSHOT_LIST_OUTPUT:
 	case LTTNG_SNAPSHOT_RECORD:
 	case LTTNG_SAVE_SESSION:
+	case LTTNG_SET_SESSION_COMPRESSION:
 		need_domain = 0;
 		break;
 	default:
@@ -2759,6 +2840,8 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	case LTTNG_LIST_DOMAINS:
 	case LTTNG_LIST_CHANNELS:
 	case LTTNG_LIST_EVENTS:
+	case LTTNG_LIST_MEMORY_USAGE:
+	case LTTNG_LIST_STREAM_STATS:
 		break;
 	default:
 		/* Setup lttng message with no payload */
@@ -3166,22 +3249,12 @@ skip_domain:
 			goto error;
 		}
 
-		/*
-		 * Setup lttng message with payload size set to the event list size in
-		 * bytes and then copy list into the llm payload.
-		 */
-		ret = setup_lttng_msg(cmd_ctx, sizeof(struct lttng_event) * nb_events);
+		ret = setup_list_msg(cmd_ctx, events, NULL, nb_events);
+		free(events);
 		if (ret < 0) {
-			free(events);
 			goto setup_error;
 		}
 
-		/* Copy event list into message payload */
-		memcpy(cmd_ctx->llm->payload, events,
-				sizeof(struct lttng_event) * nb_events);
-
-		free(events);
-
 		ret = LTTNG_OK;
 		break;
 	}
@@ -3198,23 +3271,12 @@ skip_domain:
 			goto error;
 		}
 
-		/*
-		 * Setup lttng message with payload size set to the event list size in
-		 * bytes and then copy list into the llm payload.
-		 */
-		ret = setup_lttng_msg(cmd_ctx,
-				sizeof(struct lttng_event_field) * nb_fields);
+		ret = setup_list_msg(cmd_ctx, NULL, fields, nb_fields);
+		free(fields);
 		if (ret < 0) {
-			free(fields);
 			goto setup_error;
 		}
 
-		/* Copy event list into message payload */
-		memcpy(cmd_ctx->llm->payload, fields,
-				sizeof(struct lttng_event_field) * nb_fields);
-
-		free(fields);
-
 		ret = LTTNG_OK;
 		break;
 	}
@@ -3390,6 +3452,68 @@ skip_domain:
 		ret = LTTNG_OK;
 		break;
 	}
+	case LTTNG_LIST_MEMORY_USAGE:
+	{
+		ssize_t nb_usage;
+		struct lttng_memory_usage *usage = NULL;
+
+		nb_usage = cmd_list_memory_usage(cmd_ctx->lsm->domain.type,
+				cmd_ctx->session, &usage);
+		if (nb_usage < 0) {
+			/* Return value is a negative lttng_error_code. */
+			ret = -nb_usage;
+			goto error;
+		}
+
+		ret = setup_lttng_msg(cmd_ctx,
+				nb_usage * sizeof(struct lttng_memory_usage));
+		if (ret < 0) {
+			free(usage);
+			goto setup_error;
+		}
+
+		/* Copy memory usage list into message payload */
+		if (nb_usage > 0) {
+			memcpy(cmd_ctx->llm->payload, usage,
+					nb_usage * sizeof(struct lttng_memory_usage));
+		}
+
+		free(usage);
+
+		ret = LTTNG_OK;
+		break;
+	}
+	case LTTNG_LIST_STREAM_STATS:
+	{
+		ssize_t nb_stats;
+		struct lttng_stream_stats *stats = NULL;
+
+		nb_stats = cmd_list_stream_stats(cmd_ctx->lsm->domain.type,
+				cmd_ctx->session, &stats);
+		if (nb_stats < 0) {
+			/* Return value is a negative lttng_error_code. */
+			ret = -nb_stats;
+			goto error;
+		}
+
+		ret = setup_lttng_msg(cmd_ctx,
+				nb_stats * sizeof(struct lttng_stream_stats));
+		if (ret < 0) {
+			free(stats);
+			goto setup_error;
+		}
+
+		/* Copy stream stats into message payload */
+		if (nb_stats > 0) {
+			memcpy(cmd_ctx->llm->payload, stats,
+					nb_stats * sizeof(struct lttng_stream_stats));
+		}
+
+		free(stats);
+
+		ret = LTTNG_OK;
+		break;
+	}
 	case LTTNG_LIST_EVENTS:
 	{
 		ssize_t nb_event;
@@ -3403,18 +3527,12 @@ skip_domain:
 			goto error;
 		}
 
-		ret = setup_lttng_msg(cmd_ctx, nb_event * sizeof(struct lttng_event));
+		ret = setup_list_msg(cmd_ctx, events, NULL, nb_event);
+		free(events);
 		if (ret < 0) {
-			free(events);
 			goto setup_error;
 		}
 
-		/* Copy event list into message payload */
-		memcpy(cmd_ctx->llm->payload, events,
-				nb_event * sizeof(struct lttng_event));
-
-		free(events);
-
 		ret = LTTNG_OK;
 		break;
 	}
@@ -3616,6 +3734,12 @@ skip_domain:
 			&cmd_ctx->creds);
 		break;
 	}
+	case LTTNG_SET_SESSION_COMPRESSION:
+	{
+		ret = cmd_set_session_compression(cmd_ctx->session,
+				cmd_ctx->lsm->u.compression.compression);
+		break;
+	}
 	default:
 		ret = LTTNG_ERR_UND;
 		break;
@@ -4754,7 +4878,7 @@ int main(int argc, char **argv)
 {
 	int ret = 0;
 	void *status;
-	const char *home_path, *env_app_timeout;
+	const char *home_path, *env_app_timeout, *env_metadata_push_delay;
 
 	init_kernel_workarounds();
 
@@ -5048,6 +5172,12 @@ int main(int argc, char **argv)
 		app_socket_timeout = DEFAULT_APP_SOCKET_RW_TIMEOUT;
 	}
 
+	/* Check for the metadata push coalescing delay env variable. */
+	env_metadata_push_delay = getenv(DEFAULT_METADATA_PUSH_DELAY_ENV);
+	if (env_metadata_push_delay) {
+		ust_registry_set_metadata_push_delay(atoi(env_metadata_push_delay));
+	}
+
 	write_pidfile();
 	write_julport();
 
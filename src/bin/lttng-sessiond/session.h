@@ -105,6 +105,11 @@ struct ltt_session {
 	 * Timer set when the session is created for live reading.
 	 */
 	int live_timer;
+	/*
+	 * Compression of the trace data sent to the relayd, negotiated when the
+	 * relayd sockets are created (enum lttng_compression).
+	 */
+	unsigned int compression;
 };
 
 /* Prototypes */
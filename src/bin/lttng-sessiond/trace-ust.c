@@ -328,6 +328,8 @@ struct ltt_ust_channel *trace_ust_create_channel(struct lttng_channel *chan)
 	luc->tracefile_size = chan->attr.tracefile_size;
 	luc->tracefile_count = chan->attr.tracefile_count;
 
+	luc->auto_buffer_size = chan->attr.auto_buffer_size;
+
 	DBG2("Trace UST channel %s created", luc->name);
 
 error:
@@ -66,6 +66,8 @@ struct ltt_ust_channel {
 	struct lttng_ht_node_str node;
 	uint64_t tracefile_size;
 	uint64_t tracefile_count;
+	/* Sized from the discards of the previous session, see buffer-advice.h. */
+	unsigned int auto_buffer_size;
 };
 
 /* UST domain global (LTTNG_DOMAIN_UST) */
@@ -380,11 +380,14 @@ void delete_ust_app_channel(int sock, struct ust_app_channel *ua_chan,
 	}
 
 	/* Wipe context */
-	cds_lfht_for_each_entry(ua_chan->ctx->ht, &iter.iter, ua_ctx, node.node) {
-		cds_list_del(&ua_ctx->list);
-		ret = lttng_ht_del(ua_chan->ctx, &iter);
-		assert(!ret);
-		delete_ust_app_ctx(sock, ua_ctx);
+	if (ua_chan->ctx) {
+		cds_lfht_for_each_entry(ua_chan->ctx->ht, &iter.iter, ua_ctx,
+				node.node) {
+			cds_list_del(&ua_ctx->list);
+			ret = lttng_ht_del(ua_chan->ctx, &iter);
+			assert(!ret);
+			delete_ust_app_ctx(sock, ua_ctx);
+		}
 	}
 
 	/* Wipe events */
@@ -454,7 +457,12 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 	pthread_mutex_lock(&registry->lock);
 
 	offset = registry->metadata_len_sent;
-	len = registry->metadata_len - registry->metadata_len_sent;
+	if (registry->metadata_shm) {
+		/* The consumer can only see the published metadata. */
+		len = registry->metadata_shm->published_len - offset;
+	} else {
+		len = registry->metadata_len - offset;
+	}
 	if (len == 0) {
 		DBG3("No metadata to push for metadata key %" PRIu64,
 				registry->metadata_key);
@@ -466,6 +474,11 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 		goto end;
 	}
 
+	if (registry->metadata_shm) {
+		registry->metadata_len_sent += len;
+		goto push_data;
+	}
+
 	/* Allocate only what we have to send. */
 	metadata_str = zmalloc(len);
 	if (!metadata_str) {
@@ -479,8 +492,17 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 
 push_data:
 	pthread_mutex_unlock(&registry->lock);
-	ret = consumer_push_metadata(socket, registry->metadata_key,
-			metadata_str, len, offset);
+	if (registry->metadata_shm) {
+		/*
+		 * The consumer pulls the metadata from the shared memory by itself,
+		 * only wait for it to be flushed up to the published length.
+		 */
+		ret = consumer_push_metadata(socket, registry->metadata_key,
+				NULL, 0, offset + len);
+	} else {
+		ret = consumer_push_metadata(socket, registry->metadata_key,
+				metadata_str, len, offset);
+	}
 	if (ret < 0) {
 		/*
 		 * There is an acceptable race here between the registry metadata key
@@ -824,7 +846,7 @@ struct ust_app_session *alloc_ust_app_session(struct ust_app *app)
 	}
 
 	ua_sess->handle = -1;
-	ua_sess->channels = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+	ua_sess->channels = lttng_ht_new_small(LTTNG_HT_TYPE_STRING);
 	ua_sess->metadata_attr.type = LTTNG_UST_CHAN_METADATA;
 	pthread_mutex_init(&ua_sess->lock, NULL);
 
@@ -834,6 +856,22 @@ error_free:
 	return NULL;
 }
 
+/*
+ * Return the context hash table of the given UST app channel, allocating it
+ * on first use since most channels never get any context added.
+ *
+ * Return NULL on allocation error.
+ */
+static struct lttng_ht *get_ust_app_channel_ctx_ht(
+		struct ust_app_channel *ua_chan)
+{
+	if (!ua_chan->ctx) {
+		ua_chan->ctx = lttng_ht_new_small(LTTNG_HT_TYPE_ULONG);
+	}
+
+	return ua_chan->ctx;
+}
+
 /*
  * Alloc new UST app channel.
  */
@@ -859,8 +897,8 @@ struct ust_app_channel *alloc_ust_app_channel(char *name,
 	ua_chan->handle = -1;
 	ua_chan->session = ua_sess;
 	ua_chan->key = get_next_channel_key();
-	ua_chan->ctx = lttng_ht_new(0, LTTNG_HT_TYPE_ULONG);
-	ua_chan->events = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+	/* The context table is allocated on first use. */
+	ua_chan->events = lttng_ht_new_small(LTTNG_HT_TYPE_STRING);
 	lttng_ht_node_init_str(&ua_chan->node, ua_chan->name);
 
 	CDS_INIT_LIST_HEAD(&ua_chan->streams.head);
@@ -1546,13 +1584,19 @@ static void shadow_copy_channel(struct ust_app_channel *ua_chan,
 	ua_chan->tracing_channel_id = uchan->id;
 
 	cds_list_for_each_entry(uctx, &uchan->ctx_list, list) {
+		struct lttng_ht *ctx_ht;
+
+		ctx_ht = get_ust_app_channel_ctx_ht(ua_chan);
+		if (ctx_ht == NULL) {
+			break;
+		}
 		ua_ctx = alloc_ust_app_ctx(&uctx->ctx);
 		if (ua_ctx == NULL) {
 			continue;
 		}
 		lttng_ht_node_init_ulong(&ua_ctx->node,
 				(unsigned long) ua_ctx->ctx.ctx);
-		lttng_ht_add_unique_ulong(ua_chan->ctx, &ua_ctx->node);
+		lttng_ht_add_unique_ulong(ctx_ht, &ua_ctx->node);
 		cds_list_add_tail(&ua_ctx->list, &ua_chan->ctx_list);
 	}
 
@@ -1937,10 +1981,17 @@ int create_ust_app_channel_context(struct ust_app_session *ua_sess,
 	struct lttng_ht_iter iter;
 	struct lttng_ht_node_ulong *node;
 	struct ust_app_ctx *ua_ctx;
+	struct lttng_ht *ctx_ht;
 
 	DBG2("UST app adding context to channel %s", ua_chan->name);
 
-	lttng_ht_lookup(ua_chan->ctx, (void *)((unsigned long)uctx->ctx), &iter);
+	ctx_ht = get_ust_app_channel_ctx_ht(ua_chan);
+	if (ctx_ht == NULL) {
+		ret = -ENOMEM;
+		goto error;
+	}
+
+	lttng_ht_lookup(ctx_ht, (void *)((unsigned long)uctx->ctx), &iter);
 	node = lttng_ht_iter_get_node_ulong(&iter);
 	if (node != NULL) {
 		ret = -EEXIST;
@@ -1955,7 +2006,7 @@ int create_ust_app_channel_context(struct ust_app_session *ua_sess,
 	}
 
 	lttng_ht_node_init_ulong(&ua_ctx->node, (unsigned long) ua_ctx->ctx.ctx);
-	lttng_ht_add_unique_ulong(ua_chan->ctx, &ua_ctx->node);
+	lttng_ht_add_unique_ulong(ctx_ht, &ua_ctx->node);
 	cds_list_add_tail(&ua_ctx->list, &ua_chan->ctx_list);
 
 	ret = create_ust_channel_context(ua_chan, ua_ctx, app);
@@ -2153,42 +2204,6 @@ error:
 	return ret;
 }
 
-/*
- * Duplicate the ust data object of the ust app stream and save it in the
- * buffer registry stream.
- *
- * Return 0 on success or else a negative value.
- */
-static int duplicate_stream_object(struct buffer_reg_stream *reg_stream,
-		struct ust_app_stream *stream)
-{
-	int ret;
-
-	assert(reg_stream);
-	assert(stream);
-
-	/* Reserve the amount of file descriptor we need. */
-	ret = lttng_fd_get(LTTNG_FD_APPS, 2);
-	if (ret < 0) {
-		ERR("Exhausted number of available FD upon duplicate stream");
-		goto error;
-	}
-
-	/* Duplicate object for stream once the original is in the registry. */
-	ret = ustctl_duplicate_ust_object_data(&stream->obj,
-			reg_stream->obj.ust);
-	if (ret < 0) {
-		ERR("Duplicate stream obj from %p to %p failed with ret %d",
-				reg_stream->obj.ust, stream->obj, ret);
-		lttng_fd_put(LTTNG_FD_APPS, 2);
-		goto error;
-	}
-	stream->handle = stream->obj->handle;
-
-error:
-	return ret;
-}
-
 /*
  * Duplicate the ust data object of the ust app. channel and save it in the
  * buffer registry channel.
@@ -2297,6 +2312,9 @@ static int create_buffer_reg_channel(struct buffer_reg_session *reg_sess,
 	assert(reg_chan);
 	reg_chan->consumer_key = ua_chan->key;
 	reg_chan->subbuf_size = ua_chan->attr.subbuf_size;
+	reg_chan->num_subbuf = ua_chan->attr.num_subbuf;
+	strncpy(reg_chan->name, ua_chan->name, sizeof(reg_chan->name));
+	reg_chan->name[sizeof(reg_chan->name) - 1] = '\0';
 
 	/* Create and add a channel registry to session. */
 	ret = ust_registry_channel_add(reg_sess->reg.ust,
@@ -2386,27 +2404,28 @@ static int send_channel_uid_to_ust(struct buffer_reg_channel *reg_chan,
 
 	health_code_update();
 
-	/* Send all streams to application. */
+	/*
+	 * Send all streams to application. Sending a stream object to the tracer
+	 * only passes its shm and wakeup fds over the socket and never modifies
+	 * the object, so the registry object is sent as is instead of being
+	 * duplicated (two dup() and two close() per stream) for every
+	 * application registering to this channel.
+	 */
 	pthread_mutex_lock(&reg_chan->stream_list_lock);
 	cds_list_for_each_entry(reg_stream, &reg_chan->streams, lnode) {
 		struct ust_app_stream stream;
 
-		ret = duplicate_stream_object(reg_stream, &stream);
-		if (ret < 0) {
-			goto error_stream_unlock;
-		}
+		memset(&stream, 0, sizeof(stream));
+		stream.obj = reg_stream->obj.ust;
+		stream.handle = stream.obj->handle;
+		strncpy(stream.name, ua_chan->name, sizeof(stream.name));
+		stream.name[sizeof(stream.name) - 1] = '\0';
 
 		ret = ust_consumer_send_stream_to_ust(app, ua_chan, &stream);
 		if (ret < 0) {
-			(void) release_ust_app_stream(-1, &stream);
 			goto error_stream_unlock;
 		}
-
-		/*
-		 * The return value is not important here. This function will output an
-		 * error if needed.
-		 */
-		(void) release_ust_app_stream(-1, &stream);
+		health_code_update();
 	}
 	ua_chan->is_sent = 1;
 
@@ -5135,3 +5154,176 @@ unsigned int ust_app_get_nb_stream(struct ltt_ust_session *usess)
 
 	return ret;
 }
+
+/*
+ * Append a zeroed entry to a memory usage array, growing it as needed.
+ *
+ * Return the new entry or NULL on allocation error.
+ */
+static struct lttng_memory_usage *add_memory_usage(
+		struct lttng_memory_usage **usage, size_t *count, size_t *alloc)
+{
+	struct lttng_memory_usage *entry;
+
+	if (*count == *alloc) {
+		size_t new_alloc = *alloc ? *alloc << 1 : 16;
+		struct lttng_memory_usage *new_usage;
+
+		new_usage = realloc(*usage, new_alloc * sizeof(*new_usage));
+		if (!new_usage) {
+			PERROR("realloc memory usage");
+			return NULL;
+		}
+		*usage = new_usage;
+		*alloc = new_alloc;
+	}
+
+	entry = &(*usage)[(*count)++];
+	memset(entry, 0, sizeof(*entry));
+	return entry;
+}
+
+/*
+ * Fill the metadata entry of a registry. The metadata channel has a single
+ * stream once it has been created on the consumer side.
+ */
+static void fill_metadata_usage(struct lttng_memory_usage *entry,
+		struct ust_registry_session *registry, uint64_t subbuf_size,
+		uint64_t num_subbuf)
+{
+	strncpy(entry->channel_name, DEFAULT_METADATA_NAME,
+			sizeof(entry->channel_name));
+	pthread_mutex_lock(&registry->lock);
+	entry->nr_streams = registry->metadata_key ? 1 : 0;
+	entry->metadata_cache_size = registry->metadata_alloc_len;
+	pthread_mutex_unlock(&registry->lock);
+	entry->buffer_size = entry->nr_streams * subbuf_size * num_subbuf;
+}
+
+/*
+ * Report the memory used by the buffers of a UST session: one entry per
+ * channel and per user (per-UID buffers) or application (per-PID buffers),
+ * including the metadata channel.
+ *
+ * Return the number of entries set in usage, which the caller must free, or
+ * a negative value on error.
+ */
+ssize_t ust_app_list_memory_usage(struct ltt_ust_session *usess,
+		struct lttng_memory_usage **usage)
+{
+	size_t count = 0, alloc = 0;
+	struct lttng_ht_iter iter;
+	struct lttng_memory_usage *entry;
+
+	assert(usess);
+	assert(usage);
+
+	*usage = NULL;
+	rcu_read_lock();
+
+	switch (usess->buffer_type) {
+	case LTTNG_BUFFER_PER_UID:
+	{
+		struct buffer_reg_uid *reg;
+
+		cds_list_for_each_entry(reg, &usess->buffer_reg_uid_list, lnode) {
+			struct buffer_reg_channel *reg_chan;
+
+			cds_lfht_for_each_entry(reg->registry->channels->ht, &iter.iter,
+					reg_chan, node.node) {
+				entry = add_memory_usage(usage, &count, &alloc);
+				if (!entry) {
+					goto error;
+				}
+				strncpy(entry->channel_name, reg_chan->name,
+						sizeof(entry->channel_name));
+				entry->pid = -1;
+				entry->uid = reg->uid;
+				entry->bits_per_long = reg->bits_per_long;
+				pthread_mutex_lock(&reg_chan->stream_list_lock);
+				entry->nr_streams = reg_chan->stream_count;
+				pthread_mutex_unlock(&reg_chan->stream_list_lock);
+				entry->buffer_size = entry->nr_streams *
+					reg_chan->subbuf_size * reg_chan->num_subbuf;
+			}
+
+			entry = add_memory_usage(usage, &count, &alloc);
+			if (!entry) {
+				goto error;
+			}
+			entry->pid = -1;
+			entry->uid = reg->uid;
+			entry->bits_per_long = reg->bits_per_long;
+			fill_metadata_usage(entry, reg->registry->reg.ust,
+					usess->metadata_attr.subbuf_size,
+					usess->metadata_attr.num_subbuf);
+		}
+		break;
+	}
+	case LTTNG_BUFFER_PER_PID:
+	{
+		struct ust_app *app;
+
+		cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+			struct ust_app_channel *ua_chan;
+			struct ust_app_session *ua_sess;
+			struct ust_registry_session *registry;
+			struct lttng_ht_iter chan_iter;
+
+			ua_sess = lookup_session_by_app(usess, app);
+			if (!ua_sess) {
+				/* Session not associated with this app. */
+				continue;
+			}
+
+			pthread_mutex_lock(&ua_sess->lock);
+			cds_lfht_for_each_entry(ua_sess->channels->ht, &chan_iter.iter,
+					ua_chan, node.node) {
+				entry = add_memory_usage(usage, &count, &alloc);
+				if (!entry) {
+					pthread_mutex_unlock(&ua_sess->lock);
+					goto error;
+				}
+				strncpy(entry->channel_name, ua_chan->name,
+						sizeof(entry->channel_name));
+				entry->channel_name[sizeof(entry->channel_name) - 1] = '\0';
+				entry->pid = app->pid;
+				entry->uid = app->uid;
+				entry->bits_per_long = app->bits_per_long;
+				entry->nr_streams = ua_chan->expected_stream_count;
+				entry->buffer_size = entry->nr_streams *
+					ua_chan->attr.subbuf_size * ua_chan->attr.num_subbuf;
+			}
+
+			registry = get_session_registry(ua_sess);
+			if (registry) {
+				entry = add_memory_usage(usage, &count, &alloc);
+				if (!entry) {
+					pthread_mutex_unlock(&ua_sess->lock);
+					goto error;
+				}
+				entry->pid = app->pid;
+				entry->uid = app->uid;
+				entry->bits_per_long = app->bits_per_long;
+				fill_metadata_usage(entry, registry,
+						ua_sess->metadata_attr.subbuf_size,
+						ua_sess->metadata_attr.num_subbuf);
+			}
+			pthread_mutex_unlock(&ua_sess->lock);
+		}
+		break;
+	}
+	default:
+		assert(0);
+		break;
+	}
+
+	rcu_read_unlock();
+	return count;
+
+error:
+	rcu_read_unlock();
+	free(*usage);
+	*usage = NULL;
+	return -ENOMEM;
+}
@@ -149,7 +149,7 @@ struct ust_app_channel {
 	/*
 	 * Contexts are kept in a hash table for fast lookup and in an ordered list
 	 * so we are able to enable them on the tracer side in the same order the
-	 * user added them.
+	 * user added them. The hash table is NULL until a context is added.
 	 */
 	struct lttng_ht *ctx;
 	struct cds_list_head ctx_list;
@@ -327,6 +327,8 @@ void ust_app_destroy(struct ust_app *app);
 int ust_app_snapshot_record(struct ltt_ust_session *usess,
 		struct snapshot_output *output, int wait, unsigned int nb_streams);
 unsigned int ust_app_get_nb_stream(struct ltt_ust_session *usess);
+ssize_t ust_app_list_memory_usage(struct ltt_ust_session *usess,
+		struct lttng_memory_usage **usage);
 struct ust_app *ust_app_find_by_sock(int sock);
 
 static inline
@@ -519,6 +521,13 @@ unsigned int ust_app_get_nb_stream(struct ltt_ust_session *usess)
 {
 	return 0;
 }
+static inline
+ssize_t ust_app_list_memory_usage(struct ltt_ust_session *usess,
+		struct lttng_memory_usage **usage)
+{
+	*usage = NULL;
+	return 0;
+}
 
 static inline
 int ust_app_supported(void)
@@ -172,6 +172,11 @@ static int ask_channel_creation(struct ust_app_session *ua_sess,
 			ua_sess->output_traces,
 			ua_sess->uid);
 
+	if (ua_chan->attr.type == LTTNG_UST_CHAN_METADATA &&
+			registry->metadata_shm) {
+		msg.u.ask_channel.metadata_shm = 1;
+	}
+
 	health_code_update();
 
 	ret = consumer_socket_send(socket, &msg, sizeof(msg));
@@ -179,6 +184,15 @@ static int ask_channel_creation(struct ust_app_session *ua_sess,
 		goto error;
 	}
 
+	if (msg.u.ask_channel.metadata_shm) {
+		/* The consumer reads the metadata directly from the registry. */
+		ret = lttcomm_send_fds_unix_sock(*socket->fd_ptr,
+				&registry->metadata_shm_fd, 1);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
 	ret = consumer_recv_status_channel(socket, &key,
 			&ua_chan->expected_stream_count);
 	if (ret < 0) {
@@ -487,6 +501,35 @@ int ust_consumer_metadata_request(struct consumer_socket *socket)
 	}
 	assert(ust_reg);
 
+	if (request.timer && !ust_reg->metadata_closed) {
+		int deferred;
+		size_t offset;
+
+		/*
+		 * Applications are still registering: reply that there is nothing
+		 * new so the whole burst is sent in one push on a later request.
+		 * Only periodic requests are deferred since the other ones wait on
+		 * the metadata being available.
+		 */
+		pthread_mutex_lock(&ust_reg->lock);
+		deferred = ust_registry_metadata_push_deferred(ust_reg);
+		offset = ust_reg->metadata_len_sent;
+		pthread_mutex_unlock(&ust_reg->lock);
+		if (deferred) {
+			DBG("Metadata push deferred for key %" PRIu64,
+					ust_reg->metadata_key);
+			ret = consumer_push_metadata(socket, ust_reg->metadata_key,
+					NULL, 0, offset);
+			if (ret < 0) {
+				ERR("Pushing metadata");
+				ret = -1;
+				goto end;
+			}
+			ret = 0;
+			goto end;
+		}
+	}
+
 	ret_push = ust_app_push_metadata(ust_reg, socket, 1);
 	if (ret_push < 0) {
 		ERR("Pushing metadata");
@@ -27,6 +27,7 @@
 #include <limits.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <urcu/uatomic.h>
 #include <common/common.h>
 
 #include "ust-registry.h"
@@ -85,6 +86,37 @@ int get_count_order(unsigned int count)
 	return order;
 }
 
+/*
+ * Grow the shared memory the metadata is generated in so it can hold
+ * alloc_len bytes of metadata.
+ */
+static
+int metadata_shm_grow(struct ust_registry_session *session, size_t alloc_len)
+{
+	struct lttng_metadata_shm *shm;
+
+	shm = lttng_metadata_shm_grow(session->metadata_shm_fd,
+			session->metadata_shm, session->metadata_alloc_len,
+			alloc_len);
+	if (!shm)
+		return -ENOMEM;
+	session->metadata_shm = shm;
+	session->metadata = shm->data;
+	return 0;
+}
+
+/*
+ * Make the metadata generated so far readable by the consumer. Called once
+ * a complete fragment of metadata is written.
+ */
+static
+void metadata_publish(struct ust_registry_session *session)
+{
+	if (!session->metadata_shm)
+		return;
+	lttng_metadata_shm_publish(session->metadata_shm, session->metadata_len);
+}
+
 /*
  * Returns offset where to write in metadata array, or negative error value on error.
  */
@@ -96,9 +128,9 @@ ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
 	size_t old_alloc_len = session->metadata_alloc_len;
 	ssize_t ret;
 
-	if (new_alloc_len > (UINT32_MAX >> 1))
+	if (new_alloc_len > LTTNG_METADATA_SHM_MAX_LEN)
 		return -EINVAL;
-	if ((old_alloc_len << 1) > (UINT32_MAX >> 1))
+	if ((old_alloc_len << 1) > LTTNG_METADATA_SHM_MAX_LEN)
 		return -EINVAL;
 
 	if (new_alloc_len > old_alloc_len) {
@@ -106,16 +138,29 @@ ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
 
 		new_alloc_len =
 			max_t(size_t, 1U << get_count_order(new_alloc_len), old_alloc_len << 1);
-		newptr = realloc(session->metadata, new_alloc_len);
-		if (!newptr)
-			return -ENOMEM;
-		session->metadata = newptr;
-		/* We zero directly the memory from start of allocation. */
-		memset(&session->metadata[old_alloc_len], 0, new_alloc_len - old_alloc_len);
+		if (session->metadata_shm) {
+			ret = metadata_shm_grow(session, new_alloc_len);
+			if (ret)
+				return ret;
+		} else {
+			newptr = realloc(session->metadata, new_alloc_len);
+			if (!newptr)
+				return -ENOMEM;
+			session->metadata = newptr;
+			/* We zero directly the memory from start of allocation. */
+			memset(&session->metadata[old_alloc_len], 0, new_alloc_len - old_alloc_len);
+		}
 		session->metadata_alloc_len = new_alloc_len;
 	}
 	ret = session->metadata_len;
 	session->metadata_len += len;
+
+	/* Track the registration burst for metadata push coalescing. */
+	session->metadata_pending_last_ts = trace_clock_read64();
+	if (ret == session->metadata_len_sent) {
+		session->metadata_pending_first_ts =
+			session->metadata_pending_last_ts;
+	}
 	return ret;
 }
 
@@ -294,13 +339,13 @@ int _lttng_context_metadata_statedump(struct ust_registry_session *session,
 
 static
 int _lttng_fields_metadata_statedump(struct ust_registry_session *session,
-		struct ust_registry_event *event)
+		struct ust_registry_event_desc *desc)
 {
 	int ret = 0;
 	int i;
 
-	for (i = 0; i < event->nr_fields; i++) {
-		const struct ustctl_field *field = &event->fields[i];
+	for (i = 0; i < desc->nr_fields; i++) {
+		const struct ustctl_field *field = &desc->fields[i];
 
 		ret = _lttng_field_statedump(session, field);
 		if (ret)
@@ -309,6 +354,30 @@ int _lttng_fields_metadata_statedump(struct ust_registry_session *session,
 	return ret;
 }
 
+/*
+ * Keep a copy of the metadata generated for an event description so that
+ * other sessions registering the same event can reuse it. This is best
+ * effort: on allocation failure, the text will simply be generated again.
+ */
+static
+void cache_event_metadata(struct ust_registry_event_desc *desc, int idx,
+		const char *text, size_t len)
+{
+	struct ust_registry_event_metadata *md;
+
+	md = zmalloc(sizeof(*md) + len);
+	if (!md) {
+		return;
+	}
+	md->len = len;
+	memcpy(md->text, text, len);
+
+	/* Another session may have generated it concurrently. */
+	if (uatomic_cmpxchg(&desc->metadata[idx], NULL, md) != NULL) {
+		free(md);
+	}
+}
+
 /*
  * Should be called with session registry mutex held.
  */
@@ -316,7 +385,11 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 		struct ust_registry_channel *chan,
 		struct ust_registry_event *event)
 {
-	int ret = 0;
+	int ret = 0, idx;
+	size_t start;
+	ssize_t offset;
+	struct ust_registry_event_desc *desc = event->desc;
+	struct ust_registry_event_metadata *md;
 
 	/* Don't dump metadata events */
 	if (chan->chan_id == -1U)
@@ -327,22 +400,39 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 		"	name = \"%s\";\n"
 		"	id = %u;\n"
 		"	stream_id = %u;\n",
-		event->name,
+		desc->name,
 		event->id,
 		chan->chan_id);
 	if (ret)
 		goto end;
 
+	/*
+	 * The rest of the event metadata only depends on its description and
+	 * the byte order of the session. Reuse it if it was already generated.
+	 */
+	idx = session->byte_order == BIG_ENDIAN;
+	md = rcu_dereference(desc->metadata[idx]);
+	if (md) {
+		offset = metadata_reserve(session, md->len);
+		if (offset < 0) {
+			ret = offset;
+			goto end;
+		}
+		memcpy(&session->metadata[offset], md->text, md->len);
+		goto dumped;
+	}
+	start = session->metadata_len;
+
 	ret = lttng_metadata_printf(session,
 		"	loglevel = %d;\n",
-		event->loglevel);
+		desc->loglevel);
 	if (ret)
 		goto end;
 
-	if (event->model_emf_uri) {
+	if (desc->model_emf_uri) {
 		ret = lttng_metadata_printf(session,
 			"	model.emf.uri = \"%s\";\n",
-			event->model_emf_uri);
+			desc->model_emf_uri);
 		if (ret)
 			goto end;
 	}
@@ -370,7 +460,7 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 	if (ret)
 		goto end;
 
-	ret = _lttng_fields_metadata_statedump(session, event);
+	ret = _lttng_fields_metadata_statedump(session, desc);
 	if (ret)
 		goto end;
 
@@ -379,9 +469,16 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 		"};\n\n");
 	if (ret)
 		goto end;
+
+	cache_event_metadata(desc, idx, &session->metadata[start],
+			session->metadata_len - start);
+
+dumped:
 	event->metadata_dumped = 1;
 
 end:
+	if (!ret)
+		metadata_publish(session);
 	return ret;
 }
 
@@ -436,6 +533,8 @@ int ust_metadata_channel_statedump(struct ust_registry_session *session,
 	chan->metadata_dumped = 1;
 
 end:
+	if (!ret)
+		metadata_publish(session);
 	return ret;
 }
 
@@ -710,5 +809,7 @@ int ust_metadata_session_statedump(struct ust_registry_session *session,
 		goto end;
 
 end:
+	if (!ret)
+		metadata_publish(session);
 	return ret;
 }
@@ -16,7 +16,12 @@
  */
 #define _GNU_SOURCE
 #include <assert.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <common/common.h>
 #include <common/hashtable/utils.h>
@@ -24,8 +29,21 @@
 
 #include "ust-registry.h"
 #include "ust-app.h"
+#include "ust-clock.h"
+#include "fd-limit.h"
 #include "utils.h"
 
+/* Metadata push coalescing delay in usec. 0 means disabled. */
+static unsigned int metadata_push_delay = DEFAULT_METADATA_PUSH_DELAY;
+
+/*
+ * Event descriptions shared by all registry sessions, indexed by content.
+ * Allocated on first use. Every access and refcount update is done with the
+ * lock held.
+ */
+static struct lttng_ht *event_desc_ht;
+static pthread_mutex_t event_desc_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Hash table match function for event in the registry.
  */
@@ -42,13 +60,14 @@ static int ht_match_event(struct cds_lfht_node *node, const void *_key)
 	key = _key;
 
 	/* It has to be a perfect match. */
-	if (strncmp(event->name, key->name, sizeof(event->name)) != 0) {
+	if (strncmp(event->desc->name, key->desc->name,
+				sizeof(event->desc->name)) != 0) {
 		goto no_match;
 	}
 
 	/* It has to be a perfect match. */
-	if (strncmp(event->signature, key->signature,
-				strlen(event->signature) != 0)) {
+	if (strncmp(event->desc->signature, key->desc->signature,
+				strlen(event->desc->signature) != 0)) {
 		goto no_match;
 	}
 
@@ -66,12 +85,188 @@ static unsigned long ht_hash_event(void *_key, unsigned long seed)
 
 	assert(key);
 
-	xored_key = (uint64_t) (hash_key_str(key->name, seed) ^
-			hash_key_str(key->signature, seed));
+	xored_key = (uint64_t) (hash_key_str(key->desc->name, seed) ^
+			hash_key_str(key->desc->signature, seed));
 
 	return hash_key_u64(&xored_key, seed);
 }
 
+/*
+ * Hash table match function for the shared event descriptions. The whole
+ * content has to be identical for two applications to share a description.
+ */
+static int ht_match_event_desc(struct cds_lfht_node *node, const void *_key)
+{
+	struct ust_registry_event_desc *desc;
+	const struct ust_registry_event_desc *key;
+
+	assert(node);
+	assert(_key);
+
+	desc = caa_container_of(node, struct ust_registry_event_desc, node.node);
+	key = _key;
+
+	if (strncmp(desc->name, key->name, sizeof(desc->name)) != 0) {
+		goto no_match;
+	}
+	if (strcmp(desc->signature, key->signature) != 0) {
+		goto no_match;
+	}
+	if (desc->loglevel != key->loglevel ||
+			desc->nr_fields != key->nr_fields) {
+		goto no_match;
+	}
+	if (memcmp(desc->fields, key->fields,
+				desc->nr_fields * sizeof(*desc->fields)) != 0) {
+		goto no_match;
+	}
+	if (!desc->model_emf_uri != !key->model_emf_uri) {
+		goto no_match;
+	}
+	if (desc->model_emf_uri &&
+			strcmp(desc->model_emf_uri, key->model_emf_uri) != 0) {
+		goto no_match;
+	}
+
+	/* Match */
+	return 1;
+
+no_match:
+	return 0;
+}
+
+static unsigned long ht_hash_event_desc(void *_key, unsigned long seed)
+{
+	size_t i;
+	uint64_t hashed_key;
+	struct ust_registry_event_desc *key = _key;
+
+	assert(key);
+
+	hashed_key = (uint64_t) (hash_key_str(key->name, seed) ^
+			hash_key_str(key->signature, seed));
+	hashed_key ^= ((uint64_t) key->loglevel << 32) | key->nr_fields;
+	for (i = 0; i < key->nr_fields; i++) {
+		hashed_key = hashed_key * 31 +
+			hash_key_str(key->fields[i].name, seed);
+	}
+
+	return hash_key_u64(&hashed_key, seed);
+}
+
+/*
+ * Free an event description and its content. This does NOT delete it from
+ * the shared table.
+ */
+static void destroy_event_desc(struct ust_registry_event_desc *desc)
+{
+	free(desc->fields);
+	free(desc->model_emf_uri);
+	free(desc->signature);
+	free(desc->metadata[0]);
+	free(desc->metadata[1]);
+	free(desc);
+}
+
+static void destroy_event_desc_rcu(struct rcu_head *head)
+{
+	struct lttng_ht_node_u64 *node =
+		caa_container_of(head, struct lttng_ht_node_u64, head);
+	struct ust_registry_event_desc *desc =
+		caa_container_of(node, struct ust_registry_event_desc, node);
+
+	destroy_event_desc(desc);
+}
+
+/*
+ * Return a reference on the shared description matching the given content,
+ * interning a new one if none exists.
+ *
+ * On success, the ownership of sig, fields and model_emf_uri is transferred
+ * to the description: they are either kept or freed if an identical one was
+ * already registered. On error, NULL is returned and the caller keeps them.
+ *
+ * RCU read side lock MUST be acquired before calling this function.
+ */
+static struct ust_registry_event_desc *get_event_desc(char *name, char *sig,
+		size_t nr_fields, struct ustctl_field *fields, int loglevel,
+		char *model_emf_uri)
+{
+	struct cds_lfht_node *nptr;
+	struct ust_registry_event_desc *desc, *shared;
+
+	desc = zmalloc(sizeof(*desc));
+	if (!desc) {
+		PERROR("zmalloc ust registry event description");
+		goto error;
+	}
+
+	/* Copy event name and force NULL byte. */
+	strncpy(desc->name, name, sizeof(desc->name));
+	desc->name[sizeof(desc->name) - 1] = '\0';
+	/* Allocated by ustctl. */
+	desc->signature = sig;
+	desc->nr_fields = nr_fields;
+	desc->fields = fields;
+	desc->loglevel = loglevel;
+	desc->model_emf_uri = model_emf_uri;
+	desc->refcount = 1;
+	cds_lfht_node_init(&desc->node.node);
+
+	pthread_mutex_lock(&event_desc_lock);
+	if (!event_desc_ht) {
+		event_desc_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+		if (!event_desc_ht) {
+			pthread_mutex_unlock(&event_desc_lock);
+			free(desc);
+			desc = NULL;
+			goto error;
+		}
+		event_desc_ht->match_fct = ht_match_event_desc;
+		event_desc_ht->hash_fct = ht_hash_event_desc;
+	}
+
+	nptr = cds_lfht_add_unique(event_desc_ht->ht,
+			event_desc_ht->hash_fct(desc, lttng_ht_seed),
+			event_desc_ht->match_fct, desc, &desc->node.node);
+	if (nptr != &desc->node.node) {
+		/* Identical event already registered by another application. */
+		shared = caa_container_of(nptr, struct ust_registry_event_desc,
+				node.node);
+		shared->refcount++;
+		destroy_event_desc(desc);
+		desc = shared;
+		DBG3("UST registry sharing event description %s (refcount: %u)",
+				desc->name, desc->refcount);
+	}
+	pthread_mutex_unlock(&event_desc_lock);
+
+error:
+	return desc;
+}
+
+/*
+ * Release a reference on a shared event description, freeing it after a
+ * grace period once unused.
+ */
+static void put_event_desc(struct ust_registry_event_desc *desc)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+
+	pthread_mutex_lock(&event_desc_lock);
+	assert(desc->refcount > 0);
+	if (--desc->refcount == 0) {
+		rcu_read_lock();
+		iter.iter.node = &desc->node.node;
+		ret = lttng_ht_del(event_desc_ht, &iter);
+		assert(!ret);
+		rcu_read_unlock();
+		call_rcu(&desc->node.head, destroy_event_desc_rcu);
+	}
+	pthread_mutex_unlock(&event_desc_lock);
+}
+
 /*
  * Return negative value on error, 0 if OK.
  *
@@ -129,6 +324,10 @@ int validate_event_fields(size_t nr_fields, struct ustctl_field *fields,
 /*
  * Allocate event and initialize it. This does NOT set a valid event id from a
  * registry.
+ *
+ * On success, the ownership of sig, fields and model_emf_uri is transferred
+ * to the event's shared description. On error, NULL is returned and the
+ * caller keeps them.
  */
 static struct ust_registry_event *alloc_event(int session_objd,
 		int channel_objd, char *name, char *sig, size_t nr_fields,
@@ -150,19 +349,15 @@ static struct ust_registry_event *alloc_event(int session_objd,
 		goto error;
 	}
 
+	event->desc = get_event_desc(name, sig, nr_fields, fields, loglevel,
+			model_emf_uri);
+	if (!event->desc) {
+		free(event);
+		event = NULL;
+		goto error;
+	}
 	event->session_objd = session_objd;
 	event->channel_objd = channel_objd;
-	/* Allocated by ustctl. */
-	event->signature = sig;
-	event->nr_fields = nr_fields;
-	event->fields = fields;
-	event->loglevel = loglevel;
-	event->model_emf_uri = model_emf_uri;
-	if (name) {
-		/* Copy event name and force NULL byte. */
-		strncpy(event->name, name, sizeof(event->name));
-		event->name[sizeof(event->name) - 1] = '\0';
-	}
 	cds_lfht_node_init(&event->node.node);
 
 error:
@@ -180,9 +375,7 @@ static void destroy_event(struct ust_registry_event *event)
 		return;
 	}
 
-	free(event->fields);
-	free(event->model_emf_uri);
-	free(event->signature);
+	put_event_desc(event->desc);
 	free(event);
 }
 
@@ -213,15 +406,17 @@ struct ust_registry_event *ust_registry_find_event(
 	struct lttng_ht_iter iter;
 	struct ust_registry_event *event = NULL;
 	struct ust_registry_event key;
+	struct ust_registry_event_desc key_desc;
 
 	assert(chan);
 	assert(name);
 	assert(sig);
 
 	/* Setup key for the match function. */
-	strncpy(key.name, name, sizeof(key.name));
-	key.name[sizeof(key.name) - 1] = '\0';
-	key.signature = sig;
+	strncpy(key_desc.name, name, sizeof(key_desc.name));
+	key_desc.name[sizeof(key_desc.name) - 1] = '\0';
+	key_desc.signature = sig;
+	key.desc = &key_desc;
 
 	cds_lfht_lookup(chan->ht->ht, chan->ht->hash_fct(&key, lttng_ht_seed),
 			chan->ht->match_fct, &key, &iter.iter);
@@ -293,8 +488,8 @@ int ust_registry_create_event(struct ust_registry_session *session,
 	}
 
 	DBG3("UST registry creating event with event: %s, sig: %s, id: %u, "
-			"chan_objd: %u, sess_objd: %u, chan_id: %u", event->name,
-			event->signature, event->id, event->channel_objd,
+			"chan_objd: %u, sess_objd: %u, chan_id: %u", event->desc->name,
+			event->desc->signature, event->id, event->channel_objd,
 			event->session_objd, chan->chan_id);
 
 	/*
@@ -318,7 +513,7 @@ int ust_registry_create_event(struct ust_registry_session *session,
 		} else {
 			ERR("UST registry create event add unique failed for event: %s, "
 					"sig: %s, id: %u, chan_objd: %u, sess_objd: %u",
-					event->name, event->signature, event->id,
+					event->desc->name, event->desc->signature, event->id,
 					event->channel_objd, event->session_objd);
 			ret = -EINVAL;
 			goto error_unlock;
@@ -435,7 +630,7 @@ int ust_registry_channel_add(struct ust_registry_session *session,
 		goto error_alloc;
 	}
 
-	chan->ht = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
+	chan->ht = lttng_ht_new_small(LTTNG_HT_TYPE_STRING);
 	if (!chan->ht) {
 		ret = -ENOMEM;
 		goto error;
@@ -528,6 +723,72 @@ end:
 	return;
 }
 
+/*
+ * Create the shared memory file the metadata of the given registry session is
+ * generated in. It is unlinked right away so it only lives as long as the file
+ * descriptors of the session daemon and of the consumer.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int create_metadata_shm(struct ust_registry_session *session)
+{
+	int ret, fd;
+	char name[NAME_MAX];
+	struct lttng_metadata_shm *shm;
+
+	ret = lttng_fd_get(LTTNG_FD_APPS, 1);
+	if (ret < 0) {
+		goto error;
+	}
+
+	ret = snprintf(name, sizeof(name), "/lttng-metadata-%d-%p", getpid(),
+			session);
+	if (ret < 0) {
+		PERROR("snprintf metadata shm name");
+		goto error_fd_put;
+	}
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		PERROR("shm_open metadata");
+		ret = -1;
+		goto error_fd_put;
+	}
+	ret = shm_unlink(name);
+	if (ret < 0) {
+		PERROR("shm_unlink metadata");
+		goto error_close;
+	}
+
+	ret = ftruncate(fd, LTTNG_METADATA_SHM_HEADER_LEN);
+	if (ret < 0) {
+		PERROR("ftruncate metadata shm");
+		goto error_close;
+	}
+	shm = mmap(NULL, LTTNG_METADATA_SHM_HEADER_LEN, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		PERROR("mmap metadata shm");
+		ret = -1;
+		goto error_close;
+	}
+
+	session->metadata_shm = shm;
+	session->metadata_shm_fd = fd;
+	session->metadata = shm->data;
+
+	return 0;
+
+error_close:
+	if (close(fd)) {
+		PERROR("close metadata shm");
+	}
+error_fd_put:
+	lttng_fd_put(LTTNG_FD_APPS, 1);
+error:
+	return ret;
+}
+
 /*
  * Initialize registry with default values and set the newly allocated session
  * pointer to sessionp.
@@ -566,8 +827,17 @@ int ust_registry_session_init(struct ust_registry_session **sessionp,
 	session->uint64_t_alignment = uint64_t_alignment;
 	session->long_alignment = long_alignment;
 	session->byte_order = byte_order;
+	session->metadata_shm_fd = -1;
+
+	/*
+	 * Without the shared memory, the metadata is simply pushed through the
+	 * consumer socket.
+	 */
+	if (create_metadata_shm(session) < 0) {
+		DBG("Metadata of registry session falls back to a heap buffer");
+	}
 
-	session->channels = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	session->channels = lttng_ht_new_small(LTTNG_HT_TYPE_U64);
 	if (!session->channels) {
 		goto error;
 	}
@@ -627,5 +897,57 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 		ht_cleanup_push(reg->channels);
 	}
 
-	free(reg->metadata);
+	if (reg->metadata_shm) {
+		ret = munmap(reg->metadata_shm,
+				LTTNG_METADATA_SHM_HEADER_LEN + reg->metadata_alloc_len);
+		if (ret) {
+			PERROR("munmap metadata shm");
+		}
+		ret = close(reg->metadata_shm_fd);
+		if (ret) {
+			PERROR("close metadata shm");
+		}
+		lttng_fd_put(LTTNG_FD_APPS, 1);
+	} else {
+		free(reg->metadata);
+	}
+}
+
+/*
+ * Set the delay during which periodic metadata requests are deferred after
+ * metadata is appended to a registry. A value of 0 disables the deferral.
+ */
+void ust_registry_set_metadata_push_delay(unsigned int delay_us)
+{
+	metadata_push_delay = delay_us;
+}
+
+/*
+ * Return 1 if pushing the pending metadata of the given registry should be
+ * deferred because applications are still registering events or channels,
+ * else 0. Pending metadata is never deferred for more than
+ * DEFAULT_METADATA_PUSH_MAX_DELAY.
+ *
+ * The registry lock MUST be acquired.
+ */
+int ust_registry_metadata_push_deferred(struct ust_registry_session *session)
+{
+	uint64_t now;
+
+	assert(session);
+
+	if (!metadata_push_delay ||
+			session->metadata_len == session->metadata_len_sent) {
+		return 0;
+	}
+
+	now = trace_clock_read64();
+	if (now - session->metadata_pending_last_ts >=
+				metadata_push_delay * 1000ULL ||
+			now - session->metadata_pending_first_ts >=
+				DEFAULT_METADATA_PUSH_MAX_DELAY * 1000ULL) {
+		return 0;
+	}
+
+	return 1;
 }
@@ -23,6 +23,7 @@
 
 #include <common/hashtable/hashtable.h>
 #include <common/compat/uuid.h>
+#include <common/metadata-shm.h>
 
 #include "ust-ctl.h"
 
@@ -62,6 +63,14 @@ struct ust_registry_session {
 	size_t metadata_len, metadata_alloc_len;
 	/* Length of bytes sent to the consumer. */
 	size_t metadata_len_sent;
+	/*
+	 * Shared memory the metadata is generated in, the consumer reads it
+	 * from there. NULL if it could not be created, in which case the
+	 * metadata buffer is on the heap and is pushed through the consumer
+	 * socket.
+	 */
+	struct lttng_metadata_shm *metadata_shm;
+	int metadata_shm_fd;
 	/*
 	 * Hash table containing channels sent by the UST tracer. MUST be accessed
 	 * with a RCU read side lock acquired.
@@ -75,6 +84,13 @@ struct ust_registry_session {
 	 * deletes its sessions.
 	 */
 	unsigned int metadata_closed;
+	/*
+	 * Monotonic timestamps (nsec) of the first metadata appended since the
+	 * last push to the consumer and of the most recent one. Protected by the
+	 * registry lock.
+	 */
+	uint64_t metadata_pending_first_ts;
+	uint64_t metadata_pending_last_ts;
 };
 
 struct ust_registry_channel {
@@ -112,14 +128,21 @@ struct ust_registry_channel {
 };
 
 /*
- * Event registered from a UST tracer sent to the session daemon. This is
- * indexed and matched by <event_name/signature>.
+ * TSDL text generated for an event description, excluding its name and ids
+ * which are specific to the channel it is registered in.
  */
-struct ust_registry_event {
-	int id;
-	/* Both objd are set by the tracer. */
-	int session_objd;
-	int channel_objd;
+struct ust_registry_event_metadata {
+	size_t len;
+	char text[];
+};
+
+/*
+ * Description of an event as sent by the UST tracer. Identical descriptions
+ * registered in different sessions (e.g. one per application with per-PID
+ * buffers) are interned in a global table and shared by the events using
+ * them, along with their generated metadata.
+ */
+struct ust_registry_event_desc {
 	/* Name of the event returned by the tracer. */
 	char name[LTTNG_UST_SYM_NAME_LEN];
 	char *signature;
@@ -127,6 +150,27 @@ struct ust_registry_event {
 	size_t nr_fields;
 	struct ustctl_field *fields;
 	char *model_emf_uri;
+	/* Number of events using it. Protected by the global table lock. */
+	unsigned int refcount;
+	/*
+	 * Metadata of the event for little (index 0) and big (index 1) endian
+	 * sessions. Set once, the first time it is generated, then read-only.
+	 */
+	struct ust_registry_event_metadata *metadata[2];
+	struct lttng_ht_node_u64 node;
+};
+
+/*
+ * Event registered from a UST tracer sent to the session daemon. This is
+ * indexed and matched by <event_name/signature>.
+ */
+struct ust_registry_event {
+	int id;
+	/* Both objd are set by the tracer. */
+	int session_objd;
+	int channel_objd;
+	/* Shared description of the event. */
+	struct ust_registry_event_desc *desc;
 	/*
 	 * Flag for this channel if the metadata was dumped once during
 	 * registration. 0 means no, 1 yes.
@@ -221,6 +265,8 @@ int ust_registry_session_init(struct ust_registry_session **sessionp,
 		uint32_t major,
 		uint32_t minor);
 void ust_registry_session_destroy(struct ust_registry_session *session);
+void ust_registry_set_metadata_push_delay(unsigned int delay_us);
+int ust_registry_metadata_push_deferred(struct ust_registry_session *session);
 
 int ust_registry_create_event(struct ust_registry_session *session,
 		uint64_t chan_key, int session_objd, int channel_objd, char *name,
@@ -280,6 +326,14 @@ static inline
 void ust_registry_session_destroy(struct ust_registry_session *session)
 {}
 static inline
+void ust_registry_set_metadata_push_delay(unsigned int delay_us)
+{}
+static inline
+int ust_registry_metadata_push_deferred(struct ust_registry_session *session)
+{
+	return 0;
+}
+static inline
 int ust_registry_create_event(struct ust_registry_session *session,
 		uint64_t chan_key, int session_objd, int channel_objd, char *name,
 		char *sig, size_t nr_fields, struct ustctl_field *fields, int loglevel,
@@ -58,5 +58,8 @@ extern int cmd_disable_consumer(int argc, const char **argv);
 extern int cmd_snapshot(int argc, const char **argv);
 extern int cmd_save(int argc, const char **argv);
 extern int cmd_load(int argc, const char **argv);
+extern int cmd_expand(int argc, const char **argv);
+extern int cmd_stats(int argc, const char **argv);
+extern int cmd_eval_filter(int argc, const char **argv);
 
 #endif /* _LTTNG_CMD_H */
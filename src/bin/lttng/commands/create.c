@@ -46,6 +46,7 @@ static int opt_no_output;
 static int opt_snapshot;
 static unsigned int opt_live_timer;
 static int opt_disable_consumer;
+static char *opt_compression;
 
 enum {
 	OPT_HELP = 1,
@@ -66,6 +67,7 @@ static struct poptOption long_options[] = {
 	{"disable-consumer", 0, POPT_ARG_VAL, &opt_disable_consumer, 1, 0, 0},
 	{"snapshot",        0, POPT_ARG_VAL, &opt_snapshot, 1, 0, 0},
 	{"live",            0, POPT_ARG_INT | POPT_ARGFLAG_OPTIONAL, 0, OPT_LIVE_TIMER, 0, 0},
+	{"compression",     0, POPT_ARG_STRING, &opt_compression, 0, 0, 0},
 	{0, 0, 0, 0, 0, 0, 0}
 };
 
@@ -103,6 +105,10 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "                       By default, %u is used for the timer and the\n",
 											DEFAULT_LTTNG_LIVE_TIMER);
 	fprintf(ofp, "                       network URL is set to net://127.0.0.1.\n");
+	fprintf(ofp, "      --compression NAME\n");
+	fprintf(ofp, "                       Compress the trace data streamed to the relayd.\n");
+	fprintf(ofp, "                       Supported: lz4. Ignored by a relayd without\n");
+	fprintf(ofp, "                       compression support.\n");
 	fprintf(ofp, "\n");
 	fprintf(ofp, "Extended Options:\n");
 	fprintf(ofp, "\n");
@@ -242,6 +248,7 @@ static int create_session(void)
 	char *session_name = NULL, *traces_path = NULL, *alloc_path = NULL;
 	char *alloc_url = NULL, *url = NULL, datetime[16];
 	char session_name_date[NAME_MAX + 17], *print_str_url = NULL;
+	enum lttng_compression compression = LTTNG_COMPRESSION_NONE;
 	time_t rawtime;
 	struct tm *timeinfo;
 
@@ -364,6 +371,16 @@ static int create_session(void)
 		goto error;
 	}
 
+	if (opt_compression) {
+		if (!strcmp(opt_compression, "lz4")) {
+			compression = LTTNG_COMPRESSION_LZ4;
+		} else if (strcmp(opt_compression, "none")) {
+			ERR("Unknown compression %s", opt_compression);
+			ret = CMD_ERROR;
+			goto error;
+		}
+	}
+
 	if (opt_snapshot) {
 		/* No output by default. */
 		const char *snapshot_url = NULL;
@@ -417,6 +434,14 @@ static int create_session(void)
 		}
 	}
 
+	if (compression != LTTNG_COMPRESSION_NONE) {
+		ret = lttng_set_session_compression(session_name, compression);
+		if (ret < 0) {
+			lttng_destroy_session(session_name);
+			goto error;
+		}
+	}
+
 	MSG("Session %s created.", session_name);
 	if (print_str_url && !opt_snapshot) {
 		MSG("Traces will be written in %s", print_str_url);
@@ -424,6 +449,9 @@ static int create_session(void)
 		if (opt_live_timer) {
 			MSG("Live timer set to %u usec", opt_live_timer);
 		}
+		if (compression != LTTNG_COMPRESSION_NONE) {
+			MSG("Streamed trace data compressed with %s", opt_compression);
+		}
 	} else if (opt_snapshot) {
 		if (print_str_url) {
 			MSG("Default snapshot output set to: %s", print_str_url);
@@ -42,6 +42,7 @@ static char *opt_output;
 static int opt_buffer_uid;
 static int opt_buffer_pid;
 static int opt_buffer_global;
+static int opt_auto_buffer_size;
 
 enum {
 	OPT_HELP = 1,
@@ -81,6 +82,7 @@ static struct poptOption long_options[] = {
 	{"buffers-global", 0,	POPT_ARG_VAL, &opt_buffer_global, 1, 0, 0},
 	{"tracefile-size", 'C',   POPT_ARG_INT, 0, OPT_TRACEFILE_SIZE, 0, 0},
 	{"tracefile-count", 'W',   POPT_ARG_INT, 0, OPT_TRACEFILE_COUNT, 0, 0},
+	{"auto-buffer-size", 0,	POPT_ARG_VAL, &opt_auto_buffer_size, 1, 0, 0},
 	{0, 0, 0, 0, 0, 0, 0}
 };
 
@@ -140,6 +142,8 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "                           Used in conjunction with -C option, this will limit the number\n");
 	fprintf(ofp, "                           of files created to the specified count. 0 means unlimited.\n");
 	fprintf(ofp, "                               (default: %u)\n", DEFAULT_CHANNEL_TRACEFILE_COUNT);
+	fprintf(ofp, "      --auto-buffer-size   Grow the buffers to the size recommended from the events\n");
+	fprintf(ofp, "                           discarded by the previous session of the same name\n");
 	fprintf(ofp, "\n");
 }
 
@@ -178,6 +182,7 @@ static void set_default_attr(struct lttng_domain *dom)
 	if (chan.attr.tracefile_size == -1) {
 		chan.attr.tracefile_size = default_attr.tracefile_size;
 	}
+	chan.attr.auto_buffer_size = opt_auto_buffer_size;
 }
 
 /*
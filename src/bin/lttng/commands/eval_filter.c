@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <popt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/utils.h>
+#include <lib/lttng-ctl/filter/filter-interpreter.h>
+
+#include "../command.h"
+
+#define CTX_PREFIX		"$ctx."
+
+static int opt_kernel;
+static int opt_no_optimize;
+static char *opt_file;
+static char *opt_loops;
+
+enum {
+	OPT_HELP = 1,
+	OPT_LIST_OPTIONS,
+};
+
+static struct poptOption long_options[] = {
+	/* longName, shortName, argInfo, argPtr, value, descrip, argDesc */
+	{"help",        'h', POPT_ARG_NONE, 0, OPT_HELP, 0, 0},
+	{"kernel",      'k', POPT_ARG_VAL, &opt_kernel, 1, 0, 0},
+	{"no-optimize", 'n', POPT_ARG_VAL, &opt_no_optimize, 1, 0, 0},
+	{"file",        'f', POPT_ARG_STRING, &opt_file, 0, 0, 0},
+	{"loops",       'l', POPT_ARG_STRING, &opt_loops, 0, 0, 0},
+	{"list-options", 0,  POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
+	{0, 0, 0, 0, 0, 0, 0}
+};
+
+/*
+ * usage
+ */
+static void usage(FILE *ofp)
+{
+	fprintf(ofp, "usage: lttng eval-filter EXPRESSION [NAME=VALUE ...] [OPTIONS]\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "Evaluate a filter expression, as given to enable-event --filter,\n");
+	fprintf(ofp, "against the event payload made of the NAME=VALUE fields, or against\n");
+	fprintf(ofp, "each payload of a file. A context is named $ctx.NAME. A VALUE is an\n");
+	fprintf(ofp, "integer, else a floating point number, else a string. A VALUE within\n");
+	fprintf(ofp, "double quotes is always a string.\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "Options:\n");
+	fprintf(ofp, "  -h, --help               Show this help\n");
+	fprintf(ofp, "      --list-options       Simple listing of options\n");
+	fprintf(ofp, "  -k, --kernel             Compile the filter for the kernel domain,\n");
+	fprintf(ofp, "                           where fields are never floating point\n");
+	fprintf(ofp, "  -n, --no-optimize        Do not optimize the filter\n");
+	fprintf(ofp, "  -f, --file FILE          Read one payload per line of FILE, as\n");
+	fprintf(ofp, "                           NAME=VALUE fields separated by blanks.\n");
+	fprintf(ofp, "                           Use - for the standard input.\n");
+	fprintf(ofp, "  -l, --loops N            Evaluate each payload N times and show\n");
+	fprintf(ofp, "                           the time per event\n");
+	fprintf(ofp, "\n");
+}
+
+/*
+ * Parse a NAME=VALUE token, which is modified in place and must outlive the
+ * field.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int parse_field(char *token, struct filter_payload_field *field)
+{
+	char *value, *end;
+	size_t len;
+
+	value = strchr(token, '=');
+	if (!value || value == token) {
+		ERR("Invalid field \"%s\", expecting NAME=VALUE", token);
+		return -1;
+	}
+	*value++ = '\0';
+
+	field->context = !strncmp(token, CTX_PREFIX, strlen(CTX_PREFIX));
+	field->name = field->context ? token + strlen(CTX_PREFIX) : token;
+
+	len = strlen(value);
+	if (len >= 2 && value[0] == '"' && value[len - 1] == '"') {
+		value[len - 1] = '\0';
+		field->value.type = FILTER_VALUE_STRING;
+		field->value.u.str = value + 1;
+		return 0;
+	}
+
+	errno = 0;
+	field->value.type = FILTER_VALUE_S64;
+	field->value.u.s64 = strtoll(value, &end, 0);
+	if (len && !*end && !errno) {
+		return 0;
+	}
+	errno = 0;
+	field->value.type = FILTER_VALUE_DOUBLE;
+	field->value.u.d = strtod(value, &end);
+	if (len && !*end && !errno) {
+		return 0;
+	}
+	field->value.type = FILTER_VALUE_STRING;
+	field->value.u.str = value;
+	return 0;
+}
+
+static int add_field(struct filter_payload *payload, char *token)
+{
+	struct filter_payload_field *fields;
+
+	fields = realloc(payload->fields,
+			(payload->nr_fields + 1) * sizeof(*fields));
+	if (!fields) {
+		PERROR("realloc payload fields");
+		return -1;
+	}
+	payload->fields = fields;
+	if (parse_field(token, &fields[payload->nr_fields])) {
+		return -1;
+	}
+	payload->nr_fields++;
+	return 0;
+}
+
+/*
+ * Split a payload line in blank separated fields, where blanks within double
+ * quotes are part of the field.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int parse_line(char *line, struct filter_payload *payload)
+{
+	char *p = line, *token;
+	int quoted;
+
+	for (;;) {
+		while (isspace((unsigned char) *p)) {
+			p++;
+		}
+		if (!*p) {
+			return 0;
+		}
+		token = p;
+		for (quoted = 0; *p && (quoted || !isspace((unsigned char) *p)); p++) {
+			if (*p == '"') {
+				quoted = !quoted;
+			}
+		}
+		if (*p) {
+			*p++ = '\0';
+		}
+		if (add_field(payload, token)) {
+			return -1;
+		}
+	}
+}
+
+/*
+ * Evaluate the filter against a payload, loops times, and show the result.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int eval_payload(const struct lttng_filter_bytecode *bytecode,
+		const struct filter_payload *payload, const char *desc,
+		unsigned long loops)
+{
+	int ret;
+	unsigned long i;
+	uint64_t start, elapsed;
+	struct filter_program program;
+
+	ret = filter_program_link(&program, bytecode, payload);
+	if (ret < 0) {
+		ERR("%s: unable to link the filter against the payload", desc);
+		return ret;
+	}
+
+	start = utils_get_monotonic_ns();
+	for (i = 0; i < loops; i++) {
+		ret = filter_program_run(&program, payload);
+	}
+	elapsed = utils_get_monotonic_ns() - start;
+	filter_program_fini(&program);
+
+	if (ret < 0) {
+		ERR("%s: evaluation error, the event would be discarded", desc);
+		return ret;
+	}
+	if (opt_loops) {
+		MSG("%s: %s (%.1f ns/event)", desc, ret ? "match" : "no match",
+				(double) elapsed / loops);
+	} else {
+		MSG("%s: %s", desc, ret ? "match" : "no match");
+	}
+	return 0;
+}
+
+/*
+ * Evaluate the filter against each payload of a file.
+ *
+ * Return the number of payloads which could not be evaluated, or a negative
+ * value on error.
+ */
+static int eval_file(const struct lttng_filter_bytecode *bytecode,
+		const char *path, unsigned long loops)
+{
+	int nr_errors = 0;
+	FILE *fp;
+	char *line = NULL, desc[32];
+	size_t line_size = 0;
+	unsigned long lineno = 0;
+
+	if (!strcmp(path, "-")) {
+		fp = stdin;
+	} else {
+		fp = fopen(path, "r");
+		if (!fp) {
+			PERROR("fopen %s", path);
+			return -1;
+		}
+	}
+
+	while (getline(&line, &line_size, fp) >= 0) {
+		struct filter_payload payload = { NULL, 0 };
+		char *p = line;
+
+		lineno++;
+		while (isspace((unsigned char) *p)) {
+			p++;
+		}
+		if (!*p || *p == '#') {
+			continue;
+		}
+		snprintf(desc, sizeof(desc), "Line %lu", lineno);
+		if (parse_line(p, &payload) ||
+				eval_payload(bytecode, &payload, desc, loops) < 0) {
+			nr_errors++;
+		}
+		free(payload.fields);
+	}
+	if (ferror(fp)) {
+		PERROR("read %s", path);
+		nr_errors = -1;
+	}
+
+	free(line);
+	if (fp != stdin) {
+		fclose(fp);
+	}
+	return nr_errors;
+}
+
+/*
+ * The 'eval-filter <expression> <options>' first level command
+ */
+int cmd_eval_filter(int argc, const char **argv)
+{
+	int opt, ret = CMD_SUCCESS;
+	const char *expression, *arg;
+	char *end, **tokens = NULL;
+	unsigned long loops = 1, i, nr_tokens = 0;
+	struct lttng_filter_bytecode_alloc *bytecode = NULL;
+	struct filter_payload payload = { NULL, 0 };
+	static poptContext pc;
+
+	pc = poptGetContext(NULL, argc, argv, long_options, 0);
+	poptReadDefaultConfig(pc, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_HELP:
+			usage(stdout);
+			goto end;
+		case OPT_LIST_OPTIONS:
+			list_cmd_options(stdout, long_options);
+			goto end;
+		default:
+			usage(stderr);
+			ret = CMD_UNDEFINED;
+			goto end;
+		}
+	}
+
+	expression = poptGetArg(pc);
+	if (!expression) {
+		ERR("Missing filter expression");
+		usage(stderr);
+		ret = CMD_ERROR;
+		goto end;
+	}
+	if (opt_loops) {
+		errno = 0;
+		loops = strtoul(opt_loops, &end, 0);
+		if (errno || *end || !loops) {
+			ERR("Invalid number of loops: %s", opt_loops);
+			ret = CMD_ERROR;
+			goto end;
+		}
+	}
+
+	bytecode = filter_bytecode_compile(expression, !opt_no_optimize,
+			opt_kernel);
+	if (!bytecode) {
+		ERR("Unable to compile filter: %s", expression);
+		ret = CMD_ERROR;
+		goto end;
+	}
+	MSG("Filter bytecode: %" PRIu32 " bytes", bytecode->b.reloc_table_offset);
+
+	if (opt_file) {
+		if (poptPeekArg(pc)) {
+			ERR("Fields cannot be given along with --file");
+			ret = CMD_ERROR;
+			goto end;
+		}
+		if (eval_file(&bytecode->b, opt_file, loops)) {
+			ret = CMD_ERROR;
+		}
+		goto end;
+	}
+
+	while ((arg = poptGetArg(pc))) {
+		char **new_tokens;
+
+		new_tokens = realloc(tokens, (nr_tokens + 1) * sizeof(*tokens));
+		if (!new_tokens) {
+			PERROR("realloc");
+			ret = CMD_ERROR;
+			goto end;
+		}
+		tokens = new_tokens;
+		tokens[nr_tokens] = strdup(arg);
+		if (!tokens[nr_tokens]) {
+			PERROR("strdup");
+			ret = CMD_ERROR;
+			goto end;
+		}
+		if (add_field(&payload, tokens[nr_tokens++])) {
+			ret = CMD_ERROR;
+			goto end;
+		}
+	}
+	if (eval_payload(&bytecode->b, &payload, "Payload", loops) < 0) {
+		ret = CMD_ERROR;
+	}
+
+end:
+	for (i = 0; i < nr_tokens; i++) {
+		free(tokens[i]);
+	}
+	free(tokens);
+	free(payload.fields);
+	free(bytecode);
+	poptFreeContext(pc);
+	return ret;
+}
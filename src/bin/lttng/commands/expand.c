@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <ftw.h>
+#include <limits.h>
+#include <popt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <common/index/index.h>
+
+#include "../command.h"
+
+/* Maximum number of directories nftw keeps open. */
+#define EXPAND_NOPENFD		16
+
+/* Number of trace files which could not be expanded. */
+static int nr_errors;
+
+enum {
+	OPT_HELP = 1,
+	OPT_LIST_OPTIONS,
+};
+
+static struct poptOption long_options[] = {
+	/* longName, shortName, argInfo, argPtr, value, descrip, argDesc */
+	{"help",        'h', POPT_ARG_NONE, 0, OPT_HELP, 0, 0},
+	{"list-options", 0,  POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
+	{0, 0, 0, 0, 0, 0, 0}
+};
+
+/*
+ * usage
+ */
+static void usage(FILE *ofp)
+{
+	fprintf(ofp, "usage: lttng expand PATH [OPTIONS]\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "Expand the compressed trace files found under PATH back to plain CTF,\n");
+	fprintf(ofp, "in place, so they can be read by any trace viewer.\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "Options:\n");
+	fprintf(ofp, "  -h, --help               Show this help\n");
+	fprintf(ofp, "      --list-options       Simple listing of options\n");
+	fprintf(ofp, "\n");
+}
+
+/*
+ * nftw callback expanding the trace file of each index file found in an index
+ * directory.
+ */
+static int expand_entry(const char *fpath, const struct stat *sb,
+		int typeflag, struct FTW *ftwbuf)
+{
+	int ret;
+	size_t name_len, dir_len, suffix_len = strlen(DEFAULT_INDEX_FILE_SUFFIX);
+	const char *name = fpath + ftwbuf->base;
+	char trace_path[PATH_MAX];
+
+	if (typeflag != FTW_F) {
+		return 0;
+	}
+	name_len = strlen(name);
+	if (name_len <= suffix_len ||
+			strcmp(name + name_len - suffix_len, DEFAULT_INDEX_FILE_SUFFIX)) {
+		return 0;
+	}
+	/* fpath is DIR/index/NAME.idx and the trace file DIR/NAME. */
+	dir_len = ftwbuf->base - 1;
+	if (dir_len < strlen(DEFAULT_INDEX_DIR) ||
+			strncmp(fpath + dir_len - strlen(DEFAULT_INDEX_DIR),
+				DEFAULT_INDEX_DIR, strlen(DEFAULT_INDEX_DIR))) {
+		return 0;
+	}
+	dir_len -= strlen(DEFAULT_INDEX_DIR);
+
+	ret = snprintf(trace_path, sizeof(trace_path), "%.*s%.*s", (int) dir_len,
+			fpath, (int) (name_len - suffix_len), name);
+	if (ret < 0 || ret >= sizeof(trace_path)) {
+		ERR("Trace file path too long for index %s", fpath);
+		nr_errors++;
+		return 0;
+	}
+
+	ret = index_expand_trace_file(fpath, trace_path);
+	if (ret < 0) {
+		ERR("Unable to expand %s", trace_path);
+		nr_errors++;
+	} else if (ret > 0) {
+		MSG("Expanded %s", trace_path);
+	}
+	return 0;
+}
+
+/*
+ * The 'expand <options>' first level command
+ */
+int cmd_expand(int argc, const char **argv)
+{
+	int opt, ret = CMD_SUCCESS;
+	const char *path;
+	static poptContext pc;
+
+	pc = poptGetContext(NULL, argc, argv, long_options, 0);
+	poptReadDefaultConfig(pc, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_HELP:
+			usage(stdout);
+			goto end;
+		case OPT_LIST_OPTIONS:
+			list_cmd_options(stdout, long_options);
+			goto end;
+		default:
+			usage(stderr);
+			ret = CMD_UNDEFINED;
+			goto end;
+		}
+	}
+
+	path = poptGetArg(pc);
+	if (!path) {
+		ERR("Missing trace path");
+		usage(stderr);
+		ret = CMD_ERROR;
+		goto end;
+	}
+
+	nr_errors = 0;
+	if (nftw(path, expand_entry, EXPAND_NOPENFD, FTW_PHYS)) {
+		PERROR("Walking %s", path);
+		ret = CMD_ERROR;
+		goto end;
+	}
+	if (nr_errors) {
+		ret = CMD_ERROR;
+	}
+
+end:
+	poptFreeContext(pc);
+	return ret;
+}
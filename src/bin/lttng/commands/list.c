@@ -31,6 +31,7 @@ static int opt_jul;
 static char *opt_channel;
 static int opt_domain;
 static int opt_fields;
+static int opt_memory;
 #if 0
 /* Not implemented yet */
 static char *opt_cmd_name;
@@ -64,6 +65,7 @@ static struct poptOption long_options[] = {
 	{"channel",   'c', POPT_ARG_STRING, &opt_channel, 0, 0, 0},
 	{"domain",    'd', POPT_ARG_VAL, &opt_domain, 1, 0, 0},
 	{"fields",    'f', POPT_ARG_VAL, &opt_fields, 1, 0, 0},
+	{"memory",    'm', POPT_ARG_VAL, &opt_memory, 1, 0, 0},
 	{"list-options", 0, POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
 	{0, 0, 0, 0, 0, 0, 0}
 };
@@ -93,6 +95,8 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "Session Options:\n");
 	fprintf(ofp, "  -c, --channel NAME      List details of a channel\n");
 	fprintf(ofp, "  -d, --domain            List available domain(s)\n");
+	fprintf(ofp, "  -m, --memory            List buffer memory usage per channel\n");
+	fprintf(ofp, "                          and per application or user\n");
 	fprintf(ofp, "\n");
 }
 
@@ -723,6 +727,118 @@ error_channels:
 	return ret;
 }
 
+static int compare_memory_usage(const void *a, const void *b)
+{
+	const struct lttng_memory_usage *ua = a, *ub = b;
+	int ret;
+
+	ret = strncmp(ua->channel_name, ub->channel_name,
+			sizeof(ua->channel_name));
+	if (ret) {
+		return ret;
+	}
+	if (ua->pid != ub->pid) {
+		return ua->pid < ub->pid ? -1 : 1;
+	}
+	return ua->uid < ub->uid ? -1 : (ua->uid > ub->uid);
+}
+
+static void print_memory_usage_owner(struct lttng_memory_usage *usage)
+{
+	char owner[64];
+
+	if (usage->pid >= 0) {
+		snprintf(owner, sizeof(owner), "PID %d, UID %d, %u-bit",
+				usage->pid, usage->uid, usage->bits_per_long);
+	} else if (usage->uid >= 0) {
+		snprintf(owner, sizeof(owner), "UID %d, %u-bit", usage->uid,
+				usage->bits_per_long);
+	} else {
+		snprintf(owner, sizeof(owner), "kernel");
+	}
+
+	if (usage->metadata_cache_size) {
+		MSG("%s[%s] streams: %u, buffers: %" PRIu64
+				" bytes, metadata cache: %" PRIu64 " bytes", indent6,
+				owner, usage->nr_streams, usage->buffer_size,
+				usage->metadata_cache_size);
+	} else {
+		MSG("%s[%s] streams: %u, buffers: %" PRIu64 " bytes", indent6,
+				owner, usage->nr_streams, usage->buffer_size);
+	}
+}
+
+/*
+ * List the buffer memory used by the channel(s) of the session and domain,
+ * per channel and per application or user, along with the session total.
+ *
+ * If channel_name is NULL, all channels are listed.
+ */
+static int list_memory_usage(const char *channel_name)
+{
+	int count, i, first, ret = CMD_SUCCESS;
+	uint64_t chan_streams = 0, chan_size = 0, chan_cache = 0;
+	uint64_t total_streams = 0, total_size = 0, total_cache = 0;
+	struct lttng_memory_usage *usage = NULL;
+
+	DBG("Listing memory usage (%s)", channel_name ? : "<all>");
+
+	count = lttng_list_memory_usage(handle, &usage);
+	if (count < 0) {
+		ret = count;
+		ERR("%s", lttng_strerror(ret));
+		goto end;
+	}
+
+	/* Group the entries per channel. */
+	qsort(usage, count, sizeof(*usage), compare_memory_usage);
+
+	MSG("Memory usage:\n-------------");
+	for (i = 0, first = 0; i < count; i++) {
+		struct lttng_memory_usage *entry = &usage[i];
+
+		if (channel_name && strncmp(entry->channel_name, channel_name,
+					sizeof(entry->channel_name)) != 0) {
+			first = i + 1;
+			continue;
+		}
+
+		chan_streams += entry->nr_streams;
+		chan_size += entry->buffer_size;
+		chan_cache += entry->metadata_cache_size;
+
+		/* Print the channel once all its entries are accounted. */
+		if (i + 1 < count && !strncmp(entry->channel_name,
+					usage[i + 1].channel_name,
+					sizeof(entry->channel_name))) {
+			continue;
+		}
+
+		MSG("- %s: streams: %" PRIu64 ", buffers: %" PRIu64 " bytes",
+				entry->channel_name, chan_streams, chan_size);
+		if (chan_cache) {
+			MSG("%smetadata cache: %" PRIu64 " bytes", indent4, chan_cache);
+		}
+		for (; first <= i; first++) {
+			print_memory_usage_owner(&usage[first]);
+		}
+		MSG("");
+
+		total_streams += chan_streams;
+		total_size += chan_size;
+		total_cache += chan_cache;
+		chan_streams = chan_size = chan_cache = 0;
+	}
+
+	MSG("Total: streams: %" PRIu64 ", buffers: %" PRIu64
+			" bytes, metadata cache: %" PRIu64 " bytes\n",
+			total_streams, total_size, total_cache);
+
+end:
+	free(usage);
+	return ret;
+}
+
 /*
  * List available tracing session. List only basic information.
  *
@@ -936,8 +1052,12 @@ int cmd_list(int argc, const char **argv)
 		}
 
 		if (opt_kernel || opt_userspace) {
-			/* Channel listing */
-			ret = list_channels(opt_channel);
+			if (opt_memory) {
+				ret = list_memory_usage(opt_channel);
+			} else {
+				/* Channel listing */
+				ret = list_channels(opt_channel);
+			}
 			if (ret < 0) {
 				goto end;
 			}
@@ -990,7 +1110,11 @@ int cmd_list(int argc, const char **argv)
 					continue;
 				}
 
-				ret = list_channels(opt_channel);
+				if (opt_memory) {
+					ret = list_memory_usage(opt_channel);
+				} else {
+					ret = list_channels(opt_channel);
+				}
 				if (ret < 0) {
 					goto end;
 				}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <popt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../command.h"
+
+static int opt_kernel;
+static int opt_userspace;
+static int opt_histogram;
+static char *opt_channel;
+static char *opt_session_name;
+
+enum {
+	OPT_HELP = 1,
+	OPT_USERSPACE,
+	OPT_LIST_OPTIONS,
+};
+
+static struct poptOption long_options[] = {
+	/* longName, shortName, argInfo, argPtr, value, descrip, argDesc */
+	{"help",      'h', POPT_ARG_NONE, 0, OPT_HELP, 0, 0},
+	{"kernel",    'k', POPT_ARG_VAL, &opt_kernel, 1, 0, 0},
+	{"userspace", 'u', POPT_ARG_NONE, 0, OPT_USERSPACE, 0, 0},
+	{"channel",   'c', POPT_ARG_STRING, &opt_channel, 0, 0, 0},
+	{"histogram", 'H', POPT_ARG_VAL, &opt_histogram, 1, 0, 0},
+	{"list-options", 0, POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
+	{0, 0, 0, 0, 0, 0, 0}
+};
+
+/*
+ * usage
+ */
+static void usage(FILE *ofp)
+{
+	fprintf(ofp, "usage: lttng stats [NAME] [OPTIONS]\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "Show how fast the consumer daemon drains the buffers of the session\n");
+	fprintf(ofp, "NAME, per channel and per stream. If NAME is not specified, lttng will\n");
+	fprintf(ofp, "get it from the configuration directory (.lttng).\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "Options:\n");
+	fprintf(ofp, "  -h, --help               Show this help\n");
+	fprintf(ofp, "      --list-options       Simple listing of options\n");
+	fprintf(ofp, "  -k, --kernel             Apply to the kernel tracer\n");
+	fprintf(ofp, "  -u, --userspace          Apply to the user-space tracer\n");
+	fprintf(ofp, "  -c, --channel NAME       Only show the stats of this channel\n");
+	fprintf(ofp, "  -H, --histogram          Show the write latency histogram of each\n");
+	fprintf(ofp, "                           channel\n");
+	fprintf(ofp, "\n");
+	fprintf(ofp, "The write latency of a sub-buffer is the time from the moment the\n");
+	fprintf(ofp, "consumer wakes up to read a stream until the sub-buffer is written to\n");
+	fprintf(ofp, "the trace file or sent to the relay daemon.\n");
+	fprintf(ofp, "\n");
+}
+
+static void print_stats(const struct lttng_stream_stats *stats)
+{
+	char name[LTTNG_SYMBOL_NAME_LEN + 16];
+	double rate = 0, latency_avg = 0;
+
+	if (stats->stream_name[0] == '\0') {
+		snprintf(name, sizeof(name), "%s (total)", stats->channel_name);
+	} else {
+		snprintf(name, sizeof(name), "  %s", stats->stream_name);
+	}
+	if (stats->elapsed) {
+		rate = (double) stats->bytes_consumed * 1000000000.0 /
+			stats->elapsed / (1024 * 1024);
+	}
+	if (stats->subbuf_count) {
+		latency_avg = (double) stats->latency_total / stats->subbuf_count /
+			1000;
+	}
+
+	MSG("%-28s %10" PRIu64 " %14" PRIu64 " %9.2f %14" PRIu64 " %10" PRIu64
+			" %9.1f %9.1f", name, stats->subbuf_count,
+			stats->bytes_consumed, rate, stats->bytes_written,
+			stats->events_discarded, latency_avg,
+			(double) stats->latency_max / 1000);
+}
+
+static void print_histogram(const struct lttng_stream_stats *stats)
+{
+	int i;
+
+	MSG("    Write latency:");
+	for (i = 0; i < LTTNG_STREAM_STATS_LATENCY_BUCKETS; i++) {
+		uint64_t low = i ? (uint64_t) 1 << (i - 1) : 0;
+
+		if (!stats->latency_hist[i]) {
+			continue;
+		}
+		if (i == LTTNG_STREAM_STATS_LATENCY_BUCKETS - 1) {
+			MSG("      %10" PRIu64 " us and more: %" PRIu64, low,
+					stats->latency_hist[i]);
+		} else {
+			MSG("      %10" PRIu64 " - %" PRIu64 " us: %" PRIu64, low,
+					(uint64_t) 1 << i, stats->latency_hist[i]);
+		}
+	}
+}
+
+/*
+ * Show the stats of the channels of the session for the domain of the handle,
+ * each channel total followed by its streams.
+ */
+static int show_stats(struct lttng_handle *handle)
+{
+	int count, i, ret = CMD_SUCCESS;
+	struct lttng_stream_stats *stats = NULL;
+
+	count = lttng_list_stream_stats(handle, &stats);
+	if (count < 0) {
+		ret = count;
+		ERR("%s", lttng_strerror(ret));
+		goto end;
+	}
+
+	MSG("%-28s %10s %14s %9s %14s %10s %9s %9s", "Channel/stream",
+			"Sub-bufs", "Consumed (B)", "MiB/s", "Written (B)",
+			"Discarded", "Avg (us)", "Max (us)");
+
+	/* Entries come per channel, the channel total first. */
+	for (i = 0; i < count; i++) {
+		struct lttng_stream_stats *entry = &stats[i];
+
+		if (opt_channel && strncmp(entry->channel_name, opt_channel,
+					sizeof(entry->channel_name)) != 0) {
+			continue;
+		}
+
+		if (entry->stream_name[0] == '\0') {
+			if (i > 0) {
+				MSG("");
+			}
+			print_stats(entry);
+			if (opt_histogram) {
+				print_histogram(entry);
+			}
+		} else {
+			print_stats(entry);
+		}
+	}
+	MSG("");
+
+end:
+	free(stats);
+	return ret;
+}
+
+static int stats_domain(const char *session_name, struct lttng_domain *domain)
+{
+	int ret;
+	struct lttng_handle *handle;
+
+	handle = lttng_create_handle(session_name, domain);
+	if (handle == NULL) {
+		return CMD_FATAL;
+	}
+
+	ret = show_stats(handle);
+	lttng_destroy_handle(handle);
+	return ret;
+}
+
+/*
+ * Show the stats of the requested domain or of every kernel and user space
+ * domain of the session.
+ */
+static int show_session_stats(void)
+{
+	int ret, i, nb_domain;
+	char *session_name;
+	struct lttng_domain domain;
+	struct lttng_domain *domains = NULL;
+
+	if (opt_session_name == NULL) {
+		session_name = get_session_name();
+		if (session_name == NULL) {
+			ret = CMD_ERROR;
+			goto error;
+		}
+	} else {
+		session_name = opt_session_name;
+	}
+
+	DBG("Showing stream stats of session %s", session_name);
+
+	memset(&domain, 0, sizeof(domain));
+	if (opt_kernel || opt_userspace) {
+		domain.type = opt_kernel ? LTTNG_DOMAIN_KERNEL : LTTNG_DOMAIN_UST;
+		ret = stats_domain(session_name, &domain);
+		goto free_name;
+	}
+
+	nb_domain = lttng_list_domains(session_name, &domains);
+	if (nb_domain < 0) {
+		ret = nb_domain;
+		ERR("%s", lttng_strerror(ret));
+		goto free_name;
+	}
+
+	ret = CMD_SUCCESS;
+	for (i = 0; i < nb_domain; i++) {
+		switch (domains[i].type) {
+		case LTTNG_DOMAIN_KERNEL:
+			MSG("=== Domain: Kernel ===\n");
+			break;
+		case LTTNG_DOMAIN_UST:
+			MSG("=== Domain: UST global ===\n");
+			break;
+		default:
+			/* No consumer stream for the other domains. */
+			continue;
+		}
+
+		ret = stats_domain(session_name, &domains[i]);
+		if (ret < 0) {
+			goto free_name;
+		}
+	}
+
+free_name:
+	free(domains);
+	if (opt_session_name == NULL) {
+		free(session_name);
+	}
+error:
+	return ret;
+}
+
+/*
+ *  cmd_stats
+ *
+ *  The 'stats <options>' first level command
+ */
+int cmd_stats(int argc, const char **argv)
+{
+	int opt, ret = CMD_SUCCESS;
+	static poptContext pc;
+
+	pc = poptGetContext(NULL, argc, argv, long_options, 0);
+	poptReadDefaultConfig(pc, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_HELP:
+			usage(stdout);
+			goto end;
+		case OPT_USERSPACE:
+			opt_userspace = 1;
+			break;
+		case OPT_LIST_OPTIONS:
+			list_cmd_options(stdout, long_options);
+			goto end;
+		default:
+			usage(stderr);
+			ret = CMD_UNDEFINED;
+			goto end;
+		}
+	}
+
+	if (opt_kernel && opt_userspace) {
+		ERR("Only one domain can be specified");
+		usage(stderr);
+		ret = CMD_ERROR;
+		goto end;
+	}
+
+	opt_session_name = (char*) poptGetArg(pc);
+
+	ret = show_session_stats();
+
+end:
+	poptFreeContext(pc);
+	return ret;
+}
@@ -82,6 +82,9 @@ static struct cmd_struct commands[] =  {
 	{ "snapshot", cmd_snapshot},
 	{ "save", cmd_save},
 	{ "load", cmd_load},
+	{ "expand", cmd_expand},
+	{ "stats", cmd_stats},
+	{ "eval-filter", cmd_eval_filter},
 	{ "enable-consumer", cmd_enable_consumer}, /* OBSOLETE */
 	{ "disable-consumer", cmd_disable_consumer}, /* OBSOLETE */
 	{ NULL, NULL}	/* Array closure */
@@ -122,6 +125,9 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "    view              Start trace viewer\n");
 	fprintf(ofp, "    save              Save session configuration\n");
 	fprintf(ofp, "    load              Load session configuration\n");
+	fprintf(ofp, "    expand            Expand compressed trace files\n");
+	fprintf(ofp, "    stats             Show consumer throughput and latency stats\n");
+	fprintf(ofp, "    eval-filter       Evaluate a filter against sample events\n");
 	fprintf(ofp, "\n");
 	fprintf(ofp, "Each command also has its own -h, --help option.\n");
 	fprintf(ofp, "\n");
@@ -404,7 +410,9 @@ static int check_args_no_sessiond(int argc, char **argv)
 				strncmp(argv[i], "--list-options", sizeof("--list-options")) == 0 ||
 				strncmp(argv[i], "--list-commands", sizeof("--list-commands")) == 0 ||
 				strncmp(argv[i], "version", sizeof("version")) == 0 ||
-				strncmp(argv[i], "view", sizeof("view")) == 0) {
+				strncmp(argv[i], "view", sizeof("view")) == 0 ||
+				strncmp(argv[i], "expand", sizeof("expand")) == 0 ||
+				strncmp(argv[i], "eval-filter", sizeof("eval-filter")) == 0) {
 			return 1;
 		}
 	}
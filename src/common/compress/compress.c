@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
+#include <common/common.h>
+
+#include "compress.h"
+
+/*
+ * LZ4 block format: a sequence is a token (literal length in the high nibble,
+ * match length minus LZ4_MINMATCH in the low nibble, 15 meaning that the
+ * length continues in the following bytes), the literals, the little endian
+ * offset of the match and the rest of the match length. The last sequence
+ * only has literals, the last LZ4_LASTLITERALS bytes are always literals and
+ * the last match starts at least LZ4_MFLIMIT bytes before the end.
+ */
+#define LZ4_MINMATCH		4
+#define LZ4_LASTLITERALS	5
+#define LZ4_MFLIMIT		12
+#define LZ4_MAX_DISTANCE	65535
+#define LZ4_RUN_MASK		15
+#define LZ4_HASH_LOG		12
+
+#ifndef HAVE_LIBLZ4
+
+static inline uint32_t lz4_read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/*
+ * Append a length continuation, for lengths of LZ4_RUN_MASK or more.
+ */
+static inline uint8_t *lz4_put_length(uint8_t *op, size_t len)
+{
+	for (; len >= 255; len -= 255) {
+		*op++ = 255;
+	}
+	*op++ = len;
+	return op;
+}
+
+/*
+ * Append a sequence made of litlen literals followed, if mlen is not 0, by a
+ * match of mlen bytes at the given offset.
+ *
+ * Return the new output position or NULL if it does not fit.
+ */
+static uint8_t *lz4_put_sequence(uint8_t *op, const uint8_t *oend,
+		const uint8_t *literals, size_t litlen, size_t offset, size_t mlen)
+{
+	uint8_t *token;
+	size_t need;
+
+	need = 1 + litlen + litlen / 255 + 1;
+	if (mlen) {
+		need += 2 + mlen / 255 + 1;
+	}
+	if (need > (size_t) (oend - op)) {
+		return NULL;
+	}
+
+	token = op++;
+	if (litlen >= LZ4_RUN_MASK) {
+		*token = LZ4_RUN_MASK << 4;
+		op = lz4_put_length(op, litlen - LZ4_RUN_MASK);
+	} else {
+		*token = litlen << 4;
+	}
+	memcpy(op, literals, litlen);
+	op += litlen;
+
+	if (mlen) {
+		*op++ = offset & 0xff;
+		*op++ = offset >> 8;
+		mlen -= LZ4_MINMATCH;
+		if (mlen >= LZ4_RUN_MASK) {
+			*token |= LZ4_RUN_MASK;
+			op = lz4_put_length(op, mlen - LZ4_RUN_MASK);
+		} else {
+			*token |= mlen;
+		}
+	}
+
+	return op;
+}
+
+/*
+ * Greedy single pass compressor with a hash table of the last position of
+ * each 4 bytes sequence, which is what trace packets need: most of their
+ * redundancy is in event headers and fields repeated close to each other.
+ */
+static ssize_t lz4_compress(const uint8_t *src, size_t src_len, uint8_t *dst,
+		size_t dst_len)
+{
+	uint32_t table[1 << LZ4_HASH_LOG];
+	const uint8_t *ip = src, *anchor = src, *end = src + src_len;
+	const uint8_t *mflimit = end - LZ4_MFLIMIT;
+	const uint8_t *matchlimit = end - LZ4_LASTLITERALS;
+	uint8_t *op = dst, *oend = dst + dst_len;
+
+	if (src_len > UINT32_MAX) {
+		return -1;
+	}
+	if (src_len <= LZ4_MFLIMIT) {
+		goto last_literals;
+	}
+
+	memset(table, 0, sizeof(table));
+	for (ip++; ip < mflimit;) {
+		uint32_t seq = lz4_read32(ip), h = lz4_hash(seq);
+		const uint8_t *ref = src + table[h];
+		size_t mlen;
+
+		table[h] = ip - src;
+		if (ref >= ip || ip - ref > LZ4_MAX_DISTANCE ||
+				lz4_read32(ref) != seq) {
+			/* Search faster in data which does not compress. */
+			ip += 1 + ((ip - anchor) >> 6);
+			continue;
+		}
+
+		/* Extend the match backward over the pending literals. */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+		for (mlen = LZ4_MINMATCH; ip + mlen < matchlimit &&
+				ip[mlen] == ref[mlen]; mlen++) {
+		}
+
+		op = lz4_put_sequence(op, oend, anchor, ip - anchor, ip - ref, mlen);
+		if (!op) {
+			return -1;
+		}
+		ip += mlen;
+		anchor = ip;
+	}
+
+last_literals:
+	op = lz4_put_sequence(op, oend, anchor, end - anchor, 0, 0);
+	if (!op) {
+		return -1;
+	}
+	return op - dst;
+}
+
+/*
+ * Read a length continuation.
+ *
+ * Return 0 on success or -1 if the input is truncated.
+ */
+static inline int lz4_get_length(const uint8_t **ipp, const uint8_t *iend,
+		size_t *len)
+{
+	const uint8_t *ip = *ipp;
+	uint8_t b;
+
+	do {
+		if (ip >= iend) {
+			return -1;
+		}
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+
+	*ipp = ip;
+	return 0;
+}
+
+/*
+ * Decompress a block, checking every length and offset against the input and
+ * output bounds since the data comes from the network or the disk.
+ */
+static ssize_t lz4_decompress(const uint8_t *src, size_t src_len,
+		uint8_t *dst, size_t dst_len)
+{
+	const uint8_t *ip = src, *iend = src + src_len;
+	uint8_t *op = dst, *oend = dst + dst_len;
+
+	while (ip < iend) {
+		uint8_t token = *ip++;
+		size_t litlen = token >> 4, mlen = token & LZ4_RUN_MASK, offset;
+		const uint8_t *match;
+
+		if (litlen == LZ4_RUN_MASK && lz4_get_length(&ip, iend, &litlen)) {
+			return -1;
+		}
+		if (litlen > (size_t) (iend - ip) || litlen > (size_t) (oend - op)) {
+			return -1;
+		}
+		memcpy(op, ip, litlen);
+		ip += litlen;
+		op += litlen;
+
+		/* The last sequence has no match. */
+		if (ip == iend) {
+			break;
+		}
+
+		if (iend - ip < 2) {
+			return -1;
+		}
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t) (op - dst)) {
+			return -1;
+		}
+		if (mlen == LZ4_RUN_MASK && lz4_get_length(&ip, iend, &mlen)) {
+			return -1;
+		}
+		mlen += LZ4_MINMATCH;
+		if (mlen > (size_t) (oend - op)) {
+			return -1;
+		}
+
+		/* An overlapping match repeats its start, copy it byte per byte. */
+		match = op - offset;
+		if (offset >= mlen) {
+			memcpy(op, match, mlen);
+			op += mlen;
+		} else {
+			while (mlen--) {
+				*op++ = *match++;
+			}
+		}
+	}
+
+	return op - dst;
+}
+
+#else /* HAVE_LIBLZ4 */
+
+static ssize_t lz4_compress(const uint8_t *src, size_t src_len, uint8_t *dst,
+		size_t dst_len)
+{
+	int ret;
+
+	if (src_len > LZ4_MAX_INPUT_SIZE || dst_len > INT_MAX) {
+		return -1;
+	}
+	ret = LZ4_compress_default((const char *) src, (char *) dst, src_len,
+			dst_len);
+	return ret > 0 ? ret : -1;
+}
+
+static ssize_t lz4_decompress(const uint8_t *src, size_t src_len,
+		uint8_t *dst, size_t dst_len)
+{
+	int ret;
+
+	if (src_len > INT_MAX || dst_len > INT_MAX) {
+		return -1;
+	}
+	ret = LZ4_decompress_safe((const char *) src, (char *) dst, src_len,
+			dst_len);
+	return ret >= 0 ? ret : -1;
+}
+
+#endif /* HAVE_LIBLZ4 */
+
+/*
+ * Return the size of the buffer needed to compress len bytes in the worst
+ * case, or 0 if the compression type is unknown.
+ */
+size_t compress_bound(enum lttng_compression type, size_t len)
+{
+	switch (type) {
+	case LTTNG_COMPRESSION_NONE:
+		return len;
+	case LTTNG_COMPRESSION_LZ4:
+		return len + len / 255 + 16;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Compress src_len bytes of src in dst.
+ *
+ * Return the compressed size or a negative value if it does not fit in dst,
+ * in which case the data is better sent as is.
+ */
+ssize_t compress_buffer(enum lttng_compression type, const void *src,
+		size_t src_len, void *dst, size_t dst_len)
+{
+	assert(src);
+	assert(dst);
+
+	switch (type) {
+	case LTTNG_COMPRESSION_NONE:
+		if (src_len > dst_len) {
+			return -1;
+		}
+		memcpy(dst, src, src_len);
+		return src_len;
+	case LTTNG_COMPRESSION_LZ4:
+		return lz4_compress(src, src_len, dst, dst_len);
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Decompress src_len bytes of src in dst.
+ *
+ * Return the decompressed size or a negative value if the input is corrupted
+ * or does not fit in dst.
+ */
+ssize_t decompress_buffer(enum lttng_compression type, const void *src,
+		size_t src_len, void *dst, size_t dst_len)
+{
+	assert(src);
+	assert(dst);
+
+	switch (type) {
+	case LTTNG_COMPRESSION_NONE:
+		return compress_buffer(type, src, src_len, dst, dst_len);
+	case LTTNG_COMPRESSION_LZ4:
+		return lz4_decompress(src, src_len, dst, dst_len);
+	default:
+		return -1;
+	}
+}
+
+const char *compress_type_str(enum lttng_compression type)
+{
+	switch (type) {
+	case LTTNG_COMPRESSION_NONE:
+		return "none";
+	case LTTNG_COMPRESSION_LZ4:
+		return "lz4";
+	default:
+		return "unknown";
+	}
+}
+
+/*
+ * Parse a compression name.
+ *
+ * Return 0 on success or -1 if unknown.
+ */
+int compress_parse_type(const char *str, enum lttng_compression *type)
+{
+	assert(str);
+	assert(type);
+
+	if (!strcmp(str, "none")) {
+		*type = LTTNG_COMPRESSION_NONE;
+	} else if (!strcmp(str, "lz4")) {
+		*type = LTTNG_COMPRESSION_LZ4;
+	} else {
+		return -1;
+	}
+	return 0;
+}
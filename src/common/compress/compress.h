@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _COMMON_COMPRESS_H
+#define _COMMON_COMPRESS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <lttng/lttng.h>
+
+/*
+ * Block compression of trace packets. LZ4 uses liblz4 when available and a
+ * built-in implementation of the same block format otherwise, so both ends of
+ * a connection can always decompress what the other one compressed.
+ */
+
+size_t compress_bound(enum lttng_compression type, size_t len);
+ssize_t compress_buffer(enum lttng_compression type, const void *src,
+		size_t src_len, void *dst, size_t dst_len);
+ssize_t decompress_buffer(enum lttng_compression type, const void *src,
+		size_t src_len, void *dst, size_t dst_len);
+const char *compress_type_str(enum lttng_compression type);
+int compress_parse_type(const char *str, enum lttng_compression *type);
+
+#endif /* _COMMON_COMPRESS_H */
@@ -21,9 +21,13 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
 
 #include <common/common.h>
 #include <common/utils.h>
@@ -157,6 +161,7 @@ int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel)
 		ret = -1;
 		goto end_free_mutex;
 	}
+	channel->metadata_cache->shm_fd = -1;
 	DBG("Allocated metadata cache of %" PRIu64 " bytes",
 			channel->metadata_cache->cache_alloc_size);
 
@@ -182,11 +187,149 @@ void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel)
 
 	DBG("Destroying metadata cache");
 
+	if (channel->metadata_cache->shm) {
+		if (munmap(channel->metadata_cache->shm,
+				channel->metadata_cache->shm_mapped_len)) {
+			PERROR("munmap metadata shm");
+		}
+		if (close(channel->metadata_cache->shm_fd)) {
+			PERROR("close metadata shm");
+		}
+	}
 	pthread_mutex_destroy(&channel->metadata_cache->lock);
 	free(channel->metadata_cache->data);
 	free(channel->metadata_cache);
 }
 
+/*
+ * Map the whole shared memory file, as currently sized by the session daemon,
+ * in place of the current mapping if any.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+static int map_metadata_shm(struct consumer_metadata_cache *cache, int fd)
+{
+	int ret;
+	struct stat st;
+	void *shm;
+
+	ret = fstat(fd, &st);
+	if (ret < 0) {
+		PERROR("fstat metadata shm");
+		goto end;
+	}
+	if (st.st_size < LTTNG_METADATA_SHM_HEADER_LEN) {
+		ERR("Metadata shm of %" PRId64 " bytes is too small",
+				(int64_t) st.st_size);
+		ret = -1;
+		goto end;
+	}
+
+	shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		PERROR("mmap metadata shm");
+		ret = -1;
+		goto end;
+	}
+
+	if (cache->shm && munmap(cache->shm, cache->shm_mapped_len)) {
+		PERROR("munmap metadata shm");
+	}
+	cache->shm = shm;
+	cache->shm_mapped_len = st.st_size;
+	cache->shm_fd = fd;
+
+end:
+	return ret;
+}
+
+/*
+ * Use the shared memory the session daemon generates the metadata in as the
+ * source of the cache. The cache takes ownership of the file descriptor, even
+ * on error.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int consumer_metadata_cache_map_shm(struct lttng_consumer_channel *channel,
+		int fd)
+{
+	int ret;
+
+	assert(channel);
+	assert(channel->metadata_cache);
+	assert(!channel->metadata_cache->shm);
+
+	ret = map_metadata_shm(channel->metadata_cache, fd);
+	if (ret < 0) {
+		if (close(fd)) {
+			PERROR("close metadata shm");
+		}
+		goto end;
+	}
+
+	DBG("Metadata cache of channel %" PRIu64 " mapped from shm fd %d",
+			channel->key, fd);
+
+end:
+	return ret;
+}
+
+/*
+ * Copy in the cache the metadata published in the shared memory since the
+ * last call. On success, offset is set to the end of the metadata written in
+ * the cache.
+ *
+ * The metadata cache lock MUST be acquired.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int consumer_metadata_cache_pull_shm(struct lttng_consumer_channel *channel,
+		uint64_t *offset)
+{
+	int ret = 0;
+	uint64_t published_len;
+	struct consumer_metadata_cache *cache;
+
+	assert(channel);
+	assert(channel->metadata_cache);
+	assert(channel->metadata_cache->shm);
+	assert(offset);
+
+	cache = channel->metadata_cache;
+
+	published_len = CMM_LOAD_SHARED(cache->shm->published_len);
+	/* Pairs with the barrier before the length is published. */
+	cmm_smp_rmb();
+
+	if (published_len > LTTNG_METADATA_SHM_MAX_LEN) {
+		ERR("Invalid metadata shm length %" PRIu64, published_len);
+		ret = -1;
+		goto end;
+	}
+
+	if (published_len > cache->max_offset) {
+		if (LTTNG_METADATA_SHM_HEADER_LEN + published_len >
+				cache->shm_mapped_len) {
+			/* The session daemon grew the file since the last mapping. */
+			ret = map_metadata_shm(cache, cache->shm_fd);
+			if (ret < 0) {
+				goto end;
+			}
+		}
+
+		ret = consumer_metadata_cache_write(channel, cache->max_offset,
+				published_len - cache->max_offset,
+				cache->shm->data + cache->max_offset);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	*offset = cache->max_offset;
+
+end:
+	return ret;
+}
+
 /*
  * Check if the cache is flushed up to the offset passed in parameter.
  *
@@ -20,6 +20,7 @@
 #define CONSUMER_METADATA_CACHE_H
 
 #include <common/consumer.h>
+#include <common/metadata-shm.h>
 
 struct consumer_metadata_cache {
 	char *data;
@@ -47,12 +48,23 @@ struct consumer_metadata_cache {
 	 * This is nested INSIDE the consumer_data lock.
 	 */
 	pthread_mutex_t lock;
+	/*
+	 * Metadata shared by the session daemon. NULL when the metadata is pushed
+	 * through the consumer sockets instead.
+	 */
+	struct lttng_metadata_shm *shm;
+	size_t shm_mapped_len;
+	int shm_fd;
 };
 
 int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 		unsigned int offset, unsigned int len, char *data);
 int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel);
 void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel);
+int consumer_metadata_cache_map_shm(struct lttng_consumer_channel *channel,
+		int fd);
+int consumer_metadata_cache_pull_shm(struct lttng_consumer_channel *channel,
+		uint64_t *offset);
 int consumer_metadata_cache_flushed(struct lttng_consumer_channel *channel,
 		uint64_t offset, int timer);
 
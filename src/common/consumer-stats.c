@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <common/utils.h>
+
+#include "consumer-stats.h"
+
+static unsigned int latency_bucket(uint64_t latency)
+{
+	unsigned int bucket = 0;
+	uint64_t usec = latency / 1000;
+
+	while (usec && bucket < LTTNG_STREAM_STATS_LATENCY_BUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/*
+ * Account a sub-buffer of len bytes read from the ring buffer of a stream
+ * which was found ready at ready_ts.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_stats_consumed(struct lttng_consumer_stream *stream,
+		unsigned long len, uint64_t ready_ts)
+{
+	struct consumer_stats *stats = &stream->stats;
+
+	if (!stats->first_ts) {
+		CMM_STORE_SHARED(stats->first_ts, ready_ts);
+	}
+	CMM_STORE_SHARED(stats->subbuf_count, stats->subbuf_count + 1);
+	CMM_STORE_SHARED(stats->bytes_consumed, stats->bytes_consumed + len);
+}
+
+/*
+ * Account the len bytes written out for the current sub-buffer of a stream
+ * and the latency of the write since the stream was found ready at ready_ts.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_stats_written(struct lttng_consumer_stream *stream,
+		uint64_t len, uint64_t ready_ts)
+{
+	uint64_t latency, now;
+	unsigned int bucket;
+	struct consumer_stats *stats = &stream->stats;
+
+	CMM_STORE_SHARED(stats->bytes_written, stats->bytes_written + len);
+
+	now = utils_get_monotonic_ns();
+	if (!ready_ts || now < ready_ts) {
+		return;
+	}
+	latency = now - ready_ts;
+	bucket = latency_bucket(latency);
+
+	CMM_STORE_SHARED(stats->latency_total, stats->latency_total + latency);
+	if (latency > stats->latency_max) {
+		CMM_STORE_SHARED(stats->latency_max, latency);
+	}
+	CMM_STORE_SHARED(stats->latency_hist[bucket],
+			stats->latency_hist[bucket] + 1);
+}
+
+/*
+ * Record the number of events discarded so far by the tracer for a stream
+ * and how full its last sub-buffer was, as read from the packet header into
+ * its index.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_stats_packet(struct lttng_consumer_stream *stream,
+		const struct ctf_packet_index *index)
+{
+	uint64_t packet_size, content_size;
+	struct consumer_stats *stats = &stream->stats;
+
+	CMM_STORE_SHARED(stats->events_discarded,
+			be64toh(index->events_discarded));
+
+	packet_size = be64toh(index->packet_size);
+	content_size = be64toh(index->content_size);
+	if (packet_size && content_size <= packet_size) {
+		CMM_STORE_SHARED(stats->packet_count, stats->packet_count + 1);
+		CMM_STORE_SHARED(stats->fill_total, stats->fill_total +
+				content_size * 1000 / packet_size);
+	}
+}
+
+/*
+ * Fill a discard report if the tracer discarded events of a stream since its
+ * last report and that report is old enough.
+ *
+ * The stream lock MUST be acquired.
+ *
+ * Return 1 if the report must be sent to the session daemon, else 0.
+ */
+int consumer_stats_discard_report(struct lttng_consumer_stream *stream,
+		struct lttcomm_consumer_discard_report *report)
+{
+	uint64_t now, since;
+	struct consumer_stats *stats = &stream->stats;
+	struct consumer_stats *last = &stream->report_stats;
+
+	if (stats->events_discarded <= last->events_discarded) {
+		return 0;
+	}
+
+	now = utils_get_monotonic_ns();
+	since = stream->report_ts ? stream->report_ts : stats->first_ts;
+	if (stream->report_ts &&
+			now - stream->report_ts < CONSUMER_DISCARD_REPORT_INTERVAL) {
+		return 0;
+	}
+
+	memset(report, 0, sizeof(*report));
+	report->session_id = stream->chan->session_id;
+	strncpy(report->channel_name, stream->chan->name,
+			sizeof(report->channel_name));
+	report->channel_name[sizeof(report->channel_name) - 1] = '\0';
+	report->events_discarded = stats->events_discarded -
+		last->events_discarded;
+	report->subbuf_count = stats->packet_count - last->packet_count;
+	if (since && now > since) {
+		report->interval = now - since;
+	}
+	if (report->subbuf_count) {
+		report->fill_ratio = (stats->fill_total - last->fill_total) /
+			report->subbuf_count;
+	}
+
+	memcpy(last, stats, sizeof(*last));
+	stream->report_ts = now;
+	return 1;
+}
+
+/*
+ * Copy stats updated concurrently.
+ */
+static void load_stats(struct consumer_stats *dst,
+		const struct consumer_stats *src)
+{
+	int i;
+
+	dst->first_ts = CMM_LOAD_SHARED(src->first_ts);
+	dst->subbuf_count = CMM_LOAD_SHARED(src->subbuf_count);
+	dst->bytes_consumed = CMM_LOAD_SHARED(src->bytes_consumed);
+	dst->bytes_written = CMM_LOAD_SHARED(src->bytes_written);
+	dst->events_discarded = CMM_LOAD_SHARED(src->events_discarded);
+	dst->packet_count = CMM_LOAD_SHARED(src->packet_count);
+	dst->fill_total = CMM_LOAD_SHARED(src->fill_total);
+	dst->latency_total = CMM_LOAD_SHARED(src->latency_total);
+	dst->latency_max = CMM_LOAD_SHARED(src->latency_max);
+	for (i = 0; i < LTTNG_STREAM_STATS_LATENCY_BUCKETS; i++) {
+		dst->latency_hist[i] = CMM_LOAD_SHARED(src->latency_hist[i]);
+	}
+}
+
+/*
+ * Add the stats of src to the totals of dst.
+ */
+static void add_stats(struct consumer_stats *dst,
+		const struct consumer_stats *src)
+{
+	int i;
+
+	if (src->first_ts && (!dst->first_ts || src->first_ts < dst->first_ts)) {
+		dst->first_ts = src->first_ts;
+	}
+	dst->subbuf_count += src->subbuf_count;
+	dst->bytes_consumed += src->bytes_consumed;
+	dst->bytes_written += src->bytes_written;
+	dst->events_discarded += src->events_discarded;
+	dst->packet_count += src->packet_count;
+	dst->fill_total += src->fill_total;
+	dst->latency_total += src->latency_total;
+	if (src->latency_max > dst->latency_max) {
+		dst->latency_max = src->latency_max;
+	}
+	for (i = 0; i < LTTNG_STREAM_STATS_LATENCY_BUCKETS; i++) {
+		dst->latency_hist[i] += src->latency_hist[i];
+	}
+}
+
+/*
+ * Keep the stats of a stream being deleted in the totals of its channel.
+ *
+ * The channel and stream locks MUST be acquired.
+ */
+void consumer_stats_retire(struct lttng_consumer_stream *stream)
+{
+	struct consumer_stats totals;
+
+	assert(stream->chan);
+
+	load_stats(&totals, &stream->chan->stats);
+	add_stats(&totals, &stream->stats);
+	memcpy(&stream->chan->stats, &totals, sizeof(totals));
+}
+
+/*
+ * Append a zeroed entry to a stats array, growing it as needed.
+ *
+ * Return the index of the new entry or a negative value on allocation
+ * error.
+ */
+static ssize_t add_entry(struct lttng_stream_stats **stats, size_t *count,
+		size_t *alloc)
+{
+	if (*count == *alloc) {
+		size_t new_alloc = *alloc ? *alloc << 1 : 16;
+		struct lttng_stream_stats *new_stats;
+
+		new_stats = realloc(*stats, new_alloc * sizeof(*new_stats));
+		if (!new_stats) {
+			PERROR("realloc stream stats");
+			return -ENOMEM;
+		}
+		*stats = new_stats;
+		*alloc = new_alloc;
+	}
+
+	memset(&(*stats)[*count], 0, sizeof(**stats));
+	return (*count)++;
+}
+
+static void fill_entry(struct lttng_stream_stats *entry,
+		struct lttng_consumer_channel *channel, const char *stream_name,
+		const struct consumer_stats *stats, uint64_t now)
+{
+	int i;
+
+	strncpy(entry->channel_name, channel->name,
+			sizeof(entry->channel_name));
+	entry->channel_name[sizeof(entry->channel_name) - 1] = '\0';
+	if (stream_name) {
+		strncpy(entry->stream_name, stream_name,
+				sizeof(entry->stream_name));
+		entry->stream_name[sizeof(entry->stream_name) - 1] = '\0';
+	}
+	entry->channel_key = channel->key;
+	entry->uid = channel->uid;
+	entry->metadata = channel->type == CONSUMER_CHANNEL_TYPE_METADATA;
+	if (stats->first_ts && now > stats->first_ts) {
+		entry->elapsed = now - stats->first_ts;
+	}
+	entry->subbuf_count = stats->subbuf_count;
+	entry->bytes_consumed = stats->bytes_consumed;
+	entry->bytes_written = stats->bytes_written;
+	entry->events_discarded = stats->events_discarded;
+	entry->latency_total = stats->latency_total;
+	entry->latency_max = stats->latency_max;
+	for (i = 0; i < LTTNG_STREAM_STATS_LATENCY_BUCKETS; i++) {
+		entry->latency_hist[i] = stats->latency_hist[i];
+	}
+}
+
+/*
+ * Gather the stats of every channel of a session, each one followed by its
+ * streams. A channel entry holds the totals of its deleted and current
+ * streams.
+ *
+ * Return the number of entries set in stats, which the caller must free, or
+ * a negative value on error.
+ */
+ssize_t consumer_stats_collect(uint64_t session_id,
+		struct lttng_stream_stats **stats)
+{
+	ssize_t chan_idx, stream_idx;
+	size_t count = 0, alloc = 0;
+	uint64_t now = utils_get_monotonic_ns();
+	struct lttng_ht *stream_ht = consumer_data.stream_per_chan_id_ht;
+	struct lttng_consumer_channel *channel;
+	struct lttng_ht_iter iter;
+
+	assert(stats);
+
+	DBG("Consumer stream stats command on session id %" PRIu64, session_id);
+
+	*stats = NULL;
+	rcu_read_lock();
+
+	cds_lfht_for_each_entry(consumer_data.channel_ht->ht, &iter.iter,
+			channel, node.node) {
+		struct lttng_consumer_stream *stream;
+		struct lttng_ht_iter stream_iter;
+		struct consumer_stats totals;
+
+		if (channel->session_id != session_id) {
+			continue;
+		}
+
+		chan_idx = add_entry(stats, &count, &alloc);
+		if (chan_idx < 0) {
+			goto error;
+		}
+		load_stats(&totals, &channel->stats);
+
+		cds_lfht_for_each_entry_duplicate(stream_ht->ht,
+				stream_ht->hash_fct(&channel->key, lttng_ht_seed),
+				stream_ht->match_fct, &channel->key,
+				&stream_iter.iter, stream, node_channel_id.node) {
+			struct consumer_stats stream_stats;
+
+			stream_idx = add_entry(stats, &count, &alloc);
+			if (stream_idx < 0) {
+				goto error;
+			}
+			load_stats(&stream_stats, &stream->stats);
+			fill_entry(&(*stats)[stream_idx], channel, stream->name,
+					&stream_stats, now);
+			add_stats(&totals, &stream_stats);
+		}
+
+		fill_entry(&(*stats)[chan_idx], channel, NULL, &totals, now);
+	}
+
+	rcu_read_unlock();
+	return count;
+
+error:
+	rcu_read_unlock();
+	free(*stats);
+	*stats = NULL;
+	return -ENOMEM;
+}
+
+/*
+ * Answer the LTTNG_CONSUMER_STREAM_STATS command of the session daemon: a
+ * reply header followed by the stats entries of the session.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int consumer_stats_send(int sock, uint64_t session_id)
+{
+	int ret;
+	ssize_t count;
+	struct lttng_stream_stats *stats = NULL;
+	struct lttcomm_consumer_stream_stats_reply reply;
+
+	memset(&reply, 0, sizeof(reply));
+	count = consumer_stats_collect(session_id, &stats);
+	if (count < 0) {
+		reply.ret_code = LTTCOMM_CONSUMERD_ENOMEM;
+	} else {
+		reply.ret_code = LTTCOMM_CONSUMERD_SUCCESS;
+		reply.count = count;
+	}
+
+	ret = lttcomm_send_unix_sock(sock, &reply, sizeof(reply));
+	if (ret < 0) {
+		goto end;
+	}
+	if (reply.count) {
+		ret = lttcomm_send_unix_sock(sock, stats,
+				reply.count * sizeof(*stats));
+		if (ret < 0) {
+			goto end;
+		}
+	}
+	ret = 0;
+
+end:
+	free(stats);
+	return ret;
+}
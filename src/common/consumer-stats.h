@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_CONSUMER_STATS_H
+#define LTTNG_CONSUMER_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <lttng/lttng.h>
+#include <common/index/ctf-index.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+
+#include "consumer.h"
+
+/* Minimum time between two discard reports of a stream, in nsec. */
+#define CONSUMER_DISCARD_REPORT_INTERVAL	1000000000ULL
+
+/*
+ * Per-stream and per-channel statistics of the consumer, answering the
+ * LTTNG_CONSUMER_STREAM_STATS command.
+ *
+ * The data and metadata threads account each sub-buffer once it is read
+ * from the ring buffer and once it is written out, which for an asynchronous
+ * write happens when the write completes. Only the counters of the stream are
+ * updated on that path, with the stream lock already held, so nothing is
+ * shared between streams. A channel only keeps the totals of its deleted
+ * streams; its current streams are added up when the stats are collected.
+ * The session daemon thread reads the counters without locking so a reported
+ * entry may be a few sub-buffers behind.
+ *
+ * When the tracer discards events of a stream, the read path also sends a
+ * discard report to the session daemon, at most once per
+ * CONSUMER_DISCARD_REPORT_INTERVAL for each stream.
+ */
+
+void consumer_stats_consumed(struct lttng_consumer_stream *stream,
+		unsigned long len, uint64_t ready_ts);
+void consumer_stats_written(struct lttng_consumer_stream *stream,
+		uint64_t len, uint64_t ready_ts);
+void consumer_stats_packet(struct lttng_consumer_stream *stream,
+		const struct ctf_packet_index *index);
+int consumer_stats_discard_report(struct lttng_consumer_stream *stream,
+		struct lttcomm_consumer_discard_report *report);
+void consumer_stats_retire(struct lttng_consumer_stream *stream);
+ssize_t consumer_stats_collect(uint64_t session_id,
+		struct lttng_stream_stats **stats);
+int consumer_stats_send(int sock, uint64_t session_id);
+
+#endif /* LTTNG_CONSUMER_STATS_H */
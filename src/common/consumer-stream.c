@@ -29,6 +29,7 @@
 #include <common/relayd/relayd.h>
 #include <common/ust-consumer/ust-consumer.h>
 
+#include "consumer-stats.h"
 #include "consumer-stream.h"
 
 /*
@@ -42,6 +43,7 @@ static void free_stream_rcu(struct rcu_head *head)
 		caa_container_of(node, struct lttng_consumer_stream, node);
 
 	pthread_mutex_destroy(&stream->lock);
+	free(stream->compress_buf);
 	free(stream);
 }
 
@@ -177,9 +179,11 @@ void consumer_stream_close(struct lttng_consumer_stream *stream)
 }
 
 /*
- * Delete the stream from all possible hash tables.
+ * Delete the stream from all possible hash tables. Its stats are kept in
+ * the totals of its channel.
  *
  * The consumer data lock MUST be acquired.
+ * The channel lock MUST be acquired.
  * The stream lock MUST be acquired.
  */
 void consumer_stream_delete(struct lttng_consumer_stream *stream,
@@ -217,6 +221,8 @@ void consumer_stream_delete(struct lttng_consumer_stream *stream,
 
 	rcu_read_unlock();
 
+	consumer_stats_retire(stream);
+
 	if (!stream->metadata_flag) {
 		/* Decrement the stream count of the global consumer data. */
 		assert(consumer_data.stream_count > 0);
@@ -95,6 +95,9 @@ static void metadata_switch_timer(struct lttng_consumer_local_data *ctx,
 		 *     - Calling consumer_metadata_cache_flushed():
 		 *       - channel->timer_lock
 		 *         - channel->metadata_cache->lock
+		 * or, when the metadata is shared by the session daemon, only the
+		 * locks of consumer_metadata_cache_flushed() and, before it, of the
+		 * metadata cache.
 		 *
 		 * Ensure that neither consumer_data.lock nor
 		 * channel->lock are taken within this function, since
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Asynchronous trace file writer of the data thread based on io_uring.
+ *
+ * Each sub-buffer written to a local trace file is submitted as a chain of
+ * linked requests: the write itself from the mmap'd ring buffer, the start of
+ * its writeout and, like the synchronous path, the wait for the writeout of
+ * the previous sub-buffer followed by its page cache eviction. The stream
+ * keeps the sub-buffer until the last request of the chain completes, then
+ * the completion handler releases it and writes its index.
+ *
+ * Since a stream can only hold one sub-buffer at a time, there is at most one
+ * chain in flight per stream, but the data thread keeps servicing the other
+ * streams meanwhile. The ring is only ever used by the data thread.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <liburing.h>
+
+#include <common/common.h>
+
+#include "consumer.h"
+#include "consumer-uring.h"
+
+/*
+ * Tags stored in the low bits of the request user data, along with the stream
+ * pointer. Requests without a tag only report errors.
+ */
+#define URING_TAG_WRITE		0x1UL
+#define URING_TAG_LAST		0x2UL
+#define URING_TAG_MASK		0x3UL
+
+/* Maximum number of requests chained for a sub-buffer. */
+#define URING_CHAIN_LEN		4
+
+static struct io_uring ring;
+static int ring_initialized;
+static unsigned int ring_depth;
+/* Number of chains in flight. */
+static unsigned int nr_inflight;
+static struct lttng_consumer_local_data *ring_ctx;
+
+/*
+ * Set the number of sub-buffer writes that can be in flight. 0 disables the
+ * asynchronous writer. Must be called before the data thread is started.
+ */
+void consumer_uring_set_depth(unsigned int depth)
+{
+	ring_depth = depth;
+}
+
+/*
+ * Setup the ring of the data thread. On error, the synchronous writer is used.
+ *
+ * Return 0 on success or if disabled, else a negative value.
+ */
+int consumer_uring_init(struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+
+	assert(ctx);
+
+	if (!ring_depth) {
+		return 0;
+	}
+
+	ret = io_uring_queue_init(ring_depth * URING_CHAIN_LEN, &ring, 0);
+	if (ret < 0) {
+		errno = -ret;
+		PERROR("io_uring_queue_init");
+		WARN("Consumer asynchronous writer disabled");
+		return ret;
+	}
+	ring_ctx = ctx;
+	ring_initialized = 1;
+	DBG("Consumer io_uring writer initialized with %u writes in flight",
+			ring_depth);
+
+	return 0;
+}
+
+/*
+ * Wait for all the writes in flight and release the ring.
+ */
+void consumer_uring_fini(void)
+{
+	int ret;
+
+	if (!ring_initialized) {
+		return;
+	}
+
+	while (nr_inflight) {
+		ret = consumer_uring_reap(1);
+		if (ret < 0 && ret != -EINTR) {
+			ERR("Waiting for %u asynchronous writes failed (%d)",
+					nr_inflight, ret);
+			break;
+		}
+	}
+	io_uring_queue_exit(&ring);
+	ring_initialized = 0;
+}
+
+/*
+ * Return the file descriptor to poll for completions, or -1 if the
+ * asynchronous writer is not in use.
+ */
+int consumer_uring_get_fd(void)
+{
+	return ring_initialized ? ring.ring_fd : -1;
+}
+
+static struct io_uring_sqe *get_linked_sqe(void)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(&ring);
+	/* Space was checked for the whole chain. */
+	assert(sqe);
+	sqe->flags |= IOSQE_IO_LINK;
+	io_uring_sqe_set_data(sqe, NULL);
+	return sqe;
+}
+
+/*
+ * Submit the write of len bytes at buf, the stream's current sub-buffer, at
+ * the given offset of fd. On success, the stream is flagged as having a write
+ * pending and its sub-buffer MUST be kept until the completion handler runs.
+ *
+ * Must be called with the stream lock held.
+ *
+ * Return 0 on success or a negative value if the caller has to write the
+ * sub-buffer synchronously.
+ */
+int consumer_uring_submit_write(struct lttng_consumer_stream *stream,
+		int fd, const void *buf, size_t len, off_t offset)
+{
+	int ret;
+	uintptr_t tag;
+	struct io_uring_sqe *sqe;
+
+	assert(stream);
+	assert(!stream->aio_pending);
+	/* The stream pointer carries the tags in its low bits. */
+	assert(!((uintptr_t) stream & URING_TAG_MASK));
+
+	if (!ring_initialized) {
+		return -ENOSYS;
+	}
+	if (nr_inflight >= ring_depth ||
+			io_uring_sq_space_left(&ring) < URING_CHAIN_LEN) {
+		return -EAGAIN;
+	}
+
+	sqe = get_linked_sqe();
+	io_uring_prep_write(sqe, fd, buf, len, offset);
+	tag = URING_TAG_WRITE;
+	io_uring_sqe_set_data(sqe, (void *) ((uintptr_t) stream | tag));
+
+	/* A direct I/O write leaves nothing in the page cache. */
+	if (stream->out_fd_direct) {
+		goto end_chain;
+	}
+
+	/* Start the writeout of the sub-buffer without waiting for it. */
+	sqe = get_linked_sqe();
+	io_uring_prep_sync_file_range(sqe, fd, len, offset, SYNC_FILE_RANGE_WRITE);
+
+	/*
+	 * Same as lttng_consumer_sync_trace_file(): wait for the writeout of the
+	 * previous sub-buffer and evict it from the page cache.
+	 */
+	if (offset >= stream->max_sb_size) {
+		sqe = get_linked_sqe();
+		io_uring_prep_sync_file_range(sqe, fd, stream->max_sb_size,
+				offset - stream->max_sb_size,
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+				SYNC_FILE_RANGE_WAIT_AFTER);
+
+		sqe = get_linked_sqe();
+		io_uring_prep_fadvise(sqe, fd, offset - stream->max_sb_size,
+				stream->max_sb_size, POSIX_FADV_DONTNEED);
+	}
+	tag = 0;
+
+end_chain:
+	/* Completion of the last request of the chain releases the sub-buffer. */
+	sqe->flags &= ~IOSQE_IO_LINK;
+	io_uring_sqe_set_data(sqe,
+			(void *) ((uintptr_t) stream | tag | URING_TAG_LAST));
+
+	stream->aio_pending = 1;
+	stream->aio_result = 0;
+	nr_inflight++;
+
+	ret = io_uring_submit(&ring);
+	if (ret < 0) {
+		/* The requests stay queued and are submitted on the next reap. */
+		DBG("Consumer io_uring submit deferred (%d)", ret);
+	}
+
+	return 0;
+}
+
+/*
+ * Process the available completions. If wait is set, block until at least one
+ * is available.
+ *
+ * Return the number of completions processed or a negative value on error.
+ */
+int consumer_uring_reap(int wait)
+{
+	int ret;
+	unsigned int head, nr = 0;
+	struct io_uring_cqe *cqe;
+
+	if (!ring_initialized) {
+		return 0;
+	}
+
+	/* Flush the requests of a deferred submission, if any. */
+	(void) io_uring_submit(&ring);
+
+	if (wait) {
+		ret = io_uring_wait_cqe(&ring, &cqe);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	io_uring_for_each_cqe(&ring, head, cqe) {
+		uintptr_t data = (uintptr_t) io_uring_cqe_get_data(cqe);
+		struct lttng_consumer_stream *stream =
+			(struct lttng_consumer_stream *) (data & ~URING_TAG_MASK);
+
+		/* The write can also be the last request of its chain. */
+		if (data & URING_TAG_WRITE) {
+			stream->aio_result = cqe->res;
+		} else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+			/* Sync and fadvise are hints, just like the synchronous path. */
+			DBG("Consumer io_uring hint request failed (%d)", cqe->res);
+		}
+		if (data & URING_TAG_LAST) {
+			nr_inflight--;
+			lttng_consumer_complete_subbuffer(ring_ctx, stream);
+		}
+		nr++;
+	}
+	io_uring_cq_advance(&ring, nr);
+
+	return nr;
+}
+
+/*
+ * Wait for the write in flight of a stream, if any, before it is destroyed.
+ *
+ * Must be called by the data thread WITHOUT the stream lock held.
+ */
+void consumer_uring_wait_stream(struct lttng_consumer_stream *stream)
+{
+	int ret;
+
+	assert(stream);
+
+	while (ring_initialized && stream->aio_pending) {
+		ret = consumer_uring_reap(1);
+		if (ret < 0 && ret != -EINTR) {
+			ERR("Waiting for the asynchronous write of stream %" PRIu64
+					" failed (%d)", stream->key, ret);
+			break;
+		}
+	}
+}
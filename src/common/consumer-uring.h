@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CONSUMER_URING_H
+#define CONSUMER_URING_H
+
+#include <errno.h>
+#include <sys/types.h>
+
+#include <common/error.h>
+
+#include "consumer.h"
+
+#ifdef HAVE_LIBURING
+
+void consumer_uring_set_depth(unsigned int depth);
+int consumer_uring_init(struct lttng_consumer_local_data *ctx);
+void consumer_uring_fini(void);
+int consumer_uring_get_fd(void);
+int consumer_uring_submit_write(struct lttng_consumer_stream *stream,
+		int fd, const void *buf, size_t len, off_t offset);
+int consumer_uring_reap(int wait);
+void consumer_uring_wait_stream(struct lttng_consumer_stream *stream);
+
+#else /* HAVE_LIBURING */
+
+static inline
+void consumer_uring_set_depth(unsigned int depth)
+{
+	if (depth) {
+		WARN("Consumer built without io_uring support, "
+				"using synchronous writes");
+	}
+}
+static inline
+int consumer_uring_init(struct lttng_consumer_local_data *ctx)
+{
+	return 0;
+}
+static inline
+void consumer_uring_fini(void)
+{
+}
+static inline
+int consumer_uring_get_fd(void)
+{
+	return -1;
+}
+static inline
+int consumer_uring_submit_write(struct lttng_consumer_stream *stream,
+		int fd, const void *buf, size_t len, off_t offset)
+{
+	return -ENOSYS;
+}
+static inline
+int consumer_uring_reap(int wait)
+{
+	return 0;
+}
+static inline
+void consumer_uring_wait_stream(struct lttng_consumer_stream *stream)
+{
+}
+
+#endif /* HAVE_LIBURING */
+
+#endif /* CONSUMER_URING_H */
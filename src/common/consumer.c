@@ -42,8 +42,11 @@
 #include <common/relayd/relayd.h>
 #include <common/ust-consumer/ust-consumer.h>
 #include <common/consumer-timer.h>
+#include <common/consumer-uring.h>
+#include <common/compress/compress.h>
 
 #include "consumer.h"
+#include "consumer-stats.h"
 #include "consumer-stream.h"
 #include "consumer-testpoint.h"
 
@@ -81,6 +84,18 @@ volatile int consumer_quit;
 static struct lttng_ht *metadata_ht;
 static struct lttng_ht *data_ht;
 
+/* Maximum number of sub-buffers read from a data stream when it is ready. */
+static unsigned int consumer_read_budget = DEFAULT_CONSUMER_READ_BUDGET;
+
+/* Write the local trace files of the mmap data streams with direct I/O. */
+static int consumer_direct_io;
+
+/* Compression of the packets of the local trace files, if any. */
+static enum lttng_compression consumer_output_compression;
+
+/* Serializes the messages of the threads sharing the error socket. */
+static pthread_mutex_t error_socket_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Notify a thread lttng pipe to poll back again. This usually means that some
  * global state has changed so we just send back the thread in a poll wait
@@ -307,6 +322,7 @@ static void free_relayd_rcu(struct rcu_head *head)
 	(void) relayd_close(&relayd->control_sock);
 	(void) relayd_close(&relayd->data_sock);
 
+	free(relayd->compress_buf);
 	free(relayd);
 }
 
@@ -506,6 +522,8 @@ void consumer_flag_relayd_for_destroy(struct consumer_relayd_sock_pair *relayd)
 void consumer_del_stream(struct lttng_consumer_stream *stream,
 		struct lttng_ht *ht)
 {
+	/* The sub-buffer being written must be released before the buffers. */
+	consumer_uring_wait_stream(stream);
 	consumer_stream_destroy(stream, ht);
 }
 
@@ -915,6 +933,52 @@ error:
 	return outfd;
 }
 
+/*
+ * Compress a data packet of a compressed session in the relayd compression
+ * buffer, behind its compression header. When compression does not make the
+ * packet smaller, only the header is prepared and the packet is sent as is
+ * after it.
+ *
+ * Return the number of bytes to send from the buffer or a negative value.
+ */
+static ssize_t compress_relayd_packet(struct consumer_relayd_sock_pair *relayd,
+		const void *src, size_t len)
+{
+	ssize_t ret;
+	size_t size;
+	struct lttcomm_relayd_compressed_hdr *hdr;
+
+	/* A compressed packet larger than the original is never sent. */
+	size = sizeof(*hdr) + len;
+	if (size > relayd->compress_buf_size) {
+		void *buf;
+
+		buf = realloc(relayd->compress_buf, size);
+		if (!buf) {
+			PERROR("realloc relayd compress buffer");
+			ret = -ENOMEM;
+			goto error;
+		}
+		relayd->compress_buf = buf;
+		relayd->compress_buf_size = size;
+	}
+
+	hdr = relayd->compress_buf;
+	hdr->size = htobe32(len);
+	ret = compress_buffer(relayd->control_sock.compression, src, len, hdr + 1,
+			len);
+	if (ret < 0 || ret >= len) {
+		hdr->compression = htobe32(LTTNG_COMPRESSION_NONE);
+		ret = sizeof(*hdr);
+	} else {
+		hdr->compression = htobe32(relayd->control_sock.compression);
+		ret += sizeof(*hdr);
+	}
+
+error:
+	return ret;
+}
+
 /*
  * Allocate and return a new lttng_consumer_channel object using the given key
  * to initialize the hash table node.
@@ -1091,6 +1155,9 @@ static int update_poll_array(struct lttng_consumer_local_data *ctx,
 	 */
 	(*pollfd)[i].fd = lttng_pipe_get_readfd(ctx->consumer_data_pipe);
 	(*pollfd)[i].events = POLLIN | POLLPRI;
+	/* Followed by the asynchronous writer, ignored by poll() if unused. */
+	(*pollfd)[i + 1].fd = consumer_uring_get_fd();
+	(*pollfd)[i + 1].events = POLLIN;
 	return i;
 }
 
@@ -1145,12 +1212,44 @@ void lttng_consumer_set_command_sock_path(
  */
 int lttng_consumer_send_error(struct lttng_consumer_local_data *ctx, int cmd)
 {
+	int ret = 0;
+
 	if (ctx->consumer_error_socket > 0) {
-		return lttcomm_send_unix_sock(ctx->consumer_error_socket, &cmd,
+		pthread_mutex_lock(&error_socket_lock);
+		ret = lttcomm_send_unix_sock(ctx->consumer_error_socket, &cmd,
 				sizeof(enum lttcomm_sessiond_command));
+		pthread_mutex_unlock(&error_socket_lock);
 	}
 
-	return 0;
+	return ret;
+}
+
+/*
+ * Send a discard report to the session daemon, preceded by its code in the
+ * same message. If the socket is not defined, we return 0, it is not a fatal
+ * error.
+ */
+int lttng_consumer_send_discard_report(struct lttng_consumer_local_data *ctx,
+		const struct lttcomm_consumer_discard_report *report)
+{
+	int ret = 0;
+	struct {
+		int32_t code;
+		struct lttcomm_consumer_discard_report report;
+	} LTTNG_PACKED msg;
+
+	assert(sizeof(msg.code) == sizeof(enum lttcomm_return_code));
+
+	if (ctx->consumer_error_socket > 0) {
+		msg.code = LTTCOMM_CONSUMERD_DISCARD_REPORT;
+		memcpy(&msg.report, report, sizeof(msg.report));
+		pthread_mutex_lock(&error_socket_lock);
+		ret = lttcomm_send_unix_sock(ctx->consumer_error_socket, &msg,
+				sizeof(msg));
+		pthread_mutex_unlock(&error_socket_lock);
+	}
+
+	return ret;
 }
 
 /*
@@ -1238,6 +1337,98 @@ void lttng_consumer_sync_trace_file(struct lttng_consumer_stream *stream,
 			stream->max_sb_size, POSIX_FADV_DONTNEED);
 }
 
+/*
+ * Enable or disable the direct I/O of the local trace files.
+ */
+void lttng_consumer_set_direct_io(int enable)
+{
+	consumer_direct_io = !!enable;
+	DBG("Consumer direct I/O %s", enable ? "enabled" : "disabled");
+}
+
+/*
+ * Open the local trace file of a stream for direct I/O if enabled, which must
+ * be called each time a new trace file is created for the stream.
+ *
+ * Only the data streams using the mmap output qualify: each packet is written
+ * with its padding, that is a whole sub-buffer, from the page aligned ring
+ * buffer mapping. The metadata, the index files and the splice output always
+ * go through the page cache.
+ */
+void lttng_consumer_stream_direct_io(struct lttng_consumer_stream *stream)
+{
+	assert(stream);
+
+	stream->out_fd_direct = 0;
+	if (!consumer_direct_io || stream->metadata_flag ||
+			stream->net_seq_idx != (uint64_t) -1ULL ||
+			stream->chan->output != CONSUMER_CHANNEL_MMAP ||
+			stream->out_fd < 0) {
+		return;
+	}
+
+	if (utils_set_fd_direct_io(stream->out_fd, 1) < 0) {
+		DBG("Stream %" PRIu64 " trace file written through the page cache",
+				stream->key);
+		return;
+	}
+	stream->out_fd_direct = 1;
+}
+
+/*
+ * Set the compression of the packets of the local trace files.
+ */
+void lttng_consumer_set_output_compression(enum lttng_compression compression)
+{
+	consumer_output_compression = compression;
+	DBG("Consumer trace file compression set to %s",
+			compress_type_str(compression));
+}
+
+/*
+ * Compress a packet of a local trace file in the compression buffer of the
+ * stream, which stays untouched until the packet is written.
+ *
+ * Return the compressed size, len if the packet does not get smaller and is
+ * written as is, or a negative value on error.
+ */
+static ssize_t compress_stream_packet(struct lttng_consumer_stream *stream,
+		const void *src, size_t len)
+{
+	ssize_t ret;
+
+	if (len > stream->compress_buf_size) {
+		void *buf;
+
+		buf = realloc(stream->compress_buf, len);
+		if (!buf) {
+			PERROR("realloc stream compress buffer");
+			return -ENOMEM;
+		}
+		stream->compress_buf = buf;
+		stream->compress_buf_size = len;
+	}
+
+	ret = compress_buffer(consumer_output_compression, src, len,
+			stream->compress_buf, len);
+	if (ret < 0) {
+		ret = len;
+	}
+	return ret;
+}
+
+/*
+ * Stop using direct I/O on the trace file of a stream, for a write which is
+ * not aligned or refused by the file system. The rest of the file is written
+ * through the page cache.
+ */
+static void stream_clear_direct_io(struct lttng_consumer_stream *stream)
+{
+	DBG("Stream %" PRIu64 " falls back on buffered writes", stream->key);
+	(void) utils_set_fd_direct_io(stream->out_fd, 0);
+	stream->out_fd_direct = 0;
+}
+
 /*
  * Initialise the necessary environnement :
  * - create a new context
@@ -1478,6 +1669,10 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 	int outfd = stream->out_fd;
 	struct consumer_relayd_sock_pair *relayd = NULL;
 	unsigned int relayd_hang_up = 0;
+	/* Packet to write, replaced by its compressed version if any. */
+	const char *buf;
+	size_t buf_len;
+	ssize_t compressed_len = 0;
 
 	/* RCU lock for the relayd pointer */
 	rcu_read_lock();
@@ -1534,6 +1729,20 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			/* Metadata requires the control socket. */
 			pthread_mutex_lock(&relayd->ctrl_sock_mutex);
 			netlen += sizeof(struct lttcomm_relayd_metadata_payload);
+		} else if (relayd->control_sock.compression !=
+				LTTNG_COMPRESSION_NONE) {
+			compressed_len = compress_relayd_packet(relayd,
+					mmap_base + mmap_offset, len);
+			if (compressed_len < 0) {
+				ret = compressed_len;
+				goto end;
+			}
+			if (compressed_len ==
+					sizeof(struct lttcomm_relayd_compressed_hdr)) {
+				netlen += compressed_len;
+			} else {
+				netlen = compressed_len;
+			}
 		}
 
 		ret = write_relayd_stream_header(stream, netlen, padding, relayd);
@@ -1552,15 +1761,49 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 				goto write_error;
 			}
 		}
+
+		/* Send the compression header alone if the packet follows as is. */
+		if (compressed_len == sizeof(struct lttcomm_relayd_compressed_hdr)) {
+			ret = lttng_write(outfd, relayd->compress_buf, compressed_len);
+			if (ret != compressed_len) {
+				ret = ret < 0 ? -errno : -EPIPE;
+				relayd_hang_up = 1;
+				goto write_error;
+			}
+			compressed_len = 0;
+		}
+
+		if (compressed_len) {
+			buf = relayd->compress_buf;
+			buf_len = compressed_len;
+		} else {
+			buf = mmap_base + mmap_offset;
+			buf_len = len;
+		}
 	} else {
 		/* No streaming, we have to set the len with the full padding */
 		len += padding;
 
+		buf = mmap_base + mmap_offset;
+		buf_len = len;
+		/* Only packets with an index can be found in a compressed file. */
+		if (consumer_output_compression != LTTNG_COMPRESSION_NONE &&
+				index && stream->index_fd >= 0) {
+			ret = compress_stream_packet(stream, buf, len);
+			if (ret < 0) {
+				goto end;
+			}
+			if (ret < len) {
+				buf = stream->compress_buf;
+				buf_len = ret;
+			}
+		}
+
 		/*
 		 * Check if we need to change the tracefile before writing the packet.
 		 */
 		if (stream->chan->tracefile_size > 0 &&
-				(stream->tracefile_size_current + len) >
+				(stream->tracefile_size_current + buf_len) >
 				stream->chan->tracefile_size) {
 			ret = utils_rotate_stream_file(stream->chan->pathname,
 					stream->name, stream->chan->tracefile_size,
@@ -1587,21 +1830,56 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			/* Reset current size because we just perform a rotation. */
 			stream->tracefile_size_current = 0;
 			stream->out_fd_offset = 0;
+			stream->out_fd_uncompressed_offset = 0;
 			orig_offset = 0;
+			lttng_consumer_stream_direct_io(stream);
 		}
-		stream->tracefile_size_current += len;
+		stream->tracefile_size_current += buf_len;
 		if (index) {
-			index->offset = htobe64(stream->out_fd_offset);
+			index->offset = htobe64(stream->out_fd_uncompressed_offset);
+			index->compressed_offset = htobe64(stream->out_fd_offset);
+			index->compressed_size = htobe64(buf_len);
+		}
+
+		/*
+		 * A packet which is not a whole number of pages, e.g. with
+		 * sub-buffers smaller than a page or compressed, ends the direct I/O
+		 * of the file.
+		 */
+		if (stream->out_fd_direct &&
+				!utils_is_direct_io_aligned(stream->out_fd_offset, buf_len,
+					buf)) {
+			stream_clear_direct_io(stream);
 		}
 	}
 
 	/*
-	 * This call guarantee that len or less is returned. It's impossible to
-	 * receive a ret value that is bigger than len.
+	 * Local data sub-buffers are written asynchronously when possible. The
+	 * caller keeps the sub-buffer until lttng_consumer_complete_subbuffer()
+	 * is called for the stream, which also keeps its compression buffer.
 	 */
-	ret = lttng_write(outfd, mmap_base + mmap_offset, len);
-	DBG("Consumer mmap write() ret %zd (len %lu)", ret, len);
-	if (ret < 0 || ((size_t) ret != len)) {
+	if (!relayd && !stream->metadata_flag &&
+			!consumer_uring_submit_write(stream, outfd,
+				buf, buf_len, stream->out_fd_offset)) {
+		stream->aio_len = buf_len;
+		stream->out_fd_offset += buf_len;
+		stream->out_fd_uncompressed_offset += len;
+		ret = len;
+		goto end;
+	}
+
+	/*
+	 * This call guarantee that buf_len or less is returned. It's impossible
+	 * to receive a ret value that is bigger than buf_len.
+	 */
+	ret = lttng_write(outfd, buf, buf_len);
+	if (ret < 0 && errno == EINVAL && !relayd && stream->out_fd_direct) {
+		/* Direct I/O refused by the file system, use the page cache. */
+		stream_clear_direct_io(stream);
+		ret = lttng_write(outfd, buf, buf_len);
+	}
+	DBG("Consumer mmap write() ret %zd (len %zu)", ret, buf_len);
+	if (ret < 0 || ((size_t) ret != buf_len)) {
 		/*
 		 * Report error to caller if nothing was written else at least send the
 		 * amount written.
@@ -1622,20 +1900,30 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			DBG("Consumer mmap write detected relayd hang up");
 		} else {
 			/* Unhandled error, print it and stop function right now. */
-			PERROR("Error in write mmap (ret %zd != len %lu)", ret, len);
+			PERROR("Error in write mmap (ret %zd != len %zu)", ret, buf_len);
 		}
 		goto write_error;
 	}
 	stream->output_written += ret;
+	/* The caller expects the size of the packet, not of what was sent. */
+	ret = len;
 
-	/* This call is useless on a socket so better save a syscall. */
-	if (!relayd) {
+	/*
+	 * This call is useless on a socket so better save a syscall. A direct I/O
+	 * write is already on disk and left no page to evict.
+	 */
+	if (!relayd && !stream->out_fd_direct) {
 		/* This won't block, but will start writeout asynchronously */
-		lttng_sync_file_range(outfd, stream->out_fd_offset, len,
+		lttng_sync_file_range(outfd, stream->out_fd_offset, buf_len,
 				SYNC_FILE_RANGE_WRITE);
-		stream->out_fd_offset += len;
 	}
-	lttng_consumer_sync_trace_file(stream, orig_offset);
+	if (!relayd) {
+		stream->out_fd_offset += buf_len;
+		stream->out_fd_uncompressed_offset += len;
+	}
+	if (!stream->out_fd_direct) {
+		lttng_consumer_sync_trace_file(stream, orig_offset);
+	}
 
 write_error:
 	/*
@@ -1717,6 +2005,7 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 	/* Write metadata stream id before payload */
 	if (relayd) {
 		unsigned long total_len = len;
+		int send_compressed_hdr = 0;
 
 		if (stream->metadata_flag) {
 			/*
@@ -1734,6 +2023,14 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			}
 
 			total_len += sizeof(struct lttcomm_relayd_metadata_payload);
+		} else if (relayd->control_sock.compression !=
+				LTTNG_COMPRESSION_NONE) {
+			/*
+			 * Spliced packets never go through user space so they are sent
+			 * uncompressed, with the header the relayd expects.
+			 */
+			send_compressed_hdr = 1;
+			total_len += sizeof(struct lttcomm_relayd_compressed_hdr);
 		}
 
 		ret = write_relayd_stream_header(stream, total_len, padding, relayd);
@@ -1744,6 +2041,19 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 		}
 		/* Use the returned socket. */
 		outfd = ret;
+
+		if (send_compressed_hdr) {
+			struct lttcomm_relayd_compressed_hdr hdr;
+
+			hdr.compression = htobe32(LTTNG_COMPRESSION_NONE);
+			hdr.size = htobe32(len);
+			ret = lttng_write(outfd, &hdr, sizeof(hdr));
+			if (ret != sizeof(hdr)) {
+				written = ret < 0 ? -errno : -EPIPE;
+				relayd_hang_up = 1;
+				goto write_error;
+			}
+		}
 	} else {
 		/* No streaming, we have to set the len with the full padding */
 		len += padding;
@@ -1784,7 +2094,10 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			orig_offset = 0;
 		}
 		stream->tracefile_size_current += len;
+		/* Spliced packets are never compressed. */
 		index->offset = htobe64(stream->out_fd_offset);
+		index->compressed_offset = index->offset;
+		index->compressed_size = htobe64(len);
 	}
 
 	while (len > 0) {
@@ -2384,6 +2697,9 @@ void *consumer_thread_data_poll(void *data)
 		goto end;
 	}
 
+	/* Falls back on synchronous writes on error. */
+	(void) consumer_uring_init(ctx);
+
 	while (1) {
 		health_code_update();
 
@@ -2402,8 +2718,11 @@ void *consumer_thread_data_poll(void *data)
 			free(local_stream);
 			local_stream = NULL;
 
-			/* allocate for all fds + 1 for the consumer_data_pipe */
-			pollfd = zmalloc((consumer_data.stream_count + 1) * sizeof(struct pollfd));
+			/*
+			 * allocate for all fds + 1 for the consumer_data_pipe + 1 for the
+			 * asynchronous writer completions
+			 */
+			pollfd = zmalloc((consumer_data.stream_count + 2) * sizeof(struct pollfd));
 			if (pollfd == NULL) {
 				PERROR("pollfd malloc");
 				pthread_mutex_unlock(&consumer_data.lock);
@@ -2436,11 +2755,25 @@ void *consumer_thread_data_poll(void *data)
 			err = 0;	/* All is OK */
 			goto end;
 		}
+		/*
+		 * Streams with a sub-buffer being written asynchronously are not
+		 * polled until the write completes, they can't be read meanwhile.
+		 */
+		if (consumer_uring_get_fd() >= 0) {
+			for (i = 0; i < nb_fd; i++) {
+				if (local_stream[i] == NULL) {
+					continue;
+				}
+				pollfd[i].fd = local_stream[i]->aio_pending ?
+					-1 : local_stream[i]->wait_fd;
+			}
+		}
+
 		/* poll on the array of fds */
 	restart:
-		DBG("polling on %d fd", nb_fd + 1);
+		DBG("polling on %d fd", nb_fd + 2);
 		health_poll_entry();
-		num_rdy = poll(pollfd, nb_fd + 1, -1);
+		num_rdy = poll(pollfd, nb_fd + 2, -1);
 		health_poll_exit();
 		DBG("poll num_rdy : %d", num_rdy);
 		if (num_rdy == -1) {
@@ -2489,6 +2822,14 @@ void *consumer_thread_data_poll(void *data)
 			continue;
 		}
 
+		/* Release the sub-buffers of the completed writes. */
+		if (pollfd[nb_fd + 1].revents & POLLIN) {
+			ret = consumer_uring_reap(0);
+			if (ret < 0) {
+				ERR("Reaping asynchronous writes (%d)", ret);
+			}
+		}
+
 		/* Take care of high priority channels first. */
 		for (i = 0; i < nb_fd; i++) {
 			health_code_update();
@@ -2594,6 +2935,7 @@ void *consumer_thread_data_poll(void *data)
 	err = 0;
 end:
 	DBG("polling thread exiting");
+	consumer_uring_fini();
 	free(pollfd);
 	free(local_stream);
 
@@ -3138,29 +3480,119 @@ error_testpoint:
 	return NULL;
 }
 
-ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
-		struct lttng_consumer_local_data *ctx)
+/*
+ * Set the maximum number of sub-buffers read from a data stream each time it
+ * is ready. A budget of 0 is handled as 1.
+ */
+void lttng_consumer_set_read_budget(unsigned int budget)
 {
-	ssize_t ret;
+	consumer_read_budget = budget ? budget : 1;
+	DBG("Consumer read budget set to %u sub-buffers", consumer_read_budget);
+}
+
+/*
+ * Called by the asynchronous writer once the write of the current sub-buffer
+ * of a stream is done: release the sub-buffer and write its index.
+ */
+void lttng_consumer_complete_subbuffer(struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream)
+{
+	int write_index;
 
 	pthread_mutex_lock(&stream->lock);
-	if (stream->metadata_flag) {
-		pthread_mutex_lock(&stream->metadata_rdv_lock);
+	assert(stream->aio_pending);
+
+	write_index = stream->aio_write_index;
+	if (stream->aio_result < 0 || stream->aio_result != stream->aio_len) {
+		/* Same handling as a failed synchronous write. */
+		DBG("Error writing to tracefile (ret: %d != len: %lu)",
+				stream->aio_result, stream->aio_len);
+		write_index = 0;
+	} else {
+		stream->output_written += stream->aio_len;
+		consumer_stats_written(stream, stream->aio_len, stream->ready_ts);
 	}
+	stream->aio_pending = 0;
 
 	switch (consumer_data.type) {
 	case LTTNG_CONSUMER_KERNEL:
-		ret = lttng_kconsumer_read_subbuffer(stream, ctx);
+		(void) lttng_kconsumer_put_subbuffer(stream, ctx,
+				write_index ? &stream->aio_index : NULL);
 		break;
 	case LTTNG_CONSUMER32_UST:
 	case LTTNG_CONSUMER64_UST:
-		ret = lttng_ustconsumer_read_subbuffer(stream, ctx);
+		(void) lttng_ustconsumer_put_subbuffer(stream, ctx,
+				write_index ? &stream->aio_index : NULL);
 		break;
 	default:
 		ERR("Unknown consumer_data type");
 		assert(0);
-		ret = -ENOSYS;
-		break;
+	}
+	pthread_mutex_unlock(&stream->lock);
+}
+
+ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx)
+{
+	ssize_t ret, total = 0;
+	unsigned int budget;
+
+	pthread_mutex_lock(&stream->lock);
+	if (stream->aio_pending) {
+		/* The current sub-buffer is still being written. */
+		pthread_mutex_unlock(&stream->lock);
+		return -EAGAIN;
+	}
+	if (stream->metadata_flag) {
+		pthread_mutex_lock(&stream->metadata_rdv_lock);
+	}
+
+	/*
+	 * Drain the sub-buffers already available in a data stream rather than
+	 * going back to poll() for each of them. The budget bounds the time
+	 * spent on a single busy stream. Metadata is read a packet at a time.
+	 */
+	budget = stream->metadata_flag ? 1 : consumer_read_budget;
+	stream->ready_ts = utils_get_monotonic_ns();
+	do {
+		uint64_t written = stream->output_written;
+
+		switch (consumer_data.type) {
+		case LTTNG_CONSUMER_KERNEL:
+			ret = lttng_kconsumer_read_subbuffer(stream, ctx);
+			break;
+		case LTTNG_CONSUMER32_UST:
+		case LTTNG_CONSUMER64_UST:
+			ret = lttng_ustconsumer_read_subbuffer(stream, ctx);
+			break;
+		default:
+			ERR("Unknown consumer_data type");
+			assert(0);
+			ret = -ENOSYS;
+			break;
+		}
+		if (ret <= 0) {
+			/*
+			 * No more sub-buffer (or an error, reported on the next
+			 * read if some data was consumed).
+			 */
+			break;
+		}
+		total += ret;
+		consumer_stats_consumed(stream, ret, stream->ready_ts);
+		if (stream->aio_pending) {
+			/*
+			 * The next sub-buffer can't be taken before this one is put. Its
+			 * write is accounted once completed.
+			 */
+			break;
+		}
+		consumer_stats_written(stream, stream->output_written - written,
+				stream->ready_ts);
+	} while (--budget > 0);
+
+	if (total > 0) {
+		ret = total;
 	}
 
 	if (stream->metadata_flag) {
@@ -3338,6 +3770,7 @@ int consumer_add_relayd_socket(uint64_t net_seq_idx, int sock_type,
 		/* Assign version values. */
 		relayd->control_sock.major = relayd_sock->major;
 		relayd->control_sock.minor = relayd_sock->minor;
+		relayd->control_sock.compression = relayd_sock->compression;
 
 		relayd->relayd_session_id = relayd_session_id;
 
@@ -58,6 +58,8 @@ enum lttng_consumer_command {
 	LTTNG_CONSUMER_SNAPSHOT_CHANNEL,
 	LTTNG_CONSUMER_SNAPSHOT_METADATA,
 	LTTNG_CONSUMER_STREAMS_SENT,
+	/* Return the per-stream and per-channel stats of a session. */
+	LTTNG_CONSUMER_STREAM_STATS,
 };
 
 /* State of each fd in consumer */
@@ -99,6 +101,25 @@ struct stream_list {
 /* Stub. */
 struct consumer_metadata_cache;
 
+/*
+ * Consumption statistics of a stream or channel, see consumer-stats.h.
+ */
+struct consumer_stats {
+	/* Monotonic time of the first sub-buffer consumed, 0 if none. */
+	uint64_t first_ts;
+	uint64_t subbuf_count;
+	uint64_t bytes_consumed;
+	uint64_t bytes_written;
+	uint64_t events_discarded;
+	/* Data sub-buffers read with their index and sum of their fill ratio. */
+	uint64_t packet_count;
+	uint64_t fill_total;	/* per mille */
+	/* Write latencies, in nsec. */
+	uint64_t latency_total;
+	uint64_t latency_max;
+	uint64_t latency_hist[LTTNG_STREAM_STATS_LATENCY_BUCKETS];
+};
+
 struct lttng_consumer_channel {
 	/* HT node used for consumer_data.channel_ht */
 	struct lttng_ht_node_u64 node;
@@ -206,6 +227,12 @@ struct lttng_consumer_channel {
 
 	/* Timer value in usec for live streaming. */
 	unsigned int live_timer_interval;
+
+	/*
+	 * Totals of the deleted streams of the channel. Updated with the channel
+	 * lock held.
+	 */
+	struct consumer_stats stats;
 };
 
 /*
@@ -231,6 +258,16 @@ struct lttng_consumer_stream {
 	int out_fd; /* output file to write the data */
 	/* Write position in the output file descriptor */
 	off_t out_fd_offset;
+	/* Set if out_fd is a local trace file opened for direct I/O. */
+	int out_fd_direct;
+	/*
+	 * Offset of the next packet in the local trace file once expanded, which
+	 * differs from out_fd_offset when packets are compressed. The packets
+	 * are compressed in compress_buf.
+	 */
+	uint64_t out_fd_uncompressed_offset;
+	void *compress_buf;
+	size_t compress_buf_size;
 	/* Amount of bytes written to the output */
 	uint64_t output_written;
 	enum lttng_consumer_stream_state state;
@@ -241,6 +278,17 @@ struct lttng_consumer_stream {
 	/* Maximum subbuffer size. */
 	unsigned long max_sb_size;
 
+	/*
+	 * Asynchronous write of the current sub-buffer to the tracefile. While
+	 * pending, the sub-buffer is held by the stream which is not read until
+	 * the write completes. Only used by the data thread.
+	 */
+	unsigned int aio_pending;
+	unsigned long aio_len;
+	int aio_result;
+	int aio_write_index;
+	struct ctf_packet_index aio_index;
+
 	/*
 	 * Still used by the kernel for MMAP output. For UST, the ustctl getter is
 	 * used for the mmap base and offset.
@@ -341,6 +389,19 @@ struct lttng_consumer_stream {
 	 */
 	pthread_cond_t metadata_rdv;
 	pthread_mutex_t metadata_rdv_lock;
+
+	struct consumer_stats stats;
+	/*
+	 * Time at which the consumer woke up to read the stream, kept for the
+	 * latency of a sub-buffer written asynchronously.
+	 */
+	uint64_t ready_ts;
+	/*
+	 * Stats at the time of the last discard report sent to the session
+	 * daemon, see consumer_stats_discard_report().
+	 */
+	struct consumer_stats report_stats;
+	uint64_t report_ts;
 };
 
 /*
@@ -381,6 +442,13 @@ struct consumer_relayd_sock_pair {
 	struct lttcomm_relayd_sock data_sock;
 	struct lttng_ht_node_u64 node;
 
+	/*
+	 * Packets of a compressed session are compressed in this buffer before
+	 * being sent on the data socket. Only used by the data thread.
+	 */
+	void *compress_buf;
+	size_t compress_buf_size;
+
 	/* Session id on both sides for the sockets. */
 	uint64_t relayd_session_id;
 	uint64_t sessiond_session_id;
@@ -533,6 +601,8 @@ void lttng_consumer_set_command_sock_path(
  * on error.
  */
 int lttng_consumer_send_error(struct lttng_consumer_local_data *ctx, int cmd);
+int lttng_consumer_send_discard_report(struct lttng_consumer_local_data *ctx,
+		const struct lttcomm_consumer_discard_report *report);
 
 /*
  * Called from signal handler to ensure a clean exit.
@@ -631,6 +701,12 @@ void *consumer_thread_channel_poll(void *data);
 int lttng_consumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		int sock, struct pollfd *consumer_sockpoll);
 
+void lttng_consumer_set_read_budget(unsigned int budget);
+void lttng_consumer_set_direct_io(int enable);
+void lttng_consumer_stream_direct_io(struct lttng_consumer_stream *stream);
+void lttng_consumer_set_output_compression(enum lttng_compression compression);
+void lttng_consumer_complete_subbuffer(struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream);
 ssize_t lttng_consumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		struct lttng_consumer_local_data *ctx);
 int lttng_consumer_on_recv_stream(struct lttng_consumer_stream *stream);
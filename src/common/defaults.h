@@ -108,6 +108,10 @@
 #define DEFAULT_GLOBAL_RELAY_HEALTH_UNIX_SOCK		DEFAULT_LTTNG_RUNDIR "/relayd/health-%d"
 #define DEFAULT_HOME_RELAY_HEALTH_UNIX_SOCK		DEFAULT_LTTNG_HOME_RUNDIR "/relayd/health-%d"
 
+/* Default relay statistics unix socket path */
+#define DEFAULT_GLOBAL_RELAY_STATS_UNIX_SOCK		DEFAULT_LTTNG_RUNDIR "/relayd/stats-%d"
+#define DEFAULT_HOME_RELAY_STATS_UNIX_SOCK		DEFAULT_LTTNG_HOME_RUNDIR "/relayd/stats-%d"
+
 /* Default daemon configuration file path */
 #define DEFAULT_SYSTEM_CONFIGPATH               CONFIG_LTTNG_SYSTEM_CONFIGDIR \
 	"/lttng"
@@ -204,6 +208,7 @@
 /* Must be a power of 2. Update help manuall if override. */
 #define DEFAULT_UST_PID_CHANNEL_SUBBUF_NUM		_DEFAULT_CHANNEL_SUBBUF_NUM
 #define DEFAULT_UST_UID_CHANNEL_SUBBUF_NUM		_DEFAULT_CHANNEL_SUBBUF_NUM
+
 /* See lttng-ust.h enum lttng_ust_output */
 #define DEFAULT_UST_PID_CHANNEL_OUTPUT			_DEFAULT_CHANNEL_OUTPUT
 #define DEFAULT_UST_UID_CHANNEL_OUTPUT			_DEFAULT_CHANNEL_OUTPUT
@@ -216,6 +221,12 @@
 #define DEFAULT_UST_PID_CHANNEL_READ_TIMER      0  /* usec */
 #define DEFAULT_UST_UID_CHANNEL_READ_TIMER      0  /* usec */
 
+/*
+ * Largest buffer, sub-buffer size times their number, recommended for a
+ * channel discarding events.
+ */
+#define DEFAULT_BUFFER_ADVICE_MAX_SIZE          67108864  /* bytes */
+
 /*
  * Default timeout value for the sem_timedwait() call. Blocking forever is not
  * wanted so a timeout is used to control the data flow and not freeze the
@@ -234,6 +245,19 @@
 #define DEFAULT_NETWORK_DATA_PORT           5343
 #define DEFAULT_NETWORK_VIEWER_PORT         5344
 
+/*
+ * Default memory budget, in bytes, of the in-memory cache of recent indexes
+ * kept by the relayd for each stream of a live session.
+ */
+#define DEFAULT_RELAYD_LIVE_INDEX_CACHE_SIZE	65536
+
+/*
+ * Default share, in percent of RLIMIT_NOFILE, of the files the relayd keeps
+ * open for the streams, indexes and viewers. Other files are closed and
+ * reopened on demand.
+ */
+#define DEFAULT_RELAYD_FD_CAP_THRESHOLD		75
+
 /* JUL registration TCP port. */
 #define DEFAULT_JUL_TCP_PORT                5345
 
@@ -256,6 +280,37 @@
  */
 #define DEFAULT_METADATA_AVAILABILITY_WAIT_TIME 200000  /* usec */
 
+/*
+ * Periodic metadata requests from the consumer are answered with no data
+ * while the metadata of a UST session keeps being appended (registration
+ * burst), so it is pushed in one transfer once the burst ends. A request is
+ * never deferred for more than the maximum delay. Setting the delay to 0
+ * through the environment variable disables it.
+ */
+#define DEFAULT_METADATA_PUSH_DELAY         100000  /* usec */
+#define DEFAULT_METADATA_PUSH_MAX_DELAY     1000000 /* usec */
+#define DEFAULT_METADATA_PUSH_DELAY_ENV     "LTTNG_METADATA_PUSH_DELAY"
+
+/*
+ * Maximum number of sub-buffers the consumer daemon drains from a data stream
+ * each time it is found ready, before serving the other streams. Can be
+ * overridden through the environment variable (minimum 1).
+ */
+#define DEFAULT_CONSUMER_READ_BUDGET        16
+#define DEFAULT_CONSUMER_READ_BUDGET_ENV    "LTTNG_CONSUMERD_READ_BUDGET"
+
+/*
+ * Number of local sub-buffer writes the consumer daemons keep in flight with
+ * io_uring. Disabled (0) by default.
+ */
+#define DEFAULT_CONSUMER_IO_URING_DEPTH_ENV "LTTNG_CONSUMERD_IO_URING"
+
+/* Write the local trace files of the consumer daemons with O_DIRECT. */
+#define DEFAULT_CONSUMER_DIRECT_IO_ENV      "LTTNG_CONSUMERD_DIRECT_IO"
+
+/* Compress the packets of the local trace files of the consumer daemons. */
+#define DEFAULT_CONSUMER_COMPRESS_OUTPUT_ENV "LTTNG_CONSUMERD_COMPRESS_OUTPUT"
+
 /*
  * The usual value for the maximum TCP SYN retries time and TCP FIN timeout is
  * 180 and 60 seconds on most Linux system and the default value since kernel
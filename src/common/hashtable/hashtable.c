@@ -77,9 +77,9 @@ static int match_two_u64(struct cds_lfht_node *node, const void *key)
 }
 
 /*
- * Return an allocated lttng hashtable.
+ * Allocate a lttng hashtable with the given rculfhash flags.
  */
-struct lttng_ht *lttng_ht_new(unsigned long size, int type)
+static struct lttng_ht *ht_new(unsigned long size, int type, int flags)
 {
 	struct lttng_ht *ht;
 
@@ -94,7 +94,7 @@ struct lttng_ht *lttng_ht_new(unsigned long size, int type)
 	}
 
 	ht->ht = cds_lfht_new(size, min_hash_alloc_size, max_hash_buckets_size,
-			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+			flags, NULL);
 	/*
 	 * There is already an assert in the RCU hashtable code so if the ht is
 	 * NULL here there is a *huge* problem.
@@ -132,6 +132,25 @@ error:
 	return NULL;
 }
 
+/*
+ * Return an allocated lttng hashtable.
+ */
+struct lttng_ht *lttng_ht_new(unsigned long size, int type)
+{
+	return ht_new(size, type, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING);
+}
+
+/*
+ * Return an allocated lttng hashtable meant to hold a few nodes, typically
+ * one per tracing application object. No per-CPU node accounting is
+ * allocated for it so the table only grows with the bucket chain length and
+ * is never shrunk.
+ */
+struct lttng_ht *lttng_ht_new_small(int type)
+{
+	return ht_new(DEFAULT_HT_SIZE, type, CDS_LFHT_AUTO_RESIZE);
+}
+
 /*
  * Free a lttng hashtable.
  */
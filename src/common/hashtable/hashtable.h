@@ -77,6 +77,7 @@ struct lttng_ht_node_two_u64 {
 
 /* Hashtable new and destroy */
 extern struct lttng_ht *lttng_ht_new(unsigned long size, int type);
+extern struct lttng_ht *lttng_ht_new_small(int type);
 extern void lttng_ht_destroy(struct lttng_ht *ht);
 
 /* Specialized node init and free functions */
@@ -447,22 +447,41 @@ static uint32_t __attribute__((unused)) hashlittle(const void *key,
 	return c;
 }
 
+/*
+ * Finalization mixers of MurmurHash3 (Austin Appleby, public domain). They
+ * are bijective and every bit of the input affects every bit of the output,
+ * which is all the lock-free hash table needs for fixed-size integer keys,
+ * at a fraction of the cost of running hashword() on them.
+ */
+static inline uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+
+	return k;
+}
+
+static inline uint32_t __attribute__((unused)) fmix32(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/*
+ * Hash function for uint64_t value.
+ */
 LTTNG_HIDDEN
 unsigned long hash_key_u64(void *_key, unsigned long seed)
 {
-	union {
-		uint64_t v64;
-		uint32_t v32[2];
-	} v;
-	union {
-		uint64_t v64;
-		uint32_t v32[2];
-	} key;
-
-	v.v64 = (uint64_t) seed;
-	key.v64 = *(uint64_t *) _key;
-	hashword2(key.v32, 2, &v.v32[0], &v.v32[1]);
-	return v.v64;
+	return (unsigned long) fmix64(*(uint64_t *) _key ^ (uint64_t) seed);
 }
 
 #if (CAA_BITS_PER_LONG == 64)
@@ -484,7 +503,7 @@ unsigned long hash_key_ulong(void *_key, unsigned long seed)
 {
 	uint32_t key = (uint32_t) _key;
 
-	return hashword(&key, 1, seed);
+	return fmix32(key ^ (uint32_t) seed);
 }
 #endif /* CAA_BITS_PER_LONG */
 
@@ -505,7 +524,11 @@ unsigned long hash_key_two_u64(void *key, unsigned long seed)
 {
 	struct lttng_ht_two_u64 *k = (struct lttng_ht_two_u64 *) key;
 
-	return hash_key_u64(&k->key1, seed) ^ hash_key_u64(&k->key2, seed);
+	/*
+	 * Chain the two keys instead of xoring two independent hashes so that
+	 * (a, b) and (b, a) do not collide and (a, a) does not hash to 0.
+	 */
+	return (unsigned long) fmix64(fmix64(k->key1 ^ (uint64_t) seed) ^ k->key2);
 }
 
 /*
@@ -29,7 +29,7 @@
 
 #define CTF_INDEX_MAGIC 0xC1F1DCC1
 #define CTF_INDEX_MAJOR 1
-#define CTF_INDEX_MINOR 0
+#define CTF_INDEX_MINOR 1
 
 /*
  * Header at the beginning of each index file.
@@ -46,6 +46,15 @@ struct ctf_packet_index_file_hdr {
 /*
  * Packet index generated for each trace packet store in a trace file.
  * All integer fields are stored in big endian.
+ *
+ * Since version 1.1, the packets of a trace file can be stored compressed,
+ * each one as an independent LZ4 block. The offset is then the one the packet
+ * has once the file is expanded back to plain CTF, and the packet is found at
+ * compressed_offset in the file. A packet is compressed if its compressed_size
+ * is smaller than its packet size, it is stored as is otherwise. A compressed
+ * packet expands to at most its packet size, the rest being zero padding. In
+ * a plain trace file, compressed_offset is equal to offset and compressed_size
+ * to the packet size.
  */
 struct ctf_packet_index {
 	uint64_t offset;		/* offset of the packet in the file, in bytes */
@@ -55,6 +64,9 @@ struct ctf_packet_index {
 	uint64_t timestamp_end;
 	uint64_t events_discarded;
 	uint64_t stream_id;
+	/* Since 1.1 */
+	uint64_t compressed_offset;	/* offset of the stored packet, in bytes */
+	uint64_t compressed_size;	/* size of the stored packet, in bytes */
 } __attribute__((__packed__));
 
 #endif /* LTTNG_INDEX_H */
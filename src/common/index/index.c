@@ -18,11 +18,14 @@
 
 #define _GNU_SOURCE
 #include <assert.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <common/common.h>
+#include <common/compress/compress.h>
 #include <common/defaults.h>
 #include <common/utils.h>
 
@@ -188,3 +191,297 @@ error_close:
 error:
 	return ret;
 }
+
+/*
+ * Return 1 if the packet of an index is stored compressed or elsewhere than
+ * at its offset, else 0.
+ */
+int index_is_stored(const struct ctf_packet_index *index)
+{
+	return index->compressed_offset != index->offset ||
+		be64toh(index->compressed_size) * CHAR_BIT <
+			be64toh(index->packet_size);
+}
+
+/*
+ * Read the packet of an index from its trace file, expanding it if it is
+ * stored compressed. The packet buffer must hold the packet size of the index.
+ *
+ * Return the packet size on success or else a negative value.
+ */
+ssize_t index_read_packet(int fd, const struct ctf_packet_index *index,
+		char *packet)
+{
+	ssize_t ret;
+	char *stored;
+	uint64_t size = be64toh(index->packet_size) / CHAR_BIT;
+	uint64_t stored_offset = be64toh(index->compressed_offset);
+	uint64_t stored_size = be64toh(index->compressed_size);
+
+	if (stored_size > size) {
+		ERR("Invalid stored size of the packet at offset %" PRIu64,
+				stored_offset);
+		return -EINVAL;
+	}
+
+	stored = stored_size < size ? zmalloc(stored_size) : packet;
+	if (!stored) {
+		PERROR("zmalloc stored packet");
+		return -ENOMEM;
+	}
+	do {
+		ret = pread(fd, stored, stored_size, stored_offset);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < (ssize_t) stored_size) {
+		/* The trace file may be truncated while being read live. */
+		ret = -1;
+		goto end;
+	}
+
+	if (stored != packet) {
+		/* The padding of a compressed packet is zeroes. */
+		memset(packet, 0, size);
+		ret = decompress_buffer(LTTNG_COMPRESSION_LZ4, stored, stored_size,
+				packet, size);
+		if (ret < 0) {
+			ERR("Decompressing packet at offset %" PRIu64, stored_offset);
+			goto end;
+		}
+	}
+	ret = size;
+
+end:
+	if (stored != packet) {
+		free(stored);
+	}
+	return ret;
+}
+
+/*
+ * Write the packets of a trace file at their expanded offset in a new file,
+ * and their indexes, now pointing to the expanded packets, in a new index
+ * file.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int write_expanded_file(const char *trace_path, const char *out_path,
+		int out_index_fd, char *records, uint32_t record_len,
+		uint64_t nr_records)
+{
+	int ret, trace_fd, out_fd = -1;
+	ssize_t size_ret;
+	uint64_t i;
+	char *packet = NULL;
+	size_t packet_len = 0;
+
+	trace_fd = open(trace_path, O_RDONLY);
+	if (trace_fd < 0) {
+		PERROR("open %s", trace_path);
+		ret = -1;
+		goto end;
+	}
+	out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	if (out_fd < 0) {
+		PERROR("open %s", out_path);
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < nr_records; i++) {
+		struct ctf_packet_index index;
+		uint64_t offset, size;
+
+		memcpy(&index, records + i * record_len, sizeof(index));
+		offset = be64toh(index.offset);
+		size = be64toh(index.packet_size) / CHAR_BIT;
+
+		if (size > packet_len) {
+			free(packet);
+			packet = zmalloc(size);
+			if (!packet) {
+				PERROR("zmalloc packet");
+				ret = -1;
+				goto end;
+			}
+			packet_len = size;
+		}
+
+		size_ret = index_read_packet(trace_fd, &index, packet);
+		if (size_ret < 0) {
+			ERR("Unable to read a packet of %s", trace_path);
+			ret = -1;
+			goto end;
+		}
+
+		size_ret = pwrite(out_fd, packet, size, offset);
+		if (size_ret < (ssize_t) size) {
+			PERROR("write %s", out_path);
+			ret = -1;
+			goto end;
+		}
+
+		index.compressed_offset = index.offset;
+		index.compressed_size = htobe64(size);
+		memcpy(records + i * record_len, &index, sizeof(index));
+	}
+
+	size_ret = lttng_write(out_index_fd, records, nr_records * record_len);
+	if (size_ret < (ssize_t) (nr_records * record_len)) {
+		PERROR("write expanded index");
+		ret = -1;
+		goto end;
+	}
+	ret = fsync(out_fd);
+	if (ret < 0) {
+		PERROR("fsync %s", out_path);
+	}
+
+end:
+	free(packet);
+	if (out_fd >= 0 && close(out_fd)) {
+		PERROR("close");
+	}
+	if (trace_fd >= 0 && close(trace_fd)) {
+		PERROR("close");
+	}
+	return ret;
+}
+
+/*
+ * Expand a trace file back to plain CTF, in place, given its index file.
+ * Files of an index version without compression or without any stored packet
+ * are left untouched. A partially written last index entry is dropped.
+ *
+ * Return 1 if the file was expanded, 0 if it was left as is, or a negative
+ * value on error.
+ */
+int index_expand_trace_file(const char *index_path, const char *trace_path)
+{
+	int ret, index_fd, out_index_fd = -1, stored = 0;
+	ssize_t size_ret;
+	uint32_t record_len;
+	uint64_t i, nr_records;
+	char *records = NULL;
+	char out_path[PATH_MAX], out_index_path[PATH_MAX];
+	struct ctf_packet_index_file_hdr hdr;
+	struct stat st;
+
+	index_fd = open(index_path, O_RDONLY);
+	if (index_fd < 0) {
+		PERROR("open %s", index_path);
+		ret = -1;
+		goto end;
+	}
+	size_ret = lttng_read(index_fd, &hdr, sizeof(hdr));
+	if (size_ret < (ssize_t) sizeof(hdr) ||
+			be32toh(hdr.magic) != CTF_INDEX_MAGIC ||
+			be32toh(hdr.index_major) != CTF_INDEX_MAJOR) {
+		ERR("Invalid index file %s", index_path);
+		ret = -1;
+		goto end;
+	}
+	if (be32toh(hdr.index_minor) < 1) {
+		ret = 0;
+		goto end;
+	}
+	record_len = be32toh(hdr.packet_index_len);
+	if (record_len < sizeof(struct ctf_packet_index)) {
+		ERR("Invalid index entry size in %s", index_path);
+		ret = -1;
+		goto end;
+	}
+
+	ret = fstat(index_fd, &st);
+	if (ret < 0) {
+		PERROR("fstat %s", index_path);
+		goto end;
+	}
+	/* A partially written last index is ignored. */
+	nr_records = (st.st_size - sizeof(hdr)) / record_len;
+	records = zmalloc(nr_records * record_len + 1);
+	if (!records) {
+		PERROR("zmalloc index entries");
+		ret = -1;
+		goto end;
+	}
+	size_ret = lttng_read(index_fd, records, nr_records * record_len);
+	if (size_ret < (ssize_t) (nr_records * record_len)) {
+		PERROR("read %s", index_path);
+		ret = -1;
+		goto end;
+	}
+	for (i = 0; i < nr_records && !stored; i++) {
+		stored = index_is_stored((struct ctf_packet_index *)
+				(records + i * record_len));
+	}
+	if (!stored) {
+		ret = 0;
+		goto end;
+	}
+
+	ret = snprintf(out_path, sizeof(out_path), "%s.expand", trace_path);
+	if (ret < 0 || ret >= sizeof(out_path)) {
+		ERR("Trace file path too long: %s", trace_path);
+		ret = -1;
+		goto end;
+	}
+	ret = snprintf(out_index_path, sizeof(out_index_path), "%s.expand",
+			index_path);
+	if (ret < 0 || ret >= sizeof(out_index_path)) {
+		ERR("Index file path too long: %s", index_path);
+		ret = -1;
+		goto end;
+	}
+	out_index_fd = open(out_index_path, O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	if (out_index_fd < 0) {
+		PERROR("open %s", out_index_path);
+		ret = -1;
+		goto end;
+	}
+	size_ret = lttng_write(out_index_fd, &hdr, sizeof(hdr));
+	if (size_ret < (ssize_t) sizeof(hdr)) {
+		PERROR("write %s", out_index_path);
+		ret = -1;
+		goto error_unlink;
+	}
+
+	ret = write_expanded_file(trace_path, out_path, out_index_fd, records,
+			record_len, nr_records);
+	if (ret < 0) {
+		goto error_unlink;
+	}
+
+	/*
+	 * The trace file is replaced first so that, if interrupted before the
+	 * index is, the index still flags packets as stored and the next run
+	 * fails on them instead of silently leaving a file viewers misread.
+	 */
+	ret = rename(out_path, trace_path);
+	if (ret < 0) {
+		PERROR("rename %s", out_path);
+		goto error_unlink;
+	}
+	ret = rename(out_index_path, index_path);
+	if (ret < 0) {
+		PERROR("rename %s", out_index_path);
+		goto error_unlink;
+	}
+	DBG("Expanded %s (%" PRIu64 " packets)", trace_path, nr_records);
+	ret = 1;
+	goto end;
+
+error_unlink:
+	(void) unlink(out_path);
+	(void) unlink(out_index_path);
+end:
+	if (out_index_fd >= 0 && close(out_index_fd)) {
+		PERROR("close");
+	}
+	if (index_fd >= 0 && close(index_fd)) {
+		PERROR("close");
+	}
+	free(records);
+	return ret;
+}
@@ -20,6 +20,7 @@
 #define _INDEX_H
 
 #include <inttypes.h>
+#include <sys/types.h>
 
 #include "ctf-index.h"
 
@@ -28,5 +29,9 @@ int index_create_file(char *path_name, char *stream_name, int uid, int gid,
 ssize_t index_write(int fd, struct ctf_packet_index *index, size_t len);
 int index_open(const char *path_name, const char *channel_name,
 		uint64_t tracefile_count, uint64_t tracefile_count_current);
+int index_is_stored(const struct ctf_packet_index *index);
+ssize_t index_read_packet(int fd, const struct ctf_packet_index *index,
+		char *packet);
+int index_expand_trace_file(const char *index_path, const char *trace_path);
 
 #endif /* _INDEX_H */
@@ -38,6 +38,7 @@
 #include <common/pipe.h>
 #include <common/relayd/relayd.h>
 #include <common/utils.h>
+#include <common/consumer-stats.h>
 #include <common/consumer-stream.h>
 #include <common/index/index.h>
 #include <common/consumer-timer.h>
@@ -172,6 +173,7 @@ int lttng_kconsumer_snapshot_channel(uint64_t key, char *path,
 
 			stream->out_fd = ret;
 			stream->tracefile_size_current = 0;
+			lttng_consumer_stream_direct_io(stream);
 
 			DBG("Kernel consumer snapshot stream %s/%s (%" PRIu64 ")",
 					path, stream->name, stream->key);
@@ -866,6 +868,20 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		 */
 		break;
 	}
+	case LTTNG_CONSUMER_STREAM_STATS:
+	{
+		int ret;
+
+		health_code_update();
+
+		/* The stats reply is the response, no status message. */
+		ret = consumer_stats_send(sock, msg.u.stream_stats.session_id);
+		if (ret < 0) {
+			PERROR("send stream stats");
+			goto error_fatal;
+		}
+		break;
+	}
 	case LTTNG_CONSUMER_SNAPSHOT_CHANNEL:
 	{
 		if (msg.u.snapshot_channel.metadata == 1) {
@@ -1061,6 +1077,7 @@ ssize_t lttng_kconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 	ssize_t ret = 0;
 	int infd = stream->wait_fd;
 	struct ctf_packet_index index;
+	struct lttcomm_consumer_discard_report report;
 
 	DBG("In read_subbuffer (infd : %d)", infd);
 
@@ -1092,6 +1109,10 @@ ssize_t lttng_kconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		if (ret < 0) {
 			goto end;
 		}
+		consumer_stats_packet(stream, &index);
+		if (consumer_stats_discard_report(stream, &report)) {
+			(void) lttng_consumer_send_discard_report(ctx, &report);
+		}
 	} else {
 		write_index = 0;
 	}
@@ -1163,8 +1184,41 @@ ssize_t lttng_kconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		ret = -EPERM;
 	}
 
-	err = kernctl_put_next_subbuf(infd);
-	if (err != 0) {
+	if (stream->aio_pending) {
+		/* Released by lttng_consumer_complete_subbuffer(). */
+		stream->aio_index = index;
+		stream->aio_write_index = write_index;
+		goto end;
+	}
+
+	err = lttng_kconsumer_put_subbuffer(stream, ctx,
+			write_index ? &index : NULL);
+	if (err < 0) {
+		ret = err;
+	}
+
+end:
+	return ret;
+}
+
+/*
+ * Release the current sub-buffer of a stream and write its index if one is
+ * given. Only the release can fail, a failure to write the index is logged
+ * but otherwise ignored.
+ *
+ * Stream lock MUST be acquired.
+ */
+int lttng_kconsumer_put_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx,
+		struct ctf_packet_index *index)
+{
+	int ret;
+
+	assert(stream);
+	assert(ctx);
+
+	ret = kernctl_put_next_subbuf(stream->wait_fd);
+	if (ret != 0) {
 		if (errno == EFAULT) {
 			perror("Error in unreserving sub buffer\n");
 		} else if (errno == EIO) {
@@ -1176,7 +1230,7 @@ ssize_t lttng_kconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 	}
 
 	/* Write index if needed. */
-	if (!write_index) {
+	if (!index) {
 		goto end;
 	}
 
@@ -1184,16 +1238,12 @@ ssize_t lttng_kconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		/*
 		 * In live, block until all the metadata is sent.
 		 */
-		err = consumer_stream_sync_metadata(ctx, stream->session_id);
-		if (err < 0) {
+		if (consumer_stream_sync_metadata(ctx, stream->session_id) < 0) {
 			goto end;
 		}
 	}
 
-	err = consumer_stream_write_index(stream, &index);
-	if (err < 0) {
-		goto end;
-	}
+	(void) consumer_stream_write_index(stream, index);
 
 end:
 	return ret;
@@ -1218,6 +1268,7 @@ int lttng_kconsumer_on_recv_stream(struct lttng_consumer_stream *stream)
 		}
 		stream->out_fd = ret;
 		stream->tracefile_size_current = 0;
+		lttng_consumer_stream_direct_io(stream);
 
 		if (!stream->metadata_flag) {
 			ret = index_create_file(stream->chan->pathname,
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <unistd.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+
+#include <common/error.h>
+
+#include "metadata-shm.h"
+
+/*
+ * Grow the shared memory file so it can hold new_alloc_len bytes of metadata
+ * and map it in place of the current mapping of old_alloc_len bytes. The file
+ * is extended with zeroes. The consumer keeps its own mapping and remaps once
+ * the published length goes beyond it.
+ *
+ * Return the new mapping, or NULL on error, in which case the current mapping
+ * is left untouched.
+ */
+struct lttng_metadata_shm *lttng_metadata_shm_grow(int fd,
+		struct lttng_metadata_shm *shm, size_t old_alloc_len,
+		size_t new_alloc_len)
+{
+	int ret;
+	struct lttng_metadata_shm *new_shm;
+	size_t old_map_len = LTTNG_METADATA_SHM_HEADER_LEN + old_alloc_len;
+	size_t new_map_len = LTTNG_METADATA_SHM_HEADER_LEN + new_alloc_len;
+
+	if (new_alloc_len > LTTNG_METADATA_SHM_MAX_LEN) {
+		ERR("Metadata shm of %zu bytes is too large", new_alloc_len);
+		return NULL;
+	}
+
+	ret = ftruncate(fd, new_map_len);
+	if (ret < 0) {
+		PERROR("ftruncate metadata shm");
+		return NULL;
+	}
+	new_shm = mmap(NULL, new_map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+	if (new_shm == MAP_FAILED) {
+		PERROR("mmap metadata shm");
+		return NULL;
+	}
+	ret = munmap(shm, old_map_len);
+	if (ret) {
+		PERROR("munmap metadata shm");
+	}
+	return new_shm;
+}
+
+/*
+ * Make the first len bytes of metadata readable by the consumer. They must
+ * not be modified afterwards.
+ */
+void lttng_metadata_shm_publish(struct lttng_metadata_shm *shm, uint64_t len)
+{
+	/* Write the metadata before its length. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(shm->published_len, len);
+}
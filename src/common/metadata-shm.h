@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LTTNG_METADATA_SHM_H
+#define LTTNG_METADATA_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of the header preceding the metadata in the shared memory file. */
+#define LTTNG_METADATA_SHM_HEADER_LEN	64
+
+/* Largest amount of metadata, and of metadata allocation, of a session. */
+#define LTTNG_METADATA_SHM_MAX_LEN	(UINT32_MAX >> 1)
+
+/*
+ * Layout of the shared memory file holding the metadata of a UST session
+ * registry. The session daemon generates the metadata directly in the data
+ * area and passes the file descriptor to the consumer along with the metadata
+ * channel creation.
+ *
+ * The session daemon is the only writer. Once a complete metadata fragment is
+ * written, it publishes the new length with a store-release; the bytes below
+ * the published length are never modified afterwards. The consumer reads the
+ * length with a load-acquire and copies whatever it has not seen yet, growing
+ * its mapping up to the file size when the published length goes beyond it.
+ * The session daemon never reserves more than LTTNG_METADATA_SHM_MAX_LEN bytes
+ * so a 32-bit consumer can load the length without tearing, and the consumer
+ * rejects any published length beyond it.
+ */
+struct lttng_metadata_shm {
+	uint64_t published_len;
+	char padding[LTTNG_METADATA_SHM_HEADER_LEN - sizeof(uint64_t)];
+	char data[];
+};
+
+struct lttng_metadata_shm *lttng_metadata_shm_grow(int fd,
+		struct lttng_metadata_shm *shm, size_t old_alloc_len,
+		size_t new_alloc_len);
+void lttng_metadata_shm_publish(struct lttng_metadata_shm *shm, uint64_t len);
+
+#endif /* LTTNG_METADATA_SHM_H */
@@ -31,11 +31,12 @@
 #include "relayd.h"
 
 /*
- * Send command. Fill up the header and append the data.
+ * Send command with the given command version. Fill up the header and append
+ * the data.
  */
-static int send_command(struct lttcomm_relayd_sock *rsock,
-		enum lttcomm_relayd_command cmd, void *data, size_t size,
-		int flags)
+static int send_command_version(struct lttcomm_relayd_sock *rsock,
+		enum lttcomm_relayd_command cmd, uint32_t cmd_version, void *data,
+		size_t size, int flags)
 {
 	int ret;
 	struct lttcomm_relayd_hdr header;
@@ -61,8 +62,8 @@ static int send_command(struct lttcomm_relayd_sock *rsock,
 	header.cmd = htobe32(cmd);
 	header.data_size = htobe64(size);
 
+	header.cmd_version = htobe32(cmd_version);
 	/* Zeroed for now since not used. */
-	header.cmd_version = 0;
 	header.circuit_id = 0;
 
 	/* Prepare buffer to send. */
@@ -85,6 +86,16 @@ alloc_error:
 	return ret;
 }
 
+/*
+ * Send command. Fill up the header and append the data.
+ */
+static int send_command(struct lttcomm_relayd_sock *rsock,
+		enum lttcomm_relayd_command cmd, void *data, size_t size,
+		int flags)
+{
+	return send_command_version(rsock, cmd, 0, data, size, flags);
+}
+
 /*
  * Receive reply data on socket. This MUST be call after send_command or else
  * could result in unexpected behavior(s).
@@ -372,8 +383,9 @@ int relayd_version_check(struct lttcomm_relayd_sock *rsock)
 	msg.major = htobe32(rsock->major);
 	msg.minor = htobe32(rsock->minor);
 
-	/* Send command */
-	ret = send_command(rsock, RELAYD_VERSION, (void *) &msg, sizeof(msg), 0);
+	/* Send command, requesting the compression of the socket if any. */
+	ret = send_command_version(rsock, RELAYD_VERSION, rsock->compression,
+			(void *) &msg, sizeof(msg), 0);
 	if (ret < 0) {
 		goto error;
 	}
@@ -388,6 +400,14 @@ int relayd_version_check(struct lttcomm_relayd_sock *rsock)
 	msg.major = be32toh(msg.major);
 	msg.minor = be32toh(msg.minor);
 
+	/* A relayd not acknowledging the compression receives plain data. */
+	if ((msg.minor >> RELAYD_VERSION_COMPRESSION_SHIFT) != rsock->compression) {
+		DBG2("Relayd does not support compression %u, sending plain data",
+				rsock->compression);
+		rsock->compression = LTTNG_COMPRESSION_NONE;
+	}
+	msg.minor &= RELAYD_VERSION_MINOR_MASK;
+
 	/*
 	 * Only validate the major version. If the other side is higher,
 	 * communication is not possible. Only major version equal can talk to each
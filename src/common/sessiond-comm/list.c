@@ -0,0 +1,561 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/common.h>
+
+#include "list.h"
+
+/*
+ * String table under construction. Every distinct string is stored once; the
+ * slots are an open addressing hash table of string offsets plus one, zero
+ * meaning an empty slot.
+ */
+struct strtab {
+	char *buf;
+	size_t len;
+	size_t alloc_len;
+	uint32_t *slots;
+	size_t nb_slots;
+};
+
+static uint32_t hash_str(const char *str, size_t len)
+{
+	size_t i;
+	uint32_t hash = 2166136261U;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) str[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+ * Initialize a string table able to hold nb_strings distinct strings, the
+ * empty string being the first one at offset 0.
+ */
+static int strtab_init(struct strtab *tab, size_t nb_strings)
+{
+	memset(tab, 0, sizeof(*tab));
+
+	/* Keep the load factor under one half. */
+	tab->nb_slots = 16;
+	while (tab->nb_slots < 2 * nb_strings) {
+		tab->nb_slots <<= 1;
+	}
+	tab->slots = zmalloc(tab->nb_slots * sizeof(*tab->slots));
+	tab->alloc_len = 4096;
+	tab->buf = zmalloc(tab->alloc_len);
+	if (!tab->slots || !tab->buf) {
+		free(tab->slots);
+		free(tab->buf);
+		return -LTTNG_ERR_NOMEM;
+	}
+	tab->len = 1;
+
+	return 0;
+}
+
+static void strtab_fini(struct strtab *tab)
+{
+	free(tab->slots);
+	free(tab->buf);
+}
+
+/*
+ * Add a string of at most max_len characters to the table.
+ *
+ * Return its offset in the table or a negative lttng error code.
+ */
+static int64_t strtab_add(struct strtab *tab, const char *str, size_t max_len)
+{
+	size_t len = strnlen(str, max_len), slot;
+	uint32_t offset;
+
+	if (len == 0) {
+		return 0;
+	}
+
+	slot = hash_str(str, len) & (tab->nb_slots - 1);
+	while (tab->slots[slot]) {
+		offset = tab->slots[slot] - 1;
+		if (!strncmp(tab->buf + offset, str, len) &&
+				tab->buf[offset + len] == '\0') {
+			return offset;
+		}
+		slot = (slot + 1) & (tab->nb_slots - 1);
+	}
+
+	if (tab->len + len + 1 > tab->alloc_len) {
+		char *new_buf;
+		size_t new_alloc_len = tab->alloc_len;
+
+		while (tab->len + len + 1 > new_alloc_len) {
+			new_alloc_len <<= 1;
+		}
+		new_buf = realloc(tab->buf, new_alloc_len);
+		if (!new_buf) {
+			return -LTTNG_ERR_NOMEM;
+		}
+		tab->buf = new_buf;
+		tab->alloc_len = new_alloc_len;
+	}
+
+	offset = tab->len;
+	memcpy(tab->buf + offset, str, len);
+	tab->buf[offset + len] = '\0';
+	tab->len += len + 1;
+	tab->slots[slot] = offset + 1;
+
+	return offset;
+}
+
+static int encode_event(const struct lttng_event *event,
+		struct lttcomm_list_event *wire, struct strtab *tab)
+{
+	int64_t name, symbol_name = 0;
+
+	memset(wire, 0, sizeof(*wire));
+
+	name = strtab_add(tab, event->name, sizeof(event->name));
+	if (name < 0) {
+		return name;
+	}
+
+	switch (event->type) {
+	case LTTNG_EVENT_PROBE:
+	case LTTNG_EVENT_FUNCTION:
+		wire->addr = event->attr.probe.addr;
+		wire->offset = event->attr.probe.offset;
+		symbol_name = strtab_add(tab, event->attr.probe.symbol_name,
+				sizeof(event->attr.probe.symbol_name));
+		break;
+	case LTTNG_EVENT_FUNCTION_ENTRY:
+		symbol_name = strtab_add(tab, event->attr.ftrace.symbol_name,
+				sizeof(event->attr.ftrace.symbol_name));
+		break;
+	default:
+		break;
+	}
+	if (symbol_name < 0) {
+		return symbol_name;
+	}
+
+	wire->name = name;
+	wire->type = event->type;
+	wire->loglevel_type = event->loglevel_type;
+	wire->loglevel = event->loglevel;
+	wire->enabled = event->enabled;
+	wire->pid = event->pid;
+	wire->filter = event->filter;
+	wire->exclusion = event->exclusion;
+	wire->symbol_name = symbol_name;
+
+	return 0;
+}
+
+/*
+ * Assemble the payload from the encoded records and the string table.
+ *
+ * Return the payload size or a negative lttng error code.
+ */
+static ssize_t build_payload(const struct lttcomm_list_event *events,
+		size_t nb_events, const struct lttcomm_list_field *fields,
+		size_t nb_fields, const struct strtab *tab, char **payload)
+{
+	char *buf;
+	size_t events_len, fields_len, len;
+	struct lttcomm_list_header header;
+
+	events_len = nb_events * sizeof(*events);
+	fields_len = nb_fields * sizeof(*fields);
+	len = sizeof(header) + events_len + fields_len + tab->len;
+
+	buf = zmalloc(len);
+	if (!buf) {
+		return -LTTNG_ERR_NOMEM;
+	}
+
+	header.magic = LTTCOMM_LIST_MAGIC;
+	header.version = LTTCOMM_LIST_FORMAT_VERSION;
+	header.nb_events = nb_events;
+	header.nb_fields = nb_fields;
+	header.strtab_len = tab->len;
+
+	memcpy(buf, &header, sizeof(header));
+	memcpy(buf + sizeof(header), events, events_len);
+	memcpy(buf + sizeof(header) + events_len, fields, fields_len);
+	memcpy(buf + sizeof(header) + events_len + fields_len, tab->buf,
+			tab->len);
+
+	*payload = buf;
+	return len;
+}
+
+/*
+ * Encode an event list in the compact list format. On success, payload is
+ * set to a newly allocated buffer.
+ *
+ * Return the payload size or a negative lttng error code.
+ */
+ssize_t lttcomm_list_encode_events(const struct lttng_event *events,
+		size_t nb_events, char **payload)
+{
+	int ret;
+	size_t i;
+	ssize_t len;
+	struct strtab tab;
+	struct lttcomm_list_event *wire_events;
+
+	assert(events || !nb_events);
+	assert(payload);
+
+	/* At most a name and a symbol name per event. */
+	ret = strtab_init(&tab, 2 * nb_events);
+	if (ret < 0) {
+		len = ret;
+		goto end;
+	}
+
+	wire_events = zmalloc(nb_events * sizeof(*wire_events) + 1);
+	if (!wire_events) {
+		len = -LTTNG_ERR_NOMEM;
+		goto end_strtab;
+	}
+
+	for (i = 0; i < nb_events; i++) {
+		ret = encode_event(&events[i], &wire_events[i], &tab);
+		if (ret < 0) {
+			len = ret;
+			goto end_free;
+		}
+	}
+
+	len = build_payload(wire_events, nb_events, NULL, 0, &tab, payload);
+
+end_free:
+	free(wire_events);
+end_strtab:
+	strtab_fini(&tab);
+end:
+	return len;
+}
+
+/*
+ * Encode an event field list in the compact list format. Consecutive fields of
+ * the same event share a single event record. On success, payload is set to a
+ * newly allocated buffer.
+ *
+ * Return the payload size or a negative lttng error code.
+ */
+ssize_t lttcomm_list_encode_fields(const struct lttng_event_field *fields,
+		size_t nb_fields, char **payload)
+{
+	int ret;
+	size_t i, nb_events = 0;
+	ssize_t len;
+	int64_t name;
+	struct strtab tab;
+	struct lttcomm_list_event *wire_events;
+	struct lttcomm_list_field *wire_fields;
+
+	assert(fields || !nb_fields);
+	assert(payload);
+
+	/* A name per field and at most a name and a symbol name per event. */
+	ret = strtab_init(&tab, 3 * nb_fields);
+	if (ret < 0) {
+		len = ret;
+		goto end;
+	}
+
+	wire_events = zmalloc(nb_fields * sizeof(*wire_events) + 1);
+	wire_fields = zmalloc(nb_fields * sizeof(*wire_fields) + 1);
+	if (!wire_events || !wire_fields) {
+		len = -LTTNG_ERR_NOMEM;
+		goto end_free;
+	}
+
+	for (i = 0; i < nb_fields; i++) {
+		if (i == 0 || memcmp(&fields[i].event, &fields[i - 1].event,
+					sizeof(fields[i].event))) {
+			ret = encode_event(&fields[i].event, &wire_events[nb_events],
+					&tab);
+			if (ret < 0) {
+				len = ret;
+				goto end_free;
+			}
+			nb_events++;
+		}
+
+		name = strtab_add(&tab, fields[i].field_name,
+				sizeof(fields[i].field_name));
+		if (name < 0) {
+			len = name;
+			goto end_free;
+		}
+		wire_fields[i].name = name;
+		wire_fields[i].event = nb_events - 1;
+		wire_fields[i].type = fields[i].type;
+		wire_fields[i].nowrite = fields[i].nowrite;
+	}
+
+	len = build_payload(wire_events, nb_events, wire_fields, nb_fields,
+			&tab, payload);
+
+end_free:
+	free(wire_fields);
+	free(wire_events);
+	strtab_fini(&tab);
+end:
+	return len;
+}
+
+/*
+ * Return 1 if the list reply payload is in the compact format, else 0.
+ */
+int lttcomm_list_is_compact(const char *payload, size_t len)
+{
+	struct lttcomm_list_header header;
+
+	if (!payload || len < sizeof(header)) {
+		return 0;
+	}
+	memcpy(&header, payload, sizeof(header));
+
+	return header.magic == LTTCOMM_LIST_MAGIC;
+}
+
+/*
+ * Validate a compact payload and locate its sections.
+ *
+ * Return 0 on success or a negative lttng error code.
+ */
+static int parse_payload(const char *payload, size_t len,
+		struct lttcomm_list_header *header,
+		const struct lttcomm_list_event **events,
+		const struct lttcomm_list_field **fields, const char **strtab)
+{
+	uint64_t expected_len;
+
+	if (len < sizeof(*header)) {
+		goto error;
+	}
+	memcpy(header, payload, sizeof(*header));
+	if (header->magic != LTTCOMM_LIST_MAGIC ||
+			header->version != LTTCOMM_LIST_FORMAT_VERSION) {
+		ERR("Unsupported list format version %u", header->version);
+		goto error;
+	}
+
+	expected_len = sizeof(*header) +
+		(uint64_t) header->nb_events * sizeof(**events) +
+		(uint64_t) header->nb_fields * sizeof(**fields) +
+		header->strtab_len;
+	/* The string table always holds at least the empty string. */
+	if (expected_len != len || header->strtab_len == 0) {
+		goto error;
+	}
+
+	*events = (const struct lttcomm_list_event *) (payload + sizeof(*header));
+	*fields = (const struct lttcomm_list_field *) (*events +
+			header->nb_events);
+	*strtab = (const char *) (*fields + header->nb_fields);
+	if ((*strtab)[header->strtab_len - 1] != '\0') {
+		goto error;
+	}
+
+	return 0;
+
+error:
+	ERR("Malformed list reply of %zu bytes", len);
+	return -LTTNG_ERR_FATAL;
+}
+
+/*
+ * Copy a string of the table in a fixed size buffer.
+ */
+static int copy_str(char *dst, size_t dst_len, const char *strtab,
+		size_t strtab_len, uint32_t offset)
+{
+	if (offset >= strtab_len) {
+		ERR("List reply string offset %u out of bounds", offset);
+		return -LTTNG_ERR_FATAL;
+	}
+	strncpy(dst, strtab + offset, dst_len - 1);
+	dst[dst_len - 1] = '\0';
+
+	return 0;
+}
+
+static int decode_event(const struct lttcomm_list_event *wire_event,
+		struct lttng_event *event, const char *strtab, size_t strtab_len)
+{
+	int ret;
+	struct lttcomm_list_event wire;
+
+	/* The records are not aligned in the payload. */
+	memcpy(&wire, wire_event, sizeof(wire));
+
+	ret = copy_str(event->name, sizeof(event->name), strtab, strtab_len,
+			wire.name);
+	if (ret < 0) {
+		return ret;
+	}
+
+	event->type = wire.type;
+	event->loglevel_type = wire.loglevel_type;
+	event->loglevel = wire.loglevel;
+	event->enabled = wire.enabled;
+	event->pid = wire.pid;
+	event->filter = wire.filter;
+	event->exclusion = wire.exclusion;
+
+	switch (event->type) {
+	case LTTNG_EVENT_PROBE:
+	case LTTNG_EVENT_FUNCTION:
+		event->attr.probe.addr = wire.addr;
+		event->attr.probe.offset = wire.offset;
+		ret = copy_str(event->attr.probe.symbol_name,
+				sizeof(event->attr.probe.symbol_name), strtab,
+				strtab_len, wire.symbol_name);
+		break;
+	case LTTNG_EVENT_FUNCTION_ENTRY:
+		ret = copy_str(event->attr.ftrace.symbol_name,
+				sizeof(event->attr.ftrace.symbol_name), strtab,
+				strtab_len, wire.symbol_name);
+		break;
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+/*
+ * Decode a compact event list reply. On success, events is set to a newly
+ * allocated array.
+ *
+ * Return the number of events or a negative lttng error code.
+ */
+ssize_t lttcomm_list_decode_events(const char *payload, size_t len,
+		struct lttng_event **events)
+{
+	int ret;
+	size_t i;
+	struct lttcomm_list_header header;
+	const struct lttcomm_list_event *wire_events;
+	const struct lttcomm_list_field *wire_fields;
+	const char *strtab;
+	struct lttng_event *list;
+
+	assert(events);
+
+	ret = parse_payload(payload, len, &header, &wire_events, &wire_fields,
+			&strtab);
+	if (ret < 0) {
+		return ret;
+	}
+
+	list = zmalloc(header.nb_events * sizeof(*list) + 1);
+	if (!list) {
+		return -LTTNG_ERR_NOMEM;
+	}
+
+	for (i = 0; i < header.nb_events; i++) {
+		ret = decode_event(&wire_events[i], &list[i], strtab,
+				header.strtab_len);
+		if (ret < 0) {
+			free(list);
+			return ret;
+		}
+	}
+
+	*events = list;
+	return header.nb_events;
+}
+
+/*
+ * Decode a compact event field list reply. On success, fields is set to a
+ * newly allocated array.
+ *
+ * Return the number of fields or a negative lttng error code.
+ */
+ssize_t lttcomm_list_decode_fields(const char *payload, size_t len,
+		struct lttng_event_field **fields)
+{
+	int ret;
+	size_t i;
+	struct lttcomm_list_header header;
+	const struct lttcomm_list_event *wire_events;
+	const struct lttcomm_list_field *wire_fields;
+	const char *strtab;
+	struct lttng_event_field *list;
+
+	assert(fields);
+
+	ret = parse_payload(payload, len, &header, &wire_events, &wire_fields,
+			&strtab);
+	if (ret < 0) {
+		return ret;
+	}
+
+	list = zmalloc(header.nb_fields * sizeof(*list) + 1);
+	if (!list) {
+		return -LTTNG_ERR_NOMEM;
+	}
+
+	for (i = 0; i < header.nb_fields; i++) {
+		struct lttcomm_list_field wire;
+
+		memcpy(&wire, &wire_fields[i], sizeof(wire));
+		if (wire.event >= header.nb_events) {
+			ERR("List reply field event index %u out of bounds",
+					wire.event);
+			ret = -LTTNG_ERR_FATAL;
+			goto error;
+		}
+
+		ret = copy_str(list[i].field_name, sizeof(list[i].field_name),
+				strtab, header.strtab_len, wire.name);
+		if (ret < 0) {
+			goto error;
+		}
+		list[i].type = wire.type;
+		list[i].nowrite = wire.nowrite;
+
+		ret = decode_event(&wire_events[wire.event], &list[i].event, strtab,
+				header.strtab_len);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
+	*fields = list;
+	return header.nb_fields;
+
+error:
+	free(list);
+	return ret;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LTTCOMM_LIST_H
+#define _LTTCOMM_LIST_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <lttng/lttng.h>
+#include <common/macros.h>
+
+/*
+ * Compact format of the event and event field list replies. A client asks for
+ * it by setting the list format of the command message to
+ * LTTCOMM_LIST_FORMAT_VERSION; a session daemon that does not know about it
+ * replies with the plain lttng_event or lttng_event_field arrays instead,
+ * which lttcomm_list_is_compact() tells apart with the magic number.
+ *
+ * The payload is the header followed by the event records, the field records
+ * and the string table. Strings are referenced by their offset in the string
+ * table, which starts with the empty string and holds every distinct string
+ * once. Fields reference the event they belong to by index.
+ */
+#define LTTCOMM_LIST_MAGIC		0xC7715E17
+#define LTTCOMM_LIST_FORMAT_VERSION	1
+
+struct lttcomm_list_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nb_events;
+	uint32_t nb_fields;
+	uint32_t strtab_len;
+} LTTNG_PACKED;
+
+struct lttcomm_list_event {
+	uint32_t name;
+	int32_t type;			/* enum lttng_event_type */
+	int32_t loglevel_type;		/* enum lttng_loglevel_type */
+	int32_t loglevel;
+	int32_t enabled;
+	int32_t pid;
+	uint8_t filter;
+	uint8_t exclusion;
+	/* Probe and function attributes, zero for the other event types. */
+	uint64_t addr;
+	uint64_t offset;
+	uint32_t symbol_name;
+} LTTNG_PACKED;
+
+struct lttcomm_list_field {
+	uint32_t name;
+	uint32_t event;
+	int32_t type;			/* enum lttng_event_field_type */
+	int32_t nowrite;
+} LTTNG_PACKED;
+
+ssize_t lttcomm_list_encode_events(const struct lttng_event *events,
+		size_t nb_events, char **payload);
+ssize_t lttcomm_list_encode_fields(const struct lttng_event_field *fields,
+		size_t nb_fields, char **payload);
+int lttcomm_list_is_compact(const char *payload, size_t len);
+ssize_t lttcomm_list_decode_events(const char *payload, size_t len,
+		struct lttng_event **events);
+ssize_t lttcomm_list_decode_fields(const char *payload, size_t len,
+		struct lttng_event_field **fields);
+
+#endif /* _LTTCOMM_LIST_H */
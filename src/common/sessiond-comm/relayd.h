@@ -32,6 +32,16 @@
 #define RELAYD_VERSION_COMM_MAJOR             VERSION_MAJOR
 #define RELAYD_VERSION_COMM_MINOR             VERSION_MINOR
 
+/*
+ * The compression of a session is negotiated by the version command: the
+ * command version of the request carries the compression wanted by the
+ * session daemon and the relayd acknowledges it in the high bits of the
+ * minor version of its reply. An older relayd ignores the request and the
+ * data is then sent uncompressed.
+ */
+#define RELAYD_VERSION_COMPRESSION_SHIFT      16
+#define RELAYD_VERSION_MINOR_MASK             0xffff
+
 /*
  * lttng-relayd communication header.
  */
@@ -55,6 +65,15 @@ struct lttcomm_relayd_data_hdr {
 	uint32_t padding_size;  /* Size of 0 padding the data */
 } LTTNG_PACKED;
 
+/*
+ * Prepended to the payload of every data packet of a compressed session. The
+ * payload is sent as is when compression does not make it smaller.
+ */
+struct lttcomm_relayd_compressed_hdr {
+	uint32_t compression;	/* enum lttng_compression of the payload */
+	uint32_t size;			/* uncompressed size of the payload */
+} LTTNG_PACKED;
+
 /*
  * Reply from a create session command.
  */
@@ -91,6 +91,9 @@ enum lttcomm_sessiond_command {
 	LTTNG_CREATE_SESSION_SNAPSHOT       = 29,
 	LTTNG_CREATE_SESSION_LIVE           = 30,
 	LTTNG_SAVE_SESSION                  = 31,
+	LTTNG_LIST_MEMORY_USAGE             = 32,
+	LTTNG_SET_SESSION_COMPRESSION       = 33,
+	LTTNG_LIST_STREAM_STATS             = 34,
 };
 
 enum lttcomm_relayd_command {
@@ -138,6 +141,7 @@ enum lttcomm_return_code {
 	LTTCOMM_CONSUMERD_FATAL,                    /* Fatal error. */
 	LTTCOMM_CONSUMERD_RELAYD_FAIL,              /* Error on remote relayd */
 	LTTCOMM_CONSUMERD_CHANNEL_FAIL,             /* Channel creation failed. */
+	LTTCOMM_CONSUMERD_DISCARD_REPORT,           /* Events discarded, not an error. */
 
 	/* MUST be last element */
 	LTTCOMM_NR,						/* Last element */
@@ -174,6 +178,7 @@ struct lttcomm_metadata_request_msg {
 	uint32_t bits_per_long; /* Consumer ABI */
 	uint32_t uid;
 	uint64_t key; /* Metadata channel key. */
+	uint32_t timer; /* Periodic request, the push can be deferred. */
 } LTTNG_PACKED;
 
 struct lttcomm_sockaddr {
@@ -199,6 +204,8 @@ struct lttcomm_relayd_sock {
 	struct lttcomm_sock sock;
 	uint32_t major;
 	uint32_t minor;
+	/* enum lttng_compression negotiated with the relayd. */
+	uint32_t compression;
 } LTTNG_PACKED;
 
 struct lttcomm_net_family {
@@ -264,6 +271,8 @@ struct lttcomm_session_msg {
 		/* List */
 		struct {
 			char channel_name[LTTNG_SYMBOL_NAME_LEN];
+			/* Compact reply format version understood, 0 if none. */
+			uint32_t format;
 		} LTTNG_PACKED list;
 		struct lttng_calibrate calibrate;
 		/* Used by the set_consumer_url and used by create_session also call */
@@ -285,6 +294,9 @@ struct lttcomm_session_msg {
 		struct {
 			struct lttng_save_session_attr attr;
 		} LTTNG_PACKED save_session;
+		struct {
+			uint32_t compression;	/* enum lttng_compression */
+		} LTTNG_PACKED compression;
 	} u;
 } LTTNG_PACKED;
 
@@ -413,6 +425,11 @@ struct lttcomm_consumer_msg {
 			 * because the application can be in the tracing for instance.
 			 */
 			uint32_t ust_app_uid;
+			/*
+			 * For metadata channels, set if the fd of the shared memory the
+			 * registry metadata is generated in follows this message.
+			 */
+			uint32_t metadata_shm;
 		} LTTNG_PACKED ask_channel;
 		struct {
 			uint64_t key;
@@ -447,6 +464,9 @@ struct lttcomm_consumer_msg {
 			uint64_t channel_key;
 			uint64_t net_seq_idx;
 		} LTTNG_PACKED sent_streams;
+		struct {
+			uint64_t session_id;
+		} LTTNG_PACKED stream_stats;
 	} u;
 } LTTNG_PACKED;
 
@@ -463,6 +483,30 @@ struct lttcomm_consumer_status_channel {
 	unsigned int stream_count;
 } LTTNG_PACKED;
 
+/*
+ * Reply to LTTNG_CONSUMER_STREAM_STATS, followed by count lttng_stream_stats
+ * entries.
+ */
+struct lttcomm_consumer_stream_stats_reply {
+	uint32_t ret_code;	/* enum lttcomm_return_code */
+	uint32_t count;
+} LTTNG_PACKED;
+
+/*
+ * Sent by the consumer on its error socket, right after the
+ * LTTCOMM_CONSUMERD_DISCARD_REPORT code and in the same write, when the
+ * tracer discarded events of a stream. The counts cover the sub-buffers read
+ * from the stream since its previous report.
+ */
+struct lttcomm_consumer_discard_report {
+	uint64_t session_id;
+	char channel_name[LTTNG_SYMBOL_NAME_LEN];
+	uint64_t events_discarded;
+	uint64_t subbuf_count;
+	uint64_t interval;	/* nsec since the previous report */
+	uint32_t fill_ratio;	/* mean sub-buffer fill, in per mille */
+} LTTNG_PACKED;
+
 #ifdef HAVE_LIBLTTNG_UST_CTL
 
 #include <lttng/ust-abi.h>
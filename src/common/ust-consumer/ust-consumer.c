@@ -38,6 +38,7 @@
 #include <common/relayd/relayd.h>
 #include <common/compat/fcntl.h>
 #include <common/consumer-metadata-cache.h>
+#include <common/consumer-stats.h>
 #include <common/consumer-stream.h>
 #include <common/consumer-timer.h>
 #include <common/utils.h>
@@ -907,6 +908,7 @@ static int snapshot_channel(uint64_t key, char *path, uint64_t relayd_id,
 			}
 			stream->out_fd = ret;
 			stream->tracefile_size_current = 0;
+			lttng_consumer_stream_direct_io(stream);
 
 			DBG("UST consumer snapshot stream %s/%s (%" PRIu64 ")", path,
 					stream->name, stream->key);
@@ -1021,6 +1023,42 @@ error:
 	return ret;
 }
 
+/*
+ * Update the metadata cache of the channel from the metadata shared by the
+ * session daemon and, if wait is set, wait for it to be flushed to the ring
+ * buffer.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+static int pull_metadata_shm(struct lttng_consumer_channel *channel,
+		int timer, int wait)
+{
+	int ret;
+	uint64_t offset;
+
+	pthread_mutex_lock(&channel->metadata_cache->lock);
+	ret = consumer_metadata_cache_pull_shm(channel, &offset);
+	pthread_mutex_unlock(&channel->metadata_cache->lock);
+	if (ret < 0) {
+		ERR("Pulling metadata of channel %" PRIu64 " from shm", channel->key);
+		goto end;
+	}
+
+	if (!wait) {
+		goto end;
+	}
+	while (consumer_metadata_cache_flushed(channel, offset, timer)) {
+		DBG("Waiting for metadata to be flushed");
+
+		health_code_update();
+
+		usleep(DEFAULT_METADATA_AVAILABILITY_WAIT_TIME);
+	}
+
+end:
+	return ret;
+}
+
 /*
  * Receive the metadata updates from the sessiond.
  */
@@ -1093,6 +1131,7 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		int sock, struct pollfd *consumer_sockpoll)
 {
 	ssize_t ret;
+	int metadata_shm_fd = -1;
 	enum lttcomm_return_code ret_code = LTTCOMM_CONSUMERD_SUCCESS;
 	struct lttcomm_consumer_msg msg;
 	struct lttng_consumer_channel *channel = NULL;
@@ -1192,11 +1231,33 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 		 */
 		break;
 	}
+	case LTTNG_CONSUMER_STREAM_STATS:
+	{
+		int ret;
+
+		/* The stats reply is the response, no status message. */
+		ret = consumer_stats_send(sock, msg.u.stream_stats.session_id);
+		if (ret < 0) {
+			DBG("Error when sending the stream stats: %d", ret);
+			goto error_fatal;
+		}
+		break;
+	}
 	case LTTNG_CONSUMER_ASK_CHANNEL_CREATION:
 	{
 		int ret;
 		struct ustctl_consumer_channel_attr attr;
 
+		if (msg.u.ask_channel.metadata_shm) {
+			/* The shared metadata fd follows the command. */
+			ret = lttcomm_recv_fds_unix_sock(sock, &metadata_shm_fd, 1);
+			if (ret != sizeof(metadata_shm_fd)) {
+				metadata_shm_fd = -1;
+				ERR("Receiving metadata shm fd");
+				goto error_fatal;
+			}
+		}
+
 		/* Create a plain object and reserve a channel key. */
 		channel = allocate_channel(msg.u.ask_channel.session_id,
 				msg.u.ask_channel.pathname, msg.u.ask_channel.name,
@@ -1270,6 +1331,15 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 				ERR("Allocating metadata cache");
 				goto end_channel_error;
 			}
+			if (metadata_shm_fd >= 0) {
+				/* The cache owns the fd from now on. */
+				ret = consumer_metadata_cache_map_shm(channel,
+						metadata_shm_fd);
+				metadata_shm_fd = -1;
+				if (ret < 0) {
+					goto end_channel_error;
+				}
+			}
 			consumer_timer_switch_start(channel, attr.switch_timer_interval);
 			attr.switch_timer_interval = 0;
 		} else {
@@ -1434,6 +1504,19 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 
 		health_code_update();
 
+		if (channel->metadata_cache->shm) {
+			/*
+			 * The metadata is already published in the shared memory, the
+			 * session daemon only waits for it to be flushed.
+			 */
+			assert(len == 0);
+			ret = pull_metadata_shm(channel, 0, 1);
+			if (ret < 0) {
+				ret_code = LTTCOMM_CONSUMERD_ERROR_METADATA;
+			}
+			goto end_msg_sessiond;
+		}
+
 		/* Tell session daemon we are ready to receive the metadata. */
 		ret = consumer_send_status_msg(sock, LTTCOMM_CONSUMERD_SUCCESS);
 		if (ret < 0) {
@@ -1536,6 +1619,9 @@ end_msg_sessiond:
 
 	return 1;
 end_channel_error:
+	if (metadata_shm_fd >= 0 && close(metadata_shm_fd)) {
+		PERROR("close metadata shm");
+	}
 	if (channel) {
 		/*
 		 * Free channel here since no one has a reference to it. We don't
@@ -1869,6 +1955,7 @@ int lttng_ustconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 	char dummy;
 	struct ustctl_consumer_stream *ustream;
 	struct ctf_packet_index index;
+	struct lttcomm_consumer_discard_report report;
 
 	assert(stream);
 	assert(stream->ustream);
@@ -1931,6 +2018,10 @@ retry:
 		if (ret < 0) {
 			goto end;
 		}
+		consumer_stats_packet(stream, &index);
+		if (consumer_stats_discard_report(stream, &report)) {
+			(void) lttng_consumer_send_discard_report(ctx, &report);
+		}
 	} else {
 		write_index = 0;
 	}
@@ -1968,11 +2059,40 @@ retry:
 				ret, len, subbuf_size);
 		write_index = 0;
 	}
-	err = ustctl_put_next_subbuf(ustream);
-	assert(err == 0);
+	if (stream->aio_pending) {
+		/* Released by lttng_consumer_complete_subbuffer(). */
+		stream->aio_index = index;
+		stream->aio_write_index = write_index;
+		goto end;
+	}
+	(void) lttng_ustconsumer_put_subbuffer(stream, ctx,
+			write_index ? &index : NULL);
+
+end:
+	return ret;
+}
+
+/*
+ * Release the current sub-buffer of a data stream and write its index if
+ * one is given. A failure to write the index is logged but otherwise
+ * ignored.
+ *
+ * Stream lock MUST be acquired.
+ */
+int lttng_ustconsumer_put_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx,
+		struct ctf_packet_index *index)
+{
+	int ret;
+
+	assert(stream);
+	assert(ctx);
+
+	ret = ustctl_put_next_subbuf(stream->ustream);
+	assert(ret == 0);
 
 	/* Write index if needed. */
-	if (!write_index) {
+	if (!index) {
 		goto end;
 	}
 
@@ -1980,17 +2100,13 @@ retry:
 		/*
 		 * In live, block until all the metadata is sent.
 		 */
-		err = consumer_stream_sync_metadata(ctx, stream->session_id);
-		if (err < 0) {
+		if (consumer_stream_sync_metadata(ctx, stream->session_id) < 0) {
 			goto end;
 		}
 	}
 
 	assert(!stream->metadata_flag);
-	err = consumer_stream_write_index(stream, &index);
-	if (err < 0) {
-		goto end;
-	}
+	(void) consumer_stream_write_index(stream, index);
 
 end:
 	return ret;
@@ -2017,6 +2133,7 @@ int lttng_ustconsumer_on_recv_stream(struct lttng_consumer_stream *stream)
 		}
 		stream->out_fd = ret;
 		stream->tracefile_size_current = 0;
+		lttng_consumer_stream_direct_io(stream);
 
 		if (!stream->metadata_flag) {
 			ret = index_create_file(stream->chan->pathname,
@@ -2203,6 +2320,11 @@ int lttng_ustconsumer_request_metadata(struct lttng_consumer_local_data *ctx,
 	assert(channel);
 	assert(channel->metadata_cache);
 
+	if (channel->metadata_cache->shm) {
+		/* No need to ask, the session daemon publishes the metadata. */
+		return pull_metadata_shm(channel, timer, wait);
+	}
+
 	memset(&request, 0, sizeof(request));
 
 	/* send the metadata request to sessiond */
@@ -2227,6 +2349,7 @@ int lttng_ustconsumer_request_metadata(struct lttng_consumer_local_data *ctx,
 	 */
 	request.uid = channel->ust_app_uid;
 	request.key = channel->key;
+	request.timer = timer;
 
 	DBG("Sending metadata request to sessiond, session id %" PRIu64
 			", per-pid %" PRIu64 ", app UID %u and channek key %" PRIu64,
@@ -43,6 +43,9 @@ extern void lttng_ustconsumer_del_stream(struct lttng_consumer_stream *stream);
 
 int lttng_ustconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 		struct lttng_consumer_local_data *ctx);
+int lttng_ustconsumer_put_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx,
+		struct ctf_packet_index *index);
 int lttng_ustconsumer_on_recv_stream(struct lttng_consumer_stream *stream);
 
 void lttng_ustconsumer_on_stream_hangup(struct lttng_consumer_stream *stream);
@@ -135,6 +138,14 @@ int lttng_ustconsumer_read_subbuffer(struct lttng_consumer_stream *stream,
 	return -ENOSYS;
 }
 
+static inline
+int lttng_ustconsumer_put_subbuffer(struct lttng_consumer_stream *stream,
+		struct lttng_consumer_local_data *ctx,
+		struct ctf_packet_index *index)
+{
+	return -ENOSYS;
+}
+
 static inline
 int lttng_ustconsumer_on_recv_stream(struct lttng_consumer_stream *stream)
 {
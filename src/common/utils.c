@@ -26,6 +26,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <inttypes.h>
 #include <regex.h>
@@ -440,6 +441,69 @@ end:
 	return ret;
 }
 
+/*
+ * Enable or disable direct I/O (O_DIRECT) on an open file. Writes to a file
+ * using direct I/O bypass the page cache and must be aligned, see
+ * utils_is_direct_io_aligned().
+ *
+ * Return 0 on success else a negative errno value, -EINVAL meaning that the
+ * file system does not support direct I/O.
+ */
+LTTNG_HIDDEN
+int utils_set_fd_direct_io(int fd, int enable)
+{
+	int ret, flags;
+
+	if (fd < 0) {
+		ret = -EINVAL;
+		goto end;
+	}
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0) {
+		PERROR("fcntl get flags");
+		ret = -errno;
+		goto end;
+	}
+
+	if (enable) {
+		flags |= O_DIRECT;
+	} else {
+		flags &= ~O_DIRECT;
+	}
+
+	ret = fcntl(fd, F_SETFL, flags);
+	if (ret < 0) {
+		/* Not an error for the caller which can use the page cache. */
+		ret = -errno;
+		DBG("fcntl O_DIRECT %s on fd %d: %s", enable ? "set" : "clear", fd,
+				strerror(-ret));
+	}
+
+end:
+	return ret;
+}
+
+/*
+ * Return 1 if a write of len bytes from buf at the given file offset can be
+ * done with direct I/O. The page size is used as alignment since it is a
+ * multiple of the logical block size of any file system we write to.
+ */
+LTTNG_HIDDEN
+int utils_is_direct_io_aligned(off_t offset, size_t len, const void *buf)
+{
+	static long page_size;
+
+	if (!page_size) {
+		page_size = sysconf(_SC_PAGESIZE);
+		if (page_size <= 0) {
+			page_size = 4096;
+		}
+	}
+
+	return !((offset | len | (uintptr_t) buf) & (page_size - 1));
+}
+
 /*
  * Create pid file to the given path and filename.
  */
@@ -895,6 +959,22 @@ end:
 	return home_dir;
 }
 
+/*
+ * Return the monotonic time in nsec, or 0 if it can't be read in which case
+ * nothing gets timed.
+ */
+LTTNG_HIDDEN
+uint64_t utils_get_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		return 0;
+	}
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 /*
  * With the given format, fill dst with the time of len maximum siz.
  *
@@ -36,6 +36,8 @@ int utils_create_pipe_cloexec_nonblock(int *dst);
 void utils_close_pipe(int *src);
 char *utils_strdupdelim(const char *begin, const char *end);
 int utils_set_fd_cloexec(int fd);
+int utils_set_fd_direct_io(int fd, int enable);
+int utils_is_direct_io_aligned(off_t offset, size_t len, const void *buf);
 int utils_create_pid_file(pid_t pid, const char *filepath);
 int utils_mkdir_recursive(const char *path, mode_t mode);
 int utils_create_stream_file(const char *path_name, char *file_name, uint64_t size,
@@ -47,6 +49,7 @@ int utils_parse_size_suffix(char *str, uint64_t *size);
 int utils_get_count_order_u32(uint32_t x);
 char *utils_get_home_dir(void);
 char *utils_get_user_home_dir(uid_t uid);
+uint64_t utils_get_monotonic_ns(void);
 size_t utils_get_current_time_str(const char *format, char *dst, size_t len);
 gid_t utils_get_group_id(const char *name);
 char *utils_generate_optstring(const struct option *long_options,
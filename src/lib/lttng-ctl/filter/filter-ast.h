@@ -186,5 +186,7 @@ int filter_visitor_bytecode_generate(struct filter_parser_ctx *ctx);
 void filter_bytecode_free(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_check_binary_op_nesting(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_check_binary_comparator(struct filter_parser_ctx *ctx);
+int filter_visitor_ir_optimize(struct filter_parser_ctx *ctx,
+			int integer_fields);
 
 #endif /* _FILTER_AST_H */
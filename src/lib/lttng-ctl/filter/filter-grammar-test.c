@@ -35,7 +35,7 @@ int main(int argc, char **argv)
 	struct filter_parser_ctx *ctx;
 	int ret;
 	int print_xml = 0, generate_ir = 0, generate_bytecode = 0,
-		print_bytecode = 0;
+		print_bytecode = 0, optimize_ir = 0, integer_fields = 0;
 	int i;
 
 	for (i = 1; i < argc; i++) {
@@ -49,6 +49,10 @@ int main(int argc, char **argv)
 			filter_parser_debug = 1;
 		else if (strcmp(argv[i], "-B") == 0)
 			print_bytecode = 1;
+		else if (strcmp(argv[i], "-O") == 0)
+			optimize_ir = 1;
+		else if (strcmp(argv[i], "-k") == 0)
+			integer_fields = 1;
 	}
 
 	ctx = filter_parser_ctx_alloc(stdin);
@@ -91,6 +95,17 @@ int main(int argc, char **argv)
 			goto parse_error;
 		}
 		printf("done\n");
+
+		if (optimize_ir) {
+			printf("Optimizing IR... ");
+			fflush(stdout);
+			ret = filter_visitor_ir_optimize(ctx, integer_fields);
+			if (ret) {
+				fprintf(stderr, "Optimize IR error\n");
+				goto parse_error;
+			}
+			printf("done\n");
+		}
 	}
 	if (generate_bytecode) {
 		printf("Generating bytecode... ");
@@ -0,0 +1,711 @@
+/*
+ * filter-interpreter.c
+ *
+ * LTTng filter bytecode reference interpreter
+ *
+ * Copyright 2014 - LTTng-tools contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs the filter bytecode in userspace the way the tracers do, so that a
+ * filter can be tested and its per-event cost measured before it is enabled.
+ *
+ * Linking validates the bytecode (instruction bounds, forward logical skips,
+ * relocation table) and resolves each field and context reference by name
+ * to a field of the payload, where the tracers resolve it to an offset in the
+ * event. The tracers then specialize the generic operators for the field
+ * types; here, values carry their type and the generic operators dispatch
+ * on it at run time, with the same results. The specialized operators are
+ * accepted too, and fail on a type mismatch.
+ *
+ * Running returns 1 if the event is recorded, 0 if it is discarded, or a
+ * negative error. The tracers discard the event on error.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/macros.h>
+
+#include "filter-ast.h"
+#include "filter-bytecode.h"
+#include "filter-interpreter.h"
+#include "memstream.h"
+
+/* Same stack depth as the tracers. */
+#define FILTER_STACK_LEN	10
+
+/*
+ * field_index of the unrelocated references, of the offsets within an
+ * instruction and of the other instruction starts.
+ */
+#define INDEX_REF		-1
+#define INDEX_NONE		-2
+#define INDEX_INSN		-3
+
+struct stack_entry {
+	struct filter_value v;
+	/* String loaded from the bytecode, where '*' and '\' are special. */
+	int literal;
+};
+
+/* Comparison relations, in the order of the FILTER_OP_* comparators. */
+enum relation {
+	REL_EQ, REL_NE, REL_GT, REL_LT, REL_GE, REL_LE, NR_REL,
+};
+
+/* Operand types, in the order of the FILTER_OP_* comparator groups. */
+enum compare_type {
+	CMP_GENERIC, CMP_STRING, CMP_S64, CMP_DOUBLE, CMP_DOUBLE_S64,
+	CMP_S64_DOUBLE,
+};
+
+static
+int is_ref(filter_opcode_t op)
+{
+	return (op >= FILTER_OP_LOAD_FIELD_REF
+			&& op <= FILTER_OP_LOAD_FIELD_REF_DOUBLE)
+		|| (op >= FILTER_OP_GET_CONTEXT_REF
+			&& op <= FILTER_OP_GET_CONTEXT_REF_DOUBLE);
+}
+
+/*
+ * Length of the instruction at pc, or -EINVAL if it is unknown or overruns
+ * the code.
+ */
+static
+int insn_len(const char *code, uint32_t pc, uint32_t len)
+{
+	filter_opcode_t op = code[pc];
+	uint32_t insn;
+	const char *end;
+
+	switch (op) {
+	case FILTER_OP_RETURN:
+		insn = sizeof(struct return_op);
+		break;
+	case FILTER_OP_MUL ... FILTER_OP_LE_S64_DOUBLE:
+		insn = sizeof(struct binary_op);
+		break;
+	case FILTER_OP_UNARY_PLUS ... FILTER_OP_UNARY_NOT_DOUBLE:
+		insn = sizeof(struct unary_op);
+		break;
+	case FILTER_OP_AND:
+	case FILTER_OP_OR:
+		insn = sizeof(struct logical_op);
+		break;
+	case FILTER_OP_LOAD_FIELD_REF ... FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+	case FILTER_OP_GET_CONTEXT_REF ... FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+		insn = sizeof(struct load_op) + sizeof(struct field_ref);
+		break;
+	case FILTER_OP_LOAD_STRING:
+		end = memchr(&code[pc + sizeof(struct load_op)], '\0',
+				len - pc - sizeof(struct load_op));
+		if (!end)
+			return -EINVAL;
+		insn = end - &code[pc] + 1;
+		break;
+	case FILTER_OP_LOAD_S64:
+		insn = sizeof(struct load_op) + sizeof(struct literal_numeric);
+		break;
+	case FILTER_OP_LOAD_DOUBLE:
+		insn = sizeof(struct load_op) + sizeof(struct literal_double);
+		break;
+	case FILTER_OP_CAST_TO_S64:
+	case FILTER_OP_CAST_DOUBLE_TO_S64:
+	case FILTER_OP_CAST_NOP:
+		insn = sizeof(struct cast_op);
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (insn > len - pc)
+		return -EINVAL;
+	return insn;
+}
+
+static
+int find_field(const struct filter_payload *payload, const char *name,
+		int context)
+{
+	unsigned int i;
+
+	for (i = 0; i < payload->nr_fields; i++) {
+		if (!payload->fields[i].context == !context
+				&& !strcmp(payload->fields[i].name, name))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Validate the bytecode and resolve its references to the fields of the
+ * payload. Return 0 on success, -ENOENT if a field is not in the payload,
+ * -ENOMEM or -EINVAL on error.
+ */
+LTTNG_HIDDEN
+int filter_program_link(struct filter_program *program,
+		const struct lttng_filter_bytecode *bytecode,
+		const struct filter_payload *payload)
+{
+	uint32_t len = bytecode->reloc_table_offset, pc, reloc;
+	int ret;
+
+	memset(program, 0, sizeof(*program));
+	if (len == 0 || len > bytecode->len) {
+		fprintf(stderr, "[error] %s: bad relocation table offset\n",
+			__func__);
+		return -EINVAL;
+	}
+	program->field_index = malloc(len * sizeof(*program->field_index));
+	if (!program->field_index)
+		return -ENOMEM;
+	program->code = bytecode->data;
+	program->len = len;
+	for (pc = 0; pc < len; pc++)
+		program->field_index[pc] = INDEX_NONE;
+
+	for (pc = 0; pc < len; pc += ret) {
+		filter_opcode_t op = program->code[pc];
+
+		ret = insn_len(program->code, pc, len);
+		if (ret < 0) {
+			fprintf(stderr, "[error] %s: bad instruction %u at offset %u\n",
+				__func__, (unsigned int) op, pc);
+			goto error;
+		}
+		program->field_index[pc] = is_ref(op) ? INDEX_REF : INDEX_INSN;
+	}
+
+	for (pc = 0; pc < len; pc++) {
+		filter_opcode_t op = program->code[pc];
+		struct logical_op insn;
+
+		if (program->field_index[pc] != INDEX_INSN ||
+				(op != FILTER_OP_AND && op != FILTER_OP_OR))
+			continue;
+		/*
+		 * Only jumping forward guarantees that the filter ends, and
+		 * only jumping to an instruction start that the code run is the
+		 * code validated above.
+		 */
+		memcpy(&insn, &program->code[pc], sizeof(insn));
+		if (insn.skip_offset <= pc + sizeof(insn) ||
+				insn.skip_offset >= len ||
+				program->field_index[insn.skip_offset] == INDEX_NONE) {
+			fprintf(stderr, "[error] %s: bad skip offset %u at offset %u\n",
+				__func__, (unsigned int) insn.skip_offset, pc);
+			ret = -EINVAL;
+			goto error;
+		}
+	}
+
+	for (reloc = len; reloc < bytecode->len;) {
+		const char *name;
+		uint16_t offset;
+		int index;
+
+		if (bytecode->len - reloc <= sizeof(offset))
+			goto bad_reloc;
+		memcpy(&offset, &bytecode->data[reloc], sizeof(offset));
+		name = &bytecode->data[reloc + sizeof(offset)];
+		if (!memchr(name, '\0', bytecode->len - reloc - sizeof(offset)))
+			goto bad_reloc;
+		/* Each reference is relocated once. */
+		if (offset >= len || program->field_index[offset] != INDEX_REF)
+			goto bad_reloc;
+		index = find_field(payload, name,
+			program->code[offset] >= FILTER_OP_GET_CONTEXT_REF);
+		if (index < 0) {
+			fprintf(stderr, "[error] %s: unknown %s \"%s\"\n", __func__,
+				program->code[offset] >= FILTER_OP_GET_CONTEXT_REF ?
+					"context" : "field", name);
+			ret = -ENOENT;
+			goto error;
+		}
+		program->field_index[offset] = index;
+		reloc += sizeof(offset) + strlen(name) + 1;
+	}
+
+	for (pc = 0; pc < len; pc++) {
+		if (program->field_index[pc] == INDEX_REF) {
+			fprintf(stderr, "[error] %s: no relocation for offset %u\n",
+				__func__, pc);
+			ret = -EINVAL;
+			goto error;
+		}
+	}
+	return 0;
+
+bad_reloc:
+	fprintf(stderr, "[error] %s: bad relocation table entry at offset %u\n",
+		__func__, reloc);
+	ret = -EINVAL;
+error:
+	filter_program_fini(program);
+	return ret;
+}
+
+LTTNG_HIDDEN
+void filter_program_fini(struct filter_program *program)
+{
+	free(program->field_index);
+	program->field_index = NULL;
+}
+
+/*
+ * Parse a character of a string literal: return -1 on a wildcard matching
+ * the rest of the string, else 0 with *p on the character to compare.
+ */
+static
+int parse_char(const char **p)
+{
+	switch (**p) {
+	case '\\':
+		(*p)++;
+		switch (**p) {
+		case '\\':
+		case '*':
+			return 0;
+		default:
+			return -1;
+		}
+	case '*':
+		return -1;
+	default:
+		return 0;
+	}
+}
+
+/* strcmp() where a '*' in a string literal matches the rest of the string. */
+static
+int stack_strcmp(const struct stack_entry *bx, const struct stack_entry *ax)
+{
+	const char *p = bx->v.u.str, *q = ax->v.u.str;
+	int diff;
+
+	for (;;) {
+		if (*p == '\0') {
+			if (*q == '\0')
+				return 0;
+			if (ax->literal && parse_char(&q) == -1)
+				return 0;
+			return -1;
+		}
+		if (*q == '\0') {
+			if (bx->literal && parse_char(&p) == -1)
+				return 0;
+			return 1;
+		}
+		if (bx->literal && parse_char(&p) == -1)
+			return 0;
+		if (ax->literal && parse_char(&q) == -1)
+			return 0;
+		diff = *p - *q;
+		if (diff != 0)
+			return diff;
+		p++;
+		q++;
+	}
+}
+
+static
+int relation_holds(enum relation rel, int cmp)
+{
+	switch (rel) {
+	case REL_EQ:
+		return cmp == 0;
+	case REL_NE:
+		return cmp != 0;
+	case REL_GT:
+		return cmp > 0;
+	case REL_LT:
+		return cmp < 0;
+	case REL_GE:
+		return cmp >= 0;
+	case REL_LE:
+	default:
+		return cmp <= 0;
+	}
+}
+
+static
+double to_double(const struct filter_value *v)
+{
+	return v->type == FILTER_VALUE_DOUBLE ? v->u.d : (double) v->u.s64;
+}
+
+/*
+ * Compare the two top entries of the stack into bx. The specialized
+ * comparators require their operand types.
+ */
+static
+int compare(filter_opcode_t op, struct stack_entry *bx,
+		const struct stack_entry *ax)
+{
+	enum compare_type type = (op - FILTER_OP_EQ) / NR_REL;
+	enum relation rel = (op - FILTER_OP_EQ) % NR_REL;
+	enum filter_value_type bt = bx->v.type, at = ax->v.type;
+	int result;
+
+	switch (type) {
+	case CMP_GENERIC:
+		if (bt == FILTER_VALUE_STRING && at == FILTER_VALUE_STRING)
+			type = CMP_STRING;
+		else if (bt == FILTER_VALUE_STRING || at == FILTER_VALUE_STRING)
+			return -EINVAL;
+		else if (bt == FILTER_VALUE_S64 && at == FILTER_VALUE_S64)
+			type = CMP_S64;
+		else
+			type = CMP_DOUBLE;
+		break;
+	case CMP_STRING:
+		if (bt != FILTER_VALUE_STRING || at != FILTER_VALUE_STRING)
+			return -EINVAL;
+		break;
+	case CMP_S64:
+		if (bt != FILTER_VALUE_S64 || at != FILTER_VALUE_S64)
+			return -EINVAL;
+		break;
+	case CMP_DOUBLE:
+		if (bt != FILTER_VALUE_DOUBLE || at != FILTER_VALUE_DOUBLE)
+			return -EINVAL;
+		break;
+	case CMP_DOUBLE_S64:
+		if (bt != FILTER_VALUE_DOUBLE || at != FILTER_VALUE_S64)
+			return -EINVAL;
+		type = CMP_DOUBLE;
+		break;
+	case CMP_S64_DOUBLE:
+		if (bt != FILTER_VALUE_S64 || at != FILTER_VALUE_DOUBLE)
+			return -EINVAL;
+		type = CMP_DOUBLE;
+		break;
+	}
+
+	switch (type) {
+	case CMP_STRING:
+		result = relation_holds(rel, stack_strcmp(bx, ax));
+		break;
+	case CMP_S64:
+		result = relation_holds(rel, (bx->v.u.s64 > ax->v.u.s64)
+				- (bx->v.u.s64 < ax->v.u.s64));
+		break;
+	default:
+	{
+		double b = to_double(&bx->v), a = to_double(&ax->v);
+
+		/* Spelled out: comparisons with a NaN are all false but "!=". */
+		switch (rel) {
+		case REL_EQ:
+			result = b == a;
+			break;
+		case REL_NE:
+			result = b != a;
+			break;
+		case REL_GT:
+			result = b > a;
+			break;
+		case REL_LT:
+			result = b < a;
+			break;
+		case REL_GE:
+			result = b >= a;
+			break;
+		case REL_LE:
+		default:
+			result = b <= a;
+			break;
+		}
+		break;
+	}
+	}
+
+	bx->v.type = FILTER_VALUE_S64;
+	bx->v.u.s64 = result;
+	bx->literal = 0;
+	return 0;
+}
+
+/*
+ * Conversion of a double to s64. Out of range values, which are undefined
+ * behavior in C, give the "integer indefinite" value of the x86 conversion
+ * instruction used by the tracers.
+ */
+static
+int64_t double_to_s64(double d)
+{
+	if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0))
+		return INT64_MIN;
+	return (int64_t) d;
+}
+
+static
+int unary(filter_opcode_t op, struct stack_entry *ax)
+{
+	unsigned int kind = (op - FILTER_OP_UNARY_PLUS) / 3;
+	unsigned int which = (op - FILTER_OP_UNARY_PLUS) % 3;
+
+	if (ax->v.type == FILTER_VALUE_STRING)
+		return -EINVAL;
+	/* Specialized operators: 1 for s64, 2 for double. */
+	if ((kind == 1 && ax->v.type != FILTER_VALUE_S64)
+			|| (kind == 2 && ax->v.type != FILTER_VALUE_DOUBLE))
+		return -EINVAL;
+
+	switch (which) {
+	case 0:		/* plus */
+		break;
+	case 1:		/* minus */
+		if (ax->v.type == FILTER_VALUE_S64)
+			ax->v.u.s64 = (int64_t) -(uint64_t) ax->v.u.s64;
+		else
+			ax->v.u.d = -ax->v.u.d;
+		break;
+	case 2:		/* not */
+		if (ax->v.type == FILTER_VALUE_S64) {
+			ax->v.u.s64 = !ax->v.u.s64;
+		} else {
+			ax->v.u.s64 = !ax->v.u.d;
+			ax->v.type = FILTER_VALUE_S64;
+		}
+		break;
+	}
+	return 0;
+}
+
+static
+int load_ref(filter_opcode_t op, struct stack_entry *entry,
+		const struct filter_value *value)
+{
+	switch (op) {
+	case FILTER_OP_LOAD_FIELD_REF_STRING:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+	case FILTER_OP_GET_CONTEXT_REF_STRING:
+		if (value->type != FILTER_VALUE_STRING)
+			return -EINVAL;
+		break;
+	case FILTER_OP_LOAD_FIELD_REF_S64:
+	case FILTER_OP_GET_CONTEXT_REF_S64:
+		if (value->type != FILTER_VALUE_S64)
+			return -EINVAL;
+		break;
+	case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+	case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+		if (value->type != FILTER_VALUE_DOUBLE)
+			return -EINVAL;
+		break;
+	default:
+		break;
+	}
+	if (value->type == FILTER_VALUE_STRING && !value->u.str)
+		return -EINVAL;
+	entry->v = *value;
+	entry->literal = 0;
+	return 0;
+}
+
+/*
+ * Run a linked program on a payload having the fields it was linked with.
+ * Return 1 if the event is recorded, 0 if it is discarded, or -EINVAL on a
+ * type mismatch, an unsupported operator or a stack overflow.
+ */
+LTTNG_HIDDEN
+int filter_program_run(const struct filter_program *program,
+		const struct filter_payload *payload)
+{
+	struct stack_entry stack[FILTER_STACK_LEN], *ax;
+	const char *code = program->code;
+	uint32_t pc = 0;
+	int top = -1, ret;
+
+	for (;;) {
+		filter_opcode_t op;
+
+		/* Linking checked that each instruction fits in the code. */
+		if (pc >= program->len)
+			return -EINVAL;
+		op = code[pc];
+		ax = top >= 0 ? &stack[top] : NULL;
+
+		switch (op) {
+		case FILTER_OP_RETURN:
+			if (!ax || ax->v.type != FILTER_VALUE_S64)
+				return -EINVAL;
+			return !!ax->v.u.s64;
+
+		case FILTER_OP_EQ ... FILTER_OP_LE_S64_DOUBLE:
+			if (top < 1)
+				return -EINVAL;
+			ret = compare(op, &stack[top - 1], ax);
+			if (ret)
+				return ret;
+			top--;
+			pc += sizeof(struct binary_op);
+			break;
+
+		case FILTER_OP_UNARY_PLUS ... FILTER_OP_UNARY_NOT_DOUBLE:
+			if (!ax)
+				return -EINVAL;
+			ret = unary(op, ax);
+			if (ret)
+				return ret;
+			pc += sizeof(struct unary_op);
+			break;
+
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+		{
+			struct logical_op insn;
+
+			if (!ax || ax->v.type != FILTER_VALUE_S64)
+				return -EINVAL;
+			memcpy(&insn, &code[pc], sizeof(insn));
+			/* Short-circuit: the deciding value is the result. */
+			if (op == FILTER_OP_AND && ax->v.u.s64 == 0) {
+				pc = insn.skip_offset;
+			} else if (op == FILTER_OP_OR && ax->v.u.s64 != 0) {
+				ax->v.u.s64 = 1;
+				pc = insn.skip_offset;
+			} else {
+				top--;
+				pc += sizeof(insn);
+			}
+			break;
+		}
+
+		case FILTER_OP_LOAD_FIELD_REF ... FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+		case FILTER_OP_GET_CONTEXT_REF ... FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+			if (top + 1 >= FILTER_STACK_LEN)
+				return -EINVAL;
+			ret = load_ref(op, &stack[top + 1],
+				&payload->fields[program->field_index[pc]].value);
+			if (ret)
+				return ret;
+			top++;
+			pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			break;
+
+		case FILTER_OP_LOAD_STRING:
+		{
+			const char *str = &code[pc + sizeof(struct load_op)];
+
+			if (top + 1 >= FILTER_STACK_LEN)
+				return -EINVAL;
+			top++;
+			stack[top].v.type = FILTER_VALUE_STRING;
+			stack[top].v.u.str = str;
+			stack[top].literal = 1;
+			pc += sizeof(struct load_op) + strlen(str) + 1;
+			break;
+		}
+
+		case FILTER_OP_LOAD_S64:
+			if (top + 1 >= FILTER_STACK_LEN)
+				return -EINVAL;
+			top++;
+			stack[top].v.type = FILTER_VALUE_S64;
+			memcpy(&stack[top].v.u.s64, &code[pc + sizeof(struct load_op)],
+				sizeof(struct literal_numeric));
+			stack[top].literal = 0;
+			pc += sizeof(struct load_op) + sizeof(struct literal_numeric);
+			break;
+
+		case FILTER_OP_LOAD_DOUBLE:
+			if (top + 1 >= FILTER_STACK_LEN)
+				return -EINVAL;
+			top++;
+			stack[top].v.type = FILTER_VALUE_DOUBLE;
+			memcpy(&stack[top].v.u.d, &code[pc + sizeof(struct load_op)],
+				sizeof(struct literal_double));
+			stack[top].literal = 0;
+			pc += sizeof(struct load_op) + sizeof(struct literal_double);
+			break;
+
+		case FILTER_OP_CAST_TO_S64:
+		case FILTER_OP_CAST_DOUBLE_TO_S64:
+			if (!ax || ax->v.type == FILTER_VALUE_STRING)
+				return -EINVAL;
+			if (ax->v.type == FILTER_VALUE_DOUBLE) {
+				ax->v.u.s64 = double_to_s64(ax->v.u.d);
+				ax->v.type = FILTER_VALUE_S64;
+			} else if (op == FILTER_OP_CAST_DOUBLE_TO_S64) {
+				return -EINVAL;
+			}
+			pc += sizeof(struct cast_op);
+			break;
+
+		case FILTER_OP_CAST_NOP:
+			pc += sizeof(struct cast_op);
+			break;
+
+		default:
+			/* Arithmetic operators are not supported by the tracers. */
+			return -EINVAL;
+		}
+	}
+}
+
+/*
+ * Compile a filter expression the way lttng_enable_event_with_exclusions()
+ * does. Return the bytecode, to free(), or NULL on error.
+ */
+LTTNG_HIDDEN
+struct lttng_filter_bytecode_alloc *filter_bytecode_compile(
+		const char *expression, int optimize, int integer_fields)
+{
+	struct lttng_filter_bytecode_alloc *bytecode = NULL;
+	struct filter_parser_ctx *ctx;
+	FILE *fmem;
+	int ret;
+
+	fmem = lttng_fmemopen((void *) expression, strlen(expression), "rb");
+	if (!fmem) {
+		fprintf(stderr, "Error opening memory as stream\n");
+		return NULL;
+	}
+	ctx = filter_parser_ctx_alloc(fmem);
+	if (!ctx) {
+		fprintf(stderr, "Error allocating parser\n");
+		goto end;
+	}
+	ret = filter_parser_ctx_append_ast(ctx);
+	if (!ret)
+		ret = filter_visitor_set_parent(ctx);
+	if (!ret)
+		ret = filter_visitor_ir_generate(ctx);
+	if (!ret)
+		ret = filter_visitor_ir_check_binary_op_nesting(ctx);
+	if (!ret && optimize)
+		ret = filter_visitor_ir_optimize(ctx, integer_fields);
+	if (!ret)
+		ret = filter_visitor_bytecode_generate(ctx);
+	if (ret) {
+		fprintf(stderr, "Invalid filter expression\n");
+	} else {
+		bytecode = ctx->bytecode;
+		ctx->bytecode = NULL;
+	}
+	filter_bytecode_free(ctx);
+	filter_ir_free(ctx);
+	filter_parser_ctx_free(ctx);
+end:
+	if (fclose(fmem) != 0)
+		perror("fclose");
+	return bytecode;
+}
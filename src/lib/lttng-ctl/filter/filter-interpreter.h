@@ -0,0 +1,76 @@
+#ifndef _FILTER_INTERPRETER_H
+#define _FILTER_INTERPRETER_H
+
+/*
+ * filter-interpreter.h
+ *
+ * LTTng filter bytecode reference interpreter
+ *
+ * Copyright 2014 - LTTng-tools contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include "filter-bytecode.h"
+
+enum filter_value_type {
+	FILTER_VALUE_S64,
+	FILTER_VALUE_DOUBLE,
+	FILTER_VALUE_STRING,
+};
+
+struct filter_value {
+	enum filter_value_type type;
+	union {
+		int64_t s64;
+		double d;
+		const char *str;
+	} u;
+};
+
+/* A field of the event payload, or a context if "context" is set. */
+struct filter_payload_field {
+	const char *name;
+	int context;
+	struct filter_value value;
+};
+
+struct filter_payload {
+	struct filter_payload_field *fields;
+	unsigned int nr_fields;
+};
+
+/*
+ * Bytecode validated and linked against the field names of a payload. It can
+ * then be run on any payload having the same fields in the same order.
+ */
+struct filter_program {
+	const char *code;
+	uint32_t len;
+	/* Payload field index of the field or context loaded at each offset. */
+	int32_t *field_index;
+};
+
+struct lttng_filter_bytecode_alloc *filter_bytecode_compile(
+		const char *expression, int optimize, int integer_fields);
+int filter_program_link(struct filter_program *program,
+		const struct lttng_filter_bytecode *bytecode,
+		const struct filter_payload *payload);
+void filter_program_fini(struct filter_program *program);
+int filter_program_run(const struct filter_program *program,
+		const struct filter_payload *payload);
+
+#endif /* _FILTER_INTERPRETER_H */
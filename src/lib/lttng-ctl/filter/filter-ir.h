@@ -102,4 +102,6 @@ struct ir_op {
 	} u;
 };
 
+void filter_free_ir_recursive(struct ir_op *op);
+
 #endif /* _FILTER_IR_H */
@@ -478,7 +478,7 @@ struct ir_op *make_op_binary_logical_or(struct ir_op *left, struct ir_op *right,
 	return make_op_binary_logical(AST_OP_OR, "||", left, right, side);
 }
 
-static
+LTTNG_HIDDEN
 void filter_free_ir_recursive(struct ir_op *op)
 {
 	if (!op)
@@ -0,0 +1,1350 @@
+/*
+ * filter-visitor-ir-optimize.c
+ *
+ * LTTng filter IR optimization
+ *
+ * Copyright 2014 - LTTng-tools contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The IR is rewritten in place, bottom-up, before the bytecode is generated:
+ *
+ * - comparisons and unary operators on constants are folded, "!" is pushed
+ *   into the comparison it applies to and constants are moved to the right
+ *   hand side of comparisons;
+ * - chains of the same logical operator are flattened, operands deciding the
+ *   outcome of the whole chain or having no effect on it are dropped, as are
+ *   duplicate operands;
+ * - comparisons of the same field or context against numeric constants are
+ *   merged into the smallest set of comparisons covering the same values;
+ * - the remaining operands are sorted so the string comparisons come last,
+ *   where the short-circuit can skip them.
+ *
+ * The tracer evaluates filter expressions without side effects, so
+ * evaluating fewer operands, or the same operands in another order, does not
+ * change the outcome. Values compared with a field or context that cannot be
+ * compared with them make the tracer reject the bytecode, whatever the
+ * operand order.
+ *
+ * Fields are only known to hold integers in the kernel domain; a userspace
+ * field can be a floating point number, possibly NaN, so only the
+ * transformations that hold for any real number and NaN are applied to them.
+ * Contexts always hold integers.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "filter-ast.h"
+#include "filter-parser.h"
+#include "filter-ir.h"
+
+#include <common/macros.h>
+
+/* Largest number of disjoint intervals a merged range can be made of. */
+#define RANGE_MAX_INTERVALS	4
+
+
+struct optimize_ctx {
+	/* Fields hold integers (kernel domain). */
+	int integer_fields;
+};
+
+/*
+ * Operands of a chain of the same logical operator, and the logical nodes
+ * that held them together, reused to rebuild the chain.
+ */
+struct chain {
+	enum op_type type;
+	struct ir_op **ops;
+	unsigned int nr;
+	struct ir_op **pool;
+	unsigned int nr_pool;
+};
+
+struct bound {
+	int64_t v;
+	int inf;	/* Unbounded: v is ignored. */
+	int open;	/* v is excluded. */
+};
+
+struct interval {
+	struct bound lo, hi;
+};
+
+/* Sorted disjoint intervals. Twice the room is needed while combining. */
+struct range {
+	unsigned int nr;
+	struct interval iv[2 * RANGE_MAX_INTERVALS];
+};
+
+static
+int optimize_recursive(struct optimize_ctx *o, struct ir_op **nodep);
+
+static
+int is_const(const struct ir_op *op)
+{
+	return op->op == IR_OP_LOAD && (op->data_type == IR_DATA_NUMERIC
+		|| op->data_type == IR_DATA_FLOAT);
+}
+
+static
+int is_ref(const struct ir_op *op)
+{
+	return op->op == IR_OP_LOAD && (op->data_type == IR_DATA_FIELD_REF
+		|| op->data_type == IR_DATA_GET_CONTEXT_REF);
+}
+
+static
+int is_compare(enum op_type type)
+{
+	switch (type) {
+	case AST_OP_EQ:
+	case AST_OP_NE:
+	case AST_OP_GT:
+	case AST_OP_LT:
+	case AST_OP_GE:
+	case AST_OP_LE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Operations producing 0 or 1, which can stand for a logical operator
+ * without changing the value of the expression.
+ */
+static
+int is_boolean(const struct ir_op *op)
+{
+	switch (op->op) {
+	case IR_OP_BINARY:
+	case IR_OP_LOGICAL:
+		return 1;
+	case IR_OP_UNARY:
+		return op->u.unary.type == AST_UNARY_NOT;
+	case IR_OP_LOAD:
+		return op->data_type == IR_DATA_NUMERIC
+			&& (op->u.load.u.num == 0 || op->u.load.u.num == 1);
+	default:
+		return 0;
+	}
+}
+
+static
+int is_integer_ref(struct optimize_ctx *o, const struct ir_op *ref)
+{
+	return ref->data_type == IR_DATA_GET_CONTEXT_REF || o->integer_fields;
+}
+
+static
+int same_ref(const struct ir_op *a, const struct ir_op *b)
+{
+	return a->data_type == b->data_type
+		&& !strcmp(a->u.load.u.ref, b->u.load.u.ref);
+}
+
+/*
+ * Truth value of a constant operand of a logical operator, which converts
+ * floating point numbers to integers.
+ */
+static
+int const_truth(const struct ir_op *op)
+{
+	if (op->data_type == IR_DATA_NUMERIC)
+		return op->u.load.u.num != 0;
+	return op->u.load.u.flt <= -1.0 || op->u.load.u.flt >= 1.0;
+}
+
+static
+void set_numeric(struct ir_op *op, int64_t v)
+{
+	op->data_type = IR_DATA_NUMERIC;
+	op->signedness = IR_SIGNED;
+	op->u.load.u.num = v;
+}
+
+/* Replace a node by its only remaining child. */
+static
+void replace_node(struct ir_op **nodep, struct ir_op *child)
+{
+	child->side = (*nodep)->side;
+	free(*nodep);
+	*nodep = child;
+}
+
+static
+enum op_type mirror_compare(enum op_type type)
+{
+	switch (type) {
+	case AST_OP_GT:
+		return AST_OP_LT;
+	case AST_OP_LT:
+		return AST_OP_GT;
+	case AST_OP_GE:
+		return AST_OP_LE;
+	case AST_OP_LE:
+		return AST_OP_GE;
+	default:
+		return type;
+	}
+}
+
+static
+enum op_type negate_compare(enum op_type type)
+{
+	switch (type) {
+	case AST_OP_EQ:
+		return AST_OP_NE;
+	case AST_OP_NE:
+		return AST_OP_EQ;
+	case AST_OP_GT:
+		return AST_OP_LE;
+	case AST_OP_LT:
+		return AST_OP_GE;
+	case AST_OP_GE:
+		return AST_OP_LT;
+	case AST_OP_LE:
+		return AST_OP_GT;
+	default:
+		return type;
+	}
+}
+
+static
+int compare_values(enum op_type type, int cmp)
+{
+	switch (type) {
+	case AST_OP_EQ:
+		return cmp == 0;
+	case AST_OP_NE:
+		return cmp != 0;
+	case AST_OP_GT:
+		return cmp > 0;
+	case AST_OP_LT:
+		return cmp < 0;
+	case AST_OP_GE:
+		return cmp >= 0;
+	case AST_OP_LE:
+		return cmp <= 0;
+	default:
+		return 0;
+	}
+}
+
+static
+int fold_compare(enum op_type type, const struct ir_op *left,
+		const struct ir_op *right)
+{
+	double l, r;
+
+	if (left->data_type == IR_DATA_NUMERIC
+			&& right->data_type == IR_DATA_NUMERIC) {
+		int64_t a = left->u.load.u.num, b = right->u.load.u.num;
+
+		return compare_values(type, (a > b) - (a < b));
+	}
+	l = left->data_type == IR_DATA_NUMERIC ?
+		(double) left->u.load.u.num : left->u.load.u.flt;
+	r = right->data_type == IR_DATA_NUMERIC ?
+		(double) right->u.load.u.num : right->u.load.u.flt;
+	/* Unordered values only differ. */
+	if (l != l || r != r)
+		return type == AST_OP_NE;
+	return compare_values(type, (l > r) - (l < r));
+}
+
+static
+int ir_equal(const struct ir_op *a, const struct ir_op *b)
+{
+	if (a->op != b->op || a->data_type != b->data_type)
+		return 0;
+	switch (a->op) {
+	case IR_OP_LOAD:
+		switch (a->data_type) {
+		case IR_DATA_STRING:
+			return !strcmp(a->u.load.u.string, b->u.load.u.string);
+		case IR_DATA_NUMERIC:
+			return a->u.load.u.num == b->u.load.u.num;
+		case IR_DATA_FLOAT:
+			return a->u.load.u.flt == b->u.load.u.flt;
+		case IR_DATA_FIELD_REF:
+		case IR_DATA_GET_CONTEXT_REF:
+			return !strcmp(a->u.load.u.ref, b->u.load.u.ref);
+		default:
+			return 0;
+		}
+	case IR_OP_UNARY:
+		return a->u.unary.type == b->u.unary.type
+			&& ir_equal(a->u.unary.child, b->u.unary.child);
+	case IR_OP_BINARY:
+		return a->u.binary.type == b->u.binary.type
+			&& ir_equal(a->u.binary.left, b->u.binary.left)
+			&& ir_equal(a->u.binary.right, b->u.binary.right);
+	case IR_OP_LOGICAL:
+		return a->u.logical.type == b->u.logical.type
+			&& ir_equal(a->u.logical.left, b->u.logical.left)
+			&& ir_equal(a->u.logical.right, b->u.logical.right);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Number of string comparisons, which are the only operations known to cost
+ * much more than the others. Operands are otherwise kept in the order the
+ * user wrote them, which may reflect how often they are true.
+ */
+static
+unsigned int ir_string_compares(const struct ir_op *op)
+{
+	switch (op->op) {
+	case IR_OP_LOAD:
+		return op->data_type == IR_DATA_STRING;
+	case IR_OP_UNARY:
+		return ir_string_compares(op->u.unary.child);
+	case IR_OP_BINARY:
+		return ir_string_compares(op->u.binary.left)
+			+ ir_string_compares(op->u.binary.right);
+	case IR_OP_LOGICAL:
+		return ir_string_compares(op->u.logical.left)
+			+ ir_string_compares(op->u.logical.right);
+	default:
+		return 0;
+	}
+}
+
+static
+unsigned int ir_count_compares(const struct ir_op *op)
+{
+	switch (op->op) {
+	case IR_OP_UNARY:
+		return ir_count_compares(op->u.unary.child);
+	case IR_OP_BINARY:
+		return 1;
+	case IR_OP_LOGICAL:
+		return ir_count_compares(op->u.logical.left)
+			+ ir_count_compares(op->u.logical.right);
+	default:
+		return 0;
+	}
+}
+
+static
+struct ir_op *make_numeric(int64_t v)
+{
+	struct ir_op *op;
+
+	op = calloc(sizeof(struct ir_op), 1);
+	if (!op)
+		return NULL;
+	op->op = IR_OP_LOAD;
+	set_numeric(op, v);
+	return op;
+}
+
+static
+struct ir_op *make_compare(enum op_type type, const struct ir_op *ref,
+		int64_t v)
+{
+	struct ir_op *op, *left, *right;
+
+	op = calloc(sizeof(struct ir_op), 1);
+	left = calloc(sizeof(struct ir_op), 1);
+	right = make_numeric(v);
+	if (!op || !left || !right)
+		goto error;
+	left->op = IR_OP_LOAD;
+	left->data_type = ref->data_type;
+	left->signedness = ref->signedness;
+	left->side = IR_LEFT;
+	left->u.load.u.ref = strdup(ref->u.load.u.ref);
+	if (!left->u.load.u.ref)
+		goto error;
+	right->side = IR_RIGHT;
+	op->op = IR_OP_BINARY;
+	op->data_type = IR_DATA_NUMERIC;
+	op->signedness = IR_SIGNED;
+	op->u.binary.type = type;
+	op->u.binary.left = left;
+	op->u.binary.right = right;
+	return op;
+
+error:
+	free(op);
+	free(left);
+	free(right);
+	return NULL;
+}
+
+/* Takes ownership of the operands, freed on error. */
+static
+struct ir_op *make_logical(enum op_type type, struct ir_op *left,
+		struct ir_op *right)
+{
+	struct ir_op *op = NULL;
+
+	if (!left || !right)
+		goto error;
+	op = calloc(sizeof(struct ir_op), 1);
+	if (!op)
+		goto error;
+	op->op = IR_OP_LOGICAL;
+	op->data_type = IR_DATA_NUMERIC;
+	op->signedness = IR_SIGNED;
+	op->u.logical.type = type;
+	op->u.logical.left = left;
+	op->u.logical.right = right;
+	left->side = IR_LEFT;
+	right->side = IR_RIGHT;
+	return op;
+
+error:
+	filter_free_ir_recursive(left);
+	filter_free_ir_recursive(right);
+	return NULL;
+}
+
+/* Takes ownership of the operand, freed on error. */
+static
+struct ir_op *make_not(struct ir_op *child)
+{
+	struct ir_op *op = NULL;
+
+	if (!child)
+		return NULL;
+	op = calloc(sizeof(struct ir_op), 1);
+	if (!op) {
+		filter_free_ir_recursive(child);
+		return NULL;
+	}
+	op->op = IR_OP_UNARY;
+	op->data_type = child->data_type;
+	op->signedness = child->signedness;
+	op->u.unary.type = AST_UNARY_NOT;
+	op->u.unary.child = child;
+	child->side = IR_LEFT;
+	return op;
+}
+
+/*
+ * Ranges of values. In integer mode, bounds are made inclusive and the
+ * extreme values of int64_t stand for unbounded, so adjacent intervals can be
+ * merged and a range can be complemented. Otherwise, the values are real
+ * numbers: only intervals sharing an inclusive bound are merged, and no
+ * complement is taken since NaN belongs to none of them.
+ */
+
+static
+int lo_cmp(const struct bound *a, const struct bound *b)
+{
+	if (a->inf || b->inf)
+		return b->inf - a->inf;
+	if (a->v != b->v)
+		return a->v < b->v ? -1 : 1;
+	/* An inclusive lower bound comes first. */
+	return a->open - b->open;
+}
+
+static
+int hi_cmp(const struct bound *a, const struct bound *b)
+{
+	if (a->inf || b->inf)
+		return a->inf - b->inf;
+	if (a->v != b->v)
+		return a->v < b->v ? -1 : 1;
+	/* An exclusive upper bound comes first. */
+	return b->open - a->open;
+}
+
+static
+int interval_is_point(const struct interval *iv)
+{
+	return !iv->lo.inf && !iv->hi.inf && !iv->lo.open && !iv->hi.open
+		&& iv->lo.v == iv->hi.v;
+}
+
+/* Number of comparisons needed to test a value against an interval. */
+static
+unsigned int interval_compares(const struct interval *iv)
+{
+	if (iv->lo.inf && iv->hi.inf)
+		return 0;
+	if (iv->lo.inf || iv->hi.inf || interval_is_point(iv))
+		return 1;
+	return 2;
+}
+
+/* Return 0 if the interval is empty. */
+static
+int interval_normalize(struct interval *iv, int integer)
+{
+	if (integer) {
+		if (!iv->lo.inf && iv->lo.open) {
+			if (iv->lo.v == INT64_MAX)
+				return 0;
+			iv->lo.v++;
+			iv->lo.open = 0;
+		}
+		if (!iv->lo.inf && iv->lo.v == INT64_MIN)
+			iv->lo.inf = 1;
+		if (!iv->hi.inf && iv->hi.open) {
+			if (iv->hi.v == INT64_MIN)
+				return 0;
+			iv->hi.v--;
+			iv->hi.open = 0;
+		}
+		if (!iv->hi.inf && iv->hi.v == INT64_MAX)
+			iv->hi.inf = 1;
+	}
+	if (iv->lo.inf || iv->hi.inf)
+		return 1;
+	if (iv->lo.v != iv->hi.v)
+		return iv->lo.v < iv->hi.v;
+	return !iv->lo.open && !iv->hi.open;
+}
+
+static
+int range_add(struct range *r, struct interval iv, int integer)
+{
+	if (!interval_normalize(&iv, integer))
+		return 0;
+	if (r->nr == 2 * RANGE_MAX_INTERVALS)
+		return -1;
+	r->iv[r->nr++] = iv;
+	return 0;
+}
+
+/* Sort the intervals and merge the overlapping or adjacent ones. */
+static
+int range_canonicalize(struct range *r, int integer)
+{
+	unsigned int i, j, nr = 0;
+
+	for (i = 1; i < r->nr; i++) {
+		struct interval iv = r->iv[i];
+
+		for (j = i; j > 0 && lo_cmp(&iv.lo, &r->iv[j - 1].lo) < 0; j--)
+			r->iv[j] = r->iv[j - 1];
+		r->iv[j] = iv;
+	}
+	for (i = 0; i < r->nr; i++) {
+		struct interval *cur = nr ? &r->iv[nr - 1] : NULL,
+			*next = &r->iv[i];
+		int merge;
+
+		if (!cur)
+			merge = 0;
+		else if (cur->hi.inf || next->lo.inf)
+			merge = 1;
+		else if (next->lo.v < cur->hi.v)
+			merge = 1;
+		else if (next->lo.v == cur->hi.v)
+			merge = !next->lo.open || !cur->hi.open;
+		else
+			merge = integer && next->lo.v == cur->hi.v + 1;
+		if (!merge) {
+			r->iv[nr++] = *next;
+			continue;
+		}
+		if (hi_cmp(&next->hi, &cur->hi) > 0)
+			cur->hi = next->hi;
+	}
+	r->nr = nr;
+	return nr > RANGE_MAX_INTERVALS ? -1 : 0;
+}
+
+static
+int range_union(struct range *r, const struct range *other, int integer)
+{
+	unsigned int i;
+
+	for (i = 0; i < other->nr; i++) {
+		if (range_add(r, other->iv[i], integer))
+			return -1;
+	}
+	return range_canonicalize(r, integer);
+}
+
+static
+int range_intersect(struct range *r, const struct range *other, int integer)
+{
+	struct range result = { .nr = 0 };
+	unsigned int i, j;
+
+	for (i = 0; i < r->nr; i++) {
+		for (j = 0; j < other->nr; j++) {
+			const struct interval *a = &r->iv[i], *b = &other->iv[j];
+			struct interval iv;
+
+			iv.lo = lo_cmp(&a->lo, &b->lo) >= 0 ? a->lo : b->lo;
+			iv.hi = hi_cmp(&a->hi, &b->hi) <= 0 ? a->hi : b->hi;
+			if (range_add(&result, iv, integer))
+				return -1;
+		}
+	}
+	*r = result;
+	return range_canonicalize(r, integer);
+}
+
+/* Integer mode only. */
+static
+void range_complement(const struct range *r, struct range *result)
+{
+	struct interval iv;
+	unsigned int i;
+
+	result->nr = 0;
+	memset(&iv, 0, sizeof(iv));
+	iv.lo.inf = 1;
+	for (i = 0; i < r->nr; i++) {
+		if (!r->iv[i].lo.inf) {
+			iv.hi.v = r->iv[i].lo.v - 1;
+			iv.hi.inf = 0;
+			result->iv[result->nr++] = iv;
+		}
+		if (r->iv[i].hi.inf)
+			return;
+		iv.lo.v = r->iv[i].hi.v + 1;
+		iv.lo.inf = 0;
+	}
+	iv.hi.inf = 1;
+	result->iv[result->nr++] = iv;
+}
+
+static
+int bound_equal(const struct bound *a, const struct bound *b)
+{
+	if (a->inf || b->inf)
+		return a->inf == b->inf;
+	return a->v == b->v && a->open == b->open;
+}
+
+static
+int range_equal(const struct range *a, const struct range *b)
+{
+	unsigned int i;
+
+	if (a->nr != b->nr)
+		return 0;
+	for (i = 0; i < a->nr; i++) {
+		if (!bound_equal(&a->iv[i].lo, &b->iv[i].lo)
+				|| !bound_equal(&a->iv[i].hi, &b->iv[i].hi))
+			return 0;
+	}
+	return 1;
+}
+
+static
+int range_is_full(const struct range *r)
+{
+	return r->nr == 1 && r->iv[0].lo.inf && r->iv[0].hi.inf;
+}
+
+static
+unsigned int range_compares(const struct range *r)
+{
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < r->nr; i++)
+		nr += interval_compares(&r->iv[i]);
+	return nr;
+}
+
+static
+int range_from_compare(enum op_type type, int64_t v, int integer,
+		struct range *r)
+{
+	struct interval iv;
+
+	memset(&iv, 0, sizeof(iv));
+	iv.lo.v = iv.hi.v = v;
+	r->nr = 0;
+	switch (type) {
+	case AST_OP_EQ:
+		break;
+	case AST_OP_GT:
+		iv.lo.open = 1;
+		/* fall-through */
+	case AST_OP_GE:
+		iv.hi.inf = 1;
+		break;
+	case AST_OP_LT:
+		iv.hi.open = 1;
+		/* fall-through */
+	case AST_OP_LE:
+		iv.lo.inf = 1;
+		break;
+	case AST_OP_NE:
+		/* True for NaN, which no interval holds. */
+		if (!integer)
+			return -1;
+		iv.lo.inf = 1;
+		iv.hi.open = 1;
+		range_add(r, iv, integer);
+		iv.lo.inf = 0;
+		iv.hi.inf = 1;
+		iv.hi.open = 0;
+		iv.lo.open = 1;
+		break;
+	default:
+		return -1;
+	}
+	range_add(r, iv, integer);
+	return range_canonicalize(r, integer);
+}
+
+/*
+ * Range of the values of the reference for which an operand is true, when
+ * the operand only compares that reference with numeric constants. *ref is
+ * set to the reference if it is NULL, otherwise the operand must compare the
+ * same reference. Return -1 if the operand is not such a comparison.
+ */
+static
+int operand_range(struct optimize_ctx *o, struct ir_op *op,
+		struct ir_op **ref, struct range *r)
+{
+	switch (op->op) {
+	case IR_OP_BINARY:
+	{
+		struct ir_op *left = op->u.binary.left,
+			*right = op->u.binary.right;
+
+		if (!is_ref(left) || right->op != IR_OP_LOAD
+				|| right->data_type != IR_DATA_NUMERIC)
+			return -1;
+		if (*ref && !same_ref(*ref, left))
+			return -1;
+		if (range_from_compare(op->u.binary.type, right->u.load.u.num,
+				is_integer_ref(o, left), r))
+			return -1;
+		*ref = left;
+		return 0;
+	}
+	case IR_OP_LOGICAL:
+	{
+		struct range other;
+		int integer;
+
+		if (operand_range(o, op->u.logical.left, ref, r))
+			return -1;
+		if (operand_range(o, op->u.logical.right, ref, &other))
+			return -1;
+		integer = is_integer_ref(o, *ref);
+		if (op->u.logical.type == AST_OP_AND)
+			return range_intersect(r, &other, integer);
+		return range_union(r, &other, integer);
+	}
+	default:
+		return -1;
+	}
+}
+
+/* Expression true for the values of an interval. */
+static
+struct ir_op *make_interval(const struct ir_op *ref,
+		const struct interval *iv)
+{
+	struct ir_op *lo, *hi;
+
+	if (interval_is_point(iv))
+		return make_compare(AST_OP_EQ, ref, iv->lo.v);
+	lo = iv->lo.inf ? NULL : make_compare(iv->lo.open ?
+			AST_OP_GT : AST_OP_GE, ref, iv->lo.v);
+	hi = iv->hi.inf ? NULL : make_compare(iv->hi.open ?
+			AST_OP_LT : AST_OP_LE, ref, iv->hi.v);
+	if (iv->lo.inf)
+		return hi;
+	if (iv->hi.inf)
+		return lo;
+	return make_logical(AST_OP_AND, lo, hi);
+}
+
+/* Expression true for the values of a range of more than one interval. */
+static
+struct ir_op *make_range(const struct ir_op *ref, const struct range *r)
+{
+	struct ir_op *op;
+	unsigned int i = r->nr - 1;
+
+	op = make_interval(ref, &r->iv[i]);
+	while (i-- > 0)
+		op = make_logical(AST_OP_OR, make_interval(ref, &r->iv[i]), op);
+	return op;
+}
+
+/*
+ * Operands standing for a range in a chain, when they take fewer comparisons
+ * than max_compares. Return the number of operands, 0 if the range is not
+ * worth rewriting and -ENOMEM on allocation failure.
+ */
+static
+int emit_range(enum op_type type, const struct ir_op *ref,
+		const struct range *r, int integer, unsigned int max_compares,
+		struct ir_op **ops)
+{
+	struct range complement;
+	unsigned int i, nr = 0, compares;
+	int use_complement = 0;
+
+	if (!r->nr) {
+		ops[nr++] = make_numeric(0);
+		goto end;
+	}
+	if (range_is_full(r)) {
+		/* Any value but NaN: no comparison tells it. */
+		if (!integer)
+			return 0;
+		ops[nr++] = make_numeric(1);
+		goto end;
+	}
+	compares = range_compares(r);
+	if (type == AST_OP_AND && r->nr > 1 && integer) {
+		range_complement(r, &complement);
+		if (range_compares(&complement) < compares) {
+			compares = range_compares(&complement);
+			use_complement = 1;
+		}
+	}
+	if (compares >= max_compares)
+		return 0;
+	if (type == AST_OP_OR) {
+		for (i = 0; i < r->nr; i++)
+			ops[nr++] = make_interval(ref, &r->iv[i]);
+	} else if (r->nr == 1) {
+		const struct interval *iv = &r->iv[0];
+		struct interval half = *iv;
+
+		if (interval_is_point(iv) || iv->lo.inf || iv->hi.inf) {
+			ops[nr++] = make_interval(ref, iv);
+		} else {
+			/* Both bounds are operands of the chain. */
+			half.hi.inf = 1;
+			ops[nr++] = make_interval(ref, &half);
+			half = *iv;
+			half.lo.inf = 1;
+			ops[nr++] = make_interval(ref, &half);
+		}
+	} else if (use_complement) {
+		ops[nr++] = make_not(make_range(ref, &complement));
+	} else {
+		ops[nr++] = make_range(ref, r);
+	}
+
+end:
+	for (i = 0; i < nr; i++) {
+		if (!ops[i])
+			goto error;
+	}
+	return nr;
+
+error:
+	for (i = 0; i < nr; i++)
+		filter_free_ir_recursive(ops[i]);
+	return -ENOMEM;
+}
+
+/*
+ * Replace the operands listed in members (in increasing order) by the new
+ * operands, at the position of the first member.
+ */
+static
+int chain_replace(struct chain *chain, const unsigned int *members,
+		unsigned int nr_members, struct ir_op **new_ops,
+		unsigned int nr_new)
+{
+	struct ir_op **ops;
+	unsigned int i, j, m = 0, nr = 0;
+
+	ops = calloc(chain->nr - nr_members + nr_new + 1, sizeof(*ops));
+	if (!ops)
+		return -ENOMEM;
+	for (i = 0; i < chain->nr; i++) {
+		if (m < nr_members && members[m] == i) {
+			if (!m) {
+				for (j = 0; j < nr_new; j++)
+					ops[nr++] = new_ops[j];
+			}
+			filter_free_ir_recursive(chain->ops[i]);
+			m++;
+			continue;
+		}
+		ops[nr++] = chain->ops[i];
+	}
+	free(chain->ops);
+	chain->ops = ops;
+	chain->nr = nr;
+	return 0;
+}
+
+/* Merge the comparisons of the same reference with numeric constants. */
+static
+int chain_merge_ranges(struct optimize_ctx *o, struct chain *chain)
+{
+	struct ir_op *new_ops[2 * RANGE_MAX_INTERVALS];
+	unsigned int *members = NULL;
+	struct range *ranges = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < chain->nr; i++) {
+		struct ir_op *ref = NULL;
+		struct range r;
+		unsigned int j, m, nr_members = 1, compares;
+		int integer, nr_new, keep = -1;
+
+		if (operand_range(o, chain->ops[i], &ref, &r))
+			continue;
+		free(members);
+		free(ranges);
+		members = calloc(chain->nr, sizeof(*members));
+		ranges = calloc(chain->nr, sizeof(*ranges));
+		if (!members || !ranges) {
+			ret = -ENOMEM;
+			break;
+		}
+		integer = is_integer_ref(o, ref);
+		members[0] = i;
+		ranges[0] = r;
+		compares = ir_count_compares(chain->ops[i]);
+		for (j = i + 1; j < chain->nr; j++) {
+			struct range merged = r;
+
+			if (operand_range(o, chain->ops[j], &ref,
+					&ranges[nr_members]))
+				continue;
+			if (chain->type == AST_OP_AND)
+				ret = range_intersect(&merged, &ranges[nr_members],
+						integer);
+			else
+				ret = range_union(&merged, &ranges[nr_members],
+						integer);
+			if (ret) {
+				ret = 0;
+				continue;
+			}
+			r = merged;
+			members[nr_members++] = j;
+			compares += ir_count_compares(chain->ops[j]);
+		}
+		if (nr_members < 2)
+			continue;
+
+		/* An operand may stand for the whole group already. */
+		for (m = 0; m < nr_members; m++) {
+			if (!range_equal(&ranges[m], &r))
+				continue;
+			if (keep < 0 || ir_count_compares(chain->ops[members[m]])
+					< ir_count_compares(chain->ops[members[keep]]))
+				keep = m;
+		}
+		if (keep >= 0) {
+			struct ir_op *op = chain->ops[members[keep]];
+
+			/* Move it where the group starts, drop the others. */
+			chain->ops[members[keep]] = chain->ops[i];
+			chain->ops[i] = op;
+			ret = chain_replace(chain, &members[1], nr_members - 1,
+					NULL, 0);
+			if (ret)
+				break;
+			continue;
+		}
+
+		nr_new = emit_range(chain->type, ref, &r, integer, compares,
+				new_ops);
+		if (nr_new < 0) {
+			ret = nr_new;
+			break;
+		}
+		if (!nr_new)
+			continue;
+		ret = chain_replace(chain, members, nr_members, new_ops,
+				nr_new);
+		if (ret) {
+			while (nr_new-- > 0)
+				filter_free_ir_recursive(new_ops[nr_new]);
+			break;
+		}
+		/* The new operands cannot be merged any further. */
+		i += nr_new - 1;
+	}
+	free(members);
+	free(ranges);
+	return ret;
+}
+
+/*
+ * Drop the constant operands. A constant deciding the outcome of the chain
+ * replaces the whole chain, the other ones have no effect on it.
+ */
+static
+void chain_fold_constants(struct chain *chain)
+{
+	int decisive = chain->type == AST_OP_OR, others = 0;
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < chain->nr; i++) {
+		struct ir_op *op = chain->ops[i];
+		unsigned int j;
+
+		if (!is_const(op)) {
+			others = 1;
+			continue;
+		}
+		if (const_truth(op) != decisive)
+			continue;
+		for (j = 0; j < chain->nr; j++) {
+			if (j != i)
+				filter_free_ir_recursive(chain->ops[j]);
+		}
+		set_numeric(op, decisive);
+		chain->ops[0] = op;
+		chain->nr = 1;
+		return;
+	}
+	for (i = 0; i < chain->nr; i++) {
+		struct ir_op *op = chain->ops[i];
+
+		if (is_const(op)) {
+			/* Keep one if nothing else is left. */
+			if (others || nr) {
+				filter_free_ir_recursive(op);
+				continue;
+			}
+			set_numeric(op, !decisive);
+		}
+		chain->ops[nr++] = op;
+	}
+	chain->nr = nr;
+}
+
+static
+void chain_remove_duplicates(struct chain *chain)
+{
+	unsigned int i, j, nr = 0;
+
+	for (i = 0; i < chain->nr; i++) {
+		for (j = 0; j < nr; j++) {
+			if (ir_equal(chain->ops[j], chain->ops[i]))
+				break;
+		}
+		if (j < nr) {
+			filter_free_ir_recursive(chain->ops[i]);
+			continue;
+		}
+		chain->ops[nr++] = chain->ops[i];
+	}
+	chain->nr = nr;
+}
+
+/* Operands with fewer string comparisons first, in a stable way. */
+static
+void chain_sort(struct chain *chain)
+{
+	unsigned int i, j;
+
+	for (i = 1; i < chain->nr; i++) {
+		struct ir_op *op = chain->ops[i];
+		unsigned int cost = ir_string_compares(op);
+
+		for (j = i; j > 0
+				&& ir_string_compares(chain->ops[j - 1]) > cost;
+				j--)
+			chain->ops[j] = chain->ops[j - 1];
+		chain->ops[j] = op;
+	}
+}
+
+static
+unsigned int chain_count(const struct ir_op *node, enum op_type type)
+{
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != type)
+		return 1;
+	return chain_count(node->u.logical.left, type)
+		+ chain_count(node->u.logical.right, type);
+}
+
+static
+void chain_detach(struct chain *chain, struct ir_op *node)
+{
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != chain->type) {
+		chain->ops[chain->nr++] = node;
+		return;
+	}
+	chain_detach(chain, node->u.logical.left);
+	chain_detach(chain, node->u.logical.right);
+	chain->pool[chain->nr_pool++] = node;
+}
+
+static
+int optimize_chain_operands(struct optimize_ctx *o, struct ir_op **nodep,
+		enum op_type type)
+{
+	struct ir_op *node = *nodep;
+	int ret;
+
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != type)
+		return optimize_recursive(o, nodep);
+	ret = optimize_chain_operands(o, &node->u.logical.left, type);
+	if (ret)
+		return ret;
+	return optimize_chain_operands(o, &node->u.logical.right, type);
+}
+
+/*
+ * Link the operands back together, right to left, so the first operand is
+ * evaluated first. The tree is left consistent even on allocation failure.
+ */
+static
+int chain_rebuild(struct chain *chain, struct ir_op **nodep,
+		enum ir_side side)
+{
+	struct ir_op *cur;
+	unsigned int i;
+	int ret = 0;
+
+	if (chain->nr == 1 && !is_boolean(chain->ops[0])) {
+		/* The logical operator turns the operand into a boolean. */
+		cur = make_numeric(chain->type == AST_OP_AND);
+		if (cur)
+			chain->ops[chain->nr++] = cur;
+		else
+			ret = -ENOMEM;
+	}
+	cur = chain->ops[chain->nr - 1];
+	for (i = chain->nr - 1; i > 0; i--) {
+		struct ir_op *op;
+
+		if (chain->nr_pool) {
+			op = chain->pool[--chain->nr_pool];
+		} else {
+			op = calloc(sizeof(struct ir_op), 1);
+			if (!op) {
+				while (i-- > 0)
+					filter_free_ir_recursive(chain->ops[i]);
+				ret = -ENOMEM;
+				break;
+			}
+			op->op = IR_OP_LOGICAL;
+			op->data_type = IR_DATA_NUMERIC;
+			op->signedness = IR_SIGNED;
+			op->u.logical.type = chain->type;
+		}
+		op->u.logical.left = chain->ops[i - 1];
+		op->u.logical.right = cur;
+		op->u.logical.left->side = IR_LEFT;
+		cur->side = IR_RIGHT;
+		cur = op;
+	}
+	cur->side = side;
+	*nodep = cur;
+	return ret;
+}
+
+static
+int optimize_logical(struct optimize_ctx *o, struct ir_op **nodep)
+{
+	struct ir_op *node = *nodep;
+	enum ir_side side = node->side;
+	struct chain chain;
+	unsigned int count;
+	int ret, rebuild_ret;
+
+	ret = optimize_chain_operands(o, nodep, node->u.logical.type);
+	if (ret)
+		return ret;
+
+	memset(&chain, 0, sizeof(chain));
+	chain.type = node->u.logical.type;
+	count = chain_count(node, chain.type);
+	/* Room for a neutral operand, see chain_rebuild(). */
+	chain.ops = calloc(count + 1, sizeof(*chain.ops));
+	chain.pool = calloc(count, sizeof(*chain.pool));
+	if (!chain.ops || !chain.pool) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	chain_detach(&chain, node);
+
+	chain_fold_constants(&chain);
+	ret = chain_merge_ranges(o, &chain);
+	if (!ret) {
+		chain_fold_constants(&chain);
+		chain_remove_duplicates(&chain);
+		chain_sort(&chain);
+	}
+	rebuild_ret = chain_rebuild(&chain, nodep, side);
+	if (!ret)
+		ret = rebuild_ret;
+	while (chain.nr_pool)
+		free(chain.pool[--chain.nr_pool]);
+end:
+	free(chain.ops);
+	free(chain.pool);
+	return ret;
+}
+
+static
+int optimize_unary(struct optimize_ctx *o, struct ir_op **nodep)
+{
+	struct ir_op *node = *nodep, *child;
+	int ret;
+
+	ret = optimize_recursive(o, &node->u.unary.child);
+	if (ret)
+		return ret;
+	child = node->u.unary.child;
+
+	switch (node->u.unary.type) {
+	case AST_UNARY_PLUS:
+		break;
+	case AST_UNARY_MINUS:
+		if (!is_const(child))
+			return 0;
+		if (child->data_type == IR_DATA_NUMERIC)
+			child->u.load.u.num =
+				(int64_t) -(uint64_t) child->u.load.u.num;
+		else
+			child->u.load.u.flt = -child->u.load.u.flt;
+		break;
+	case AST_UNARY_NOT:
+		if (is_const(child)) {
+			if (child->data_type == IR_DATA_NUMERIC)
+				set_numeric(child, !child->u.load.u.num);
+			else
+				set_numeric(child, child->u.load.u.flt == 0.0);
+			break;
+		}
+		if (child->op == IR_OP_UNARY
+				&& child->u.unary.type == AST_UNARY_NOT
+				&& is_boolean(child->u.unary.child)) {
+			struct ir_op *grandchild = child->u.unary.child;
+
+			free(child);
+			child = grandchild;
+			break;
+		}
+		if (child->op == IR_OP_BINARY) {
+			enum op_type type = child->u.binary.type;
+
+			/* Arithmetic and bitwise results are kept as is. */
+			if (!is_compare(type))
+				return 0;
+			/* The opposite of an order only holds for integers. */
+			if (type != AST_OP_EQ && type != AST_OP_NE
+					&& (!is_ref(child->u.binary.left)
+					|| !is_integer_ref(o, child->u.binary.left)
+					|| child->u.binary.right->op != IR_OP_LOAD
+					|| child->u.binary.right->data_type != IR_DATA_NUMERIC))
+				return 0;
+			child->u.binary.type = negate_compare(type);
+			break;
+		}
+		return 0;
+	default:
+		return 0;
+	}
+	replace_node(nodep, child);
+	return 0;
+}
+
+static
+int optimize_binary(struct optimize_ctx *o, struct ir_op **nodep)
+{
+	struct ir_op *node = *nodep, *left, *right;
+	int ret;
+
+	ret = optimize_recursive(o, &node->u.binary.left);
+	if (ret)
+		return ret;
+	ret = optimize_recursive(o, &node->u.binary.right);
+	if (ret)
+		return ret;
+	left = node->u.binary.left;
+	right = node->u.binary.right;
+	if (!is_compare(node->u.binary.type))
+		return 0;
+
+	if (is_const(left) && is_const(right)) {
+		set_numeric(left, fold_compare(node->u.binary.type,
+				left, right));
+		filter_free_ir_recursive(right);
+		replace_node(nodep, left);
+		return 0;
+	}
+	if (is_const(left) && is_ref(right)) {
+		node->u.binary.type = mirror_compare(node->u.binary.type);
+		node->u.binary.left = right;
+		node->u.binary.right = left;
+		right->side = IR_LEFT;
+		left->side = IR_RIGHT;
+	}
+	return 0;
+}
+
+static
+int optimize_recursive(struct optimize_ctx *o, struct ir_op **nodep)
+{
+	struct ir_op *node = *nodep;
+
+	switch (node->op) {
+	case IR_OP_UNKNOWN:
+	default:
+		fprintf(stderr, "[error] %s: unknown op type\n", __func__);
+		return -EINVAL;
+
+	case IR_OP_ROOT:
+	{
+		int ret;
+
+		ret = optimize_recursive(o, &node->u.root.child);
+		if (ret)
+			return ret;
+		node->data_type = node->u.root.child->data_type;
+		node->signedness = node->u.root.child->signedness;
+		return 0;
+	}
+	case IR_OP_LOAD:
+		return 0;
+	case IR_OP_UNARY:
+		return optimize_unary(o, nodep);
+	case IR_OP_BINARY:
+		return optimize_binary(o, nodep);
+	case IR_OP_LOGICAL:
+		return optimize_logical(o, nodep);
+	}
+}
+
+/*
+ * integer_fields tells whether the event fields are known to hold integers,
+ * which is the case in the kernel domain.
+ */
+LTTNG_HIDDEN
+int filter_visitor_ir_optimize(struct filter_parser_ctx *ctx,
+		int integer_fields)
+{
+	struct optimize_ctx o = {
+		.integer_fields = integer_fields,
+	};
+
+	return optimize_recursive(&o, &ctx->ir_root);
+}
@@ -31,6 +31,7 @@
 #include <common/common.h>
 #include <common/defaults.h>
 #include <common/sessiond-comm/sessiond-comm.h>
+#include <common/sessiond-comm/list.h>
 #include <common/uri.h>
 #include <common/utils.h>
 #include <lttng/lttng.h>
@@ -820,6 +821,17 @@ int lttng_enable_event_with_exclusions(struct lttng_handle *handle,
 		}
 		dbg_printf("done\n");
 
+		dbg_printf("Optimizing IR... ");
+		fflush(stdout);
+		ret = filter_visitor_ir_optimize(ctx,
+				handle->domain.type == LTTNG_DOMAIN_KERNEL);
+		if (ret) {
+			fprintf(stderr, "Optimize IR error\n");
+			ret = -LTTNG_ERR_FILTER_INVAL;
+			goto parse_error;
+		}
+		dbg_printf("done\n");
+
 		dbg_printf("Generating bytecode... ");
 		fflush(stdout);
 		ret = filter_visitor_bytecode_generate(ctx);
@@ -994,6 +1006,45 @@ int lttng_disable_channel(struct lttng_handle *handle, const char *name)
 	return lttng_ctl_ask_sessiond(&lsm, NULL);
 }
 
+/*
+ * Ask the session daemon for a list of events, or of event fields if fields
+ * is set, asking for the compact list format and converting it back to the
+ * public structures. Session daemons that do not support it reply with the
+ * plain arrays.
+ *
+ * Return the number of entries or a negative lttng error code.
+ */
+static int ask_sessiond_list(struct lttcomm_session_msg *lsm,
+		struct lttng_event **events, struct lttng_event_field **fields)
+{
+	int ret;
+	char *payload = NULL;
+
+	lsm->u.list.format = LTTCOMM_LIST_FORMAT_VERSION;
+
+	ret = lttng_ctl_ask_sessiond(lsm, (void **) &payload);
+	if (ret < 0) {
+		return ret;
+	}
+
+	if (!lttcomm_list_is_compact(payload, ret)) {
+		if (fields) {
+			*fields = (struct lttng_event_field *) payload;
+			return ret / sizeof(struct lttng_event_field);
+		}
+		*events = (struct lttng_event *) payload;
+		return ret / sizeof(struct lttng_event);
+	}
+
+	if (fields) {
+		ret = lttcomm_list_decode_fields(payload, ret, fields);
+	} else {
+		ret = lttcomm_list_decode_events(payload, ret, events);
+	}
+	free(payload);
+	return ret;
+}
+
 /*
  *  Lists all available tracepoints of domain.
  *  Sets the contents of the events array.
@@ -1003,7 +1054,6 @@ int lttng_disable_channel(struct lttng_handle *handle, const char *name)
 int lttng_list_tracepoints(struct lttng_handle *handle,
 		struct lttng_event **events)
 {
-	int ret;
 	struct lttcomm_session_msg lsm;
 
 	if (handle == NULL) {
@@ -1014,12 +1064,7 @@ int lttng_list_tracepoints(struct lttng_handle *handle,
 	lsm.cmd_type = LTTNG_LIST_TRACEPOINTS;
 	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
 
-	ret = lttng_ctl_ask_sessiond(&lsm, (void **) events);
-	if (ret < 0) {
-		return ret;
-	}
-
-	return ret / sizeof(struct lttng_event);
+	return ask_sessiond_list(&lsm, events, NULL);
 }
 
 /*
@@ -1031,7 +1076,6 @@ int lttng_list_tracepoints(struct lttng_handle *handle,
 int lttng_list_tracepoint_fields(struct lttng_handle *handle,
 		struct lttng_event_field **fields)
 {
-	int ret;
 	struct lttcomm_session_msg lsm;
 
 	if (handle == NULL) {
@@ -1042,12 +1086,7 @@ int lttng_list_tracepoint_fields(struct lttng_handle *handle,
 	lsm.cmd_type = LTTNG_LIST_TRACEPOINT_FIELDS;
 	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
 
-	ret = lttng_ctl_ask_sessiond(&lsm, (void **) fields);
-	if (ret < 0) {
-		return ret;
-	}
-
-	return ret / sizeof(struct lttng_event_field);
+	return ask_sessiond_list(&lsm, NULL, fields);
 }
 
 /*
@@ -1198,6 +1237,69 @@ int lttng_list_channels(struct lttng_handle *handle,
 	return ret / sizeof(struct lttng_channel);
 }
 
+/*
+ *  Ask the session daemon for the buffer memory used by a session.
+ *  Sets the contents of the usage array.
+ *  Returns the number of lttng_memory_usage entries in usage;
+ *  on error, returns a negative value.
+ */
+int lttng_list_memory_usage(struct lttng_handle *handle,
+		struct lttng_memory_usage **usage)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || usage == NULL) {
+		return -LTTNG_ERR_INVALID;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LIST_MEMORY_USAGE;
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+
+	ret = lttng_ctl_ask_sessiond(&lsm, (void**) usage);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return ret / sizeof(struct lttng_memory_usage);
+}
+
+/*
+ *  Ask the session daemon for the consumer stats of the streams and channels
+ *  of a session.
+ *  Sets the contents of the stats array.
+ *  Returns the number of lttng_stream_stats entries in stats;
+ *  on error, returns a negative value.
+ */
+int lttng_list_stream_stats(struct lttng_handle *handle,
+		struct lttng_stream_stats **stats)
+{
+	int ret;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || stats == NULL) {
+		return -LTTNG_ERR_INVALID;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_LIST_STREAM_STATS;
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+
+	ret = lttng_ctl_ask_sessiond(&lsm, (void**) stats);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return ret / sizeof(struct lttng_stream_stats);
+}
+
 /*
  *  Ask the session daemon for all available events of a session channel.
  *  Sets the contents of the events array.
@@ -1207,7 +1309,6 @@ int lttng_list_channels(struct lttng_handle *handle,
 int lttng_list_events(struct lttng_handle *handle,
 		const char *channel_name, struct lttng_event **events)
 {
-	int ret;
 	struct lttcomm_session_msg lsm;
 
 	/* Safety check. An handle and channel name are mandatory */
@@ -1224,12 +1325,7 @@ int lttng_list_events(struct lttng_handle *handle,
 
 	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
 
-	ret = lttng_ctl_ask_sessiond(&lsm, (void**) events);
-	if (ret < 0) {
-		return ret;
-	}
-
-	return ret / sizeof(struct lttng_event);
+	return ask_sessiond_list(&lsm, events, NULL);
 }
 
 /*
@@ -1595,6 +1691,29 @@ end:
 	return ret;
 }
 
+/*
+ * Set the compression of the trace data sent to the relay daemon.
+ *
+ * Returns LTTNG_OK on success or a negative error code.
+ */
+int lttng_set_session_compression(const char *name,
+		enum lttng_compression compression)
+{
+	struct lttcomm_session_msg lsm;
+
+	if (name == NULL) {
+		return -LTTNG_ERR_INVALID;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+
+	lsm.cmd_type = LTTNG_SET_SESSION_COMPRESSION;
+	lttng_ctl_copy_string(lsm.session.name, name, sizeof(lsm.session.name));
+	lsm.u.compression.compression = compression;
+
+	return lttng_ctl_ask_sessiond(&lsm, NULL);
+}
+
 /*
  * lib constructor
  */
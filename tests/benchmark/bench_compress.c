@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Packet compression benchmark. For each packet size (from 4 KiB up to -s,
+ * growing by a factor of 4), -n packets are compressed and decompressed one
+ * at a time, like the consumer and relay daemons do, and the compression
+ * ratio and the throughput of both directions are reported. The input is
+ * either synthetic CTF-like events and random bytes, or the content of the
+ * trace files given on the command line, e.g. the stream files of a trace.
+ *
+ * Usage: bench_compress [-s MAX_PACKET_SIZE] [-n PACKETS] [FILE...]
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <common/compress/compress.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define MIN_PACKET_SIZE		4096UL
+
+static unsigned long opt_max_size = 1UL << 20;
+static unsigned long opt_packets = 256;
+
+/*
+ * Events of a few types with a timestamp growing by small increments and
+ * payloads drawn from a small set of values, the usual content of a packet.
+ */
+static void fill_ctf(char *buf, size_t len)
+{
+	size_t pos = 0;
+	uint64_t ts = 1000000;
+	unsigned int seed = 1;
+
+	while (pos + 32 <= len) {
+		uint32_t id = rand_r(&seed) % 8;
+		uint64_t payload = rand_r(&seed) % 64;
+
+		ts += rand_r(&seed) % 1024;
+		memcpy(buf + pos, &id, sizeof(id));
+		memcpy(buf + pos + 4, &ts, sizeof(ts));
+		memcpy(buf + pos + 12, &payload, sizeof(payload));
+		memset(buf + pos + 20, 0, 12);
+		pos += 32;
+	}
+	memset(buf + pos, 0, len - pos);
+}
+
+static void fill_random(char *buf, size_t len)
+{
+	size_t i;
+	unsigned int seed = 42;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = rand_r(&seed);
+	}
+}
+
+/*
+ * Read a file, repeated if needed, to fill len bytes.
+ *
+ * Return 0 on success else -1.
+ */
+static int fill_file(char *buf, size_t len, const char *path)
+{
+	int ret = -1;
+	size_t pos = 0, nr;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+
+	while (pos < len) {
+		nr = fread(buf + pos, 1, len - pos, fp);
+		if (nr == 0) {
+			if (ferror(fp) || pos == 0) {
+				fprintf(stderr, "Cannot read %s\n", path);
+				goto end;
+			}
+			rewind(fp);
+		}
+		pos += nr;
+	}
+	ret = 0;
+
+end:
+	fclose(fp);
+	return ret;
+}
+
+/*
+ * Compress and decompress every packet of the input.
+ *
+ * Return 0 on success else -1.
+ */
+static int run_bench(const char *name, const char *input, size_t packet_size,
+		char *dst, char *out)
+{
+	unsigned long i;
+	uint64_t start, compress_ns, decompress_ns = 0, total = 0, compressed = 0;
+	size_t dst_len = compress_bound(LTTNG_COMPRESSION_LZ4, packet_size);
+	ssize_t *sizes;
+	double mib = (double) packet_size * opt_packets / (1 << 20);
+
+	sizes = calloc(opt_packets, sizeof(*sizes));
+	if (!sizes) {
+		return -1;
+	}
+
+	start = now_ns();
+	for (i = 0; i < opt_packets; i++) {
+		sizes[i] = compress_buffer(LTTNG_COMPRESSION_LZ4,
+				input + i * packet_size, packet_size,
+				dst + i * dst_len, dst_len);
+	}
+	compress_ns = now_ns() - start;
+
+	for (i = 0; i < opt_packets; i++) {
+		ssize_t ret;
+
+		if (sizes[i] < 0) {
+			fprintf(stderr, "Compression failed\n");
+			goto error;
+		}
+		start = now_ns();
+		ret = decompress_buffer(LTTNG_COMPRESSION_LZ4, dst + i * dst_len,
+				sizes[i], out, packet_size);
+		decompress_ns += now_ns() - start;
+		if (ret != packet_size ||
+				memcmp(out, input + i * packet_size, packet_size)) {
+			fprintf(stderr, "Decompression mismatch\n");
+			goto error;
+		}
+		total += packet_size;
+		/* Packets which do not shrink are sent as is. */
+		compressed += sizes[i] < packet_size ? sizes[i] : packet_size;
+	}
+
+	printf("%-16s %10zu %8.3f %12.1f %12.1f\n", name, packet_size,
+			(double) compressed / total, mib * 1e9 / compress_ns,
+			mib * 1e9 / decompress_ns);
+	free(sizes);
+	return 0;
+
+error:
+	free(sizes);
+	return -1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-s MAX_PACKET_SIZE] [-n PACKETS] [FILE...]\n",
+			prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = EXIT_FAILURE;
+	size_t size, input_len;
+	char *input = NULL, *dst = NULL, *out = NULL;
+
+	while ((opt = getopt(argc, argv, "s:n:h")) != -1) {
+		switch (opt) {
+		case 's':
+			opt_max_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt_packets = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (opt_max_size < MIN_PACKET_SIZE || !opt_packets) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	input_len = opt_max_size * opt_packets;
+	input = malloc(input_len);
+	dst = malloc(compress_bound(LTTNG_COMPRESSION_LZ4, opt_max_size) *
+			opt_packets);
+	out = malloc(opt_max_size);
+	if (!input || !dst || !out) {
+		perror("malloc");
+		goto end;
+	}
+
+	printf("# %-14s %10s %8s %12s %12s\n", "input", "packet", "ratio",
+			"comp(MiB/s)", "decomp(MiB/s)");
+	if (optind == argc) {
+		fill_ctf(input, input_len);
+		for (size = MIN_PACKET_SIZE; size <= opt_max_size; size *= 4) {
+			if (run_bench("ctf-like", input, size, dst, out)) {
+				goto end;
+			}
+		}
+		fill_random(input, input_len);
+		for (size = MIN_PACKET_SIZE; size <= opt_max_size; size *= 4) {
+			if (run_bench("random", input, size, dst, out)) {
+				goto end;
+			}
+		}
+	}
+	for (; optind < argc; optind++) {
+		const char *name = strrchr(argv[optind], '/');
+
+		name = name ? name + 1 : argv[optind];
+		if (fill_file(input, input_len, argv[optind])) {
+			goto end;
+		}
+		for (size = MIN_PACKET_SIZE; size <= opt_max_size; size *= 4) {
+			if (run_bench(name, input, size, dst, out)) {
+				goto end;
+			}
+		}
+	}
+	ret = EXIT_SUCCESS;
+
+end:
+	free(input);
+	free(dst);
+	free(out);
+	return ret;
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Connection storm benchmark of the hand-off of new connections from the
+ * listener threads of the relay daemon to its worker thread. -p producer
+ * threads, standing for the listeners, each hand -n connections as fast as
+ * they can to a worker thread polling for them. Two hand-offs are measured:
+ *
+ *   pipe:  wait-free queue, futex wake up of a dispatcher thread which writes
+ *          each connection pointer to a pipe read by the worker (the former
+ *          relayd design).
+ *   queue: relay_conn_queue, the worker drains the wait-free queue itself when
+ *          its eventfd is readable.
+ *
+ * The throughput and the mean latency from enqueue to worker are reported.
+ *
+ * Usage: bench_conn_queue [-p PRODUCERS] [-n CONNECTIONS]
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/futex.h>
+
+#include <bin/lttng-relayd/conn-queue.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+struct bench_conn {
+	struct relay_connection conn;
+	uint64_t enqueue_ts;
+};
+
+struct bench_result {
+	uint64_t elapsed_ns;
+	uint64_t latency_ns;
+	uint64_t received;
+};
+
+static unsigned long opt_producers = 4;
+static unsigned long opt_connections = 100000;
+
+static struct bench_conn *conns;
+static pthread_barrier_t barrier;
+
+/* Former design: queue, futex and dispatcher thread writing to a pipe. */
+static struct cds_wfq_queue pipe_queue;
+static int32_t pipe_futex;
+static int dispatch_exit;
+static int conn_pipe[2] = { -1, -1 };
+
+/* New design. */
+static struct relay_conn_queue conn_queue = { .event_fd = -1 };
+
+static int use_pipe;
+
+/* The benchmark never destroys queued connections. */
+void connection_destroy(struct relay_connection *conn)
+{
+}
+
+static void *producer_thread(void *data)
+{
+	unsigned long i, id = (unsigned long) data;
+
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < opt_connections; i++) {
+		struct bench_conn *bconn = &conns[id * opt_connections + i];
+
+		bconn->enqueue_ts = now_ns();
+		if (use_pipe) {
+			cds_wfq_enqueue(&pipe_queue, &bconn->conn.qnode);
+			futex_nto1_wake(&pipe_futex);
+		} else {
+			relay_conn_queue_enqueue(&conn_queue, &bconn->conn);
+		}
+	}
+	return NULL;
+}
+
+static void *dispatcher_thread(void *data)
+{
+	struct cds_wfq_node *node;
+	struct relay_connection *conn;
+
+	while (!CMM_LOAD_SHARED(dispatch_exit)) {
+		futex_nto1_prepare(&pipe_futex);
+		while ((node = cds_wfq_dequeue_blocking(&pipe_queue))) {
+			conn = caa_container_of(node, struct relay_connection, qnode);
+			if (lttng_write(conn_pipe[1], &conn, sizeof(conn)) <
+					sizeof(conn)) {
+				perror("write");
+				exit(EXIT_FAILURE);
+			}
+		}
+		futex_nto1_wait(&pipe_futex);
+	}
+	return NULL;
+}
+
+static void receive(struct relay_connection *conn, struct bench_result *res)
+{
+	struct bench_conn *bconn = caa_container_of(conn, struct bench_conn, conn);
+
+	res->latency_ns += now_ns() - bconn->enqueue_ts;
+	res->received++;
+}
+
+static void *worker_thread(void *data)
+{
+	struct bench_result *res = data;
+	struct relay_connection *conn;
+	struct pollfd pfd;
+	uint64_t total = opt_producers * opt_connections;
+
+	pfd.fd = use_pipe ? conn_pipe[0] : conn_queue.event_fd;
+	pfd.events = POLLIN;
+
+	while (res->received < total) {
+		if (poll(&pfd, 1, -1) < 0) {
+			perror("poll");
+			exit(EXIT_FAILURE);
+		}
+		if (use_pipe) {
+			if (lttng_read(conn_pipe[0], &conn, sizeof(conn)) <
+					sizeof(conn)) {
+				perror("read");
+				exit(EXIT_FAILURE);
+			}
+			receive(conn, res);
+		} else {
+			relay_conn_queue_ack(&conn_queue);
+			while ((conn = relay_conn_queue_dequeue(&conn_queue))) {
+				receive(conn, res);
+			}
+		}
+	}
+	return NULL;
+}
+
+static int run_bench(int pipe_mode, struct bench_result *res)
+{
+	int ret;
+	unsigned long i;
+	uint64_t start;
+	pthread_t worker, dispatcher, *producers;
+
+	use_pipe = pipe_mode;
+	memset(res, 0, sizeof(*res));
+	memset(conns, 0, sizeof(*conns) * opt_producers * opt_connections);
+	producers = calloc(opt_producers, sizeof(*producers));
+	if (!producers) {
+		return -1;
+	}
+
+	if (use_pipe) {
+		cds_wfq_init(&pipe_queue);
+		pipe_futex = 0;
+		dispatch_exit = 0;
+		if (pipe(conn_pipe) < 0 ||
+				pthread_create(&dispatcher, NULL, dispatcher_thread, NULL)) {
+			perror("dispatcher setup");
+			exit(EXIT_FAILURE);
+		}
+	} else if (relay_conn_queue_init(&conn_queue) < 0) {
+		exit(EXIT_FAILURE);
+	}
+
+	pthread_barrier_init(&barrier, NULL, opt_producers + 1);
+	ret = pthread_create(&worker, NULL, worker_thread, res);
+	for (i = 0; !ret && i < opt_producers; i++) {
+		ret = pthread_create(&producers[i], NULL, producer_thread,
+				(void *) i);
+	}
+	if (ret) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now_ns();
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < opt_producers; i++) {
+		pthread_join(producers[i], NULL);
+	}
+	pthread_join(worker, NULL);
+	res->elapsed_ns = now_ns() - start;
+	pthread_barrier_destroy(&barrier);
+
+	if (use_pipe) {
+		CMM_STORE_SHARED(dispatch_exit, 1);
+		futex_nto1_wake(&pipe_futex);
+		pthread_join(dispatcher, NULL);
+		close(conn_pipe[0]);
+		close(conn_pipe[1]);
+	} else {
+		relay_conn_queue_fini(&conn_queue);
+	}
+	free(producers);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-p PRODUCERS] [-n CONNECTIONS]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, mode;
+	struct bench_result res;
+
+	while ((opt = getopt(argc, argv, "p:n:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			opt_producers = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt_connections = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (!opt_producers || !opt_connections) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	conns = calloc(opt_producers * opt_connections, sizeof(*conns));
+	if (!conns) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+
+	printf("# %6s %10s %12s %14s %14s\n", "mode", "producers",
+			"connections", "conn/s", "latency(us)");
+	for (mode = 1; mode >= 0; mode--) {
+		if (run_bench(mode, &res)) {
+			fprintf(stderr, "Benchmark failed\n");
+			return EXIT_FAILURE;
+		}
+		printf("%8s %10lu %12" PRIu64 " %14.0f %14.1f\n",
+				mode ? "pipe" : "queue", opt_producers, res.received,
+				(double) res.received * 1000000000.0 / res.elapsed_ns,
+				(double) res.latency_ns / res.received / 1000.0);
+	}
+
+	free(conns);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,1139 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Drain throughput of the consumer daemon without a tracer. A synthetic
+ * producer thread plays the part of the kernel tracer: it fills the
+ * sub-buffers of -s ring buffers with CTF packets, and the kernctl_*()
+ * functions, defined here in place of the ioctl() wrappers of libkernel-ctl,
+ * serve them to the unmodified kernel consumer read path, from
+ * lttng_consumer_read_subbuffer() down to lttng_consumer_on_read_subbuffer_mmap()
+ * or lttng_consumer_on_read_subbuffer_splice(). -r reader threads, standing
+ * for the data thread of the consumer daemon, each drain their share of the
+ * streams in turn.
+ *
+ * Output modes:
+ *
+ *   mmap:   local trace files written from the mapping of the ring buffer.
+ *   splice: local trace files spliced from the ring buffer.
+ *   relayd: network streaming of the mapped packets to a stand-in relay
+ *           daemon on TCP loopback which acknowledges the control commands
+ *           and discards the data.
+ *
+ * Each sub-buffer holds a packet of -f percent of the sub-buffer size, the
+ * rest being padding. Without -R, the producer refills the sub-buffers as
+ * soon as they are released so the drain rate of the consumer is measured.
+ * With -R, it produces RATE MB/s and counts the packets it can't store as
+ * discarded events, like the tracer would.
+ *
+ * Reported are the throughput, the CPU time of the reader threads per GB
+ * drained and the percentiles of the time a sub-buffer is held by the
+ * consumer (service, from get to put) and of the time from its commit by the
+ * producer to its release (drain).
+ *
+ * Trace files are rotated according to -C and -W in a temporary directory
+ * created under -o (/tmp by default) and removed at exit. -D enables direct
+ * I/O on the trace files. io_uring is not initialized, writes are
+ * synchronous.
+ *
+ * Usage: bench_consumerd [-m mmap|splice|relayd] [-s STREAMS] [-r READERS]
+ *        [-b SUBBUF_SIZE] [-n NUM_SUBBUF] [-f FILL] [-R RATE] [-d SECONDS]
+ *        [-C TRACEFILE_SIZE] [-W TRACEFILE_COUNT] [-o DIR] [-D]
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu.h>
+#include <urcu/uatomic.h>
+
+#include <bin/lttng-consumerd/health-consumerd.h>
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/consumer.h>
+#include <common/kernel-ctl/kernel-ctl.h>
+#include <common/sessiond-comm/relayd.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/* Defined by lttng-consumerd, only used by the consumer threads. */
+struct health_app *health_consumerd;
+int health_quit_pipe[2] = { -1, -1 };
+
+#define CTF_MAGIC		0xC1FC1FC1
+/* Mean event size used to count the events of a discarded packet. */
+#define EVENT_SIZE		32
+/* Sleep of a producer or reader thread which found nothing to do. */
+#define IDLE_SLEEP_US		20
+/* Latency samples kept per reader thread, the most recent ones. */
+#define MAX_SAMPLES		(1UL << 20)
+#define RELAYD_NET_SEQ_IDX	0
+
+enum mode {
+	MODE_MMAP,
+	MODE_SPLICE,
+	MODE_RELAYD,
+};
+
+static const char *mode_str[] = {
+	[MODE_MMAP] = "mmap",
+	[MODE_SPLICE] = "splice",
+	[MODE_RELAYD] = "relayd",
+};
+
+/* Packet header and context as written by lttng-modules. */
+struct packet_header {
+	uint32_t magic;
+	uint8_t uuid[16];
+	uint32_t stream_id;
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
+	uint64_t content_size;		/* in bits */
+	uint64_t packet_size;		/* in bits */
+	uint64_t events_discarded;
+	uint32_t cpu_id;
+} LTTNG_PACKED;
+
+/*
+ * Synthetic ring buffer of a stream. The producer owns the produced count,
+ * the reader of the stream owns the consumed count; both are counts of
+ * sub-buffers.
+ */
+struct ring {
+	/* Stream file descriptor, the key of the kernctl_*() calls. */
+	int fd;
+	/* Splice mode: a file per sub-buffer, dup2()'ed on fd when read. */
+	int *slot_fds;
+	char **slots;
+	uint64_t *commit_ts;
+	unsigned long produced;
+	unsigned long consumed;
+	/* Reader side. */
+	unsigned long read_idx;
+	uint64_t get_ts;
+	/* Producer side. */
+	uint64_t next_ts;
+	uint64_t last_ts;
+	uint64_t discarded;
+	struct lttng_consumer_stream *stream;
+};
+
+struct samples {
+	uint64_t *ns;
+	unsigned long nr;
+};
+
+struct reader {
+	pthread_t tid;
+	unsigned long id;
+	uint64_t bytes;
+	uint64_t packets;
+	uint64_t cpu_ns;
+	int error;
+	struct samples service;
+	struct samples drain;
+};
+
+static enum mode opt_mode = MODE_MMAP;
+static unsigned long opt_streams = 4;
+static unsigned long opt_readers = 1;
+static unsigned long opt_subbuf_size = DEFAULT_KERNEL_CHANNEL_SUBBUF_SIZE;
+static unsigned long opt_num_subbuf = 4;
+static unsigned long opt_fill = 100;
+static unsigned long opt_rate;
+static unsigned long opt_duration = 5;
+static uint64_t opt_tracefile_size = 64 * 1024 * 1024;
+static uint64_t opt_tracefile_count = 4;
+static const char *opt_dir = "/tmp";
+static int opt_direct_io;
+
+static struct lttng_consumer_local_data *ctx;
+static struct ring *rings;
+/* Rings indexed by stream file descriptor. */
+static struct ring **fd_rings;
+static int nr_fd_rings;
+static char trace_dir[PATH_MAX];
+static unsigned int shm_count;
+static pthread_barrier_t barrier;
+static int stop;
+static __thread struct reader *current_reader;
+
+/* Stand-in relay daemon. */
+static int relayd_fds[2] = { -1, -1 };
+static uint64_t relayd_bytes;
+
+static void add_sample(struct samples *samples, uint64_t ns)
+{
+	samples->ns[samples->nr++ % MAX_SAMPLES] = ns;
+}
+
+static struct ring *get_ring(int fd)
+{
+	if (fd < 0 || fd >= nr_fd_rings || !fd_rings[fd]) {
+		errno = EBADF;
+		return NULL;
+	}
+	return fd_rings[fd];
+}
+
+static struct packet_header *read_header(struct ring *ring)
+{
+	return (struct packet_header *) ring->slots[ring->read_idx];
+}
+
+/*
+ * Kernel tracer ring buffer interface used by the kernel consumer, served
+ * from the synthetic ring buffers.
+ */
+
+int kernctl_get_next_subbuf(int fd)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	if (ring->consumed == uatomic_read(&ring->produced)) {
+		errno = EAGAIN;
+		return -1;
+	}
+	/* Read the packet only once it is committed. */
+	cmm_smp_rmb();
+
+	ring->read_idx = ring->consumed % opt_num_subbuf;
+	if (opt_mode == MODE_SPLICE &&
+			dup2(ring->slot_fds[ring->read_idx], fd) < 0) {
+		return -1;
+	}
+	ring->get_ts = now_ns();
+	return 0;
+}
+
+int kernctl_put_next_subbuf(int fd)
+{
+	uint64_t now;
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+
+	now = now_ns();
+	if (current_reader) {
+		add_sample(&current_reader->service, now - ring->get_ts);
+		add_sample(&current_reader->drain,
+				now - ring->commit_ts[ring->read_idx]);
+		current_reader->bytes += opt_subbuf_size;
+		current_reader->packets++;
+	}
+
+	/* Done with the packet before the producer overwrites it. */
+	cmm_smp_mb();
+	uatomic_set(&ring->consumed, ring->consumed + 1);
+	return 0;
+}
+
+int kernctl_get_mmap_len(int fd, unsigned long *len)
+{
+	if (!get_ring(fd)) {
+		return -1;
+	}
+	*len = opt_subbuf_size * opt_num_subbuf;
+	return 0;
+}
+
+int kernctl_get_max_subbuf_size(int fd, unsigned long *len)
+{
+	if (!get_ring(fd)) {
+		return -1;
+	}
+	*len = opt_subbuf_size;
+	return 0;
+}
+
+int kernctl_get_mmap_read_offset(int fd, unsigned long *off)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*off = ring->read_idx * opt_subbuf_size;
+	return 0;
+}
+
+int kernctl_get_subbuf_size(int fd, unsigned long *len)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*len = read_header(ring)->content_size / CHAR_BIT;
+	return 0;
+}
+
+int kernctl_get_padded_subbuf_size(int fd, unsigned long *len)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*len = read_header(ring)->packet_size / CHAR_BIT;
+	return 0;
+}
+
+int kernctl_snapshot(int fd)
+{
+	return get_ring(fd) ? 0 : -1;
+}
+
+int kernctl_snapshot_get_consumed(int fd, unsigned long *pos)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*pos = uatomic_read(&ring->consumed) * opt_subbuf_size;
+	return 0;
+}
+
+int kernctl_snapshot_get_produced(int fd, unsigned long *pos)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*pos = uatomic_read(&ring->produced) * opt_subbuf_size;
+	return 0;
+}
+
+/* Snapshots are not benchmarked. */
+int kernctl_get_subbuf(int fd, unsigned long *pos)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int kernctl_put_subbuf(int fd)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int kernctl_buffer_flush(int fd)
+{
+	return get_ring(fd) ? 0 : -1;
+}
+
+int kernctl_get_timestamp_begin(int fd, uint64_t *timestamp_begin)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*timestamp_begin = read_header(ring)->timestamp_begin;
+	return 0;
+}
+
+int kernctl_get_timestamp_end(int fd, uint64_t *timestamp_end)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*timestamp_end = read_header(ring)->timestamp_end;
+	return 0;
+}
+
+int kernctl_get_events_discarded(int fd, uint64_t *events_discarded)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*events_discarded = read_header(ring)->events_discarded;
+	return 0;
+}
+
+int kernctl_get_content_size(int fd, uint64_t *content_size)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*content_size = read_header(ring)->content_size;
+	return 0;
+}
+
+int kernctl_get_packet_size(int fd, uint64_t *packet_size)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*packet_size = read_header(ring)->packet_size;
+	return 0;
+}
+
+int kernctl_get_stream_id(int fd, uint64_t *stream_id)
+{
+	struct ring *ring = get_ring(fd);
+
+	if (!ring) {
+		return -1;
+	}
+	*stream_id = read_header(ring)->stream_id;
+	return 0;
+}
+
+int kernctl_get_current_timestamp(int fd, uint64_t *ts)
+{
+	if (!get_ring(fd)) {
+		return -1;
+	}
+	*ts = now_ns();
+	return 0;
+}
+
+static int ring_full(struct ring *ring)
+{
+	return ring->produced - uatomic_read(&ring->consumed) >= opt_num_subbuf;
+}
+
+/* Commit the next packet of a ring, which must not be full. */
+static void produce(struct ring *ring, uint64_t now)
+{
+	unsigned long idx = ring->produced % opt_num_subbuf;
+	struct packet_header *header = (struct packet_header *) ring->slots[idx];
+
+	/* Released by the reader before it was marked consumed. */
+	cmm_smp_mb();
+	header->timestamp_begin = ring->last_ts;
+	header->timestamp_end = now;
+	header->events_discarded = ring->discarded;
+	ring->commit_ts[idx] = now;
+	ring->last_ts = now;
+
+	cmm_smp_wmb();
+	uatomic_set(&ring->produced, ring->produced + 1);
+}
+
+static void *producer_thread(void *data)
+{
+	unsigned long i;
+	uint64_t now, interval = 0;
+	unsigned long content = opt_subbuf_size * opt_fill / 100;
+
+	if (opt_rate) {
+		/* Nanoseconds between two packets of a stream. */
+		interval = (uint64_t) opt_streams * opt_subbuf_size * 1000 /
+				opt_rate;
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	now = now_ns();
+	for (i = 0; i < opt_streams; i++) {
+		rings[i].last_ts = rings[i].next_ts = now;
+	}
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		int idle = 1;
+
+		now = now_ns();
+		for (i = 0; i < opt_streams; i++) {
+			struct ring *ring = &rings[i];
+
+			if (opt_rate) {
+				if (now < ring->next_ts) {
+					continue;
+				}
+				ring->next_ts += interval;
+				idle = 0;
+				if (ring_full(ring)) {
+					ring->discarded += content / EVENT_SIZE;
+					continue;
+				}
+			} else if (ring_full(ring)) {
+				continue;
+			}
+			produce(ring, now);
+			idle = 0;
+		}
+		if (idle) {
+			usleep(IDLE_SLEEP_US);
+		}
+	}
+
+	return NULL;
+}
+
+static void *reader_thread(void *data)
+{
+	unsigned long i;
+	struct timespec start, end;
+	struct reader *reader = data;
+
+	rcu_register_thread();
+	current_reader = reader;
+
+	pthread_barrier_wait(&barrier);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		ssize_t total = 0;
+
+		for (i = reader->id; i < opt_streams; i += opt_readers) {
+			ssize_t ret;
+
+			ret = lttng_consumer_read_subbuffer(rings[i].stream, ctx);
+			if (ret > 0) {
+				total += ret;
+			} else if (ret < 0 && ret != -EAGAIN) {
+				fprintf(stderr, "Reading stream %lu failed: %s\n", i,
+						strerror(-ret));
+				reader->error = 1;
+				CMM_STORE_SHARED(stop, 1);
+				break;
+			}
+		}
+		if (!total) {
+			usleep(IDLE_SLEEP_US);
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	reader->cpu_ns = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+			end.tv_nsec - start.tv_nsec;
+
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = read(fd, buf, len);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	return lttng_write(fd, buf, len) == len ? 0 : -1;
+}
+
+/*
+ * Control connection of the stand-in relay daemon: every command succeeds,
+ * new streams get consecutive ids.
+ */
+static void *relayd_control_thread(void *data)
+{
+	char buf[4096];
+	uint64_t next_stream_id = 0;
+	int fd = relayd_fds[LTTNG_STREAM_CONTROL];
+
+	for (;;) {
+		uint64_t size;
+		struct lttcomm_relayd_hdr hdr;
+		struct lttcomm_relayd_status_stream stream_reply;
+		struct lttcomm_relayd_generic_reply reply;
+
+		if (read_full(fd, &hdr, sizeof(hdr))) {
+			break;
+		}
+		for (size = be64toh(hdr.data_size); size > 0;) {
+			size_t len = size < sizeof(buf) ? size : sizeof(buf);
+
+			if (read_full(fd, buf, len)) {
+				goto end;
+			}
+			size -= len;
+		}
+
+		if (be32toh(hdr.cmd) == RELAYD_ADD_STREAM) {
+			stream_reply.handle = htobe64(next_stream_id++);
+			stream_reply.ret_code = htobe32(LTTNG_OK);
+			if (write_full(fd, &stream_reply, sizeof(stream_reply))) {
+				break;
+			}
+		} else {
+			reply.ret_code = htobe32(LTTNG_OK);
+			if (write_full(fd, &reply, sizeof(reply))) {
+				break;
+			}
+		}
+	}
+
+end:
+	return NULL;
+}
+
+/* Data connection of the stand-in relay daemon: the packets are dropped. */
+static void *relayd_data_thread(void *data)
+{
+	char *buf;
+	size_t buf_len = opt_subbuf_size;
+	int fd = relayd_fds[LTTNG_STREAM_DATA];
+
+	buf = malloc(buf_len);
+	if (!buf) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	for (;;) {
+		uint32_t size;
+		struct lttcomm_relayd_data_hdr hdr;
+
+		if (read_full(fd, &hdr, sizeof(hdr))) {
+			break;
+		}
+		size = be32toh(hdr.data_size);
+		if (size > buf_len || read_full(fd, buf, size)) {
+			break;
+		}
+		uatomic_add(&relayd_bytes, size);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+/*
+ * Connect to the stand-in relay daemon and hand the socket to the consumer
+ * the way the session daemon does, through a unix socket.
+ */
+static void add_relayd_socket(int listen_fd, struct sockaddr_in *addr,
+		enum lttng_stream_type type)
+{
+	int ret, fd, sv[2];
+	struct pollfd sockpoll[2];
+	struct lttcomm_relayd_sock relayd_sock;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *) addr, sizeof(*addr))) {
+		perror("connect relayd");
+		exit(EXIT_FAILURE);
+	}
+	relayd_fds[type] = accept(listen_fd, NULL, NULL);
+	if (relayd_fds[type] < 0) {
+		perror("accept relayd");
+		exit(EXIT_FAILURE);
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		perror("socketpair");
+		exit(EXIT_FAILURE);
+	}
+	/* Queued before the consumer asks for it. */
+	if (lttcomm_send_fds_unix_sock(sv[0], &fd, 1) < 0) {
+		fprintf(stderr, "Sending the relayd socket failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(sockpoll, 0, sizeof(sockpoll));
+	sockpoll[0].fd = ctx->consumer_should_quit[0];
+	sockpoll[0].events = POLLIN | POLLPRI;
+	sockpoll[1].fd = sv[1];
+	sockpoll[1].events = POLLIN | POLLPRI;
+
+	memset(&relayd_sock, 0, sizeof(relayd_sock));
+	relayd_sock.sock.proto = LTTCOMM_SOCK_TCP;
+	relayd_sock.sock.sockaddr.type = LTTCOMM_INET;
+	relayd_sock.sock.sockaddr.addr.sin = *addr;
+	relayd_sock.major = RELAYD_VERSION_COMM_MAJOR;
+	relayd_sock.minor = RELAYD_VERSION_COMM_MINOR;
+
+	rcu_read_lock();
+	ret = consumer_add_relayd_socket(RELAYD_NET_SEQ_IDX, type, ctx, sv[1],
+			sockpoll, &relayd_sock, 1, 1);
+	rcu_read_unlock();
+	if (ret < 0) {
+		fprintf(stderr, "Adding the relayd socket failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	close(fd);
+	close(sv[0]);
+	close(sv[1]);
+}
+
+static void setup_relayd(pthread_t *tids)
+{
+	int fd;
+	socklen_t len = sizeof(struct sockaddr_in);
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+			listen(fd, 2) ||
+			getsockname(fd, (struct sockaddr *) &addr, &len)) {
+		perror("relayd listen");
+		exit(EXIT_FAILURE);
+	}
+
+	add_relayd_socket(fd, &addr, LTTNG_STREAM_CONTROL);
+	add_relayd_socket(fd, &addr, LTTNG_STREAM_DATA);
+	close(fd);
+
+	if (pthread_create(&tids[0], NULL, relayd_control_thread, NULL) ||
+			pthread_create(&tids[1], NULL, relayd_data_thread, NULL)) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static int create_shm(size_t size)
+{
+	int fd;
+	char name[NAME_MAX];
+
+	snprintf(name, sizeof(name), "/bench-consumerd-%d-%u", getpid(),
+			shm_count++);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		perror("shm_open");
+		exit(EXIT_FAILURE);
+	}
+	(void) shm_unlink(name);
+	if (ftruncate(fd, size)) {
+		perror("ftruncate");
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+static void *map_shm(int fd, size_t size)
+{
+	void *addr;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+	return addr;
+}
+
+/* Allocate the sub-buffers of a ring and write the constant packet parts. */
+static void setup_ring(struct ring *ring, unsigned int cpu)
+{
+	unsigned long i;
+	char *base = NULL;
+	size_t content = opt_subbuf_size * opt_fill / 100;
+
+	ring->slots = calloc(opt_num_subbuf, sizeof(*ring->slots));
+	ring->commit_ts = calloc(opt_num_subbuf, sizeof(*ring->commit_ts));
+	if (!ring->slots || !ring->commit_ts) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	if (opt_mode == MODE_SPLICE) {
+		ring->slot_fds = calloc(opt_num_subbuf, sizeof(*ring->slot_fds));
+		if (!ring->slot_fds) {
+			perror("calloc");
+			exit(EXIT_FAILURE);
+		}
+		for (i = 0; i < opt_num_subbuf; i++) {
+			ring->slot_fds[i] = create_shm(opt_subbuf_size);
+			ring->slots[i] = map_shm(ring->slot_fds[i], opt_subbuf_size);
+		}
+		ring->fd = dup(ring->slot_fds[0]);
+		if (ring->fd < 0) {
+			perror("dup");
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		ring->fd = create_shm(opt_subbuf_size * opt_num_subbuf);
+		base = map_shm(ring->fd, opt_subbuf_size * opt_num_subbuf);
+		for (i = 0; i < opt_num_subbuf; i++) {
+			ring->slots[i] = base + i * opt_subbuf_size;
+		}
+	}
+
+	for (i = 0; i < opt_num_subbuf; i++) {
+		struct packet_header *header;
+
+		memset(ring->slots[i], 0x5a, content);
+		memset(ring->slots[i] + content, 0, opt_subbuf_size - content);
+
+		header = (struct packet_header *) ring->slots[i];
+		header->magic = CTF_MAGIC;
+		memset(header->uuid, 0x42, sizeof(header->uuid));
+		header->stream_id = 0;
+		header->timestamp_begin = header->timestamp_end = 0;
+		header->content_size = (uint64_t) content * CHAR_BIT;
+		header->packet_size = (uint64_t) opt_subbuf_size * CHAR_BIT;
+		header->events_discarded = 0;
+		header->cpu_id = cpu;
+	}
+}
+
+/* Create the consumer channel and streams the way the kernel consumer does. */
+static void setup_consumer(void)
+{
+	int ret, alloc_ret;
+	unsigned long i;
+	struct lttng_consumer_channel *channel;
+
+	channel = consumer_allocate_channel(1, 1, trace_dir, "bench",
+			getuid(), getgid(),
+			opt_mode == MODE_RELAYD ? RELAYD_NET_SEQ_IDX : (uint64_t) -1ULL,
+			opt_mode == MODE_SPLICE ? LTTNG_EVENT_SPLICE : LTTNG_EVENT_MMAP,
+			opt_tracefile_size, opt_tracefile_count, 0, 1, 0);
+	if (!channel) {
+		fprintf(stderr, "Channel allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	channel->type = CONSUMER_CHANNEL_TYPE_DATA;
+
+	for (i = 0; i < opt_streams; i++) {
+		struct lttng_consumer_stream *stream;
+
+		stream = consumer_allocate_stream(channel->key, rings[i].fd,
+				LTTNG_CONSUMER_ACTIVE_STREAM, channel->name,
+				channel->uid, channel->gid, channel->relayd_id,
+				channel->session_id, i, &alloc_ret, channel->type,
+				channel->monitor);
+		if (!stream) {
+			fprintf(stderr, "Stream allocation failed\n");
+			exit(EXIT_FAILURE);
+		}
+		stream->chan = channel;
+		stream->wait_fd = rings[i].fd;
+		stream->output = opt_mode == MODE_SPLICE ?
+				LTTNG_EVENT_SPLICE : LTTNG_EVENT_MMAP;
+		uatomic_inc(&channel->refcount);
+
+		ret = lttng_consumer_on_recv_stream(stream);
+		if (ret < 0) {
+			fprintf(stderr, "Stream %lu setup failed\n", i);
+			exit(EXIT_FAILURE);
+		}
+		if (opt_mode == MODE_RELAYD) {
+			ret = consumer_send_relayd_stream(stream, channel->pathname);
+			if (ret < 0) {
+				fprintf(stderr, "Sending stream %lu to the relayd failed\n",
+						i);
+				exit(EXIT_FAILURE);
+			}
+		}
+		rings[i].stream = stream;
+	}
+}
+
+static void setup_rings(void)
+{
+	unsigned long i;
+
+	rings = calloc(opt_streams, sizeof(*rings));
+	if (!rings) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < opt_streams; i++) {
+		setup_ring(&rings[i], i);
+		if (rings[i].fd >= nr_fd_rings) {
+			nr_fd_rings = rings[i].fd + 1;
+		}
+	}
+
+	fd_rings = calloc(nr_fd_rings, sizeof(*fd_rings));
+	if (!fd_rings) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < opt_streams; i++) {
+		fd_rings[rings[i].fd] = &rings[i];
+	}
+}
+
+/* Print the percentiles of the samples of all readers, in microseconds. */
+static void print_latency(const char *name, struct reader *readers,
+		size_t offset)
+{
+	unsigned long i, nr = 0;
+	uint64_t *all;
+
+	all = malloc(opt_readers * MAX_SAMPLES * sizeof(*all));
+	if (!all) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < opt_readers; i++) {
+		struct samples *samples = (void *) &readers[i] + offset;
+		unsigned long count = samples->nr < MAX_SAMPLES ?
+				samples->nr : MAX_SAMPLES;
+
+		memcpy(all + nr, samples->ns, count * sizeof(*all));
+		nr += count;
+	}
+
+	printf("%-18s", name);
+	if (nr) {
+		qsort(all, nr, sizeof(*all), cmp_u64);
+		printf("p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+				(double) all[nr / 2] / 1000,
+				(double) all[nr * 99 / 100] / 1000,
+				(double) all[nr * 999 / 1000] / 1000,
+				(double) all[nr - 1] / 1000);
+	} else {
+		printf("no sample\n");
+	}
+	free(all);
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+		struct FTW *ftwbuf)
+{
+	return remove(path);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-m mmap|splice|relayd] [-s STREAMS] "
+			"[-r READERS]\n"
+			"\t[-b SUBBUF_SIZE] [-n NUM_SUBBUF] [-f FILL] [-R RATE] "
+			"[-d SECONDS]\n"
+			"\t[-C TRACEFILE_SIZE] [-W TRACEFILE_COUNT] [-o DIR] [-D]\n",
+			prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = EXIT_SUCCESS;
+	unsigned long i;
+	uint64_t start, elapsed, bytes = 0, packets = 0, cpu_ns = 0;
+	uint64_t discarded = 0;
+	pthread_t producer_tid, relayd_tids[2];
+	struct reader *readers;
+
+	while ((opt = getopt(argc, argv, "m:s:r:b:n:f:R:d:C:W:o:Dh")) != -1) {
+		switch (opt) {
+		case 'm':
+			for (i = 0; i < ARRAY_SIZE(mode_str); i++) {
+				if (!strcmp(optarg, mode_str[i])) {
+					break;
+				}
+			}
+			if (i == ARRAY_SIZE(mode_str)) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			opt_mode = i;
+			break;
+		case 's':
+			opt_streams = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			opt_readers = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			opt_subbuf_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt_num_subbuf = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			opt_fill = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			opt_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			opt_tracefile_size = strtoull(optarg, NULL, 0);
+			break;
+		case 'W':
+			opt_tracefile_count = strtoull(optarg, NULL, 0);
+			break;
+		case 'o':
+			opt_dir = optarg;
+			break;
+		case 'D':
+			opt_direct_io = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_streams || !opt_readers || opt_readers > opt_streams ||
+			opt_subbuf_size < getpagesize() ||
+			(opt_subbuf_size & (opt_subbuf_size - 1)) ||
+			opt_num_subbuf < 2 || opt_fill > 100 ||
+			opt_subbuf_size * opt_fill / 100 <
+				sizeof(struct packet_header) ||
+			!opt_duration) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	snprintf(trace_dir, sizeof(trace_dir), "%s/bench-consumerd-XXXXXX",
+			opt_dir);
+	if (!mkdtemp(trace_dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	rcu_register_thread();
+	if (lttng_consumer_init()) {
+		fprintf(stderr, "Consumer initialization failed\n");
+		ret = EXIT_FAILURE;
+		goto end;
+	}
+	ctx = lttng_consumer_create(LTTNG_CONSUMER_KERNEL, NULL, NULL, NULL,
+			NULL);
+	if (!ctx) {
+		fprintf(stderr, "Consumer context creation failed\n");
+		ret = EXIT_FAILURE;
+		goto end;
+	}
+	lttng_consumer_set_direct_io(opt_direct_io);
+
+	if (opt_mode == MODE_RELAYD) {
+		setup_relayd(relayd_tids);
+	}
+	setup_rings();
+	setup_consumer();
+
+	readers = calloc(opt_readers, sizeof(*readers));
+	if (!readers) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	pthread_barrier_init(&barrier, NULL, opt_readers + 2);
+	if (pthread_create(&producer_tid, NULL, producer_thread, NULL)) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < opt_readers; i++) {
+		readers[i].id = i;
+		readers[i].service.ns = malloc(MAX_SAMPLES * sizeof(uint64_t));
+		readers[i].drain.ns = malloc(MAX_SAMPLES * sizeof(uint64_t));
+		if (!readers[i].service.ns || !readers[i].drain.ns) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		if (pthread_create(&readers[i].tid, NULL, reader_thread,
+					&readers[i])) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	pthread_barrier_wait(&barrier);
+	start = now_ns();
+	sleep(opt_duration);
+	CMM_STORE_SHARED(stop, 1);
+
+	for (i = 0; i < opt_readers; i++) {
+		pthread_join(readers[i].tid, NULL);
+		bytes += readers[i].bytes;
+		packets += readers[i].packets;
+		cpu_ns += readers[i].cpu_ns;
+		if (readers[i].error) {
+			ret = EXIT_FAILURE;
+		}
+	}
+	elapsed = now_ns() - start;
+	pthread_join(producer_tid, NULL);
+	for (i = 0; i < opt_streams; i++) {
+		discarded += rings[i].discarded;
+	}
+
+	printf("mode:             %s%s\n", mode_str[opt_mode],
+			opt_direct_io ? " (direct I/O)" : "");
+	printf("streams:          %lu (%lu reader thread%s)\n", opt_streams,
+			opt_readers, opt_readers > 1 ? "s" : "");
+	printf("sub-buffers:      %lu x %lu bytes, %lu%% full\n",
+			opt_num_subbuf, opt_subbuf_size, opt_fill);
+	printf("throughput:       %.1f MB/s (%" PRIu64 " packets)\n",
+			(double) bytes * 1000 / elapsed, packets);
+	printf("reader CPU:       %.2f s/GB\n", bytes ?
+			(double) cpu_ns / bytes : 0);
+	print_latency("service (us):", readers, offsetof(struct reader, service));
+	print_latency("drain (us):", readers, offsetof(struct reader, drain));
+	if (opt_rate) {
+		printf("discarded events: %" PRIu64 "\n", discarded);
+	}
+	if (opt_mode == MODE_RELAYD) {
+		printf("relayd received:  %" PRIu64 " bytes\n",
+				uatomic_read(&relayd_bytes));
+		/* The stand-in relay daemon stops on the end of its sockets. */
+		shutdown(relayd_fds[LTTNG_STREAM_CONTROL], SHUT_RDWR);
+		shutdown(relayd_fds[LTTNG_STREAM_DATA], SHUT_RDWR);
+		pthread_join(relayd_tids[0], NULL);
+		pthread_join(relayd_tids[1], NULL);
+	}
+
+	/* The consumer objects go away with the process. */
+end:
+	(void) nftw(trace_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	return ret;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Trace file write benchmark comparing the two output modes of the consumer
+ * daemon: buffered writes followed, like lttng_consumer_sync_trace_file(), by
+ * the writeout and page cache eviction of the previous packet, and O_DIRECT
+ * writes. Each run writes -n packets of -s bytes (a sub-buffer, page size
+ * multiple) from a page aligned buffer to a file created in -d, and reports
+ * the throughput, the CPU time used and the number of pages of the file left
+ * in the page cache.
+ *
+ * Usage: bench_direct_io [-d DIR] [-s PACKET_SIZE] [-n PACKETS] [-r RUNS]
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <common/compat/fcntl.h>
+#include <common/readwrite.h>
+#include <common/utils.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+enum bench_mode {
+	MODE_BUFFERED	= 0,
+	MODE_DIRECT	= 1,
+	NR_MODES	= 2,
+};
+
+static const char *mode_names[NR_MODES] = {
+	[MODE_BUFFERED] = "buffered",
+	[MODE_DIRECT] = "direct",
+};
+
+static const char *opt_dir = "/tmp";
+static uint64_t opt_packet_size = 1UL << 20;
+static unsigned long opt_packets = 1024;
+static unsigned long opt_runs = 3;
+
+static uint64_t cpu_ns(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+		1000000000ULL + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) *
+		1000ULL;
+}
+
+/*
+ * Return the number of pages of the file which are in the page cache.
+ */
+static long resident_pages(int fd, size_t len)
+{
+	long page_size = sysconf(_SC_PAGESIZE), nr = 0;
+	size_t i, nr_pages = (len + page_size - 1) / page_size;
+	unsigned char *vec;
+	void *addr;
+
+	addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	vec = malloc(nr_pages);
+	if (!vec || mincore(addr, len, vec) < 0) {
+		perror("mincore");
+		nr = -1;
+		goto end;
+	}
+	for (i = 0; i < nr_pages; i++) {
+		nr += vec[i] & 1;
+	}
+
+end:
+	free(vec);
+	munmap(addr, len);
+	return nr;
+}
+
+static int run_bench(enum bench_mode mode, char *buf)
+{
+	int fd, ret;
+	unsigned long i;
+	off_t offset = 0;
+	uint64_t start, start_cpu, elapsed, elapsed_cpu;
+	size_t len = opt_packet_size * opt_packets;
+	char path[PATH_MAX];
+	long resident;
+
+	snprintf(path, sizeof(path), "%s/bench_direct_io.XXXXXX", opt_dir);
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return -1;
+	}
+	unlink(path);
+
+	if (mode == MODE_DIRECT && utils_set_fd_direct_io(fd, 1) < 0) {
+		fprintf(stderr, "O_DIRECT not supported in %s\n", opt_dir);
+		ret = -1;
+		goto end;
+	}
+
+	start = now_ns();
+	start_cpu = cpu_ns();
+	for (i = 0; i < opt_packets; i++) {
+		/* Make every packet different, like the tracer does. */
+		buf[i % opt_packet_size] = i;
+		if (lttng_write(fd, buf, opt_packet_size) != opt_packet_size) {
+			perror("write");
+			ret = -1;
+			goto end;
+		}
+		if (mode == MODE_BUFFERED) {
+			lttng_sync_file_range(fd, offset, opt_packet_size,
+					SYNC_FILE_RANGE_WRITE);
+			if (offset >= opt_packet_size) {
+				lttng_sync_file_range(fd, offset - opt_packet_size,
+						opt_packet_size, SYNC_FILE_RANGE_WAIT_BEFORE |
+						SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+				posix_fadvise(fd, offset - opt_packet_size,
+						opt_packet_size, POSIX_FADV_DONTNEED);
+			}
+		}
+		offset += opt_packet_size;
+	}
+	/* Both modes end with the data on disk. */
+	fdatasync(fd);
+	elapsed = now_ns() - start;
+	elapsed_cpu = cpu_ns() - start_cpu;
+
+	resident = resident_pages(fd, len);
+	printf("%10s %10" PRIu64 " %10lu %12.1f %12.1f %10ld\n", mode_names[mode],
+			opt_packet_size, opt_packets,
+			(double) len / elapsed * 1000000000.0 / (1 << 20),
+			(double) elapsed_cpu / opt_packets / 1000.0, resident);
+	ret = 0;
+
+end:
+	close(fd);
+	return ret;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-d DIR] [-s PACKET_SIZE] [-n PACKETS] "
+			"[-r RUNS]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	unsigned long run;
+	void *buf;
+
+	while ((opt = getopt(argc, argv, "d:s:n:r:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			opt_dir = optarg;
+			break;
+		case 's':
+			if (utils_parse_size_suffix(optarg, &opt_packet_size) < 0) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			opt_packets = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			opt_runs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_packets || !opt_runs ||
+			!utils_is_direct_io_aligned(0, opt_packet_size, NULL)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* Page aligned, like the ring buffer mapping. */
+	if (posix_memalign(&buf, sysconf(_SC_PAGESIZE), opt_packet_size)) {
+		fprintf(stderr, "Allocating packet buffer\n");
+		return EXIT_FAILURE;
+	}
+	memset(buf, 0x42, opt_packet_size);
+
+	printf("# %8s %10s %10s %12s %12s %10s\n", "mode", "packet", "packets",
+			"MiB/s", "cpu(us/pkt)", "cached");
+	for (run = 0; run < opt_runs; run++) {
+		if (run_bench(MODE_BUFFERED, buf) || run_bench(MODE_DIRECT, buf)) {
+			fprintf(stderr, "Benchmark failed\n");
+			free(buf);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free(buf);
+	return EXIT_SUCCESS;
+}
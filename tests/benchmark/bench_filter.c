@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Per-event cost of filter expressions. Each expression, given with -e or
+ * taken from the defaults below, is compiled without and with the IR
+ * optimizations, then run by the reference interpreter over -n generated
+ * event payloads, -l times. The bytecode size, the time per event and the
+ * share of recorded events are reported for both. The interpreter follows
+ * the tracers, so the ratio between two filters carries over to the tracer,
+ * if not the absolute time.
+ *
+ * The payloads have the integer fields a and b, the floating point field d,
+ * the string field s and the vtid and procname contexts. With -k, the
+ * filters are compiled for the kernel domain and d is an integer.
+ *
+ * Usage: bench_filter [-e EXPRESSION]... [-k] [-n PAYLOADS] [-l LOOPS]
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <common/macros.h>
+#include <lib/lttng-ctl/filter/filter-interpreter.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define NR_FIELDS		6
+
+static const char *default_expressions[] = {
+	"a == 1",
+	"a >= 10 && a <= 20",
+	"a == 1 || a == 2 || a == 3 || a == 4",
+	"s == \"foo\"",
+	"s == \"foo*\" || s == \"bar*\"",
+	"$ctx.vtid == 42 && (a < 10 || d > 5.5)",
+	"($ctx.procname == \"app*\" && a != 3) || (b > 100 && s != \"x\")",
+};
+
+static const char *strings[] = { "foo", "foobar", "bar", "baz", "x", "" };
+static const char *procnames[] = { "app-1", "app-2", "daemon", "shell" };
+
+static int opt_kernel;
+static unsigned long opt_payloads = 1024;
+static unsigned long opt_loops = 1000;
+
+static const char **expressions;
+static unsigned long nr_expressions;
+
+/* All the payloads have the same fields, in the same order. */
+static struct filter_payload *build_payloads(void)
+{
+	unsigned long i;
+	struct filter_payload *payloads;
+	struct filter_payload_field *fields;
+
+	payloads = calloc(opt_payloads, sizeof(*payloads));
+	fields = calloc(opt_payloads * NR_FIELDS, sizeof(*fields));
+	if (!payloads || !fields) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	srand(42);
+	for (i = 0; i < opt_payloads; i++) {
+		struct filter_payload_field *f = &fields[i * NR_FIELDS];
+
+		f[0].name = "a";
+		f[0].value.type = FILTER_VALUE_S64;
+		f[0].value.u.s64 = rand() % 32;
+		f[1].name = "b";
+		f[1].value.type = FILTER_VALUE_S64;
+		f[1].value.u.s64 = rand() % 200;
+		f[2].name = "d";
+		if (opt_kernel) {
+			f[2].value.type = FILTER_VALUE_S64;
+			f[2].value.u.s64 = rand() % 10;
+		} else {
+			f[2].value.type = FILTER_VALUE_DOUBLE;
+			f[2].value.u.d = (rand() % 100) / 10.0;
+		}
+		f[3].name = "s";
+		f[3].value.type = FILTER_VALUE_STRING;
+		f[3].value.u.str = strings[rand() % ARRAY_SIZE(strings)];
+		f[4].name = "vtid";
+		f[4].context = 1;
+		f[4].value.type = FILTER_VALUE_S64;
+		f[4].value.u.s64 = 40 + rand() % 4;
+		f[5].name = "procname";
+		f[5].context = 1;
+		f[5].value.type = FILTER_VALUE_STRING;
+		f[5].value.u.str = procnames[rand() % ARRAY_SIZE(procnames)];
+
+		payloads[i].fields = f;
+		payloads[i].nr_fields = NR_FIELDS;
+	}
+
+	return payloads;
+}
+
+/*
+ * Run a filter over all the payloads opt_loops times. Return the time per
+ * event in ns and the number of recorded events of a single pass.
+ */
+static double run(const char *expression, int optimize,
+		const struct filter_payload *payloads, uint32_t *len,
+		unsigned long *recorded)
+{
+	unsigned long i, j;
+	uint64_t start, elapsed;
+	struct lttng_filter_bytecode_alloc *bytecode;
+	struct filter_program program;
+	int ret;
+
+	bytecode = filter_bytecode_compile(expression, optimize, opt_kernel);
+	if (!bytecode) {
+		fprintf(stderr, "Invalid filter expression: %s\n", expression);
+		exit(EXIT_FAILURE);
+	}
+	if (filter_program_link(&program, &bytecode->b, &payloads[0])) {
+		fprintf(stderr, "Unable to link filter: %s\n", expression);
+		exit(EXIT_FAILURE);
+	}
+	*len = bytecode->b.reloc_table_offset;
+
+	*recorded = 0;
+	for (i = 0; i < opt_payloads; i++) {
+		ret = filter_program_run(&program, &payloads[i]);
+		if (ret < 0) {
+			fprintf(stderr, "Evaluation error on payload %lu: %s\n", i,
+					expression);
+			exit(EXIT_FAILURE);
+		}
+		*recorded += ret;
+	}
+
+	start = now_ns();
+	for (j = 0; j < opt_loops; j++) {
+		for (i = 0; i < opt_payloads; i++) {
+			(void) filter_program_run(&program, &payloads[i]);
+		}
+	}
+	elapsed = now_ns() - start;
+
+	filter_program_fini(&program);
+	free(bytecode);
+	return (double) elapsed / (opt_loops * opt_payloads);
+}
+
+static void bench(const char *expression,
+		const struct filter_payload *payloads)
+{
+	uint32_t plain_len, opt_len;
+	unsigned long plain_recorded, opt_recorded;
+	double plain_ns, opt_ns;
+
+	plain_ns = run(expression, 0, payloads, &plain_len, &plain_recorded);
+	opt_ns = run(expression, 1, payloads, &opt_len, &opt_recorded);
+	if (plain_recorded != opt_recorded) {
+		fprintf(stderr, "Optimized filter records %lu events instead of %lu: %s\n",
+				opt_recorded, plain_recorded, expression);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%8" PRIu32 " %8" PRIu32 " %10.1f %10.1f %7.1f%%  %s\n",
+			plain_len, opt_len, plain_ns, opt_ns,
+			100.0 * plain_recorded / opt_payloads, expression);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-e EXPRESSION]... [-k] [-n PAYLOADS] "
+			"[-l LOOPS]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	unsigned long i;
+	struct filter_payload *payloads;
+
+	while ((opt = getopt(argc, argv, "e:kn:l:h")) != -1) {
+		switch (opt) {
+		case 'e':
+			expressions = realloc(expressions,
+					(nr_expressions + 1) * sizeof(*expressions));
+			if (!expressions) {
+				perror("realloc");
+				return EXIT_FAILURE;
+			}
+			expressions[nr_expressions++] = optarg;
+			break;
+		case 'k':
+			opt_kernel = 1;
+			break;
+		case 'n':
+			opt_payloads = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			opt_loops = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_payloads || !opt_loops) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	payloads = build_payloads();
+
+	printf("# %6s %8s %10s %10s %8s  %s\n", "len(B)", "opt(B)",
+			"ns/event", "opt(ns)", "recorded", "expression");
+	if (nr_expressions) {
+		for (i = 0; i < nr_expressions; i++) {
+			bench(expressions[i], payloads);
+		}
+	} else {
+		for (i = 0; i < ARRAY_SIZE(default_expressions); i++) {
+			bench(default_expressions[i], payloads);
+		}
+	}
+
+	free(payloads[0].fields);
+	free(payloads);
+	free(expressions);
+	return EXIT_SUCCESS;
+}
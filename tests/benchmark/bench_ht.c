@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Micro-benchmark of the lttng_ht wrapper. For each table size (from 1024
+ * entries up to -n, growing by a factor of 4) and each thread count (from 1
+ * up to -t, doubling), the threads concurrently insert their share of the
+ * keys, perform -l random lookups each and then delete their keys. The cost
+ * per operation of each phase is reported in nanoseconds.
+ *
+ * Usage: bench_ht [-k u64|ulong|two_u64] [-n ENTRIES] [-t THREADS] [-l LOOKUPS]
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <urcu.h>
+
+#include <common/hashtable/hashtable.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define MIN_ENTRIES		1024UL
+
+enum bench_phase {
+	PHASE_INSERT	= 0,
+	PHASE_LOOKUP	= 1,
+	PHASE_DELETE	= 2,
+	NR_PHASES		= 3,
+};
+
+struct bench_node {
+	union {
+		struct lttng_ht_node_ulong ulong;
+		struct lttng_ht_node_u64 u64;
+		struct lttng_ht_node_two_u64 two_u64;
+	} u;
+};
+
+struct bench_thread {
+	pthread_t tid;
+	unsigned int seed;
+	unsigned long first, last;
+	unsigned long misses;
+};
+
+static int opt_type = LTTNG_HT_TYPE_U64;
+static unsigned long opt_entries = 1UL << 20;
+static unsigned long opt_threads = 4;
+static unsigned long opt_lookups = 1000000;
+
+static struct lttng_ht *bench_ht;
+static struct bench_node *nodes;
+static unsigned long nr_entries;
+static pthread_barrier_t barrier;
+
+/*
+ * Keys are spread the way object keys usually are: two u64 keys pair a small
+ * session id with a sequential key.
+ */
+static void bench_add(unsigned long i)
+{
+	struct bench_node *node = &nodes[i];
+
+	switch (opt_type) {
+	case LTTNG_HT_TYPE_ULONG:
+		lttng_ht_node_init_ulong(&node->u.ulong, i);
+		lttng_ht_add_unique_ulong(bench_ht, &node->u.ulong);
+		break;
+	case LTTNG_HT_TYPE_U64:
+		lttng_ht_node_init_u64(&node->u.u64, i);
+		lttng_ht_add_unique_u64(bench_ht, &node->u.u64);
+		break;
+	case LTTNG_HT_TYPE_TWO_U64:
+		lttng_ht_node_init_two_u64(&node->u.two_u64, i & 0xff, i >> 8);
+		lttng_ht_add_unique_two_u64(bench_ht, &node->u.two_u64);
+		break;
+	default:
+		assert(0);
+	}
+}
+
+static void bench_lookup(unsigned long i, struct lttng_ht_iter *iter)
+{
+	uint64_t u64_key = i;
+	struct lttng_ht_two_u64 two_u64_key = {
+		.key1 = i & 0xff,
+		.key2 = i >> 8,
+	};
+
+	switch (opt_type) {
+	case LTTNG_HT_TYPE_ULONG:
+		lttng_ht_lookup(bench_ht, (void *) i, iter);
+		break;
+	case LTTNG_HT_TYPE_U64:
+		lttng_ht_lookup(bench_ht, &u64_key, iter);
+		break;
+	case LTTNG_HT_TYPE_TWO_U64:
+		lttng_ht_lookup(bench_ht, &two_u64_key, iter);
+		break;
+	default:
+		assert(0);
+	}
+}
+
+static void *bench_thread(void *data)
+{
+	unsigned long i;
+	struct lttng_ht_iter iter;
+	struct bench_thread *th = data;
+
+	rcu_register_thread();
+
+	/* Insert phase. */
+	pthread_barrier_wait(&barrier);
+	rcu_read_lock();
+	for (i = th->first; i < th->last; i++) {
+		bench_add(i);
+	}
+	rcu_read_unlock();
+	pthread_barrier_wait(&barrier);
+
+	/* Lookup phase. */
+	pthread_barrier_wait(&barrier);
+	rcu_read_lock();
+	for (i = 0; i < opt_lookups; i++) {
+		bench_lookup(rand_r(&th->seed) % nr_entries, &iter);
+		if (!cds_lfht_iter_get_node(&iter.iter)) {
+			th->misses++;
+		}
+	}
+	rcu_read_unlock();
+	pthread_barrier_wait(&barrier);
+
+	/* Delete phase. */
+	pthread_barrier_wait(&barrier);
+	rcu_read_lock();
+	for (i = th->first; i < th->last; i++) {
+		bench_lookup(i, &iter);
+		if (lttng_ht_del(bench_ht, &iter)) {
+			th->misses++;
+		}
+	}
+	rcu_read_unlock();
+	pthread_barrier_wait(&barrier);
+
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static int run_bench(unsigned long entries, unsigned long nr_threads)
+{
+	int ret, phase;
+	unsigned long i, misses = 0;
+	uint64_t start, elapsed[NR_PHASES];
+	struct bench_thread *threads;
+
+	nr_entries = entries;
+	bench_ht = lttng_ht_new(0, opt_type);
+	nodes = calloc(entries, sizeof(*nodes));
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!bench_ht || !nodes || !threads) {
+		ret = -1;
+		goto end;
+	}
+
+	pthread_barrier_init(&barrier, NULL, nr_threads + 1);
+	for (i = 0; i < nr_threads; i++) {
+		threads[i].seed = i + 1;
+		threads[i].first = entries * i / nr_threads;
+		threads[i].last = entries * (i + 1) / nr_threads;
+		ret = pthread_create(&threads[i].tid, NULL, bench_thread, &threads[i]);
+		if (ret) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (phase = 0; phase < NR_PHASES; phase++) {
+		pthread_barrier_wait(&barrier);
+		start = now_ns();
+		pthread_barrier_wait(&barrier);
+		elapsed[phase] = now_ns() - start;
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(threads[i].tid, NULL);
+		misses += threads[i].misses;
+	}
+	pthread_barrier_destroy(&barrier);
+
+	printf("%10lu %8lu %12.1f %12.1f %12.1f %8lu\n", entries, nr_threads,
+			(double) elapsed[PHASE_INSERT] * nr_threads / entries,
+			(double) elapsed[PHASE_LOOKUP] / opt_lookups,
+			(double) elapsed[PHASE_DELETE] * nr_threads / entries,
+			misses);
+	ret = 0;
+
+end:
+	/* Deleted nodes can still be referenced by concurrent readers. */
+	synchronize_rcu();
+	if (bench_ht) {
+		lttng_ht_destroy(bench_ht);
+	}
+	free(nodes);
+	free(threads);
+	return ret;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-k u64|ulong|two_u64] [-n ENTRIES] "
+			"[-t THREADS] [-l LOOKUPS]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	unsigned long entries, threads;
+
+	while ((opt = getopt(argc, argv, "k:n:t:l:h")) != -1) {
+		switch (opt) {
+		case 'k':
+			if (!strcmp(optarg, "u64")) {
+				opt_type = LTTNG_HT_TYPE_U64;
+			} else if (!strcmp(optarg, "ulong")) {
+				opt_type = LTTNG_HT_TYPE_ULONG;
+			} else if (!strcmp(optarg, "two_u64")) {
+				opt_type = LTTNG_HT_TYPE_TWO_U64;
+			} else {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			opt_entries = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			opt_lookups = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (opt_entries < MIN_ENTRIES || !opt_threads || !opt_lookups) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rcu_register_thread();
+
+	printf("# %10s %8s %12s %12s %12s %8s\n", "entries", "threads",
+			"insert(ns)", "lookup(ns)", "delete(ns)", "misses");
+	for (entries = MIN_ENTRIES; entries <= opt_entries; entries *= 4) {
+		for (threads = 1; threads <= opt_threads; threads *= 2) {
+			if (run_bench(entries, threads)) {
+				fprintf(stderr, "Benchmark failed\n");
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	rcu_unregister_thread();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Cost of a "lttng list -u" reply in the plain and in the compact list
+ * formats. For each tracepoint count (from 1000 up to -n, growing by a factor
+ * of 4), a tracepoint list is built the way the session daemon builds it from
+ * -a applications registering the same events, each event having -f fields.
+ * The reply of the tracepoint list and of the field list is then sent through
+ * a unix socket pair and converted back to the public structures on the
+ * other side, which is what a list command costs once the session daemon has
+ * the list. The bytes on the wire and the time of a round of both replies
+ * are reported, along with the time the session daemon spends encoding the
+ * compact replies.
+ *
+ * Usage: bench_list [-n EVENTS] [-a APPS] [-f FIELDS] [-l LOOPS]
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <common/sessiond-comm/list.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define MIN_EVENTS		1000UL
+
+static unsigned long opt_events = 64000;
+static unsigned long opt_apps = 20;
+static unsigned long opt_fields = 4;
+static unsigned long opt_loops = 10;
+
+struct reply {
+	char *payload;
+	size_t len;
+};
+
+/* Replies sent by the session daemon side, alternating events and fields. */
+struct sender_data {
+	int fd;
+	struct reply replies[2];
+};
+
+static void build_lists(unsigned long nb_events, struct lttng_event **events,
+		struct lttng_event_field **fields)
+{
+	unsigned long i, per_app = nb_events / opt_apps;
+	struct lttng_event *ev;
+	struct lttng_event_field *fi;
+
+	ev = calloc(nb_events, sizeof(*ev));
+	fi = calloc(nb_events * opt_fields, sizeof(*fi));
+	if (!ev || !fi) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < nb_events; i++) {
+		snprintf(ev[i].name, sizeof(ev[i].name), "provider_%lu:event_%lu",
+				(i % per_app) / 32, i % per_app);
+		ev[i].type = LTTNG_EVENT_TRACEPOINT;
+		ev[i].loglevel = 13;
+		ev[i].enabled = -1;
+		ev[i].pid = 1000 + i / per_app;
+	}
+	for (i = 0; i < nb_events * opt_fields; i++) {
+		snprintf(fi[i].field_name, sizeof(fi[i].field_name), "field_%lu",
+				i % opt_fields);
+		fi[i].type = LTTNG_EVENT_FIELD_INTEGER;
+		fi[i].event = ev[i / opt_fields];
+	}
+
+	*events = ev;
+	*fields = fi;
+}
+
+static void xfer_full(int fd, char *buf, size_t len, int send)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = send ? write(fd, buf, len) : read(fd, buf, len);
+		if (ret <= 0) {
+			perror(send ? "write" : "read");
+			exit(EXIT_FAILURE);
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* The session daemon side: send the length then the payload. */
+static void *sender(void *data)
+{
+	unsigned long i;
+	struct sender_data *sender_data = data;
+
+	for (i = 0; i < 2 * opt_loops; i++) {
+		struct reply *reply = &sender_data->replies[i % 2];
+		uint64_t len = reply->len;
+
+		xfer_full(sender_data->fd, (char *) &len, sizeof(len), 1);
+		xfer_full(sender_data->fd, reply->payload, reply->len, 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * Send the event and field replies opt_loops times and decode them. Return
+ * the elapsed time of a single event and field list round.
+ */
+static uint64_t run(struct reply *replies, int compact,
+		unsigned long nb_events)
+{
+	int fds[2];
+	unsigned long i;
+	uint64_t start, elapsed;
+	pthread_t tid;
+	struct sender_data sender_data;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		perror("socketpair");
+		exit(EXIT_FAILURE);
+	}
+	sender_data.fd = fds[0];
+	memcpy(sender_data.replies, replies, sizeof(sender_data.replies));
+
+	start = now_ns();
+	if (pthread_create(&tid, NULL, sender, &sender_data)) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < 2 * opt_loops; i++) {
+		uint64_t len;
+		char *buf;
+		ssize_t nb;
+
+		xfer_full(fds[1], (char *) &len, sizeof(len), 0);
+		buf = malloc(len);
+		if (!buf) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		xfer_full(fds[1], buf, len, 0);
+
+		if (!compact) {
+			/* The plain arrays are handed to the caller as is. */
+			free(buf);
+			continue;
+		}
+		if (i % 2 == 0) {
+			struct lttng_event *events;
+
+			nb = lttcomm_list_decode_events(buf, len, &events);
+			if (nb == nb_events) {
+				free(events);
+			}
+		} else {
+			struct lttng_event_field *fields;
+
+			nb = lttcomm_list_decode_fields(buf, len, &fields);
+			if (nb == nb_events * opt_fields) {
+				free(fields);
+			}
+		}
+		if (nb < 0) {
+			fprintf(stderr, "Decoding failed\n");
+			exit(EXIT_FAILURE);
+		}
+		free(buf);
+	}
+	pthread_join(tid, NULL);
+	elapsed = now_ns() - start;
+
+	close(fds[0]);
+	close(fds[1]);
+	return elapsed / opt_loops;
+}
+
+static void bench(unsigned long nb_events)
+{
+	ssize_t len;
+	uint64_t plain_ns, compact_ns, encode_start, encode_ns;
+	struct lttng_event *events;
+	struct lttng_event_field *fields;
+	struct reply plain[2], compact[2];
+
+	build_lists(nb_events, &events, &fields);
+
+	plain[0].payload = (char *) events;
+	plain[0].len = nb_events * sizeof(*events);
+	plain[1].payload = (char *) fields;
+	plain[1].len = nb_events * opt_fields * sizeof(*fields);
+
+	encode_start = now_ns();
+	len = lttcomm_list_encode_events(events, nb_events, &compact[0].payload);
+	if (len < 0) {
+		fprintf(stderr, "Encoding failed\n");
+		exit(EXIT_FAILURE);
+	}
+	compact[0].len = len;
+	len = lttcomm_list_encode_fields(fields, nb_events * opt_fields,
+			&compact[1].payload);
+	if (len < 0) {
+		fprintf(stderr, "Encoding failed\n");
+		exit(EXIT_FAILURE);
+	}
+	compact[1].len = len;
+	encode_ns = now_ns() - encode_start;
+
+	plain_ns = run(plain, 0, nb_events);
+	compact_ns = run(compact, 1, nb_events);
+
+	printf("%8lu %12zu %12zu %10.2f %10.2f %10.2f\n", nb_events,
+			plain[0].len + plain[1].len,
+			compact[0].len + compact[1].len,
+			(double) plain_ns / 1000000,
+			(double) compact_ns / 1000000,
+			(double) encode_ns / 1000000);
+
+	free(compact[0].payload);
+	free(compact[1].payload);
+	free(events);
+	free(fields);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n EVENTS] [-a APPS] [-f FIELDS] "
+			"[-l LOOPS]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	unsigned long nb_events;
+
+	while ((opt = getopt(argc, argv, "n:a:f:l:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			opt_events = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			opt_apps = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			opt_fields = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			opt_loops = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (opt_events < MIN_EVENTS || !opt_apps || opt_apps > MIN_EVENTS ||
+			!opt_fields || !opt_loops) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("# %6s %12s %12s %10s %10s %10s\n", "events", "plain(B)",
+			"compact(B)", "plain(ms)", "compact(ms)", "encode(ms)");
+	for (nb_events = MIN_EVENTS; nb_events <= opt_events; nb_events *= 4) {
+		bench(nb_events);
+	}
+
+	return EXIT_SUCCESS;
+}
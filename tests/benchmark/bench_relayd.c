@@ -0,0 +1,903 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Load generator for a running relay daemon. -H simulated hosts each open a
+ * control and a data connection, create a live session and stream packets
+ * to -s streams the way a consumer daemon does: a data header and the packet
+ * on the data connection, then the index on the control connection, which
+ * the relay daemon acknowledges. -v simulated live viewers, at most one per
+ * session, attach to the sessions from their last packets and read every
+ * new packet through the index and packet commands, either polling every -P
+ * milliseconds or, with -N, woken up by index notifications.
+ *
+ * Reported are the ingest throughput, the percentiles of the index
+ * round-trip time, the throughput read by the viewers and the percentiles of
+ * the freshness of the packets they read: the time from the index of a
+ * packet being sent by its host to the viewer receiving that index.
+ *
+ * The relay daemon stores the traces as usual, under
+ * bench-host-N/bench-PID/kernel in its output directory, rotated according
+ * to -C and -W; they are not removed.
+ *
+ * Usage: bench_relayd [-U URL] [-L LIVE_URL] [-H HOSTS] [-s STREAMS]
+ *        [-b PACKET_SIZE] [-f FILL] [-R RATE] [-v VIEWERS] [-P POLL_MS] [-N]
+ *        [-T LIVE_TIMER] [-C TRACEFILE_SIZE] [-W TRACEFILE_COUNT]
+ *        [-d SECONDS]
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+
+#include <common/common.h>
+#include <common/compat/endian.h>
+#include <common/index/ctf-index.h>
+#include <common/relayd/relayd.h>
+#include <common/sessiond-comm/relayd.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <common/uri.h>
+
+#include <bin/lttng-relayd/lttng-viewer-abi.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define CTF_MAGIC		0xC1FC1FC1
+/* Index round trips and freshness samples kept per thread, the last ones. */
+#define MAX_SAMPLES		(1UL << 20)
+
+static const char metadata[] =
+	"/* CTF 1.8 */\n"
+	"trace {\n"
+	"\tmajor = 1;\n"
+	"\tminor = 8;\n"
+	"\tbyte_order = le;\n"
+	"};\n";
+
+struct samples {
+	uint64_t *ns;
+	unsigned long nr;
+};
+
+struct host_stream {
+	uint64_t id;
+	uint64_t net_seq_num;
+	uint64_t last_ts;
+};
+
+struct host {
+	pthread_t tid;
+	unsigned long id;
+	struct lttcomm_relayd_sock *control;
+	struct lttcomm_relayd_sock *data;
+	uint64_t session_id;
+	struct host_stream *streams;
+	char *packet;
+	uint64_t bytes;
+	uint64_t packets;
+	struct samples index_rtt;
+	int error;
+};
+
+struct viewer {
+	pthread_t tid;
+	struct host *host;
+	struct lttcomm_sock *cmd_sock;
+	struct lttcomm_sock *notif_sock;
+	uint64_t metadata_id;
+	int has_metadata;
+	uint64_t *streams;
+	unsigned long nr_streams;
+	char *buf;
+	size_t buf_len;
+	uint64_t bytes;
+	uint64_t packets;
+	struct samples freshness;
+	int error;
+};
+
+static const char *opt_url = "net://localhost";
+static const char *opt_live_url = "tcp://localhost";
+static unsigned long opt_hosts = 4;
+static unsigned long opt_streams = 4;
+static unsigned long opt_packet_size = DEFAULT_KERNEL_CHANNEL_SUBBUF_SIZE;
+static unsigned long opt_fill = 100;
+static unsigned long opt_rate;
+static unsigned long opt_viewers = 1;
+static unsigned long opt_poll_ms = 10;
+static int opt_notify;
+static unsigned long opt_live_timer = DEFAULT_LTTNG_LIVE_TIMER;
+static uint64_t opt_tracefile_size = 64 * 1024 * 1024;
+static uint64_t opt_tracefile_count = 4;
+static unsigned long opt_duration = 5;
+
+static struct lttng_uri *relayd_uris;
+static struct lttng_uri *live_uri;
+static pthread_barrier_t barrier;
+static int stop;
+
+static void init_samples(struct samples *samples)
+{
+	samples->ns = malloc(MAX_SAMPLES * sizeof(*samples->ns));
+	if (!samples->ns) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	samples->nr = 0;
+}
+
+static void add_sample(struct samples *samples, uint64_t ns)
+{
+	samples->ns[samples->nr++ % MAX_SAMPLES] = ns;
+}
+
+static struct lttcomm_relayd_sock *connect_relayd(struct lttng_uri *uri)
+{
+	struct lttcomm_relayd_sock *rsock;
+
+	rsock = lttcomm_alloc_relayd_sock(uri, RELAYD_VERSION_COMM_MAJOR,
+			RELAYD_VERSION_COMM_MINOR);
+	if (!rsock || relayd_connect(rsock) < 0) {
+		fprintf(stderr, "Unable to reach the relay daemon\n");
+		exit(EXIT_FAILURE);
+	}
+	if (uri->stype == LTTNG_STREAM_CONTROL &&
+			relayd_version_check(rsock) < 0) {
+		fprintf(stderr, "Relay daemon version check failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return rsock;
+}
+
+/*
+ * Create the session of a host, its metadata and its streams, as the session
+ * and consumer daemons do for a kernel session streamed live.
+ */
+static void setup_host(struct host *host)
+{
+	unsigned long i;
+	uint64_t metadata_id;
+	char session_name[NAME_MAX], hostname[NAME_MAX], path[PATH_MAX];
+	char channel_name[NAME_MAX];
+	size_t content = opt_packet_size * opt_fill / 100;
+	struct lttcomm_relayd_metadata_payload payload;
+
+	host->control = connect_relayd(&relayd_uris[0]);
+	host->data = connect_relayd(&relayd_uris[1]);
+
+	snprintf(session_name, sizeof(session_name), "bench-%d", getpid());
+	snprintf(hostname, sizeof(hostname), "bench-host-%lu", host->id);
+	snprintf(path, sizeof(path), "%s/%s/kernel", hostname, session_name);
+	if (relayd_create_session(host->control, &host->session_id,
+				session_name, hostname, opt_live_timer, 0) < 0) {
+		fprintf(stderr, "Session creation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Metadata goes on the control connection, right after its command. */
+	if (relayd_add_stream(host->control, DEFAULT_METADATA_NAME, path,
+				&metadata_id, 0, 0) < 0 ||
+			relayd_send_metadata(host->control,
+				sizeof(payload) + sizeof(metadata)) < 0) {
+		fprintf(stderr, "Sending the metadata failed\n");
+		exit(EXIT_FAILURE);
+	}
+	payload.stream_id = htobe64(metadata_id);
+	payload.padding_size = 0;
+	if (lttng_write(host->control->sock.fd, &payload, sizeof(payload)) !=
+				sizeof(payload) ||
+			lttng_write(host->control->sock.fd, metadata,
+				sizeof(metadata)) != sizeof(metadata)) {
+		perror("write metadata");
+		exit(EXIT_FAILURE);
+	}
+
+	host->streams = calloc(opt_streams, sizeof(*host->streams));
+	if (!host->streams) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < opt_streams; i++) {
+		snprintf(channel_name, sizeof(channel_name), "channel0_%lu", i);
+		if (relayd_add_stream(host->control, channel_name, path,
+					&host->streams[i].id, opt_tracefile_size,
+					opt_tracefile_count) < 0) {
+			fprintf(stderr, "Stream creation failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (relayd_streams_sent(host->control) < 0) {
+		fprintf(stderr, "Streams sent command failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	host->packet = calloc(1, opt_packet_size);
+	if (!host->packet) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	*(uint32_t *) host->packet = CTF_MAGIC;
+	memset(host->packet + sizeof(uint32_t), 0x5a,
+			content - sizeof(uint32_t));
+	init_samples(&host->index_rtt);
+}
+
+/* Send a packet of a stream and its index. */
+static int send_packet(struct host *host, struct host_stream *stream)
+{
+	uint64_t now, start;
+	size_t content = opt_packet_size * opt_fill / 100;
+	struct lttcomm_relayd_data_hdr hdr;
+	struct ctf_packet_index index;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.stream_id = htobe64(stream->id);
+	hdr.net_seq_num = htobe64(stream->net_seq_num);
+	hdr.data_size = htobe32(content);
+	hdr.padding_size = htobe32(opt_packet_size - content);
+	if (relayd_send_data_hdr(host->data, &hdr, sizeof(hdr)) < 0 ||
+			lttng_write(host->data->sock.fd, host->packet, content) !=
+				content) {
+		return -1;
+	}
+
+	now = now_ns();
+	memset(&index, 0, sizeof(index));
+	index.packet_size = htobe64((uint64_t) opt_packet_size * CHAR_BIT);
+	index.content_size = htobe64((uint64_t) content * CHAR_BIT);
+	/* The viewers compute the freshness from the end timestamp. */
+	index.timestamp_begin = htobe64(stream->last_ts);
+	index.timestamp_end = htobe64(now);
+	stream->last_ts = now;
+
+	start = now_ns();
+	if (relayd_send_index(host->control, &index, stream->id,
+				stream->net_seq_num) < 0) {
+		return -1;
+	}
+	add_sample(&host->index_rtt, now_ns() - start);
+
+	stream->net_seq_num++;
+	host->bytes += opt_packet_size;
+	host->packets++;
+	return 0;
+}
+
+static void *host_thread(void *data)
+{
+	unsigned long i;
+	uint64_t next_ts, interval = 0;
+	struct host *host = data;
+
+	if (opt_rate) {
+		/* Nanoseconds between two packets of the host. */
+		interval = (uint64_t) opt_packet_size * 1000 / opt_rate;
+	}
+
+	pthread_barrier_wait(&barrier);
+	next_ts = now_ns();
+	for (i = 0; i < opt_streams; i++) {
+		host->streams[i].last_ts = next_ts;
+	}
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		for (i = 0; i < opt_streams && !CMM_LOAD_SHARED(stop); i++) {
+			if (opt_rate) {
+				uint64_t now = now_ns();
+
+				if (now < next_ts) {
+					usleep((next_ts - now) / 1000);
+				}
+				next_ts += interval;
+			}
+			if (send_packet(host, &host->streams[i])) {
+				fprintf(stderr, "Host %lu lost the relay daemon\n",
+						host->id);
+				host->error = 1;
+				return NULL;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static struct lttcomm_sock *connect_live(enum lttng_viewer_connection_type type)
+{
+	struct lttcomm_sock *sock;
+	struct lttng_viewer_cmd cmd;
+	struct lttng_viewer_connect msg;
+
+	sock = lttcomm_alloc_sock_from_uri(live_uri);
+	if (!sock || lttcomm_create_sock(sock) < 0 ||
+			sock->ops->connect(sock) < 0) {
+		fprintf(stderr, "Unable to reach the relay daemon live port\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.data_size = htobe64(sizeof(msg));
+	cmd.cmd = htobe32(LTTNG_VIEWER_CONNECT);
+	memset(&msg, 0, sizeof(msg));
+	msg.major = htobe32(RELAYD_VERSION_COMM_MAJOR);
+	msg.minor = htobe32(RELAYD_VERSION_COMM_MINOR);
+	msg.type = htobe32(type);
+	if (lttng_write(sock->fd, &cmd, sizeof(cmd)) != sizeof(cmd) ||
+			lttng_write(sock->fd, &msg, sizeof(msg)) != sizeof(msg) ||
+			lttng_read(sock->fd, &msg, sizeof(msg)) != sizeof(msg)) {
+		fprintf(stderr, "Viewer handshake failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return sock;
+}
+
+/* Send a viewer command and receive the fixed part of its reply. */
+static int viewer_cmd(struct viewer *viewer, uint32_t cmd_type,
+		const void *request, size_t request_len,
+		void *reply, size_t reply_len)
+{
+	int fd = viewer->cmd_sock->fd;
+	struct lttng_viewer_cmd cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.data_size = htobe64(request_len);
+	cmd.cmd = htobe32(cmd_type);
+	if (lttng_write(fd, &cmd, sizeof(cmd)) != sizeof(cmd) ||
+			(request_len &&
+				lttng_write(fd, request, request_len) != request_len) ||
+			lttng_read(fd, reply, reply_len) != reply_len) {
+		return -1;
+	}
+	return 0;
+}
+
+static int viewer_recv(struct viewer *viewer, size_t len)
+{
+	if (len > viewer->buf_len) {
+		char *buf = realloc(viewer->buf, len);
+
+		if (!buf) {
+			return -1;
+		}
+		viewer->buf = buf;
+		viewer->buf_len = len;
+	}
+	return lttng_read(viewer->cmd_sock->fd, viewer->buf, len) == len ? 0 : -1;
+}
+
+static int recv_streams(struct viewer *viewer, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		struct lttng_viewer_stream stream;
+		uint64_t *streams;
+
+		if (lttng_read(viewer->cmd_sock->fd, &stream, sizeof(stream)) !=
+				sizeof(stream)) {
+			return -1;
+		}
+		if (be32toh(stream.metadata_flag)) {
+			viewer->metadata_id = be64toh(stream.id);
+			viewer->has_metadata = 1;
+			continue;
+		}
+		streams = realloc(viewer->streams,
+				(viewer->nr_streams + 1) * sizeof(*streams));
+		if (!streams) {
+			return -1;
+		}
+		streams[viewer->nr_streams++] = be64toh(stream.id);
+		viewer->streams = streams;
+	}
+	return 0;
+}
+
+static int get_metadata(struct viewer *viewer)
+{
+	struct lttng_viewer_get_metadata request;
+	struct lttng_viewer_metadata_packet reply;
+
+	if (!viewer->has_metadata) {
+		return 0;
+	}
+	request.stream_id = htobe64(viewer->metadata_id);
+
+	for (;;) {
+		if (viewer_cmd(viewer, LTTNG_VIEWER_GET_METADATA, &request,
+					sizeof(request), &reply, sizeof(reply))) {
+			return -1;
+		}
+		switch (be32toh(reply.status)) {
+		case LTTNG_VIEWER_METADATA_OK:
+			if (viewer_recv(viewer, be64toh(reply.len))) {
+				return -1;
+			}
+			break;
+		case LTTNG_VIEWER_NO_NEW_METADATA:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+}
+
+static int get_new_streams(struct viewer *viewer)
+{
+	struct lttng_viewer_new_streams_request request;
+	struct lttng_viewer_new_streams_response response;
+
+	request.session_id = htobe64(viewer->host->session_id);
+	if (viewer_cmd(viewer, LTTNG_VIEWER_GET_NEW_STREAMS, &request,
+				sizeof(request), &response, sizeof(response))) {
+		return -1;
+	}
+	if (be32toh(response.status) != LTTNG_VIEWER_NEW_STREAMS_OK) {
+		return 0;
+	}
+	return recv_streams(viewer, be32toh(response.streams_count));
+}
+
+/* Get the packet of an index, fetching the metadata first if needed. */
+static int get_packet(struct viewer *viewer, uint64_t stream_id,
+		struct lttng_viewer_index *index)
+{
+	int retried = 0;
+	uint32_t len;
+	struct lttng_viewer_get_packet request;
+	struct lttng_viewer_trace_packet reply;
+
+	request.stream_id = htobe64(stream_id);
+	request.offset = index->offset;
+	request.len = htobe32(be64toh(index->packet_size) / CHAR_BIT);
+
+retry:
+	if (viewer_cmd(viewer, LTTNG_VIEWER_GET_PACKET, &request,
+				sizeof(request), &reply, sizeof(reply))) {
+		return -1;
+	}
+	switch (be32toh(reply.status)) {
+	case LTTNG_VIEWER_GET_PACKET_OK:
+		len = be32toh(reply.len);
+		if (viewer_recv(viewer, len)) {
+			return -1;
+		}
+		viewer->bytes += len;
+		viewer->packets++;
+		return 0;
+	case LTTNG_VIEWER_GET_PACKET_ERR:
+		if (!retried &&
+				(be32toh(reply.flags) & LTTNG_VIEWER_FLAG_NEW_METADATA)) {
+			retried = 1;
+			if (get_metadata(viewer)) {
+				return -1;
+			}
+			goto retry;
+		}
+		return -1;
+	default:
+		/* Retry or end of file, the index is dropped. */
+		return 0;
+	}
+}
+
+/*
+ * Read every packet of a stream available on the relay daemon.
+ *
+ * Return the number of packets read or -1 on error.
+ */
+static int drain_stream(struct viewer *viewer, unsigned long idx)
+{
+	int nr = 0;
+	uint32_t flags;
+	uint64_t stream_id = viewer->streams[idx];
+	struct lttng_viewer_get_next_index request;
+	struct lttng_viewer_index index;
+
+	for (;;) {
+		request.stream_id = htobe64(stream_id);
+		if (viewer_cmd(viewer, LTTNG_VIEWER_GET_NEXT_INDEX, &request,
+					sizeof(request), &index, sizeof(index))) {
+			return -1;
+		}
+		flags = be32toh(index.flags);
+		if ((flags & LTTNG_VIEWER_FLAG_NEW_STREAM) &&
+				get_new_streams(viewer)) {
+			return -1;
+		}
+		if ((flags & LTTNG_VIEWER_FLAG_NEW_METADATA) &&
+				get_metadata(viewer)) {
+			return -1;
+		}
+
+		switch (be32toh(index.status)) {
+		case LTTNG_VIEWER_INDEX_OK:
+			break;
+		case LTTNG_VIEWER_INDEX_RETRY:
+		case LTTNG_VIEWER_INDEX_INACTIVE:
+			return nr;
+		case LTTNG_VIEWER_INDEX_HUP:
+		case LTTNG_VIEWER_INDEX_EOF:
+			/* Stream gone, stop asking for it. */
+			viewer->streams[idx] = viewer->streams[--viewer->nr_streams];
+			return nr;
+		default:
+			return -1;
+		}
+
+		add_sample(&viewer->freshness,
+				now_ns() - be64toh(index.timestamp_end));
+		if (get_packet(viewer, stream_id, &index)) {
+			return -1;
+		}
+		nr++;
+	}
+}
+
+static void setup_viewer(struct viewer *viewer)
+{
+	struct lttng_viewer_create_session_response create;
+	struct lttng_viewer_attach_session_request attach;
+	struct lttng_viewer_attach_session_response attach_reply;
+	struct lttng_viewer_subscribe subscribe;
+	struct lttng_viewer_subscribe_response subscribe_reply;
+
+	viewer->cmd_sock = connect_live(LTTNG_VIEWER_CLIENT_COMMAND);
+	if (viewer_cmd(viewer, LTTNG_VIEWER_CREATE_SESSION, NULL, 0, &create,
+				sizeof(create)) ||
+			be32toh(create.status) != LTTNG_VIEWER_CREATE_SESSION_OK) {
+		fprintf(stderr, "Viewer session creation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&attach, 0, sizeof(attach));
+	attach.session_id = htobe64(viewer->host->session_id);
+	attach.seek = htobe32(LTTNG_VIEWER_SEEK_LAST);
+	if (viewer_cmd(viewer, LTTNG_VIEWER_ATTACH_SESSION, &attach,
+				sizeof(attach), &attach_reply, sizeof(attach_reply)) ||
+			be32toh(attach_reply.status) != LTTNG_VIEWER_ATTACH_OK ||
+			recv_streams(viewer, be32toh(attach_reply.streams_count)) ||
+			get_metadata(viewer)) {
+		fprintf(stderr, "Viewer attach failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (opt_notify) {
+		struct lttng_viewer_cmd cmd;
+		int fd;
+
+		viewer->notif_sock = connect_live(LTTNG_VIEWER_CLIENT_NOTIFICATION);
+		fd = viewer->notif_sock->fd;
+
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.data_size = htobe64(sizeof(subscribe));
+		cmd.cmd = htobe32(LTTNG_VIEWER_SUBSCRIBE);
+		subscribe.session_id = attach.session_id;
+		if (lttng_write(fd, &cmd, sizeof(cmd)) != sizeof(cmd) ||
+				lttng_write(fd, &subscribe, sizeof(subscribe)) !=
+					sizeof(subscribe) ||
+				lttng_read(fd, &subscribe_reply,
+					sizeof(subscribe_reply)) !=
+					sizeof(subscribe_reply) ||
+				be32toh(subscribe_reply.status) !=
+					LTTNG_VIEWER_SUBSCRIBE_OK) {
+			fprintf(stderr, "Viewer subscription failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	init_samples(&viewer->freshness);
+}
+
+/* Wait for new indexes: notified or after the poll period. */
+static void viewer_wait(struct viewer *viewer)
+{
+	struct pollfd pollfd;
+	char buf[64 * sizeof(struct lttng_viewer_index_notification)];
+
+	if (!viewer->notif_sock) {
+		usleep(opt_poll_ms * 1000);
+		return;
+	}
+
+	/*
+	 * Every stream is read again once woken up, the notifications themselves
+	 * are only drained.
+	 */
+	pollfd.fd = viewer->notif_sock->fd;
+	pollfd.events = POLLIN;
+	if (poll(&pollfd, 1, opt_poll_ms) > 0) {
+		while (recv(pollfd.fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+			;
+		}
+	}
+}
+
+static void *viewer_thread(void *data)
+{
+	unsigned long i;
+	struct viewer *viewer = data;
+
+	pthread_barrier_wait(&barrier);
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		int nr = 0;
+
+		for (i = 0; i < viewer->nr_streams; i++) {
+			int ret = drain_stream(viewer, i);
+
+			if (ret < 0) {
+				fprintf(stderr, "Viewer of host %lu failed\n",
+						viewer->host->id);
+				viewer->error = 1;
+				return NULL;
+			}
+			nr += ret;
+		}
+		if (!nr) {
+			viewer_wait(viewer);
+		}
+	}
+
+	return NULL;
+}
+
+/* Print the percentiles of a set of samples in the given unit. */
+static void print_samples(const char *name, struct samples **sets,
+		unsigned long nr_sets, double unit_ns)
+{
+	unsigned long i, nr = 0;
+	uint64_t *all;
+
+	all = malloc(nr_sets * MAX_SAMPLES * sizeof(*all));
+	if (!all) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nr_sets; i++) {
+		unsigned long count = sets[i]->nr < MAX_SAMPLES ?
+				sets[i]->nr : MAX_SAMPLES;
+
+		memcpy(all + nr, sets[i]->ns, count * sizeof(*all));
+		nr += count;
+	}
+
+	printf("%-18s", name);
+	if (nr) {
+		qsort(all, nr, sizeof(*all), cmp_u64);
+		printf("p50 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+				all[nr / 2] / unit_ns,
+				all[nr * 99 / 100] / unit_ns,
+				all[nr * 999 / 1000] / unit_ns,
+				all[nr - 1] / unit_ns);
+	} else {
+		printf("no sample\n");
+	}
+	free(all);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-U URL] [-L LIVE_URL] [-H HOSTS] "
+			"[-s STREAMS]\n"
+			"\t[-b PACKET_SIZE] [-f FILL] [-R RATE] [-v VIEWERS] "
+			"[-P POLL_MS] [-N]\n"
+			"\t[-T LIVE_TIMER] [-C TRACEFILE_SIZE] [-W TRACEFILE_COUNT] "
+			"[-d SECONDS]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = EXIT_SUCCESS;
+	unsigned long i;
+	ssize_t nr_uris;
+	uint64_t start, elapsed, bytes = 0, packets = 0;
+	uint64_t viewer_bytes = 0, viewer_packets = 0;
+	struct host *hosts;
+	struct viewer *viewers;
+	struct samples **sets;
+	char live_url[PATH_MAX];
+
+	while ((opt = getopt(argc, argv, "U:L:H:s:b:f:R:v:P:NT:C:W:d:h")) != -1) {
+		switch (opt) {
+		case 'U':
+			opt_url = optarg;
+			break;
+		case 'L':
+			opt_live_url = optarg;
+			break;
+		case 'H':
+			opt_hosts = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opt_streams = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			opt_packet_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			opt_fill = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			opt_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			opt_viewers = strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			opt_poll_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'N':
+			opt_notify = 1;
+			break;
+		case 'T':
+			opt_live_timer = strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			opt_tracefile_size = strtoull(optarg, NULL, 0);
+			break;
+		case 'W':
+			opt_tracefile_count = strtoull(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt_duration = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* A relay daemon accepts a single viewer per session. */
+	if (!opt_hosts || !opt_streams || opt_viewers > opt_hosts ||
+			opt_fill > 100 ||
+			opt_packet_size * opt_fill / 100 < sizeof(uint32_t) ||
+			!opt_live_timer || !opt_duration) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	nr_uris = uri_parse_str_urls(opt_url, NULL, &relayd_uris);
+	if (nr_uris != 2 || relayd_uris[0].dtype == LTTNG_DST_PATH) {
+		fprintf(stderr, "Invalid relay daemon URL %s\n", opt_url);
+		return EXIT_FAILURE;
+	}
+	/* Same default port as lttng-relayd when the live URL has none. */
+	if (!strchr(opt_live_url + strlen("tcp://"), ':')) {
+		snprintf(live_url, sizeof(live_url), "%s:%d", opt_live_url,
+				DEFAULT_NETWORK_VIEWER_PORT);
+	} else {
+		snprintf(live_url, sizeof(live_url), "%s", opt_live_url);
+	}
+	if (uri_parse(live_url, &live_uri) != 1) {
+		fprintf(stderr, "Invalid live URL %s\n", live_url);
+		return EXIT_FAILURE;
+	}
+
+	hosts = calloc(opt_hosts, sizeof(*hosts));
+	viewers = calloc(opt_viewers, sizeof(*viewers));
+	sets = calloc(opt_hosts + opt_viewers, sizeof(*sets));
+	if (!hosts || (opt_viewers && !viewers) || !sets) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < opt_hosts; i++) {
+		hosts[i].id = i;
+		setup_host(&hosts[i]);
+	}
+	for (i = 0; i < opt_viewers; i++) {
+		viewers[i].host = &hosts[i];
+		setup_viewer(&viewers[i]);
+	}
+
+	pthread_barrier_init(&barrier, NULL, opt_hosts + opt_viewers + 1);
+	for (i = 0; i < opt_hosts; i++) {
+		if (pthread_create(&hosts[i].tid, NULL, host_thread, &hosts[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+	for (i = 0; i < opt_viewers; i++) {
+		if (pthread_create(&viewers[i].tid, NULL, viewer_thread,
+					&viewers[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	pthread_barrier_wait(&barrier);
+	start = now_ns();
+	sleep(opt_duration);
+	CMM_STORE_SHARED(stop, 1);
+
+	for (i = 0; i < opt_hosts; i++) {
+		pthread_join(hosts[i].tid, NULL);
+		bytes += hosts[i].bytes;
+		packets += hosts[i].packets;
+		if (hosts[i].error) {
+			ret = EXIT_FAILURE;
+		}
+	}
+	elapsed = now_ns() - start;
+	for (i = 0; i < opt_viewers; i++) {
+		pthread_join(viewers[i].tid, NULL);
+		viewer_bytes += viewers[i].bytes;
+		viewer_packets += viewers[i].packets;
+		if (viewers[i].error) {
+			ret = EXIT_FAILURE;
+		}
+	}
+
+	printf("relayd:           %s, live %s\n", opt_url, live_url);
+	printf("hosts:            %lu x %lu streams, packets of %lu bytes "
+			"(%lu%% full)\n", opt_hosts, opt_streams, opt_packet_size,
+			opt_fill);
+	printf("ingest:           %.1f MB/s (%" PRIu64 " packets)\n",
+			(double) bytes * 1000 / elapsed, packets);
+	for (i = 0; i < opt_hosts; i++) {
+		sets[i] = &hosts[i].index_rtt;
+	}
+	print_samples("index RTT (us):", sets, opt_hosts, 1000.0);
+	if (opt_viewers) {
+		printf("viewers:          %lu (%s every %lu ms), %.1f MB/s "
+				"(%" PRIu64 " packets)\n", opt_viewers,
+				opt_notify ? "notified or" : "polling", opt_poll_ms,
+				(double) viewer_bytes * 1000 / elapsed, viewer_packets);
+		for (i = 0; i < opt_viewers; i++) {
+			sets[i] = &viewers[i].freshness;
+		}
+		print_samples("freshness (ms):", sets, opt_viewers, 1000000.0);
+	}
+
+	/* Closing the control connection ends the session on the relayd side. */
+	for (i = 0; i < opt_viewers; i++) {
+		lttcomm_destroy_sock(viewers[i].cmd_sock);
+		if (viewers[i].notif_sock) {
+			lttcomm_destroy_sock(viewers[i].notif_sock);
+		}
+	}
+	for (i = 0; i < opt_hosts; i++) {
+		unsigned long j;
+
+		for (j = 0; j < opt_streams && !hosts[i].error; j++) {
+			struct host_stream *stream = &hosts[i].streams[j];
+
+			(void) relayd_send_close_stream(hosts[i].control, stream->id,
+					stream->net_seq_num - 1);
+		}
+		(void) relayd_close(hosts[i].control);
+		(void) relayd_close(hosts[i].data);
+	}
+
+	return ret;
+}
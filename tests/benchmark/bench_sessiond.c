@@ -0,0 +1,1138 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Control plane scalability of a running session daemon with many UST
+ * applications. The applications are simulated in this process: each one
+ * registers a command and a notify socket on the session daemon application
+ * socket, answers the tracer commands and registers its channels and -e
+ * events on the notify socket when its tracing sessions start, like
+ * liblttng-ust does. The session daemon sees distinct processes of the same
+ * uid and does all of its usual per-application work; the consumer daemon
+ * allocates real buffers, whose file descriptors are closed on reception.
+ *
+ * For each application count, from 1 up to -n growing by a factor of 4, the
+ * new applications register in a burst, optionally while a session is
+ * started (-A), then -l rounds of create, enable-event, list, start, stop and
+ * destroy are run through liblttng-ctl. The median latency of the
+ * registration and of each command is reported along with the resident
+ * memory of the session daemon. Stop does not wait for the data to be
+ * flushed, which is the consumer daemon work.
+ *
+ * The session daemon needs a file descriptor limit above twice the
+ * application count, e.g. ulimit -n before launching it.
+ *
+ * Usage: bench_sessiond [-n APPS] [-e EVENTS] [-l LOOPS] [-t THREADS] [-p]
+ *        [-A] [-S APPS_SOCKET] [-P SESSIOND_PID]
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+
+#include <lttng/lttng.h>
+#include <common/common.h>
+#include <common/defaults.h>
+#include <common/sessiond-comm/sessiond-comm.h>
+#include <common/utils.h>
+
+#include <bin/lttng-sessiond/lttng-ust-ctl.h>
+#include <bin/lttng-sessiond/lttng-ust-error.h>
+
+#include "bench.h"
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/*
+ * Wire format of the liblttng-ust communication layer (ust-comm.h of
+ * lttng-ust), spoken by the session daemon through liblttng-ust-ctl. It is
+ * not installed by lttng-ust.
+ */
+#define LTTNG_UST_EXCLUSION			0xA1
+#define LTTNG_UST_COMM_REG_MSG_PADDING		64
+#define USTCOMM_MSG_PADDING1			32
+#define USTCOMM_MSG_PADDING2			32
+#define USTCOMM_REPLY_PADDING1			32
+#define USTCOMM_REPLY_PADDING2			32
+#define USTCOMM_NOTIFY_EVENT_MSG_PADDING	32
+#define USTCOMM_NOTIFY_EVENT_REPLY_PADDING	32
+#define USTCOMM_NOTIFY_CHANNEL_MSG_PADDING	32
+#define USTCOMM_NOTIFY_CHANNEL_REPLY_PADDING	32
+
+struct ustctl_reg_msg {
+	uint32_t magic;
+	uint32_t major;
+	uint32_t minor;
+	uint32_t pid;
+	uint32_t ppid;
+	uint32_t uid;
+	uint32_t gid;
+	uint32_t bits_per_long;
+	uint32_t uint8_t_alignment;
+	uint32_t uint16_t_alignment;
+	uint32_t uint32_t_alignment;
+	uint32_t uint64_t_alignment;
+	uint32_t long_alignment;
+	uint32_t socket_type;			/* enum ustctl_socket_type */
+	char name[LTTNG_UST_ABI_PROCNAME_LEN];
+	char padding[LTTNG_UST_COMM_REG_MSG_PADDING];
+} LTTNG_PACKED;
+
+struct ustcomm_ust_msg {
+	uint32_t handle;
+	uint32_t cmd;
+	char padding[USTCOMM_MSG_PADDING1];
+	union {
+		struct lttng_ust_channel channel;
+		struct lttng_ust_stream stream;
+		struct lttng_ust_event event;
+		struct lttng_ust_context context;
+		struct lttng_ust_tracer_version version;
+		struct lttng_ust_tracepoint_iter tracepoint;
+		struct {
+			uint32_t data_size;	/* following filter data */
+			uint32_t reloc_offset;
+			uint64_t seqnum;
+		} LTTNG_PACKED filter;
+		struct {
+			uint32_t count;		/* how many names follow */
+		} LTTNG_PACKED exclusion;
+		char padding[USTCOMM_MSG_PADDING2];
+	} u;
+} LTTNG_PACKED;
+
+struct ustcomm_ust_reply {
+	uint32_t handle;
+	uint32_t cmd;
+	int32_t ret_code;
+	uint32_t ret_val;
+	char padding[USTCOMM_REPLY_PADDING1];
+	union {
+		struct {
+			uint64_t memory_map_size;
+		} LTTNG_PACKED channel;
+		struct {
+			uint64_t memory_map_size;
+		} LTTNG_PACKED stream;
+		struct lttng_ust_tracer_version version;
+		struct lttng_ust_tracepoint_iter tracepoint;
+		char padding[USTCOMM_REPLY_PADDING2];
+	} u;
+} LTTNG_PACKED;
+
+struct ustcomm_notify_hdr {
+	uint32_t notify_cmd;
+} LTTNG_PACKED;
+
+struct ustcomm_notify_event_msg {
+	uint32_t session_objd;
+	uint32_t channel_objd;
+	char event_name[LTTNG_UST_SYM_NAME_LEN];
+	int32_t loglevel;
+	uint32_t signature_len;
+	uint32_t fields_len;
+	uint32_t model_emf_uri_len;
+	char padding[USTCOMM_NOTIFY_EVENT_MSG_PADDING];
+} LTTNG_PACKED;
+
+struct ustcomm_notify_event_reply {
+	int32_t ret_code;
+	uint32_t event_id;
+	char padding[USTCOMM_NOTIFY_EVENT_REPLY_PADDING];
+} LTTNG_PACKED;
+
+struct ustcomm_notify_channel_msg {
+	uint32_t session_objd;
+	uint32_t channel_objd;
+	uint32_t ctx_fields_len;
+	char padding[USTCOMM_NOTIFY_CHANNEL_MSG_PADDING];
+} LTTNG_PACKED;
+
+struct ustcomm_notify_channel_reply {
+	int32_t ret_code;
+	uint32_t chan_id;
+	uint32_t header_type;
+	char padding[USTCOMM_NOTIFY_CHANNEL_REPLY_PADDING];
+} LTTNG_PACKED;
+
+/* Above the largest pid_max, so no simulated pid is the one of a real app. */
+#define FAKE_PID_BASE		(1U << 22)
+#define NR_EVENT_FIELDS		2
+#define INIT_OBJECTS		16
+#define REGISTRATION_TIMEOUT	60	/* seconds */
+
+enum object_type {
+	OBJ_FREE = 0,
+	OBJ_ROOT,
+	OBJ_SESSION,
+	OBJ_CHANNEL,
+	OBJ_EVENT,
+	OBJ_CONTEXT,
+	OBJ_TP_LIST,
+	OBJ_FIELD_LIST,
+};
+
+/* Tracer object of an application, indexed by its handle. */
+struct object {
+	enum object_type type;
+	uint32_t parent;
+	int active;			/* Session started. */
+	int registered;			/* Channel registered. */
+	unsigned char *tp_registered;	/* Channel events registered. */
+	unsigned long list_pos;		/* Tracepoint list iterator. */
+	char name[LTTNG_UST_SYM_NAME_LEN];
+};
+
+struct app {
+	unsigned long id;
+	int cmd_fd;
+	int notify_fd;
+	struct object *objs;
+	uint32_t nr_objs;
+	uint64_t reg_start;
+	uint64_t reg_ns;
+	int dead;
+};
+
+struct worker {
+	pthread_t tid;
+	int epfd;
+};
+
+static const char *steps[] = {
+	"create", "enable", "list", "start", "stop", "destroy",
+};
+#define NR_STEPS	(sizeof(steps) / sizeof(steps[0]))
+
+static unsigned long opt_apps = 1024;
+static unsigned long opt_events = 16;
+static unsigned long opt_loops = 5;
+static unsigned long opt_threads = 4;
+static int opt_per_pid;
+static int opt_active;
+static const char *opt_sock_path;
+static pid_t opt_sessiond_pid;
+
+static struct app *apps;
+static unsigned long nr_apps;
+static struct worker *workers;
+static struct ustctl_field event_fields[NR_EVENT_FIELDS];
+static char output_dir[] = "/tmp/bench-sessiond-XXXXXX";
+static char sock_path[PATH_MAX];
+static unsigned long nr_registered;
+static unsigned long nr_dead;
+static int stop;
+
+static double median_ms(uint64_t *ns, unsigned long nr)
+{
+	qsort(ns, nr, sizeof(*ns), cmp_u64);
+	return (double) ns[nr / 2] / 1000000;
+}
+
+/* Read and drop len bytes following a command. */
+static int skip(int fd, size_t len)
+{
+	char buf[4096];
+
+	while (len) {
+		size_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+
+		if (lttng_read(fd, buf, chunk) != chunk) {
+			return -1;
+		}
+		len -= chunk;
+	}
+	return 0;
+}
+
+/* Receive and close the file descriptors of a channel or a stream. */
+static int recv_fds(int fd, size_t nb_fd)
+{
+	char dummy;
+	char tmp[CMSG_SPACE(LTTCOMM_MAX_SEND_FDS * sizeof(int))];
+	ssize_t ret;
+	size_t i;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &dummy;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = tmp;
+	msg.msg_controllen = CMSG_SPACE(nb_fd * sizeof(int));
+
+	do {
+		ret = recvmsg(fd, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0) {
+		return -1;
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+			cmsg->cmsg_len != CMSG_LEN(nb_fd * sizeof(int))) {
+		return -1;
+	}
+	for (i = 0; i < nb_fd; i++) {
+		int rfd;
+
+		memcpy(&rfd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+		close(rfd);
+	}
+	return 0;
+}
+
+static int alloc_object(struct app *app, enum object_type type,
+		uint32_t parent)
+{
+	uint32_t i;
+	struct object *obj;
+
+	for (i = 1; i < app->nr_objs; i++) {
+		if (app->objs[i].type == OBJ_FREE) {
+			break;
+		}
+	}
+	if (i == app->nr_objs) {
+		uint32_t nr = app->nr_objs * 2;
+
+		obj = realloc(app->objs, nr * sizeof(*obj));
+		if (!obj) {
+			return -1;
+		}
+		memset(obj + app->nr_objs, 0, (nr - app->nr_objs) * sizeof(*obj));
+		app->objs = obj;
+		app->nr_objs = nr;
+	}
+
+	obj = &app->objs[i];
+	memset(obj, 0, sizeof(*obj));
+	obj->type = type;
+	obj->parent = parent;
+	if (type == OBJ_CHANNEL) {
+		obj->tp_registered = calloc(opt_events, 1);
+		if (!obj->tp_registered) {
+			return -1;
+		}
+	}
+	return i;
+}
+
+static struct object *get_object(struct app *app, uint32_t handle)
+{
+	if (handle >= app->nr_objs || app->objs[handle].type == OBJ_FREE) {
+		return NULL;
+	}
+	return &app->objs[handle];
+}
+
+/* Release an object and, as the tracer does, the objects it owns. */
+static void release_object(struct app *app, uint32_t handle)
+{
+	uint32_t i;
+	struct object *obj = get_object(app, handle);
+
+	if (!obj || obj->type == OBJ_ROOT) {
+		return;
+	}
+	obj->type = OBJ_FREE;
+	free(obj->tp_registered);
+	obj->tp_registered = NULL;
+	for (i = 1; i < app->nr_objs; i++) {
+		if (app->objs[i].type != OBJ_FREE && app->objs[i].parent == handle) {
+			release_object(app, i);
+		}
+	}
+}
+
+static void tracepoint_name(unsigned long i, char *name, size_t len)
+{
+	snprintf(name, len, "bench_app:event_%lu", i);
+}
+
+/* Enabler names are either exact or end with a '*' wildcard. */
+static int enabler_match(const char *enabler, const char *name)
+{
+	size_t len = strlen(enabler);
+
+	if (len && enabler[len - 1] == '*') {
+		return !strncmp(enabler, name, len - 1);
+	}
+	return !strcmp(enabler, name);
+}
+
+static int register_channel(struct app *app, uint32_t session,
+		uint32_t channel)
+{
+	struct {
+		struct ustcomm_notify_hdr header;
+		struct ustcomm_notify_channel_msg m;
+	} LTTNG_PACKED msg;
+	struct {
+		struct ustcomm_notify_hdr header;
+		struct ustcomm_notify_channel_reply r;
+	} LTTNG_PACKED reply;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.header.notify_cmd = USTCTL_NOTIFY_CMD_CHANNEL;
+	msg.m.session_objd = session;
+	msg.m.channel_objd = channel;
+	if (lttng_write(app->notify_fd, &msg, sizeof(msg)) != sizeof(msg) ||
+			lttng_read(app->notify_fd, &reply, sizeof(reply)) !=
+				sizeof(reply) ||
+			reply.header.notify_cmd != USTCTL_NOTIFY_CMD_CHANNEL) {
+		return -1;
+	}
+	return 0;
+}
+
+static int register_event(struct app *app, uint32_t session,
+		uint32_t channel, const char *name)
+{
+	static const char signature[] = "int, int";
+	struct {
+		struct ustcomm_notify_hdr header;
+		struct ustcomm_notify_event_msg m;
+	} LTTNG_PACKED msg;
+	struct {
+		struct ustcomm_notify_hdr header;
+		struct ustcomm_notify_event_reply r;
+	} LTTNG_PACKED reply;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.header.notify_cmd = USTCTL_NOTIFY_CMD_EVENT;
+	msg.m.session_objd = session;
+	msg.m.channel_objd = channel;
+	strncpy(msg.m.event_name, name, sizeof(msg.m.event_name) - 1);
+	msg.m.loglevel = 13;
+	msg.m.signature_len = sizeof(signature);
+	msg.m.fields_len = sizeof(event_fields);
+	if (lttng_write(app->notify_fd, &msg, sizeof(msg)) != sizeof(msg) ||
+			lttng_write(app->notify_fd, signature, sizeof(signature)) !=
+				sizeof(signature) ||
+			lttng_write(app->notify_fd, event_fields,
+				sizeof(event_fields)) != sizeof(event_fields) ||
+			lttng_read(app->notify_fd, &reply, sizeof(reply)) !=
+				sizeof(reply) ||
+			reply.header.notify_cmd != USTCTL_NOTIFY_CMD_EVENT) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Register a channel of a started session and the tracepoints its enablers
+ * match, once each.
+ */
+static int sync_channel(struct app *app, uint32_t channel)
+{
+	uint32_t i;
+	unsigned long tp;
+	struct object *chan = &app->objs[channel];
+	char name[LTTNG_UST_SYM_NAME_LEN];
+
+	if (!chan->registered) {
+		if (register_channel(app, chan->parent, channel)) {
+			return -1;
+		}
+		chan->registered = 1;
+	}
+
+	for (i = 1; i < app->nr_objs; i++) {
+		struct object *event = &app->objs[i];
+
+		if (event->type != OBJ_EVENT || event->parent != channel) {
+			continue;
+		}
+		for (tp = 0; tp < opt_events; tp++) {
+			if (chan->tp_registered[tp]) {
+				continue;
+			}
+			tracepoint_name(tp, name, sizeof(name));
+			if (!enabler_match(event->name, name)) {
+				continue;
+			}
+			if (register_event(app, chan->parent, channel, name)) {
+				return -1;
+			}
+			chan->tp_registered[tp] = 1;
+		}
+	}
+	return 0;
+}
+
+static int sync_session(struct app *app, uint32_t session)
+{
+	uint32_t i;
+
+	for (i = 1; i < app->nr_objs; i++) {
+		if (app->objs[i].type == OBJ_CHANNEL &&
+				app->objs[i].parent == session &&
+				sync_channel(app, i)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Answer a command of the session daemon.
+ *
+ * Return 0 on success or -1 if the command socket is no longer usable.
+ */
+static int handle_cmd(struct app *app)
+{
+	int ret = 0, handle, is_event;
+	struct object *obj, *session;
+	struct ustcomm_ust_msg msg;
+	struct ustcomm_ust_reply reply;
+
+	if (lttng_read(app->cmd_fd, &msg, sizeof(msg)) != sizeof(msg)) {
+		return -1;
+	}
+
+	memset(&reply, 0, sizeof(reply));
+	reply.handle = msg.handle;
+	reply.cmd = msg.cmd;
+	obj = get_object(app, msg.handle);
+	if (!obj) {
+		reply.ret_code = -LTTNG_UST_ERR_INVAL;
+	}
+
+	switch (msg.cmd) {
+	case LTTNG_UST_RELEASE:
+		release_object(app, msg.handle);
+		break;
+	case LTTNG_UST_TRACER_VERSION:
+		reply.u.version.major = 2;
+		reply.u.version.minor = 6;
+		break;
+	case LTTNG_UST_REGISTER_DONE:
+		app->reg_ns = now_ns() - app->reg_start;
+		uatomic_inc(&nr_registered);
+		break;
+	case LTTNG_UST_SESSION:
+	case LTTNG_UST_TRACEPOINT_LIST:
+	case LTTNG_UST_TRACEPOINT_FIELD_LIST:
+		handle = alloc_object(app, msg.cmd == LTTNG_UST_SESSION ?
+				OBJ_SESSION : msg.cmd == LTTNG_UST_TRACEPOINT_LIST ?
+				OBJ_TP_LIST : OBJ_FIELD_LIST, 0);
+		if (handle < 0) {
+			return -1;
+		}
+		reply.ret_val = handle;
+		break;
+	case LTTNG_UST_TRACEPOINT_LIST_GET:
+		if (!obj || obj->list_pos >= opt_events) {
+			reply.ret_code = -LTTNG_UST_ERR_NOENT;
+			break;
+		}
+		tracepoint_name(obj->list_pos++, reply.u.tracepoint.name,
+				sizeof(reply.u.tracepoint.name));
+		reply.u.tracepoint.loglevel = 13;
+		break;
+	case LTTNG_UST_TRACEPOINT_FIELD_LIST_GET:
+		/* No field list, it would follow the reply. */
+		reply.ret_code = -LTTNG_UST_ERR_NOENT;
+		break;
+	case LTTNG_UST_CHANNEL:
+		if (msg.u.channel.len > LTTNG_UST_CHANNEL_DATA_MAX_LEN ||
+				skip(app->cmd_fd, msg.u.channel.len) ||
+				recv_fds(app->cmd_fd, 1)) {
+			return -1;
+		}
+		if (obj) {
+			handle = alloc_object(app, OBJ_CHANNEL, msg.handle);
+			if (handle < 0) {
+				return -1;
+			}
+			reply.ret_val = handle;
+		}
+		break;
+	case LTTNG_UST_STREAM:
+		/* Shared memory and wakeup file descriptors. */
+		if (recv_fds(app->cmd_fd, 2)) {
+			return -1;
+		}
+		break;
+	case LTTNG_UST_EVENT:
+	case LTTNG_UST_CONTEXT:
+		if (!obj) {
+			break;
+		}
+		is_event = msg.cmd == LTTNG_UST_EVENT && obj->type == OBJ_CHANNEL;
+		handle = alloc_object(app, is_event ? OBJ_EVENT : OBJ_CONTEXT,
+				msg.handle);
+		if (handle < 0) {
+			return -1;
+		}
+		reply.ret_val = handle;
+		if (!is_event) {
+			break;
+		}
+		memcpy(app->objs[handle].name, msg.u.event.name,
+				sizeof(app->objs[handle].name));
+		app->objs[handle].name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+		/* The object table may have moved. */
+		session = get_object(app, app->objs[msg.handle].parent);
+		if (session && session->active) {
+			ret = sync_channel(app, msg.handle);
+		}
+		break;
+	case LTTNG_UST_FILTER:
+		ret = skip(app->cmd_fd, msg.u.filter.data_size);
+		break;
+	case LTTNG_UST_EXCLUSION:
+		ret = skip(app->cmd_fd,
+				(size_t) msg.u.exclusion.count * LTTNG_UST_SYM_NAME_LEN);
+		break;
+	case LTTNG_UST_ENABLE:
+	case LTTNG_UST_SESSION_START:
+		if (obj && obj->type == OBJ_SESSION) {
+			obj->active = 1;
+			ret = sync_session(app, msg.handle);
+		}
+		break;
+	case LTTNG_UST_DISABLE:
+	case LTTNG_UST_SESSION_STOP:
+		if (obj && obj->type == OBJ_SESSION) {
+			obj->active = 0;
+		}
+		break;
+	default:
+		/* Wait quiescent, flush buffer, calibrate: nothing to do. */
+		break;
+	}
+	if (ret) {
+		return -1;
+	}
+
+	if (lttng_write(app->cmd_fd, &reply, sizeof(reply)) != sizeof(reply)) {
+		return -1;
+	}
+	return 0;
+}
+
+static void *worker_thread(void *data)
+{
+	int i, nr;
+	struct worker *worker = data;
+	struct epoll_event events[64];
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		nr = epoll_wait(worker->epfd, events, 64, 100);
+		for (i = 0; i < nr; i++) {
+			struct app *app = events[i].data.ptr;
+
+			if (handle_cmd(app)) {
+				/* The session daemon unregisters it on close. */
+				epoll_ctl(worker->epfd, EPOLL_CTL_DEL, app->cmd_fd, NULL);
+				app->dead = 1;
+				uatomic_inc(&nr_dead);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static int app_connect(struct app *app, enum ustctl_socket_type type)
+{
+	int fd;
+	struct ustctl_reg_msg msg;
+
+	fd = lttcomm_connect_unix_sock(sock_path);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to connect to %s\n", sock_path);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.magic = LTTNG_UST_COMM_MAGIC;
+	msg.major = LTTNG_UST_ABI_MAJOR_VERSION;
+	msg.minor = LTTNG_UST_ABI_MINOR_VERSION;
+	msg.pid = FAKE_PID_BASE + app->id;
+	msg.ppid = getpid();
+	msg.uid = getuid();
+	msg.gid = getgid();
+	msg.bits_per_long = sizeof(long) * CHAR_BIT;
+	msg.uint8_t_alignment = __alignof__(uint8_t) * CHAR_BIT;
+	msg.uint16_t_alignment = __alignof__(uint16_t) * CHAR_BIT;
+	msg.uint32_t_alignment = __alignof__(uint32_t) * CHAR_BIT;
+	msg.uint64_t_alignment = __alignof__(uint64_t) * CHAR_BIT;
+	msg.long_alignment = __alignof__(long) * CHAR_BIT;
+	msg.socket_type = type;
+	snprintf(msg.name, sizeof(msg.name), "bench-app");
+	if (lttng_write(fd, &msg, sizeof(msg)) != sizeof(msg)) {
+		perror("write registration");
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+/* Register the applications up to the given count in a burst. */
+static void register_apps(unsigned long count)
+{
+	unsigned long i, first = nr_apps;
+	uint64_t deadline = now_ns() + REGISTRATION_TIMEOUT * 1000000000ULL;
+
+	for (i = first; i < count; i++) {
+		struct app *app = &apps[i];
+		struct epoll_event ev;
+
+		app->id = i;
+		app->objs = calloc(INIT_OBJECTS, sizeof(*app->objs));
+		if (!app->objs) {
+			perror("calloc");
+			exit(EXIT_FAILURE);
+		}
+		app->objs[0].type = OBJ_ROOT;
+		app->nr_objs = INIT_OBJECTS;
+		app->reg_start = now_ns();
+		app->cmd_fd = app_connect(app, USTCTL_SOCKET_CMD);
+		ev.events = EPOLLIN;
+		ev.data.ptr = app;
+		if (epoll_ctl(workers[i % opt_threads].epfd, EPOLL_CTL_ADD,
+					app->cmd_fd, &ev)) {
+			perror("epoll_ctl");
+			exit(EXIT_FAILURE);
+		}
+		app->notify_fd = app_connect(app, USTCTL_SOCKET_NOTIFY);
+	}
+	nr_apps = count;
+
+	while (uatomic_read(&nr_registered) + uatomic_read(&nr_dead) < count) {
+		if (now_ns() > deadline) {
+			fprintf(stderr, "Registration timed out\n");
+			exit(EXIT_FAILURE);
+		}
+		usleep(1000);
+	}
+	if (uatomic_read(&nr_dead)) {
+		fprintf(stderr, "%lu applications were dropped by the session "
+				"daemon\n", uatomic_read(&nr_dead));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static struct lttng_handle *create_session(const char *name)
+{
+	char url[PATH_MAX];
+	struct lttng_domain domain;
+	struct lttng_handle *handle;
+
+	snprintf(url, sizeof(url), "file://%s", output_dir);
+	if (lttng_create_session(name, url) < 0) {
+		fprintf(stderr, "Session creation failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&domain, 0, sizeof(domain));
+	domain.type = LTTNG_DOMAIN_UST;
+	domain.buf_type = opt_per_pid ? LTTNG_BUFFER_PER_PID :
+			LTTNG_BUFFER_PER_UID;
+	handle = lttng_create_handle(name, &domain);
+	if (!handle) {
+		fprintf(stderr, "Handle creation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return handle;
+}
+
+static void enable_events(struct lttng_handle *handle)
+{
+	struct lttng_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	snprintf(ev.name, sizeof(ev.name), "bench_app:*");
+	ev.type = LTTNG_EVENT_TRACEPOINT;
+	ev.loglevel_type = LTTNG_EVENT_LOGLEVEL_ALL;
+	ev.loglevel = -1;
+	if (lttng_enable_event(handle, &ev, NULL) < 0) {
+		fprintf(stderr, "Enabling the events failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Let the consumer daemon finish the data not waited for by stop. */
+static void wait_data(const char *name)
+{
+	while (lttng_data_pending(name) == 1) {
+		usleep(DEFAULT_DATA_AVAILABILITY_WAIT_TIME);
+	}
+}
+
+static void destroy_session(const char *name, struct lttng_handle *handle)
+{
+	if (lttng_destroy_session(name) < 0) {
+		fprintf(stderr, "Session destruction failed\n");
+		exit(EXIT_FAILURE);
+	}
+	lttng_destroy_handle(handle);
+}
+
+/* Run a session lifetime, timing each command. */
+static void run(const char *name, uint64_t *step_ns)
+{
+	int ret;
+	unsigned int step = 0;
+	uint64_t start;
+	struct lttng_event *events;
+	struct lttng_handle *handle;
+
+	start = now_ns();
+	handle = create_session(name);
+	step_ns[step++] = now_ns() - start;
+
+	start = now_ns();
+	enable_events(handle);
+	step_ns[step++] = now_ns() - start;
+
+	start = now_ns();
+	ret = lttng_list_tracepoints(handle, &events);
+	step_ns[step++] = now_ns() - start;
+	if (ret < 0) {
+		fprintf(stderr, "Listing the tracepoints failed\n");
+		exit(EXIT_FAILURE);
+	}
+	free(events);
+
+	start = now_ns();
+	ret = lttng_start_tracing(name);
+	step_ns[step++] = now_ns() - start;
+	if (ret < 0) {
+		fprintf(stderr, "Start failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now_ns();
+	ret = lttng_stop_tracing_no_wait(name);
+	step_ns[step++] = now_ns() - start;
+	if (ret < 0) {
+		fprintf(stderr, "Stop failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	wait_data(name);
+	start = now_ns();
+	destroy_session(name, handle);
+	step_ns[step++] = now_ns() - start;
+}
+
+static pid_t find_sessiond(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+	pid_t pid = 0;
+
+	dir = opendir("/proc");
+	if (!dir) {
+		return 0;
+	}
+	while (!pid && (entry = readdir(dir))) {
+		char path[PATH_MAX], comm[32] = "";
+		struct stat st;
+		FILE *fp;
+
+		if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+			continue;
+		}
+		snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+		fp = fopen(path, "r");
+		if (!fp) {
+			continue;
+		}
+		if (fgets(comm, sizeof(comm), fp) &&
+				!strcmp(comm, "lttng-sessiond\n") &&
+				!stat(path, &st) && st.st_uid == geteuid()) {
+			pid = atoi(entry->d_name);
+		}
+		fclose(fp);
+	}
+	closedir(dir);
+	return pid;
+}
+
+/* Resident memory of a process in kB, 0 if unknown. */
+static unsigned long rss_kb(pid_t pid)
+{
+	FILE *fp;
+	char path[PATH_MAX], line[128];
+	unsigned long kb = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	fp = fopen(path, "r");
+	if (!fp) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "VmRSS: %lu kB", &kb) == 1) {
+			break;
+		}
+	}
+	fclose(fp);
+	return kb;
+}
+
+static void bench(unsigned long count)
+{
+	unsigned long i, step, first = nr_apps;
+	uint64_t *reg_ns, *step_ns[NR_STEPS];
+	char name[NAME_MAX];
+	struct lttng_handle *active = NULL;
+
+	if (opt_active) {
+		snprintf(name, sizeof(name), "bench-sessiond-%d-active", getpid());
+		active = create_session(name);
+		enable_events(active);
+		if (lttng_start_tracing(name) < 0) {
+			fprintf(stderr, "Start failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	register_apps(count);
+	if (active) {
+		if (lttng_stop_tracing_no_wait(name) < 0) {
+			fprintf(stderr, "Stop failed\n");
+			exit(EXIT_FAILURE);
+		}
+		wait_data(name);
+		destroy_session(name, active);
+	}
+
+	reg_ns = malloc((count - first) * sizeof(*reg_ns));
+	if (!reg_ns) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = first; i < count; i++) {
+		reg_ns[i - first] = apps[i].reg_ns;
+	}
+	for (step = 0; step < NR_STEPS; step++) {
+		step_ns[step] = calloc(opt_loops, sizeof(uint64_t));
+		if (!step_ns[step]) {
+			perror("calloc");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (i = 0; i < opt_loops; i++) {
+		uint64_t ns[NR_STEPS];
+
+		snprintf(name, sizeof(name), "bench-sessiond-%d-%lu", getpid(), i);
+		run(name, ns);
+		for (step = 0; step < NR_STEPS; step++) {
+			step_ns[step][i] = ns[step];
+		}
+	}
+
+	printf("%8lu %10.2f", count, median_ms(reg_ns, count - first));
+	for (step = 0; step < NR_STEPS; step++) {
+		printf(" %10.2f", median_ms(step_ns[step], opt_loops));
+		free(step_ns[step]);
+	}
+	if (opt_sessiond_pid) {
+		printf(" %10.1f\n", (double) rss_kb(opt_sessiond_pid) / 1024);
+	} else {
+		printf(" %10s\n", "n/a");
+	}
+	fflush(stdout);
+	free(reg_ns);
+}
+
+static void init_event_fields(void)
+{
+	int i;
+
+	for (i = 0; i < NR_EVENT_FIELDS; i++) {
+		struct ustctl_integer_type *integer =
+				&event_fields[i].type.u.basic.integer;
+
+		snprintf(event_fields[i].name, sizeof(event_fields[i].name),
+				"field_%d", i);
+		event_fields[i].type.atype = ustctl_atype_integer;
+		integer->size = 32;
+		integer->signedness = 1;
+		integer->base = 10;
+		integer->encoding = ustctl_encode_none;
+		integer->alignment = 8;
+	}
+}
+
+static int rm_entry(const char *path, const struct stat *sb, int flag,
+		struct FTW *ftwbuf)
+{
+	return remove(path);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n APPS] [-e EVENTS] [-l LOOPS] "
+			"[-t THREADS] [-p]\n"
+			"\t[-A] [-S APPS_SOCKET] [-P SESSIOND_PID]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	unsigned long i, count;
+	struct rlimit rlim;
+
+	while ((opt = getopt(argc, argv, "n:e:l:t:pAS:P:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			opt_apps = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			opt_events = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			opt_loops = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			opt_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			opt_per_pid = 1;
+			break;
+		case 'A':
+			opt_active = 1;
+			break;
+		case 'S':
+			opt_sock_path = optarg;
+			break;
+		case 'P':
+			opt_sessiond_pid = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!opt_apps || !opt_events || !opt_loops || !opt_threads) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!lttng_session_daemon_alive()) {
+		fprintf(stderr, "No session daemon\n");
+		return EXIT_FAILURE;
+	}
+	if (opt_sock_path) {
+		snprintf(sock_path, sizeof(sock_path), "%s", opt_sock_path);
+	} else if (!geteuid()) {
+		snprintf(sock_path, sizeof(sock_path),
+				DEFAULT_GLOBAL_APPS_UNIX_SOCK);
+	} else {
+		snprintf(sock_path, sizeof(sock_path),
+				DEFAULT_HOME_APPS_UNIX_SOCK, utils_get_home_dir());
+	}
+	if (!opt_sessiond_pid) {
+		opt_sessiond_pid = find_sessiond();
+	}
+
+	/* Two sockets per application, plus the file descriptors in flight. */
+	if (!getrlimit(RLIMIT_NOFILE, &rlim)) {
+		rlim.rlim_cur = rlim.rlim_max;
+		(void) setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+
+	if (!mkdtemp(output_dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+	init_event_fields();
+
+	apps = calloc(opt_apps, sizeof(*apps));
+	workers = calloc(opt_threads, sizeof(*workers));
+	if (!apps || !workers) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < opt_threads; i++) {
+		workers[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (workers[i].epfd < 0) {
+			perror("epoll_create1");
+			return EXIT_FAILURE;
+		}
+		if (pthread_create(&workers[i].tid, NULL, worker_thread,
+					&workers[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("# %s buffers, %lu events per application%s\n",
+			opt_per_pid ? "per-pid" : "per-uid", opt_events,
+			opt_active ? ", registering during an active session" : "");
+	printf("# %6s %10s", "apps", "reg(ms)");
+	for (i = 0; i < NR_STEPS; i++) {
+		char header[16];
+
+		snprintf(header, sizeof(header), "%s(ms)", steps[i]);
+		printf(" %10s", header);
+	}
+	printf(" %10s\n", "rss(MB)");
+
+	for (count = 1; ; count *= 4) {
+		if (count > opt_apps) {
+			count = opt_apps;
+		}
+		bench(count);
+		if (count == opt_apps) {
+			break;
+		}
+	}
+
+	CMM_STORE_SHARED(stop, 1);
+	for (i = 0; i < opt_threads; i++) {
+		pthread_join(workers[i].tid, NULL);
+	}
+	for (i = 0; i < nr_apps; i++) {
+		uint32_t j;
+
+		close(apps[i].cmd_fd);
+		close(apps[i].notify_fd);
+		for (j = 0; j < apps[i].nr_objs; j++) {
+			free(apps[i].objs[j].tp_registered);
+		}
+		free(apps[i].objs);
+	}
+	(void) nftw(output_dir, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+	return EXIT_SUCCESS;
+}
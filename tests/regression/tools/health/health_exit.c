@@ -195,17 +195,6 @@ int __testpoint_consumerd_thread_metadata_timer(void)
 
 /* Relay daemon */
 
-int __testpoint_relayd_thread_dispatcher(void)
-{
-	const char *var = "LTTNG_RELAYD_THREAD_DISPATCHER_EXIT";
-
-	if (check_env_var(var)) {
-		pthread_exit(NULL);
-	}
-
-	return 0;
-}
-
 int __testpoint_relayd_thread_worker(void)
 {
 	const char *var = "LTTNG_RELAYD_THREAD_WORKER_EXIT";
@@ -229,17 +218,6 @@ int __testpoint_relayd_thread_listener(void)
 	return 0;
 }
 
-int __testpoint_relayd_thread_live_dispatcher(void)
-{
-	const char *var = "LTTNG_RELAYD_THREAD_LIVE_DISPATCHER_EXIT";
-
-	if (check_env_var(var)) {
-		pthread_exit(NULL);
-	}
-
-	return 0;
-}
-
 int __testpoint_relayd_thread_live_worker(void)
 {
 	const char *var = "LTTNG_RELAYD_THREAD_LIVE_WORKER_EXIT";
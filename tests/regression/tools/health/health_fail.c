@@ -187,17 +187,6 @@ int __testpoint_consumerd_thread_metadata_timer(void)
 
 /* Relay daemon */
 
-int __testpoint_relayd_thread_dispatcher(void)
-{
-	const char *var = "LTTNG_RELAYD_THREAD_DISPATCHER_TP_FAIL";
-
-	if (check_env_var(var)) {
-		return 1;
-	}
-
-	return 0;
-}
-
 int __testpoint_relayd_thread_worker(void)
 {
 	const char *var = "LTTNG_RELAYD_THREAD_WORKER_TP_FAIL";
@@ -220,17 +209,6 @@ int __testpoint_relayd_thread_listener(void)
 	return 0;
 }
 
-int __testpoint_relayd_thread_live_dispatcher(void)
-{
-	const char *var = "LTTNG_RELAYD_THREAD_LIVE_DISPATCHER_TP_FAIL";
-
-	if (check_env_var(var)) {
-		return 1;
-	}
-
-	return 0;
-}
-
 int __testpoint_relayd_thread_live_worker(void)
 {
 	const char *var = "LTTNG_RELAYD_THREAD_LIVE_WORKER_TP_FAIL";
@@ -200,17 +200,6 @@ int __testpoint_consumerd_thread_metadata_timer(void)
 
 /* Relay daemon */
 
-int __testpoint_relayd_thread_dispatcher(void)
-{
-	const char *var = "LTTNG_RELAYD_THREAD_DISPATCHER_STALL";
-
-	if (check_env_var(var)) {
-		do_stall();
-	}
-
-	return 0;
-}
-
 int __testpoint_relayd_thread_worker(void)
 {
 	const char *var = "LTTNG_RELAYD_THREAD_WORKER_STALL";
@@ -233,17 +222,6 @@ int __testpoint_relayd_thread_listener(void)
 	return 0;
 }
 
-int __testpoint_relayd_thread_live_dispatcher(void)
-{
-	const char *var = "LTTNG_RELAYD_THREAD_LIVE_DISPATCHER_STALL";
-
-	if (check_env_var(var)) {
-		do_stall();
-	}
-
-	return 0;
-}
-
 int __testpoint_relayd_thread_live_worker(void)
 {
 	const char *var = "LTTNG_RELAYD_THREAD_LIVE_WORKER_STALL";
@@ -20,7 +20,7 @@ UST_EVENT_NAME="tp:tptest"
 KERNEL_EVENT_NAME="sched_switch"
 CHANNEL_NAME="testchan"
 HEALTH_CHECK_BIN="health_check"
-NUM_TESTS=90
+NUM_TESTS=74
 SLEEP_TIME=30
 
 source $TESTDIR/utils/utils.sh
@@ -173,10 +173,8 @@ THREAD=("LTTNG_SESSIOND_THREAD_MANAGE_CLIENTS"
 	"LTTNG_CONSUMERD_THREAD_METADATA"
 	"LTTNG_CONSUMERD_THREAD_METADATA_TIMER"
 
-	"LTTNG_RELAYD_THREAD_DISPATCHER"
 	"LTTNG_RELAYD_THREAD_WORKER"
 	"LTTNG_RELAYD_THREAD_LISTENER"
-	"LTTNG_RELAYD_THREAD_LIVE_DISPATCHER"
 	"LTTNG_RELAYD_THREAD_LIVE_WORKER"
 	"LTTNG_RELAYD_THREAD_LIVE_LISTENER"
 )
@@ -194,10 +192,8 @@ ERROR_STRING=(
 	"Thread \"Consumer daemon metadata\" is not responding"
 	"Thread \"Consumer daemon metadata timer\" is not responding"
 
-	"Thread \"Relay daemon dispatcher\" is not responding in component \"relayd\"."
 	"Thread \"Relay daemon worker\" is not responding in component \"relayd\"."
 	"Thread \"Relay daemon listener\" is not responding in component \"relayd\"."
-	"Thread \"Relay daemon live dispatcher\" is not responding in component \"relayd\"."
 	"Thread \"Relay daemon live worker\" is not responding in component \"relayd\"."
 	"Thread \"Relay daemon live listener\" is not responding in component \"relayd\"."
 )
@@ -235,8 +231,6 @@ NEEDS_ROOT=(
 	0
 	0
 	0
-	0
-	0
 )
 
 TEST_CONSUMERD=(
@@ -256,8 +250,6 @@ TEST_CONSUMERD=(
 	1
 	1
 	1
-	1
-	1
 )
 
 TEST_RELAYD=(
@@ -277,8 +269,6 @@ TEST_RELAYD=(
 	1
 	1
 	1
-	1
-	1
 )
 
 STDOUT_PATH=$(mktemp)
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/defaults.h>
+#include <bin/lttng-sessiond/buffer-advice.h>
+#include <bin/lttng-sessiond/trace-kernel.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+int ust_consumerd32_fd;
+int ust_consumerd64_fd;
+
+#ifdef HAVE_LIBLTTNG_UST_CTL
+/* Only kernel channels are tested, normally defined by trace-ust.c. */
+struct ltt_ust_channel *trace_ust_find_channel_by_name(struct lttng_ht *ht,
+		char *name)
+{
+	return NULL;
+}
+#endif
+
+#define SESSION_NAME		"advice"
+#define AUTO_CHANNEL		"auto"
+#define FIXED_CHANNEL		"fixed"
+#define SUBBUF_SIZE		4096
+#define NUM_SUBBUF		4
+
+#define NUM_TESTS 12
+
+static void test_recommend(void)
+{
+	uint64_t size, count;
+
+	size = SUBBUF_SIZE;
+	count = NUM_SUBBUF;
+	ok(buffer_advice_recommend(&size, &count, 499) == 0 &&
+			size == SUBBUF_SIZE && count == 2 * NUM_SUBBUF,
+			"Sub-buffers filled below 50%% are doubled in count");
+
+	size = SUBBUF_SIZE;
+	count = NUM_SUBBUF;
+	ok(buffer_advice_recommend(&size, &count, 500) == 0 &&
+			size == 2 * SUBBUF_SIZE && count == NUM_SUBBUF,
+			"Sub-buffers filled to 50%% are doubled in size");
+
+	size = SUBBUF_SIZE;
+	count = NUM_SUBBUF;
+	ok(buffer_advice_recommend(&size, &count, 1000) == 0 &&
+			size == 2 * SUBBUF_SIZE && count == NUM_SUBBUF,
+			"Full sub-buffers are doubled in size");
+
+	size = DEFAULT_BUFFER_ADVICE_MAX_SIZE / 2 / NUM_SUBBUF;
+	count = NUM_SUBBUF;
+	ok(buffer_advice_recommend(&size, &count, 1000) == 0 &&
+			size * count == DEFAULT_BUFFER_ADVICE_MAX_SIZE,
+			"Buffer is grown up to the maximum size");
+
+	count = NUM_SUBBUF;
+	ok(buffer_advice_recommend(&size, &count, 1000) == -1 &&
+			size * count == DEFAULT_BUFFER_ADVICE_MAX_SIZE,
+			"Buffer of the maximum size is left as is");
+
+	size = DEFAULT_BUFFER_ADVICE_MAX_SIZE / 2 / NUM_SUBBUF;
+	count = NUM_SUBBUF + 1;
+	ok(buffer_advice_recommend(&size, &count, 0) == -1 &&
+			size == DEFAULT_BUFFER_ADVICE_MAX_SIZE / 2 / NUM_SUBBUF &&
+			count == NUM_SUBBUF + 1,
+			"Buffer growing past the maximum size is left as is");
+}
+
+static int add_channel(struct ltt_kernel_session *kern, const char *name,
+		unsigned int auto_size)
+{
+	struct lttng_channel attr;
+	struct ltt_kernel_channel *kchan;
+
+	memset(&attr, 0, sizeof(attr));
+	strcpy(attr.name, name);
+	attr.attr.subbuf_size = SUBBUF_SIZE;
+	attr.attr.num_subbuf = NUM_SUBBUF;
+	attr.attr.auto_buffer_size = auto_size;
+
+	kchan = trace_kernel_create_channel(&attr);
+	if (!kchan) {
+		return -1;
+	}
+	cds_list_add(&kchan->list, &kern->channel_list.head);
+	kern->channel_count++;
+	return 0;
+}
+
+static void add_report(uint64_t session_id, const char *name)
+{
+	struct lttcomm_consumer_discard_report report;
+
+	memset(&report, 0, sizeof(report));
+	report.session_id = session_id;
+	strcpy(report.channel_name, name);
+	report.events_discarded = 100;
+	report.subbuf_count = NUM_SUBBUF;
+	report.interval = 1000000000;
+	report.fill_ratio = 900;
+	buffer_advice_add_report(LTTNG_DOMAIN_KERNEL, &report);
+}
+
+/* Size of the buffer of a new channel once the advice is applied. */
+static uint64_t applied_size(struct ltt_session *session, const char *name,
+		uint64_t subbuf_size, unsigned int auto_size)
+{
+	struct lttng_channel attr;
+
+	memset(&attr, 0, sizeof(attr));
+	strcpy(attr.name, name);
+	attr.attr.subbuf_size = subbuf_size;
+	attr.attr.num_subbuf = NUM_SUBBUF;
+	attr.attr.auto_buffer_size = auto_size;
+	buffer_advice_apply(session, LTTNG_DOMAIN_KERNEL, &attr);
+	return attr.attr.subbuf_size * attr.attr.num_subbuf;
+}
+
+static void test_apply(void)
+{
+	struct ltt_session session, next_session, other_session;
+
+	memset(&session, 0, sizeof(session));
+	strcpy(session.name, SESSION_NAME);
+	session.id = 1;
+	session.kernel_session = trace_kernel_create_session();
+	if (!session.kernel_session ||
+			add_channel(session.kernel_session, AUTO_CHANNEL, 1) ||
+			add_channel(session.kernel_session, FIXED_CHANNEL, 0)) {
+		fail("Create the kernel channels");
+		skip(NUM_TESTS - 7, "No kernel channels");
+		goto end;
+	}
+	pass("Create the kernel channels");
+
+	buffer_advice_track_session(&session);
+	add_report(session.id, AUTO_CHANNEL);
+	add_report(session.id, FIXED_CHANNEL);
+	buffer_advice_untrack_session(&session);
+
+	memset(&next_session, 0, sizeof(next_session));
+	strcpy(next_session.name, SESSION_NAME);
+	next_session.id = 2;
+	memset(&other_session, 0, sizeof(other_session));
+	strcpy(other_session.name, "other");
+	other_session.id = 3;
+
+	ok(applied_size(&next_session, AUTO_CHANNEL, SUBBUF_SIZE, 1) ==
+			2 * SUBBUF_SIZE * NUM_SUBBUF,
+			"Automatically sized channel is enlarged in the next session");
+	ok(applied_size(&next_session, AUTO_CHANNEL, SUBBUF_SIZE, 0) ==
+			SUBBUF_SIZE * NUM_SUBBUF,
+			"Channel without auto_buffer_size is left as is");
+	ok(applied_size(&next_session, FIXED_CHANNEL, SUBBUF_SIZE, 1) ==
+			SUBBUF_SIZE * NUM_SUBBUF,
+			"Channel which was not sized automatically has no advice");
+	ok(applied_size(&next_session, AUTO_CHANNEL, 4 * SUBBUF_SIZE, 1) ==
+			4 * SUBBUF_SIZE * NUM_SUBBUF,
+			"Larger requested buffer is kept");
+	ok(applied_size(&other_session, AUTO_CHANNEL, SUBBUF_SIZE, 1) ==
+			SUBBUF_SIZE * NUM_SUBBUF,
+			"Advice only applies to a session of the same name");
+
+end:
+	if (session.kernel_session) {
+		trace_kernel_destroy_session(session.kernel_session);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Buffer advice unit tests");
+
+	test_recommend();
+	test_apply();
+
+	return exit_status();
+}
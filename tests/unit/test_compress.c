@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/compress/compress.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define PACKET_SIZE		(256 * 1024)
+
+#define NUM_TESTS 15
+
+static uint8_t src[PACKET_SIZE];
+static uint8_t out[PACKET_SIZE];
+static uint8_t *dst;
+static size_t dst_len;
+
+/*
+ * Fill the buffer the way a packet of a ring buffer is: a packet header then
+ * events made of a small header, a timestamp growing by small increments and
+ * a payload drawn from a few values.
+ */
+static void fill_ctf(uint8_t *buf, size_t len)
+{
+	size_t pos = 0;
+	uint64_t ts = 1000000;
+	unsigned int seed = 1;
+
+	while (pos + 32 <= len) {
+		uint32_t id = rand_r(&seed) % 4;
+		uint64_t payload = rand_r(&seed) % 16;
+
+		ts += rand_r(&seed) % 512;
+		memcpy(buf + pos, &id, sizeof(id));
+		memcpy(buf + pos + 4, &ts, sizeof(ts));
+		memcpy(buf + pos + 12, &payload, sizeof(payload));
+		memset(buf + pos + 20, 0, 12);
+		pos += 32;
+	}
+	memset(buf + pos, 0, len - pos);
+}
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+	size_t i;
+	unsigned int seed = 42;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = rand_r(&seed);
+	}
+}
+
+/*
+ * Compress and decompress len bytes of src.
+ *
+ * Return the compressed size or a negative value on error.
+ */
+static ssize_t round_trip(size_t len)
+{
+	ssize_t clen, dlen;
+
+	clen = compress_buffer(LTTNG_COMPRESSION_LZ4, src, len, dst, dst_len);
+	if (clen < 0) {
+		return -1;
+	}
+	memset(out, 0xaa, sizeof(out));
+	dlen = decompress_buffer(LTTNG_COMPRESSION_LZ4, dst, clen, out, len);
+	if (dlen != len || memcmp(src, out, len)) {
+		return -1;
+	}
+	return clen;
+}
+
+static void test_round_trips(void)
+{
+	ssize_t clen;
+	size_t i;
+	int fail = 0;
+
+	memset(src, 0, PACKET_SIZE);
+	clen = round_trip(PACKET_SIZE);
+	ok(clen > 0 && clen < PACKET_SIZE / 100, "Zeroed packet round trip");
+
+	fill_ctf(src, PACKET_SIZE);
+	clen = round_trip(PACKET_SIZE);
+	diag("CTF-like packet: %zd bytes compressed to %zd", (size_t) PACKET_SIZE,
+			clen);
+	ok(clen > 0 && clen < PACKET_SIZE / 2, "CTF-like packet round trip");
+
+	fill_random(src, PACKET_SIZE);
+	clen = round_trip(PACKET_SIZE);
+	ok(clen > 0, "Random packet round trip");
+	ok(clen <= compress_bound(LTTNG_COMPRESSION_LZ4, PACKET_SIZE),
+			"Random packet fits in the bound");
+
+	/* Small sizes take the literals only paths. */
+	fill_ctf(src, PACKET_SIZE);
+	for (i = 0; i < 64; i++) {
+		if (round_trip(i) < 0) {
+			fail++;
+		}
+	}
+	ok(fail == 0, "Small buffers round trip");
+}
+
+static void test_bounds(void)
+{
+	ssize_t clen;
+
+	fill_random(src, PACKET_SIZE);
+	clen = compress_buffer(LTTNG_COMPRESSION_LZ4, src, PACKET_SIZE, dst,
+			PACKET_SIZE);
+	ok(clen < 0, "Incompressible data does not fit in its own size");
+
+	fill_ctf(src, PACKET_SIZE);
+	clen = compress_buffer(LTTNG_COMPRESSION_LZ4, src, PACKET_SIZE, dst,
+			dst_len);
+	ok(decompress_buffer(LTTNG_COMPRESSION_LZ4, dst, clen, out,
+			PACKET_SIZE - 1) < 0,
+			"Decompression does not overflow the output");
+	ok(decompress_buffer(LTTNG_COMPRESSION_LZ4, dst, clen / 2, out,
+			PACKET_SIZE) != PACKET_SIZE,
+			"Truncated input is detected");
+}
+
+static void test_corrupted(void)
+{
+	/* Literal length continuation running past the end of the input. */
+	static const uint8_t bad_len[] = { 0xf0, 0xff, 0xff };
+	/* Match offset pointing before the start of the output. */
+	static const uint8_t bad_offset[] = { 0x10, 'a', 0x10, 0x00, 0x00 };
+	/* Zero offset. */
+	static const uint8_t zero_offset[] = { 0x10, 'a', 0x00, 0x00, 0x00 };
+
+	ok(decompress_buffer(LTTNG_COMPRESSION_LZ4, bad_len, sizeof(bad_len),
+			out, sizeof(out)) < 0, "Truncated length is rejected");
+	ok(decompress_buffer(LTTNG_COMPRESSION_LZ4, bad_offset,
+			sizeof(bad_offset), out, sizeof(out)) < 0,
+			"Out of bounds offset is rejected");
+	ok(decompress_buffer(LTTNG_COMPRESSION_LZ4, zero_offset,
+			sizeof(zero_offset), out, sizeof(out)) < 0,
+			"Zero offset is rejected");
+}
+
+static void test_types(void)
+{
+	enum lttng_compression type;
+	ssize_t len;
+
+	fill_ctf(src, 4096);
+	len = compress_buffer(LTTNG_COMPRESSION_NONE, src, 4096, dst, dst_len);
+	ok(len == 4096 && !memcmp(src, dst, 4096), "No compression copies");
+	ok(compress_parse_type("lz4", &type) == 0 &&
+			type == LTTNG_COMPRESSION_LZ4, "Parse lz4");
+	ok(compress_parse_type("zip", &type) < 0, "Unknown name is rejected");
+	ok(compress_bound(-1, 4096) == 0, "Unknown type has no bound");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Packet compression unit tests");
+
+	dst_len = compress_bound(LTTNG_COMPRESSION_LZ4, PACKET_SIZE);
+	dst = malloc(dst_len);
+	if (!dst) {
+		diag("malloc failed");
+		return EXIT_FAILURE;
+	}
+
+	test_round_trips();
+	test_bounds();
+	test_corrupted();
+	test_types();
+
+	free(dst);
+	return exit_status();
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/compat/endian.h>
+#include <common/consumer-stats.h>
+#include <common/utils.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/* Normally defined by consumer.c. */
+struct lttng_consumer_global_data consumer_data;
+
+#define SESSION_ID	42
+#define NR_STREAMS	2
+
+#define NUM_TESTS 20
+
+static struct lttng_consumer_channel channel, other_channel;
+static struct lttng_consumer_stream streams[NR_STREAMS];
+
+static void init_channel(struct lttng_consumer_channel *chan, uint64_t key,
+		uint64_t session_id, const char *name)
+{
+	memset(chan, 0, sizeof(*chan));
+	chan->key = key;
+	chan->session_id = session_id;
+	chan->uid = 1000;
+	chan->type = CONSUMER_CHANNEL_TYPE_DATA;
+	strcpy(chan->name, name);
+	lttng_ht_node_init_u64(&chan->node, key);
+	lttng_ht_add_unique_u64(consumer_data.channel_ht, &chan->node);
+}
+
+static void init_streams(void)
+{
+	int i;
+
+	for (i = 0; i < NR_STREAMS; i++) {
+		struct lttng_consumer_stream *stream = &streams[i];
+
+		memset(stream, 0, sizeof(*stream));
+		stream->key = i;
+		stream->chan = &channel;
+		snprintf(stream->name, sizeof(stream->name), "%s_%d",
+				channel.name, i);
+		lttng_ht_node_init_u64(&stream->node_channel_id, channel.key);
+		lttng_ht_add_u64(consumer_data.stream_per_chan_id_ht,
+				&stream->node_channel_id);
+	}
+}
+
+/* Account a packet of 8 kB holding content_size bytes. */
+static void packet(struct lttng_consumer_stream *stream,
+		uint64_t content_size, uint64_t events_discarded)
+{
+	struct ctf_packet_index index;
+
+	memset(&index, 0, sizeof(index));
+	index.packet_size = htobe64(8192 * 8);
+	index.content_size = htobe64(content_size * 8);
+	index.events_discarded = htobe64(events_discarded);
+	consumer_stats_packet(stream, &index);
+}
+
+static void test_accounting(void)
+{
+	ssize_t count;
+	uint64_t now;
+	struct lttng_stream_stats *stats = NULL;
+
+	/* A sub-buffer of the first stream written 100 usec after wake up. */
+	now = utils_get_monotonic_ns();
+	ok(now > 0, "Monotonic clock is readable");
+	consumer_stats_consumed(&streams[0], 4096, now - 100000);
+	consumer_stats_written(&streams[0], 1024, now - 100000);
+
+	/* Two untimed sub-buffers and discarded events on the second. */
+	consumer_stats_consumed(&streams[1], 8192, now);
+	consumer_stats_written(&streams[1], 8192, 0);
+	consumer_stats_consumed(&streams[1], 8192, now);
+	consumer_stats_written(&streams[1], 8192, 0);
+	packet(&streams[1], 8192, 7);
+
+	count = consumer_stats_collect(SESSION_ID, &stats);
+	ok(count == NR_STREAMS + 1, "One entry for the channel and each stream");
+	if (count != NR_STREAMS + 1) {
+		skip(9, "Unexpected entries");
+		goto end;
+	}
+
+	ok(stats[0].stream_name[0] == '\0' &&
+			!strcmp(stats[0].channel_name, channel.name) &&
+			stats[0].channel_key == channel.key,
+			"Channel entry comes first");
+	ok(stats[0].subbuf_count == 3 && stats[0].bytes_consumed == 20480 &&
+			stats[0].bytes_written == 17408,
+			"Channel counters are the sum of its streams");
+	ok(stats[0].events_discarded == 7, "Channel discarded events");
+	ok(stats[0].elapsed >= 100000, "Elapsed time since the first sub-buffer");
+
+	ok(!strcmp(stats[1].stream_name, "chan0_0") ||
+			!strcmp(stats[1].stream_name, "chan0_1"),
+			"Stream entries follow their channel");
+	if (!strcmp(stats[1].stream_name, "chan0_1")) {
+		struct lttng_stream_stats tmp = stats[1];
+
+		stats[1] = stats[2];
+		stats[2] = tmp;
+	}
+	ok(stats[1].subbuf_count == 1 && stats[1].bytes_consumed == 4096 &&
+			stats[1].bytes_written == 1024,
+			"Written bytes account for compression");
+	ok(stats[1].latency_max >= 100000 &&
+			stats[1].latency_total == stats[1].latency_max,
+			"Write latency measured from the wake up");
+	/* 100 usec lands in the [64, 128) usec bucket. */
+	ok(stats[1].latency_hist[7] == 1, "Latency histogram bucket");
+	ok(stats[2].latency_total == 0 && stats[2].subbuf_count == 2,
+			"Untimed writes are not in the latencies");
+
+end:
+	free(stats);
+}
+
+static void test_retire(void)
+{
+	ssize_t count;
+	struct lttng_ht_iter iter;
+	struct lttng_stream_stats *stats = NULL;
+
+	/* Delete the first stream the way consumer_stream_delete() does. */
+	iter.iter.node = &streams[0].node_channel_id.node;
+	lttng_ht_del(consumer_data.stream_per_chan_id_ht, &iter);
+	consumer_stats_retire(&streams[0]);
+
+	count = consumer_stats_collect(SESSION_ID, &stats);
+	ok(count == NR_STREAMS, "Deleted stream is not listed");
+	ok(count > 0 && stats[0].subbuf_count == 3 &&
+			stats[0].bytes_consumed == 20480 &&
+			stats[0].latency_hist[7] == 1,
+			"Channel keeps the stats of its deleted streams");
+	free(stats);
+
+	count = consumer_stats_collect(SESSION_ID + 1, &stats);
+	ok(count == 1 && stats[0].subbuf_count == 0,
+			"Channel of another session without streams");
+	free(stats);
+
+	count = consumer_stats_collect(SESSION_ID + 2, &stats);
+	ok(count == 0 && !stats, "Unknown session has no entry");
+	free(stats);
+}
+
+static void test_discard_report(void)
+{
+	struct lttng_consumer_stream *stream = &streams[1];
+	struct lttcomm_consumer_discard_report report;
+
+	/* The stream has discarded 7 events over one full packet so far. */
+	ok(consumer_stats_discard_report(stream, &report) == 1,
+			"Discarded events are reported");
+	ok(report.session_id == SESSION_ID &&
+			!strcmp(report.channel_name, channel.name) &&
+			report.events_discarded == 7 && report.subbuf_count == 1 &&
+			report.fill_ratio == 1000,
+			"Report of the first discards");
+
+	packet(stream, 2048, 7);
+	ok(consumer_stats_discard_report(stream, &report) == 0,
+			"No report without new discards");
+
+	packet(stream, 4096, 12);
+	ok(consumer_stats_discard_report(stream, &report) == 0,
+			"Reports are rate limited");
+
+	/* Pretend the last report is one interval old. */
+	stream->report_ts -= CONSUMER_DISCARD_REPORT_INTERVAL;
+	ok(consumer_stats_discard_report(stream, &report) == 1 &&
+			report.events_discarded == 5 && report.subbuf_count == 2 &&
+			report.fill_ratio == 375 &&
+			report.interval >= CONSUMER_DISCARD_REPORT_INTERVAL,
+			"Report covers the packets since the previous one");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Consumer stream stats unit tests");
+
+	rcu_register_thread();
+	consumer_data.channel_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	consumer_data.stream_per_chan_id_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+	if (!consumer_data.channel_ht || !consumer_data.stream_per_chan_id_ht) {
+		diag("lttng_ht_new failed");
+		return EXIT_FAILURE;
+	}
+
+	init_channel(&channel, 1, SESSION_ID, "chan0");
+	init_channel(&other_channel, 2, SESSION_ID + 1, "chan1");
+	init_streams();
+
+	test_accounting();
+	test_retire();
+	test_discard_report();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
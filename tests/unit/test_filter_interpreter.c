@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/macros.h>
+#include <lib/lttng-ctl/filter/filter-interpreter.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/* Each case is run on the plain and on the optimized bytecode. */
+#define TESTS_PER_CASE		2
+#define NR_MALFORMED_TESTS	6
+
+struct test_case {
+	const char *expression;
+	/* 1 if recorded, 0 if discarded, or the negative link or run error. */
+	int expected;
+};
+
+/* Run on the payload below. */
+static const struct test_case cases[] = {
+	{ "a == 5", 1 },
+	{ "a != 5", 0 },
+	{ "a > 3 && a <= 5", 1 },
+	{ "a < 0 || a >= 6", 0 },
+	{ "d > 2.4 && d < 2.6", 1 },
+	/* Mixed integer and floating point comparisons. */
+	{ "d > 2", 1 },
+	{ "a == 5.0", 1 },
+	{ "-a == -5", 1 },
+	{ "!(a == 5)", 0 },
+	{ "!a", 0 },
+	{ "s == \"hello\"", 1 },
+	{ "s == \"hell\"", 0 },
+	{ "s != \"world\"", 1 },
+	{ "s > \"hallo\" && s < \"help\"", 1 },
+	/* A '*' in a literal matches the rest of the string. */
+	{ "s == \"hel*\"", 1 },
+	{ "s == \"help*\"", 0 },
+	{ "s == \"*\"", 1 },
+	{ "$ctx.vtid == 42", 1 },
+	{ "$ctx.procname == \"app*\" && $ctx.vtid > 40", 1 },
+	/* The short-circuit skips the comparison of the unknown type. */
+	{ "a == 5 || s == 1", 1 },
+	{ "a == 6 || s == 1", -EINVAL },
+	{ "a == 6 && s == 1", 0 },
+	{ "b == 1", -ENOENT },
+	{ "$ctx.a == 1", -ENOENT },
+};
+
+static struct filter_payload_field fields[] = {
+	{ "a", 0, { FILTER_VALUE_S64, { .s64 = 5 } } },
+	{ "d", 0, { FILTER_VALUE_DOUBLE, { .d = 2.5 } } },
+	{ "s", 0, { FILTER_VALUE_STRING, { .str = "hello" } } },
+	{ "vtid", 1, { FILTER_VALUE_S64, { .s64 = 42 } } },
+	{ "procname", 1, { FILTER_VALUE_STRING, { .str = "app-1" } } },
+};
+
+static const struct filter_payload payload = {
+	.fields = fields,
+	.nr_fields = ARRAY_SIZE(fields),
+};
+
+static
+int evaluate(const struct lttng_filter_bytecode *bytecode)
+{
+	struct filter_program program;
+	int ret;
+
+	ret = filter_program_link(&program, bytecode, &payload);
+	if (ret)
+		return ret;
+	ret = filter_program_run(&program, &payload);
+	filter_program_fini(&program);
+	return ret;
+}
+
+static
+void test_case(const struct test_case *tc)
+{
+	int optimize;
+
+	for (optimize = 0; optimize < 2; optimize++) {
+		struct lttng_filter_bytecode_alloc *bytecode;
+		int ret;
+
+		bytecode = filter_bytecode_compile(tc->expression, optimize, 0);
+		ret = bytecode ? evaluate(&bytecode->b) : -EINVAL;
+		ok(ret == tc->expected, "\"%s\"%s gives %d, expected %d",
+			tc->expression, optimize ? " optimized" : "", ret,
+			tc->expected);
+		free(bytecode);
+	}
+}
+
+static
+void test_malformed(void)
+{
+	struct lttng_filter_bytecode_alloc *bytecode;
+	struct lttng_filter_bytecode *b;
+	uint32_t pc, lit;
+	uint16_t offset;
+	char literal;
+
+	/* LOAD_FIELD_REF a, CAST_TO_S64, LOAD_S64, EQ, AND, ... */
+	bytecode = filter_bytecode_compile("a == 5 && a == 6", 0, 0);
+	if (!bytecode) {
+		fail("Compiling the malformed bytecode tests expression");
+		skip(NR_MALFORMED_TESTS - 1, "No bytecode");
+		return;
+	}
+	b = &bytecode->b;
+	ok(evaluate(b) == 0, "Valid bytecode runs");
+
+	for (pc = 0; b->data[pc] != FILTER_OP_AND; pc++)
+		;
+	memcpy(&offset, &b->data[pc + 1], sizeof(offset));
+	memcpy(&b->data[pc + 1], &(uint16_t) { 0 }, sizeof(offset));
+	ok(evaluate(b) == -EINVAL, "Backward skip offset is rejected");
+	memcpy(&b->data[pc + 1], &(uint16_t) { b->reloc_table_offset },
+		sizeof(offset));
+	ok(evaluate(b) == -EINVAL, "Skip offset past the code is rejected");
+	memcpy(&b->data[pc + 1], &offset, sizeof(offset));
+
+	/* Skip into the literal of "a == 6", made to look like a reference. */
+	for (lit = pc; b->data[lit] != FILTER_OP_LOAD_S64 ||
+			memcmp(&b->data[lit + sizeof(struct load_op)],
+				&(int64_t) { 6 }, sizeof(int64_t)); lit++)
+		;
+	lit += sizeof(struct load_op);
+	literal = b->data[lit];
+	b->data[lit] = FILTER_OP_LOAD_FIELD_REF;
+	memcpy(&b->data[pc + 1], &(uint16_t) { lit }, sizeof(offset));
+	ok(evaluate(b) == -EINVAL, "Skip offset within an instruction is rejected");
+	memcpy(&b->data[pc + 1], &offset, sizeof(offset));
+	b->data[lit] = literal;
+
+	b->data[pc] = NR_FILTER_OPS;
+	ok(evaluate(b) == -EINVAL, "Unknown instruction is rejected");
+	b->data[pc] = FILTER_OP_AND;
+
+	/* Relocate the cast following the first field reference. */
+	memcpy(&b->data[b->reloc_table_offset],
+		&(uint16_t) { sizeof(struct load_op) + sizeof(struct field_ref) },
+		sizeof(offset));
+	ok(evaluate(b) == -EINVAL, "Relocation of a non-reference is rejected");
+
+	free(bytecode);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	plan_tests(TESTS_PER_CASE * ARRAY_SIZE(cases) + NR_MALFORMED_TESTS);
+
+	diag("Filter bytecode interpreter unit tests");
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++)
+		test_case(&cases[i]);
+	test_malformed();
+
+	return exit_status();
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/macros.h>
+#include <lib/lttng-ctl/filter/filter-ast.h>
+#include <lib/lttng-ctl/filter/filter-ir.h>
+#include <lib/lttng-ctl/filter/filter-bytecode.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/* Each case is checked for results, comparison count and cost. */
+#define TESTS_PER_CASE		3
+
+struct test_case {
+	const char *expression;
+	int kernel;
+	/* Comparisons left in the optimized bytecode. */
+	unsigned int compares;
+	/* Fewer comparisons are evaluated over the samples. */
+	int fewer_evaluations;
+};
+
+static const struct test_case cases[] = {
+	{ "a == 1 || a == 2 || a == 3", 1, 2, 1 },
+	/* Userspace fields may be floating point numbers. */
+	{ "a == 1 || a == 2 || a == 3", 0, 3, 0 },
+	{ "$ctx.vtid == 1 || $ctx.vtid == 2 || $ctx.vtid == 3", 0, 2, 1 },
+	{ "a >= 1 && a <= 3 || a == 4", 1, 2, 1 },
+	{ "a == 1 || a == 2 || b == 3", 1, 3, 0 },
+	{ "a != 1 && a != 2 && a != 3", 1, 2, 1 },
+	{ "(a < 1 || a > 1) && (a < 3 || a > 3)", 1, 2, 1 },
+	{ "a > 1 && a > 5 && a < 10", 0, 2, 1 },
+	{ "a < 3 || a < 7", 0, 1, 1 },
+	{ "a == 1 && a == 2", 0, 0, 1 },
+	{ "d == 1 || d == 2 || d == 3", 0, 3, 0 },
+	{ "d < 1 || d >= 1", 0, 2, 0 },
+	{ "d > 1 && d > 2", 0, 1, 1 },
+	{ "1 == 1 && a > 3", 0, 1, 1 },
+	{ "0 && s == \"foo\"", 0, 0, 0 },
+	{ "a > 3 || 1.5", 0, 0, 1 },
+	{ "a == 1 && 0.5", 0, 0, 1 },
+	{ "s == \"foo\" && a == 1", 0, 2, 1 },
+	{ "(a == 1 || s == \"x\") && (a == 1 || s == \"x\")", 0, 2, 1 },
+	{ "-(-5) == a", 0, 1, 0 },
+	{ "!(a == 1)", 0, 1, 0 },
+	{ "!(a < 5)", 1, 1, 0 },
+	{ "!(a < 5)", 0, 1, 0 },
+	{ "!!(s == \"foo\")", 0, 1, 0 },
+	{ "a", 0, 0, 0 },
+};
+
+enum value_type {
+	VALUE_S64,
+	VALUE_DOUBLE,
+	VALUE_STRING,
+};
+
+struct value {
+	enum value_type type;
+	int64_t s64;
+	double d;
+	const char *str;
+};
+
+/* Field and context values of a sample event. */
+struct sample {
+	int64_t a, b, vtid;
+	double d;
+	const char *s;
+};
+
+static const int64_t a_values[] = {
+	INT64_MIN, -1, 0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, INT64_MAX,
+};
+static const int64_t b_values[] = { 2, 3 };
+static const int64_t vtid_values[] = { 1, 2, 3, 4 };
+static const double d_values[] = { 0.5, 1.0, 1.5, 2.0, 3.0, NAN };
+static const char *s_values[] = { "foo", "x" };
+
+static
+struct value load_ref(const struct ir_op *op, const struct sample *sample)
+{
+	struct value v = { .type = VALUE_S64 };
+	const char *name = op->u.load.u.ref;
+
+	if (!strcmp(name, "a")) {
+		v.s64 = sample->a;
+	} else if (!strcmp(name, "b")) {
+		v.s64 = sample->b;
+	} else if (!strcmp(name, "vtid")) {
+		v.s64 = sample->vtid;
+	} else if (!strcmp(name, "d")) {
+		v.type = VALUE_DOUBLE;
+		v.d = sample->d;
+	} else {
+		v.type = VALUE_STRING;
+		v.str = sample->s;
+	}
+	return v;
+}
+
+static
+double to_double(const struct value *v)
+{
+	return v->type == VALUE_DOUBLE ? v->d : (double) v->s64;
+}
+
+static
+int64_t truth(const struct value *v)
+{
+	if (v->type == VALUE_DOUBLE)
+		return (int64_t) v->d != 0;
+	return v->s64 != 0;
+}
+
+static
+int compare(enum op_type type, const struct value *l, const struct value *r)
+{
+	int cmp;
+
+	if (l->type == VALUE_STRING) {
+		cmp = strcmp(l->str, r->str);
+	} else if (l->type == VALUE_S64 && r->type == VALUE_S64) {
+		cmp = (l->s64 > r->s64) - (l->s64 < r->s64);
+	} else {
+		double a = to_double(l), b = to_double(r);
+
+		if (a != a || b != b)
+			return type == AST_OP_NE;
+		cmp = (a > b) - (a < b);
+	}
+	switch (type) {
+	case AST_OP_EQ:
+		return cmp == 0;
+	case AST_OP_NE:
+		return cmp != 0;
+	case AST_OP_GT:
+		return cmp > 0;
+	case AST_OP_LT:
+		return cmp < 0;
+	case AST_OP_GE:
+		return cmp >= 0;
+	case AST_OP_LE:
+		return cmp <= 0;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Evaluate the IR the way the tracer evaluates the bytecode generated from
+ * it, counting the comparisons.
+ */
+static
+struct value eval(const struct ir_op *op, const struct sample *sample,
+		unsigned long *compares)
+{
+	struct value v = { .type = VALUE_S64 }, l, r;
+
+	switch (op->op) {
+	case IR_OP_ROOT:
+		l = eval(op->u.root.child, sample, compares);
+		v.s64 = l.s64;
+		break;
+	case IR_OP_LOAD:
+		switch (op->data_type) {
+		case IR_DATA_STRING:
+			v.type = VALUE_STRING;
+			v.str = op->u.load.u.string;
+			break;
+		case IR_DATA_NUMERIC:
+			v.s64 = op->u.load.u.num;
+			break;
+		case IR_DATA_FLOAT:
+			v.type = VALUE_DOUBLE;
+			v.d = op->u.load.u.flt;
+			break;
+		default:
+			v = load_ref(op, sample);
+			break;
+		}
+		break;
+	case IR_OP_UNARY:
+		v = eval(op->u.unary.child, sample, compares);
+		if (op->u.unary.type == AST_UNARY_MINUS) {
+			if (v.type == VALUE_DOUBLE)
+				v.d = -v.d;
+			else
+				v.s64 = (int64_t) -(uint64_t) v.s64;
+		} else if (op->u.unary.type == AST_UNARY_NOT) {
+			v.s64 = v.type == VALUE_DOUBLE ? !v.d : !v.s64;
+			v.type = VALUE_S64;
+		}
+		break;
+	case IR_OP_BINARY:
+		l = eval(op->u.binary.left, sample, compares);
+		r = eval(op->u.binary.right, sample, compares);
+		v.s64 = compare(op->u.binary.type, &l, &r);
+		(*compares)++;
+		break;
+	case IR_OP_LOGICAL:
+		l = eval(op->u.logical.left, sample, compares);
+		v.s64 = truth(&l);
+		if (v.s64 == (op->u.logical.type == AST_OP_OR))
+			break;
+		r = eval(op->u.logical.right, sample, compares);
+		v.s64 = truth(&r);
+		break;
+	default:
+		break;
+	}
+	return v;
+}
+
+static
+unsigned int bytecode_compares(struct lttng_filter_bytecode *b)
+{
+	unsigned int pc = 0, nr = 0;
+
+	while (pc < b->reloc_table_offset) {
+		filter_opcode_t op = b->data[pc];
+
+		switch (op) {
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+			pc += sizeof(struct logical_op);
+			break;
+		case FILTER_OP_LOAD_FIELD_REF:
+		case FILTER_OP_GET_CONTEXT_REF:
+			pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			break;
+		case FILTER_OP_LOAD_STRING:
+			pc += sizeof(struct load_op)
+				+ strlen(&b->data[pc + 1]) + 1;
+			break;
+		case FILTER_OP_LOAD_S64:
+			pc += sizeof(struct load_op)
+				+ sizeof(struct literal_numeric);
+			break;
+		case FILTER_OP_LOAD_DOUBLE:
+			pc += sizeof(struct load_op)
+				+ sizeof(struct literal_double);
+			break;
+		default:
+			if (op >= FILTER_OP_EQ && op <= FILTER_OP_LE_S64_DOUBLE)
+				nr++;
+			pc++;
+			break;
+		}
+	}
+	return nr;
+}
+
+static
+struct filter_parser_ctx *compile(const char *expression, int optimize,
+		int kernel)
+{
+	struct filter_parser_ctx *ctx;
+	FILE *fmem;
+	int ret;
+
+	fmem = fmemopen((void *) expression, strlen(expression), "r");
+	if (!fmem)
+		return NULL;
+	ctx = filter_parser_ctx_alloc(fmem);
+	if (!ctx)
+		goto end;
+	ret = filter_parser_ctx_append_ast(ctx);
+	if (!ret)
+		ret = filter_visitor_set_parent(ctx);
+	if (!ret)
+		ret = filter_visitor_ir_generate(ctx);
+	if (!ret)
+		ret = filter_visitor_ir_check_binary_op_nesting(ctx);
+	if (!ret && optimize) {
+		ret = filter_visitor_ir_optimize(ctx, kernel);
+		/* The optimized IR must still be valid. */
+		if (!ret)
+			ret = filter_visitor_ir_check_binary_op_nesting(ctx);
+	}
+	if (!ret)
+		ret = filter_visitor_bytecode_generate(ctx);
+	if (ret) {
+		filter_bytecode_free(ctx);
+		filter_ir_free(ctx);
+		filter_parser_ctx_free(ctx);
+		ctx = NULL;
+	}
+end:
+	fclose(fmem);
+	return ctx;
+}
+
+static
+void release(struct filter_parser_ctx *ctx)
+{
+	filter_bytecode_free(ctx);
+	filter_ir_free(ctx);
+	filter_parser_ctx_free(ctx);
+}
+
+static
+void test_case(const struct test_case *tc)
+{
+	struct filter_parser_ctx *orig, *opt;
+	unsigned long orig_evals = 0, opt_evals = 0, mismatches = 0;
+	unsigned int ia, ib, iv, id, is, compares;
+	int better;
+
+	orig = compile(tc->expression, 0, tc->kernel);
+	opt = compile(tc->expression, 1, tc->kernel);
+	if (!orig || !opt) {
+		fail("Compile \"%s\"", tc->expression);
+		skip(TESTS_PER_CASE - 1, "Compile error");
+		goto end;
+	}
+
+	for (ia = 0; ia < ARRAY_SIZE(a_values); ia++)
+	for (ib = 0; ib < ARRAY_SIZE(b_values); ib++)
+	for (iv = 0; iv < ARRAY_SIZE(vtid_values); iv++)
+	for (id = 0; id < ARRAY_SIZE(d_values); id++)
+	for (is = 0; is < ARRAY_SIZE(s_values); is++) {
+		struct sample sample = {
+			.a = a_values[ia],
+			.b = b_values[ib],
+			.vtid = vtid_values[iv],
+			.d = d_values[id],
+			.s = s_values[is],
+		};
+		struct value r1, r2;
+
+		r1 = eval(orig->ir_root, &sample, &orig_evals);
+		r2 = eval(opt->ir_root, &sample, &opt_evals);
+		if (!!r1.s64 != !!r2.s64)
+			mismatches++;
+	}
+	ok(!mismatches, "Same results for \"%s\" (%s)", tc->expression,
+			tc->kernel ? "kernel" : "userspace");
+
+	compares = bytecode_compares(&opt->bytecode->b);
+	ok(compares == tc->compares, "%u comparisons left, expected %u",
+			compares, tc->compares);
+
+	better = bytecode_get_len(&opt->bytecode->b)
+			<= bytecode_get_len(&orig->bytecode->b);
+	if (tc->fewer_evaluations)
+		better = better && opt_evals < orig_evals;
+	else
+		better = better && opt_evals <= orig_evals;
+	ok(better, "Bytecode %u -> %u bytes, %lu -> %lu comparisons evaluated",
+			bytecode_get_len(&orig->bytecode->b),
+			bytecode_get_len(&opt->bytecode->b),
+			orig_evals, opt_evals);
+
+end:
+	if (orig)
+		release(orig);
+	if (opt)
+		release(opt);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	plan_tests(TESTS_PER_CASE * ARRAY_SIZE(cases));
+
+	diag("Filter IR optimization unit tests");
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++)
+		test_case(&cases[i]);
+
+	return exit_status();
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/hashtable/hashtable.h>
+#include <common/hashtable/utils.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/* Number of keys hashed by each distribution test. */
+#define NR_KEYS			(1UL << 16)
+/* Number of buckets used for the distribution (power of two). */
+#define NR_BUCKETS		(1UL << 10)
+/* Number of samples used for the avalanche test. */
+#define NR_AVALANCHE_SAMPLES	4096
+
+#define NUM_TESTS 12
+
+static unsigned long buckets[NR_BUCKETS];
+static unsigned long hashes[NR_KEYS];
+
+/*
+ * Return 1 if the given bucket occupancy is compatible with a uniform
+ * distribution. The chi-square statistic of a uniform distribution over B
+ * buckets has a mean of B - 1 and a standard deviation of sqrt(2(B - 1)); we
+ * allow six standard deviations which no decent hash should ever exceed.
+ */
+static int check_uniform(const char *name)
+{
+	unsigned long i;
+	double expected = (double) NR_KEYS / NR_BUCKETS, chi2 = 0, limit;
+
+	for (i = 0; i < NR_BUCKETS; i++) {
+		double diff = (double) buckets[i] - expected;
+
+		chi2 += (diff * diff) / expected;
+	}
+	limit = (NR_BUCKETS - 1) + 6 * sqrt(2 * (NR_BUCKETS - 1));
+
+	diag("%s: chi-square %.1f (limit %.1f)", name, chi2, limit);
+	return chi2 < limit;
+}
+
+static int cmp_ulong(const void *a, const void *b)
+{
+	unsigned long ua = *(const unsigned long *) a;
+	unsigned long ub = *(const unsigned long *) b;
+
+	return (ua > ub) - (ua < ub);
+}
+
+/*
+ * Return the number of duplicate values in the hashes array.
+ */
+static unsigned long count_collisions(void)
+{
+	unsigned long i, collisions = 0;
+
+	qsort(hashes, NR_KEYS, sizeof(hashes[0]), cmp_ulong);
+	for (i = 1; i < NR_KEYS; i++) {
+		if (hashes[i] == hashes[i - 1]) {
+			collisions++;
+		}
+	}
+
+	return collisions;
+}
+
+/*
+ * Hash NR_KEYS u64 keys generated as start + i * stride and check both the
+ * bucket distribution and the number of full hash collisions.
+ */
+static void test_u64_keys(uint64_t start, uint64_t stride, const char *name)
+{
+	unsigned long i;
+
+	memset(buckets, 0, sizeof(buckets));
+	for (i = 0; i < NR_KEYS; i++) {
+		uint64_t key = start + i * stride;
+
+		hashes[i] = hash_key_u64(&key, lttng_ht_seed);
+		buckets[hashes[i] & (NR_BUCKETS - 1)]++;
+	}
+
+	ok(check_uniform(name), "Uniform bucket distribution of %s u64 keys",
+			name);
+	ok(count_collisions() == 0, "No hash collision on %s u64 keys", name);
+}
+
+static void test_ulong_keys(void)
+{
+	unsigned long i;
+
+	memset(buckets, 0, sizeof(buckets));
+	for (i = 0; i < NR_KEYS; i++) {
+		hashes[i] = hash_key_ulong((void *) i, lttng_ht_seed);
+		buckets[hashes[i] & (NR_BUCKETS - 1)]++;
+	}
+
+	ok(check_uniform("sequential ulong"),
+			"Uniform bucket distribution of sequential ulong keys");
+	ok(count_collisions() == 0, "No hash collision on sequential ulong keys");
+}
+
+/*
+ * Two u64 keys are typically (session id, channel key) or (stream id, net
+ * seq num) pairs: a small first key and a sequential second key.
+ */
+static void test_two_u64_keys(void)
+{
+	unsigned long i;
+	int symmetric = 0, zero = 0;
+
+	memset(buckets, 0, sizeof(buckets));
+	for (i = 0; i < NR_KEYS; i++) {
+		struct lttng_ht_two_u64 key = {
+			.key1 = i & 0xf,
+			.key2 = i >> 4,
+		};
+
+		hashes[i] = hash_key_two_u64(&key, lttng_ht_seed);
+		buckets[hashes[i] & (NR_BUCKETS - 1)]++;
+	}
+
+	ok(check_uniform("two u64"),
+			"Uniform bucket distribution of two u64 keys");
+	ok(count_collisions() == 0, "No hash collision on two u64 keys");
+
+	for (i = 1; i < 1024; i++) {
+		struct lttng_ht_two_u64 ab = { .key1 = i, .key2 = i + 1 };
+		struct lttng_ht_two_u64 ba = { .key1 = i + 1, .key2 = i };
+		struct lttng_ht_two_u64 aa = { .key1 = i, .key2 = i };
+
+		if (hash_key_two_u64(&ab, lttng_ht_seed) ==
+				hash_key_two_u64(&ba, lttng_ht_seed)) {
+			symmetric++;
+		}
+		if (hash_key_two_u64(&aa, lttng_ht_seed) == 0) {
+			zero++;
+		}
+	}
+	ok(symmetric == 0, "Two u64 hash is not symmetric");
+	ok(zero == 0, "Two u64 hash of identical keys is not zero");
+}
+
+/*
+ * Flipping any input bit should flip about half of the output bits.
+ */
+static void test_u64_avalanche(void)
+{
+	unsigned long i, bit;
+	unsigned long long flipped = 0, total = 0;
+	double ratio;
+
+	srand(42);
+	for (i = 0; i < NR_AVALANCHE_SAMPLES; i++) {
+		uint64_t key = ((uint64_t) rand() << 32) ^ (uint64_t) rand();
+		unsigned long ref = hash_key_u64(&key, lttng_ht_seed);
+
+		for (bit = 0; bit < 64; bit++) {
+			uint64_t flip = key ^ (1ULL << bit);
+
+			flipped += __builtin_popcountl(ref ^
+					hash_key_u64(&flip, lttng_ht_seed));
+			total += sizeof(unsigned long) * 8;
+		}
+	}
+	ratio = (double) flipped / total;
+
+	diag("u64 avalanche ratio: %.4f", ratio);
+	ok(ratio > 0.49 && ratio < 0.51, "u64 hash avalanche ratio is ~0.5");
+}
+
+static void test_seed(void)
+{
+	uint64_t key = 1234;
+
+	ok(hash_key_u64(&key, 1) != hash_key_u64(&key, 2),
+			"u64 hash depends on the seed");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Hash table hash functions unit tests");
+
+	test_u64_keys(0, 1, "sequential");
+	test_u64_keys(1ULL << 32, 4096, "page strided");
+	test_ulong_keys();
+	test_two_u64_keys();
+	test_u64_avalanche();
+	test_seed();
+
+	return exit_status();
+}
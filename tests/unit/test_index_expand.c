@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap/tap.h>
+
+#include <common/common.h>
+#include <common/compress/compress.h>
+#include <common/defaults.h>
+#include <common/index/index.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define PACKET_SIZE		4096
+#define NR_PACKETS		3
+/* Content size of the last packet, the rest is zero padding. */
+#define LAST_CONTENT_SIZE	3000
+/* Size of an index entry of version 1.0, without the compression fields. */
+#define INDEX_1_0_LEN		(7 * sizeof(uint64_t))
+
+#define NUM_TESTS 16
+
+static char tmp_dir[] = "/tmp/test_index_expand.XXXXXX";
+static char trace_path[PATH_MAX];
+static char index_path[PATH_MAX];
+
+/* The packets as expanded, then as stored in the trace file. */
+static char plain[NR_PACKETS * PACKET_SIZE];
+static struct ctf_packet_index indexes[NR_PACKETS];
+
+/*
+ * Packet 0 is made of a few values and is stored compressed, packet 1 is
+ * random and stored as is, packet 2 is compressed without its zero padding.
+ */
+static void fill_packets(void)
+{
+	int i;
+	unsigned int seed = 1;
+
+	for (i = 0; i < PACKET_SIZE; i++) {
+		plain[i] = rand_r(&seed) % 4;
+		plain[PACKET_SIZE + i] = rand_r(&seed);
+	}
+	for (i = 0; i < LAST_CONTENT_SIZE; i++) {
+		plain[2 * PACKET_SIZE + i] = 'a' + i % 8;
+	}
+}
+
+static int write_file(const char *path, const void *buf, size_t len)
+{
+	int fd;
+	ssize_t ret;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		return -1;
+	}
+	ret = lttng_write(fd, buf, len);
+	close(fd);
+	return ret == len ? 0 : -1;
+}
+
+/* Return the content of a file, to be freed, or NULL on error. */
+static char *read_file(const char *path, size_t *len)
+{
+	int fd;
+	char *buf;
+	struct stat st;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+	buf = zmalloc(st.st_size + 1);
+	if (buf && lttng_read(fd, buf, st.st_size) != st.st_size) {
+		free(buf);
+		buf = NULL;
+	}
+	close(fd);
+	*len = st.st_size;
+	return buf;
+}
+
+/*
+ * Write the trace file of the packets as the consumer stores them and its
+ * index of the given minor version. A partial entry is appended to the index
+ * when partial is set.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int write_trace(uint32_t minor, int partial)
+{
+	int i, ret;
+	uint64_t stored_offset = 0;
+	uint32_t record_len = minor ? sizeof(struct ctf_packet_index) :
+		INDEX_1_0_LEN;
+	char stored[NR_PACKETS * PACKET_SIZE];
+	char records[sizeof(struct ctf_packet_index_file_hdr) +
+		(NR_PACKETS + 1) * sizeof(struct ctf_packet_index)];
+	size_t records_len = sizeof(struct ctf_packet_index_file_hdr);
+	struct ctf_packet_index_file_hdr hdr;
+
+	hdr.magic = htobe32(CTF_INDEX_MAGIC);
+	hdr.index_major = htobe32(CTF_INDEX_MAJOR);
+	hdr.index_minor = htobe32(minor);
+	hdr.packet_index_len = htobe32(record_len);
+	memcpy(records, &hdr, sizeof(hdr));
+
+	for (i = 0; i < NR_PACKETS; i++) {
+		struct ctf_packet_index *index = &indexes[i];
+		const char *packet = plain + i * PACKET_SIZE;
+		size_t content_size = i == 2 ? LAST_CONTENT_SIZE : PACKET_SIZE;
+		ssize_t stored_size = PACKET_SIZE;
+		char buf[PACKET_SIZE];
+
+		if (minor && i != 1) {
+			stored_size = compress_buffer(LTTNG_COMPRESSION_LZ4, packet,
+					content_size, buf, sizeof(buf));
+			if (stored_size <= 0 || stored_size >= PACKET_SIZE) {
+				return -1;
+			}
+		} else {
+			memcpy(buf, packet, PACKET_SIZE);
+		}
+		memcpy(stored + stored_offset, buf, stored_size);
+
+		memset(index, 0, sizeof(*index));
+		index->offset = htobe64(i * PACKET_SIZE);
+		index->packet_size = htobe64(PACKET_SIZE * CHAR_BIT);
+		index->content_size = htobe64(content_size * CHAR_BIT);
+		index->timestamp_begin = htobe64(1000 * i);
+		index->timestamp_end = htobe64(1000 * i + 999);
+		index->stream_id = htobe64(3);
+		index->compressed_offset = htobe64(stored_offset);
+		index->compressed_size = htobe64(stored_size);
+		memcpy(records + records_len, index, record_len);
+		records_len += record_len;
+		stored_offset += stored_size;
+	}
+	if (partial) {
+		memcpy(records + records_len, &indexes[0], record_len / 2);
+		records_len += record_len / 2;
+	}
+
+	ret = write_file(trace_path, stored, stored_offset);
+	if (ret < 0) {
+		return ret;
+	}
+	return write_file(index_path, records, records_len);
+}
+
+static void test_read_packet(void)
+{
+	int i, fd, ok_packets = 0;
+	char packet[PACKET_SIZE];
+	struct ctf_packet_index plain_index;
+
+	ok(index_is_stored(&indexes[0]) && index_is_stored(&indexes[1]) &&
+			index_is_stored(&indexes[2]),
+			"Packets after a compressed one are stored");
+	plain_index = indexes[1];
+	plain_index.compressed_offset = plain_index.offset;
+	ok(!index_is_stored(&plain_index),
+			"Packet at its offset and of its size is not stored");
+
+	fd = open(trace_path, O_RDONLY);
+	for (i = 0; fd >= 0 && i < NR_PACKETS; i++) {
+		memset(packet, 0xff, sizeof(packet));
+		if (index_read_packet(fd, &indexes[i], packet) == PACKET_SIZE &&
+				!memcmp(packet, plain + i * PACKET_SIZE, PACKET_SIZE)) {
+			ok_packets++;
+		}
+	}
+	ok(ok_packets == NR_PACKETS,
+			"Compressed and stored packets read back as plain");
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+static void test_expand(void)
+{
+	int i, ok_entries = 0;
+	char *trace, *index;
+	size_t trace_len, index_len;
+	struct ctf_packet_index_file_hdr hdr;
+
+	ok(index_expand_trace_file(index_path, trace_path) == 1,
+			"Trace file with stored packets is expanded");
+
+	trace = read_file(trace_path, &trace_len);
+	ok(trace && trace_len == sizeof(plain) &&
+			!memcmp(trace, plain, sizeof(plain)),
+			"Expanded trace file holds the plain packets");
+	free(trace);
+
+	index = read_file(index_path, &index_len);
+	ok(index && index_len == sizeof(hdr) +
+			NR_PACKETS * sizeof(struct ctf_packet_index),
+			"Partial last index entry is dropped");
+	if (!index || index_len < sizeof(hdr)) {
+		skip(3, "No expanded index");
+		free(index);
+		return;
+	}
+	memcpy(&hdr, index, sizeof(hdr));
+	ok(be32toh(hdr.index_minor) == 1 &&
+			be32toh(hdr.packet_index_len) == sizeof(struct ctf_packet_index),
+			"Index header is kept");
+	for (i = 0; i < NR_PACKETS &&
+			sizeof(hdr) + (i + 1) * sizeof(indexes[0]) <= index_len; i++) {
+		struct ctf_packet_index entry, expected = indexes[i];
+
+		memcpy(&entry, index + sizeof(hdr) + i * sizeof(entry),
+				sizeof(entry));
+		expected.compressed_offset = expected.offset;
+		expected.compressed_size = htobe64(PACKET_SIZE);
+		if (!memcmp(&entry, &expected, sizeof(entry)) &&
+				!index_is_stored(&entry)) {
+			ok_entries++;
+		}
+	}
+	ok(ok_entries == NR_PACKETS,
+			"Index entries point to the expanded packets");
+	free(index);
+
+	ok(index_expand_trace_file(index_path, trace_path) == 0,
+			"Expanded trace file is left as is");
+}
+
+/* Compare the trace and index files against what write_trace() wrote. */
+static int files_unchanged(const char *trace_before, size_t trace_len_before,
+		const char *index_before, size_t index_len_before)
+{
+	int ret;
+	char *trace, *index;
+	size_t trace_len = 0, index_len = 0;
+
+	trace = read_file(trace_path, &trace_len);
+	index = read_file(index_path, &index_len);
+	ret = trace && index && trace_len == trace_len_before &&
+		index_len == index_len_before &&
+		!memcmp(trace, trace_before, trace_len) &&
+		!memcmp(index, index_before, index_len);
+	free(trace);
+	free(index);
+	return ret;
+}
+
+static void test_untouched(void)
+{
+	char *trace, *index;
+	size_t trace_len = 0, index_len = 0;
+
+	ok(write_trace(0, 0) == 0, "Write a trace file with a 1.0 index");
+	trace = read_file(trace_path, &trace_len);
+	index = read_file(index_path, &index_len);
+	ok(index_expand_trace_file(index_path, trace_path) == 0,
+			"Trace file of a 1.0 index is left as is");
+	ok(files_unchanged(trace, trace_len, index, index_len),
+			"Trace and 1.0 index files are untouched");
+	free(trace);
+	free(index);
+
+	/* A stored size larger than the packet is invalid. */
+	ok(write_trace(1, 0) == 0, "Write a trace file with a 1.1 index");
+	indexes[1].compressed_size = htobe64(PACKET_SIZE + 1);
+	index = read_file(index_path, &index_len);
+	if (index && index_len >= sizeof(struct ctf_packet_index_file_hdr) +
+			2 * sizeof(indexes[0])) {
+		memcpy(index + sizeof(struct ctf_packet_index_file_hdr) +
+				sizeof(indexes[0]), &indexes[1], sizeof(indexes[0]));
+		(void) write_file(index_path, index, index_len);
+	}
+	trace = read_file(trace_path, &trace_len);
+	ok(index_expand_trace_file(index_path, trace_path) < 0,
+			"Invalid stored packet size is an error");
+	ok(files_unchanged(trace, trace_len, index, index_len),
+			"Failed expansion leaves the files untouched");
+	free(trace);
+	free(index);
+}
+
+int main(int argc, char **argv)
+{
+	char index_dir[PATH_MAX];
+
+	plan_tests(NUM_TESTS);
+
+	diag("Trace file expansion unit tests");
+
+	if (!mkdtemp(tmp_dir)) {
+		diag("Unable to create %s", tmp_dir);
+		return EXIT_FAILURE;
+	}
+	snprintf(index_dir, sizeof(index_dir), "%s/" DEFAULT_INDEX_DIR, tmp_dir);
+	snprintf(trace_path, sizeof(trace_path), "%s/chan_0", tmp_dir);
+	snprintf(index_path, sizeof(index_path), "%s/" DEFAULT_INDEX_DIR
+			"/chan_0" DEFAULT_INDEX_FILE_SUFFIX, tmp_dir);
+	if (mkdir(index_dir, S_IRWXU)) {
+		diag("Unable to create %s", index_dir);
+		return EXIT_FAILURE;
+	}
+
+	fill_packets();
+	ok(write_trace(1, 1) == 0,
+			"Write a trace file with a 1.1 index and a partial entry");
+	test_read_packet();
+	test_expand();
+	test_untouched();
+
+	(void) unlink(trace_path);
+	(void) unlink(index_path);
+	(void) rmdir(index_dir);
+	(void) rmdir(tmp_dir);
+	return exit_status();
+}
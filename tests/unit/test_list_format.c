@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <common/sessiond-comm/list.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define NR_APPS			8
+#define NR_PROVIDER_EVENTS	64
+#define NR_EVENTS		(NR_APPS * NR_PROVIDER_EVENTS)
+#define NR_EVENT_FIELDS		4
+
+#define NUM_TESTS 15
+
+/*
+ * Fill the list the way a UST tracepoint list is: every application
+ * registers the same events.
+ */
+static void fill_events(struct lttng_event *events)
+{
+	int i;
+
+	memset(events, 0, NR_EVENTS * sizeof(*events));
+	for (i = 0; i < NR_EVENTS; i++) {
+		snprintf(events[i].name, sizeof(events[i].name),
+				"provider:event_%d", i % NR_PROVIDER_EVENTS);
+		events[i].type = LTTNG_EVENT_TRACEPOINT;
+		events[i].loglevel_type = LTTNG_EVENT_LOGLEVEL_SINGLE;
+		events[i].loglevel = i % 15;
+		events[i].enabled = -1;
+		events[i].pid = 1000 + i / NR_PROVIDER_EVENTS;
+	}
+}
+
+static void test_events(void)
+{
+	ssize_t len, nb;
+	char *payload;
+	struct lttng_event events[NR_EVENTS], *decoded = NULL;
+
+	fill_events(events);
+
+	len = lttcomm_list_encode_events(events, NR_EVENTS, &payload);
+	ok(len > 0, "Encode %d events", NR_EVENTS);
+	ok(len < NR_EVENTS * sizeof(struct lttng_event) / 10,
+			"Compact list is at least 10 times smaller (%zd bytes)", len);
+	ok(lttcomm_list_is_compact(payload, len), "Compact list is detected");
+	ok(!lttcomm_list_is_compact((char *) events, sizeof(events)),
+			"Plain event array is not detected as compact");
+
+	nb = lttcomm_list_decode_events(payload, len, &decoded);
+	ok(nb == NR_EVENTS, "Decode %d events", NR_EVENTS);
+	ok(decoded && !memcmp(events, decoded, sizeof(events)),
+			"Decoded events match the encoded ones");
+
+	/* Any truncation must be caught. */
+	ok(lttcomm_list_decode_events(payload, len - 1, &decoded) < 0,
+			"Truncated list is rejected");
+
+	free(decoded);
+	free(payload);
+}
+
+static void test_probe_events(void)
+{
+	ssize_t len, nb;
+	char *payload;
+	struct lttng_event events[2], *decoded = NULL;
+
+	memset(events, 0, sizeof(events));
+	strcpy(events[0].name, "my_probe");
+	events[0].type = LTTNG_EVENT_PROBE;
+	events[0].enabled = 1;
+	events[0].attr.probe.addr = 0xffffffff81000000ULL;
+	events[0].attr.probe.offset = 0x10;
+	strcpy(events[0].attr.probe.symbol_name, "do_sys_open");
+	strcpy(events[1].name, "my_function");
+	events[1].type = LTTNG_EVENT_FUNCTION_ENTRY;
+	events[1].filter = 1;
+	strcpy(events[1].attr.ftrace.symbol_name, "vfs_read");
+
+	len = lttcomm_list_encode_events(events, 2, &payload);
+	nb = lttcomm_list_decode_events(payload, len, &decoded);
+	ok(nb == 2, "Decode probe and function events");
+	ok(decoded && !memcmp(events, decoded, sizeof(events)),
+			"Probe and function attributes are preserved");
+
+	free(decoded);
+	free(payload);
+}
+
+static void test_fields(void)
+{
+	int i;
+	ssize_t len, nb;
+	char *payload;
+	struct lttng_event events[NR_EVENTS];
+	struct lttng_event_field *fields, *decoded = NULL;
+	size_t nb_fields = NR_EVENTS * NR_EVENT_FIELDS;
+
+	fill_events(events);
+	fields = calloc(nb_fields, sizeof(*fields));
+	if (!fields) {
+		diag("calloc failed");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nb_fields; i++) {
+		snprintf(fields[i].field_name, sizeof(fields[i].field_name),
+				"field_%d", i % NR_EVENT_FIELDS);
+		fields[i].type = LTTNG_EVENT_FIELD_INTEGER;
+		fields[i].nowrite = i % 2;
+		fields[i].event = events[i / NR_EVENT_FIELDS];
+	}
+
+	len = lttcomm_list_encode_fields(fields, nb_fields, &payload);
+	ok(len > 0, "Encode %zu fields", nb_fields);
+	ok(len < nb_fields * sizeof(struct lttng_event_field) / 10,
+			"Compact field list is at least 10 times smaller (%zd bytes)",
+			len);
+
+	nb = lttcomm_list_decode_fields(payload, len, &decoded);
+	ok(nb == nb_fields, "Decode %zu fields", nb_fields);
+	ok(decoded && !memcmp(fields, decoded, nb_fields * sizeof(*fields)),
+			"Decoded fields match the encoded ones");
+
+	/* Point the first field to a nonexistent event. */
+	memset(payload + sizeof(struct lttcomm_list_header) +
+			NR_EVENTS * sizeof(struct lttcomm_list_event) +
+			sizeof(uint32_t), 0xff, sizeof(uint32_t));
+	ok(lttcomm_list_decode_fields(payload, len, &decoded) < 0,
+			"Out of bounds event index is rejected");
+
+	free(decoded);
+	free(payload);
+	free(fields);
+}
+
+static void test_empty(void)
+{
+	ssize_t len, nb;
+	char *payload;
+	struct lttng_event *decoded = NULL;
+
+	len = lttcomm_list_encode_events(NULL, 0, &payload);
+	nb = lttcomm_list_decode_events(payload, len, &decoded);
+	ok(nb == 0, "Empty list round trip");
+
+	free(decoded);
+	free(payload);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Compact list format unit tests");
+
+	test_events();
+	test_probe_events();
+	test_fields();
+	test_empty();
+
+	return exit_status();
+}
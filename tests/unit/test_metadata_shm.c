@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap/tap.h>
+
+#include <common/consumer.h>
+#include <common/consumer-metadata-cache.h>
+#include <common/metadata-shm.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+/* Normally defined by consumer.c. */
+struct lttng_consumer_global_data consumer_data;
+
+#define FIRST_ALLOC_LEN		256
+#define FIRST_LEN		100
+#define SECOND_ALLOC_LEN	65536
+#define SECOND_LEN		40000
+
+#define NUM_TESTS 14
+
+/* Session daemon side of the shared memory. */
+static int shm_fd = -1;
+static struct lttng_metadata_shm *shm;
+static size_t shm_alloc_len;
+
+static struct lttng_consumer_channel channel;
+
+/* Same steps as create_metadata_shm() of the session daemon. */
+static int create_shm(void)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "/lttng-test-metadata-%d", getpid());
+	shm_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (shm_fd < 0) {
+		return -1;
+	}
+	if (shm_unlink(name) || ftruncate(shm_fd, LTTNG_METADATA_SHM_HEADER_LEN)) {
+		return -1;
+	}
+	shm = mmap(NULL, LTTNG_METADATA_SHM_HEADER_LEN, PROT_READ | PROT_WRITE,
+			MAP_SHARED, shm_fd, 0);
+	if (shm == MAP_FAILED) {
+		shm = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static int grow_shm(size_t alloc_len)
+{
+	struct lttng_metadata_shm *new_shm;
+
+	new_shm = lttng_metadata_shm_grow(shm_fd, shm, shm_alloc_len, alloc_len);
+	if (!new_shm) {
+		return -1;
+	}
+	shm = new_shm;
+	shm_alloc_len = alloc_len;
+	return 0;
+}
+
+static void fill(char *data, size_t from, size_t to)
+{
+	size_t i;
+
+	for (i = from; i < to; i++) {
+		data[i] = 'a' + i % 26;
+	}
+}
+
+static int check(const char *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (data[i] != 'a' + i % 26) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void test_pull(void)
+{
+	int ret;
+	uint64_t offset = 0;
+	struct consumer_metadata_cache *cache = channel.metadata_cache;
+
+	ok(grow_shm(FIRST_ALLOC_LEN) == 0, "Grow the shm to %d bytes",
+			FIRST_ALLOC_LEN);
+	fill(shm->data, 0, FIRST_LEN);
+	lttng_metadata_shm_publish(shm, FIRST_LEN);
+
+	ret = consumer_metadata_cache_map_shm(&channel, dup(shm_fd));
+	ok(ret == 0 && cache->shm_mapped_len ==
+			LTTNG_METADATA_SHM_HEADER_LEN + FIRST_ALLOC_LEN,
+			"Consumer maps the whole shm");
+
+	ret = consumer_metadata_cache_pull_shm(&channel, &offset);
+	ok(ret == 0 && offset == FIRST_LEN, "First pull returns offset %" PRIu64,
+			offset);
+	ok(cache->contiguous == FIRST_LEN && check(cache->data, FIRST_LEN),
+			"First pull copies the published metadata");
+
+	/* Unpublished bytes are not pulled. */
+	fill(shm->data, FIRST_LEN, FIRST_ALLOC_LEN);
+	ret = consumer_metadata_cache_pull_shm(&channel, &offset);
+	ok(ret == 0 && offset == FIRST_LEN &&
+			cache->total_bytes_written == FIRST_LEN,
+			"Pull without new publication copies nothing");
+
+	/* Grow past the consumer mapping between two pulls. */
+	ok(grow_shm(SECOND_ALLOC_LEN) == 0, "Grow the shm to %d bytes",
+			SECOND_ALLOC_LEN);
+	ok(check(shm->data, FIRST_ALLOC_LEN),
+			"Growing keeps the metadata written so far");
+	fill(shm->data, FIRST_ALLOC_LEN, SECOND_LEN);
+	lttng_metadata_shm_publish(shm, SECOND_LEN);
+	ok(cache->shm_mapped_len < LTTNG_METADATA_SHM_HEADER_LEN + SECOND_LEN,
+			"Published length is beyond the consumer mapping");
+
+	ret = consumer_metadata_cache_pull_shm(&channel, &offset);
+	ok(ret == 0 && offset == SECOND_LEN,
+			"Second pull returns offset %" PRIu64, offset);
+	ok(cache->shm_mapped_len ==
+			LTTNG_METADATA_SHM_HEADER_LEN + SECOND_ALLOC_LEN,
+			"Consumer remaps the grown shm");
+	ok(cache->contiguous == SECOND_LEN &&
+			cache->total_bytes_written == SECOND_LEN &&
+			check(cache->data, SECOND_LEN),
+			"Second pull copies the metadata past the old mapping");
+}
+
+static void test_limit(void)
+{
+	uint64_t offset = 0;
+
+	ok(!lttng_metadata_shm_grow(shm_fd, shm, shm_alloc_len,
+			(size_t) LTTNG_METADATA_SHM_MAX_LEN + 1),
+			"Growing past the maximum length is rejected");
+
+	lttng_metadata_shm_publish(shm, (uint64_t) LTTNG_METADATA_SHM_MAX_LEN + 1);
+	ok(consumer_metadata_cache_pull_shm(&channel, &offset) < 0,
+			"Published length past the maximum is rejected");
+	ok(channel.metadata_cache->max_offset == SECOND_LEN,
+			"Rejected pull leaves the cache untouched");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Metadata shared memory unit tests");
+
+	if (create_shm()) {
+		diag("Unable to create the metadata shm");
+		return EXIT_FAILURE;
+	}
+	if (consumer_metadata_cache_allocate(&channel)) {
+		diag("Unable to allocate the metadata cache");
+		return EXIT_FAILURE;
+	}
+
+	test_pull();
+	test_limit();
+
+	consumer_metadata_cache_destroy(&channel);
+	munmap(shm, LTTNG_METADATA_SHM_HEADER_LEN + shm_alloc_len);
+	close(shm_fd);
+	return exit_status();
+}
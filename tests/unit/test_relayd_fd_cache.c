@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap/tap.h>
+
+#include <bin/lttng-relayd/fd-cache.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define CACHE_CAP	2
+#define NR_FILES	(CACHE_CAP + 2)
+
+#define NUM_TESTS 7
+
+static char tmp_dir[] = "/tmp/test-relayd-fd-cache-XXXXXX";
+static char paths[NR_FILES][64];
+
+static struct relay_fd *create_file(int i)
+{
+	int fd;
+
+	snprintf(paths[i], sizeof(paths[i]), "%s/file%d", tmp_dir, i);
+	fd = open(paths[i], O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	assert(fd >= 0);
+
+	return relay_fd_create(fd);
+}
+
+static void test_fd_cache(void)
+{
+	int i, fd, all_written = 1;
+	char c;
+	struct relay_fd *files[NR_FILES];
+
+	relay_fd_cache_init(CACHE_CAP);
+
+	for (i = 0; i < NR_FILES; i++) {
+		files[i] = create_file(i);
+		assert(files[i]);
+		fd = relay_fd_acquire(files[i]);
+		c = 'a' + i;
+		all_written &= (fd >= 0 && write(fd, &c, 1) == 1);
+		relay_fd_release(files[i]);
+	}
+	ok(all_written, "Write in every file");
+
+	ok(files[0]->fd < 0 && files[1]->fd < 0,
+			"Least recently used files are closed over the cap");
+	ok(files[NR_FILES - 1]->fd >= 0, "Most recently used file is open");
+
+	/* Reopening must restore the offset where we stopped writing. */
+	fd = relay_fd_acquire(files[0]);
+	ok(fd >= 0 && lseek(fd, 0, SEEK_CUR) == 1,
+			"Closed file is reopened at its offset");
+	c = 'z';
+	ok(write(fd, &c, 1) == 1 && pread(fd, &c, 1, 0) == 1 && c == 'a',
+			"Reopened file keeps its content");
+	relay_fd_release(files[0]);
+
+	/* A file in use is never closed. */
+	fd = relay_fd_acquire(files[1]);
+	for (i = 0; i < NR_FILES; i++) {
+		if (i == 1) {
+			continue;
+		}
+		(void) relay_fd_acquire(files[i]);
+		relay_fd_release(files[i]);
+	}
+	ok(files[1]->fd == fd, "File in use is not closed");
+	relay_fd_release(files[1]);
+
+	for (i = 0; i < NR_FILES; i++) {
+		relay_fd_get_ref(files[i]);
+		relay_fd_put_ref(files[i]);
+		relay_fd_put_ref(files[i]);
+		(void) unlink(paths[i]);
+	}
+	ok(rmdir(tmp_dir) == 0, "Every file is released and removed");
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Relayd fd cache unit tests");
+
+	if (!mkdtemp(tmp_dir)) {
+		diag("Cannot create temporary directory");
+		return exit_status();
+	}
+
+	test_fd_cache();
+
+	return exit_status();
+}
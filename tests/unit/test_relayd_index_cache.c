@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 - LTTng-tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 2 only, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tap/tap.h>
+
+#include <bin/lttng-relayd/index-cache.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+
+#define CACHE_ENTRIES	8
+
+#define NUM_TESTS 11
+
+static void make_index(struct ctf_packet_index *index, uint64_t value)
+{
+	memset(index, 0, sizeof(*index));
+	index->offset = value;
+	index->timestamp_begin = value;
+}
+
+static int check_get(struct index_cache *cache, uint64_t tracefile_id,
+		uint64_t pos, uint64_t expected)
+{
+	struct ctf_packet_index index;
+
+	if (index_cache_get(cache, tracefile_id, pos, &index)) {
+		return 0;
+	}
+	return index.offset == expected && index.timestamp_begin == expected;
+}
+
+static void test_create(void)
+{
+	struct index_cache *cache;
+
+	ok(index_cache_create(sizeof(struct index_cache_entry) - 1) == NULL,
+			"Budget smaller than one entry disables the cache");
+
+	cache = index_cache_create(3 * sizeof(struct index_cache_entry));
+	ok(cache && cache->size == 2,
+			"Cache size is rounded down to a power of two");
+	index_cache_destroy(cache);
+}
+
+static void test_lookup(void)
+{
+	uint64_t i;
+	int all_found = 1;
+	struct ctf_packet_index index;
+	struct index_cache *cache;
+
+	cache = index_cache_create(CACHE_ENTRIES *
+			sizeof(struct index_cache_entry));
+	assert(cache);
+
+	ok(index_cache_get(cache, 0, 0, &index) == -ENOENT,
+			"Empty cache has no index");
+
+	for (i = 0; i < CACHE_ENTRIES; i++) {
+		make_index(&index, i);
+		index_cache_add(cache, 0, i, &index);
+	}
+	for (i = 0; i < CACHE_ENTRIES; i++) {
+		all_found &= check_get(cache, 0, i, i);
+	}
+	ok(all_found, "Every index of a full cache is found");
+	ok(index_cache_get(cache, 0, CACHE_ENTRIES, &index) == -ENOENT,
+			"Index not written yet is not found");
+	ok(index_cache_get(cache, 1, 0, &index) == -ENOENT,
+			"Index of another tracefile is not found");
+
+	/* Overwrite the oldest entries. */
+	for (i = CACHE_ENTRIES; i < CACHE_ENTRIES + 3; i++) {
+		make_index(&index, i);
+		index_cache_add(cache, 0, i, &index);
+	}
+	ok(index_cache_get(cache, 0, 2, &index) == -ENOENT,
+			"Overwritten index is not found");
+	ok(check_get(cache, 0, 3, 3) && check_get(cache, 0, 10, 10),
+			"Oldest and newest remaining indexes are found");
+
+	/* Rotation to a new tracefile. */
+	make_index(&index, 100);
+	index_cache_add(cache, 1, 0, &index);
+	make_index(&index, 101);
+	index_cache_add(cache, 1, 1, &index);
+	ok(check_get(cache, 1, 0, 100) && check_get(cache, 1, 1, 101),
+			"Indexes of the new tracefile are found");
+	ok(index_cache_get(cache, 0, 10, &index) == -ENOENT,
+			"Indexes of the previous tracefile are read from the file");
+
+	/* A missing position must not return the wrong index. */
+	make_index(&index, 103);
+	index_cache_add(cache, 1, 3, &index);
+	ok(index_cache_get(cache, 1, 1, &index) == -ENOENT &&
+			check_get(cache, 1, 3, 103),
+			"Hole in the positions is detected");
+
+	index_cache_destroy(cache);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(NUM_TESTS);
+
+	diag("Relayd index cache unit tests");
+
+	test_create();
+	test_lookup();
+
+	return exit_status();
+}